@@ -6,6 +6,7 @@
 #include <mapnik/value_types.hpp>
 
 // stl
+#include <algorithm>
 #include <chrono>
 #include <iomanip>
 #include <iostream>
@@ -43,9 +43,23 @@ benchmarks = [
     "test_font_registration.cpp",
     "test_rendering.cpp",
     "test_rendering_shared_map.cpp",
+    "test_csv_loading.cpp",
+    "test_memory_datasource.cpp",
+    "test_image_scaling.cpp",
 ]
 for cpp_test in benchmarks:
     test_program = test_env_local.Program('out/'+cpp_test.replace('.cpp',''), source=[cpp_test])
     if 'install' in COMMAND_LINE_TARGETS:
         env.Alias('install',test_program)
     #Depends(test_program, env.subst('../src/%s' % env['MAPNIK_LIB_NAME']))
+
+# benchmarks built against shape plugin sources
+shape_env = test_env_local.Clone()
+shape_env.AppendUnique(CPPPATH=['../plugins/input/shape'])
+dbfile_obj = shape_env.Object('out/dbfile', source=['../plugins/input/shape/dbfile.cpp'])
+shape_io_obj = shape_env.Object('out/shape_io', source=['../plugins/input/shape/shape_io.cpp'])
+for cpp_test, objects in [("test_dbf_decoding.cpp", [dbfile_obj]),
+                          ("test_shape_decoding.cpp", [dbfile_obj, shape_io_obj])]:
+    test_program = shape_env.Program('out/'+cpp_test.replace('.cpp',''), source=[cpp_test] + objects)
+    if 'install' in COMMAND_LINE_TARGETS:
+        env.Alias('install',test_program)
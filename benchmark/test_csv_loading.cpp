@@ -0,0 +1,126 @@
+#include "bench_framework.hpp"
+#include <mapnik/datasource.hpp>
+#include <mapnik/datasource_cache.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/query.hpp>
+#include <mapnik/util/fs.hpp>
+
+// stl
+#include <fstream>
+#include <iostream>
+#include <string>
+
+// writes the rows of benchmark/data/roads.csv `copies` times under a single header
+bool write_csv(std::string const& source, std::string const& filename, int copies)
+{
+    std::ifstream in(source.c_str(), std::ios::in | std::ios::binary);
+    if (!in) return false;
+    std::string header;
+    std::getline(in, header);
+    std::string rows((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (!rows.empty() && rows.back() != '\n') rows += '\n';
+    std::ofstream out(filename.c_str(), std::ios::out | std::ios::binary);
+    out << header << '\n';
+    for (int i = 0; i < copies; ++i)
+    {
+        out.write(rows.data(), rows.size());
+    }
+    return out.good();
+}
+
+class test : public benchmark::test_case
+{
+    std::string filename_;
+    mapnik::value_integer jobs_;
+    bool cache_features_;
+public:
+    test(mapnik::parameters const& params,
+         std::string const& filename,
+         mapnik::value_integer jobs,
+         bool cache_features)
+     : test_case(params),
+       filename_(filename),
+       jobs_(jobs),
+       cache_features_(cache_features) {}
+
+    mapnik::datasource_ptr load(mapnik::value_integer jobs) const
+    {
+        mapnik::parameters p;
+        p["type"] = "csv";
+        p["file"] = filename_;
+        p["filesize_max"] = "0";
+        p["jobs"] = std::to_string(jobs);
+        p["cache_features"] = cache_features_ ? "true" : "false";
+        return mapnik::datasource_cache::instance().create(p);
+    }
+
+    // the chunked load has to give the same features as a serial one
+    bool validate() const
+    {
+        mapnik::datasource_ptr serial = load(1);
+        mapnik::datasource_ptr parallel = load(jobs_);
+        if (!(serial->envelope() == parallel->envelope())) return false;
+        mapnik::query q(serial->envelope());
+        mapnik::featureset_ptr fs0 = serial->features(q);
+        mapnik::featureset_ptr fs1 = parallel->features(q);
+        std::size_t count = 0;
+        mapnik::feature_ptr f0;
+        while ((f0 = fs0->next()))
+        {
+            mapnik::feature_ptr f1 = fs1->next();
+            if (!f1 || f0->id() != f1->id() || !(f0->envelope() == f1->envelope())) return false;
+            ++count;
+        }
+        return count > 0 && !fs1->next();
+    }
+
+    bool operator()() const
+    {
+        for (std::size_t i=0;i<iterations_;++i) {
+            mapnik::datasource_ptr ds = load(jobs_);
+            if (!ds->envelope().valid()) return false;
+        }
+        return true;
+    }
+};
+
+// loads roads.csv scaled up to ~55MB (--copies N to change its size, ~7500
+// copies give a 2GB file) or any csv given with --file, serially and in chunks
+int main(int argc, char** argv)
+{
+    mapnik::parameters params;
+    benchmark::handle_args(argc,argv,params);
+    mapnik::datasource_cache::instance().register_datasources("./plugins/input/");
+    boost::optional<std::string> file = params.get<std::string>("file");
+    std::string filename;
+    if (file)
+    {
+        filename = *file;
+    }
+    else
+    {
+        mapnik::value_integer copies = *params.get<mapnik::value_integer>("copies", 200);
+        filename = "./benchmark/out/roads_" + std::to_string(copies) + ".csv";
+        if (!mapnik::util::exists(filename)
+            && !write_csv("./benchmark/data/roads.csv", filename, copies))
+        {
+            std::clog << "could not write " << filename << "\n";
+            return -1;
+        }
+    }
+    mapnik::value_integer jobs = *params.get<mapnik::value_integer>("jobs", std::thread::hardware_concurrency());
+    int result = 0;
+    {
+        test test_runner(params, filename, 1, true);
+        result |= run(test_runner,"csv loading (serial)");
+    }
+    {
+        test test_runner(params, filename, jobs, true);
+        result |= run(test_runner,"csv loading (jobs=" + std::to_string(jobs) + ")");
+    }
+    {
+        test test_runner(params, filename, jobs, false);
+        result |= run(test_runner,"csv indexing (jobs=" + std::to_string(jobs) + ")");
+    }
+    return result;
+}
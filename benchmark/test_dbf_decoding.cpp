@@ -0,0 +1,143 @@
+#include "bench_framework.hpp"
+#include <mapnik/feature.hpp>
+#include <mapnik/feature_factory.hpp>
+#include <mapnik/unicode.hpp>
+#include <mapnik/util/fs.hpp>
+#include "dbfile.hpp"
+
+// stl
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// writes a dbf with `count` records of (NAME C32, POP N10, AREA N19.6, VALID L1, UPDATED D8)
+void write_dbf(std::string const& filename, int count)
+{
+    struct field { const char* name; char type; int length; int dec; };
+    std::vector<field> fields = {
+        {"NAME", 'C', 32, 0},
+        {"POP", 'N', 10, 0},
+        {"AREA", 'N', 19, 6},
+        {"VALID", 'L', 1, 0},
+        {"UPDATED", 'D', 8, 0}
+    };
+    int record_length = 1;
+    for (auto const& fd : fields) record_length += fd.length;
+    int header_length = 32 * fields.size() + 33;
+
+    std::ofstream out(filename.c_str(), std::ios::out | std::ios::binary);
+    char header[32] = {0};
+    header[0] = 3;
+    header[1] = 115; header[2] = 1; header[3] = 1;
+    for (int i = 0; i < 4; ++i) header[4 + i] = static_cast<char>((count >> (8 * i)) & 0xff);
+    header[8] = static_cast<char>(header_length & 0xff);
+    header[9] = static_cast<char>(header_length >> 8);
+    header[10] = static_cast<char>(record_length & 0xff);
+    header[11] = static_cast<char>(record_length >> 8);
+    out.write(header, 32);
+    for (auto const& fd : fields)
+    {
+        char desc[32] = {0};
+        std::strncpy(desc, fd.name, 10);
+        desc[11] = fd.type;
+        desc[16] = static_cast<char>(fd.length);
+        desc[17] = static_cast<char>(fd.dec);
+        out.write(desc, 32);
+    }
+    out.put('\r');
+    std::vector<char> record(record_length + 1);
+    for (int i = 1; i <= count; ++i)
+    {
+        std::snprintf(record.data(), record.size(), " %-32s%10d%19.6f%c%08d",
+                      ("feature " + std::to_string(i)).c_str(),
+                      i,
+                      i * 0.5,
+                      (i % 2) ? 'T' : 'F',
+                      20150101);
+        out.write(record.data(), record_length);
+    }
+    out.put('\x1a');
+}
+
+class test : public benchmark::test_case
+{
+    std::string filename_;
+    std::vector<int> cols_;
+    bool file_order_;
+public:
+    test(mapnik::parameters const& params,
+         std::string const& filename,
+         std::vector<int> const& cols,
+         bool file_order)
+     : test_case(params),
+       filename_(filename),
+       cols_(cols),
+       file_order_(file_order) {}
+
+    bool validate() const
+    {
+        dbf_file dbf(filename_);
+        if (!dbf.is_open() || dbf.num_fields() != 5) return false;
+        mapnik::transcoder tr("utf-8");
+        mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+        for (int i = 0; i < dbf.num_fields(); ++i) ctx->push(dbf.descriptor(i).name_);
+        int index = dbf.num_records();
+        mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, index));
+        dbf.move_to(index);
+        dbf.add_attributes({0, 1, 2, 3, 4}, tr, *feature);
+        return feature->get("NAME").to_string() == "feature " + std::to_string(index)
+            && feature->get("POP") == mapnik::value_integer(index)
+            && feature->get("AREA") == index * 0.5
+            && feature->get("VALID") == ((index % 2) ? true : false)
+            && feature->get("UPDATED").to_string() == "20150101";
+    }
+
+    bool operator()() const
+    {
+        for (std::size_t i=0;i<iterations_;++i) {
+            dbf_file dbf(filename_);
+            dbf.set_batch_mode(file_order_);
+            mapnik::transcoder tr("utf-8");
+            mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+            for (int col : cols_) ctx->push(dbf.descriptor(col).name_);
+            int count = dbf.num_records();
+            for (int j = 0; j < count; ++j)
+            {
+                // 7919 is coprime with the record count, so every record is visited once
+                int index = file_order_ ? j + 1 : static_cast<int>((j * 7919LL) % count) + 1;
+                mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, index));
+                dbf.move_to(index);
+                dbf.add_attributes(cols_, tr, *feature);
+                if (feature->get(std::size_t(0)).is_null()) return false;
+            }
+        }
+        return true;
+    }
+};
+
+int main(int argc, char** argv)
+{
+    mapnik::parameters params;
+    benchmark::handle_args(argc,argv,params);
+    std::string filename(*params.get<std::string>("file", "./benchmark/out/1m.dbf"));
+    if (!mapnik::util::exists(filename))
+    {
+        write_dbf(filename, 1000000);
+    }
+    {
+        test test_runner(params, filename, {0, 1, 2, 3, 4}, true);
+        run(test_runner,"dbf all columns (file order)");
+    }
+    {
+        test test_runner(params, filename, {1}, true);
+        run(test_runner,"dbf one column (file order)");
+    }
+    {
+        test test_runner(params, filename, {0, 1, 2, 3, 4}, false);
+        run(test_runner,"dbf all columns (random order)");
+    }
+    return 0;
+}
@@ -0,0 +1,85 @@
+#include "bench_framework.hpp"
+#include <mapnik/image.hpp>
+#include <mapnik/image_reader.hpp>
+#include <mapnik/image_util.hpp>
+#include <mapnik/image_scaling.hpp>
+
+class test : public benchmark::test_case
+{
+    mapnik::image_rgba8 im_;
+    mapnik::scaling_method_e method_;
+    double scale_;
+public:
+    test(mapnik::parameters const& params,
+         mapnik::scaling_method_e method,
+         double scale)
+     : test_case(params),
+       im_(),
+       method_(method),
+       scale_(scale)
+    {
+        std::string filename("./benchmark/data/multicolor.png");
+        std::unique_ptr<mapnik::image_reader> reader(mapnik::get_image_reader(filename,"png"));
+        if (!reader.get())
+        {
+            throw mapnik::image_reader_exception("Failed to load: " + filename);
+        }
+        im_ = mapnik::image_rgba8(reader->width(),reader->height());
+        reader->read(0,0,im_);
+        mapnik::premultiply_alpha(im_);
+    }
+
+    std::size_t scaled_width() const { return std::max(1, static_cast<int>(im_.width() * scale_)); }
+    std::size_t scaled_height() const { return std::max(1, static_cast<int>(im_.height() * scale_)); }
+
+    void scale(mapnik::image_rgba8 & target, mapnik::image_rgba8 const& source) const
+    {
+        mapnik::scale_image_agg(target, source, method_,
+                                double(target.width()) / source.width(),
+                                double(target.height()) / source.height(),
+                                0.0, 0.0, 3.0);
+    }
+
+    // an opaque image of a single color has to keep it
+    bool validate() const
+    {
+        mapnik::image_rgba8 source(im_.width(), im_.height());
+        source.set(0xff336699);
+        mapnik::image_rgba8 target(scaled_width(), scaled_height(), true, true);
+        scale(target, source);
+        for (std::size_t y = 0; y < target.height(); ++y)
+        {
+            for (std::size_t x = 0; x < target.width(); ++x)
+            {
+                if (target(x, y) != 0xff336699) return false;
+            }
+        }
+        return true;
+    }
+
+    bool operator()() const
+    {
+        for (std::size_t i=0;i<iterations_;++i) {
+            mapnik::image_rgba8 target(scaled_width(), scaled_height(), true, true);
+            scale(target, im_);
+        }
+        return true;
+    }
+};
+
+// scales multicolor.png with --method (default bilinear) by --scale (default 0.5)
+int main(int argc, char** argv)
+{
+    mapnik::parameters params;
+    benchmark::handle_args(argc,argv,params);
+    std::string method_name = *params.get<std::string>("method", "bilinear");
+    boost::optional<mapnik::scaling_method_e> method = mapnik::scaling_method_from_string(method_name);
+    if (!method)
+    {
+        std::clog << "unknown scaling method: " << method_name << "\n";
+        return -1;
+    }
+    std::string scale = *params.get<std::string>("scale", "0.5");
+    test test_runner(params, *method, std::stod(scale));
+    return run(test_runner,"image scaling (" + method_name + ", x" + scale + ")");
+}
@@ -0,0 +1,101 @@
+#include "bench_framework.hpp"
+#include <mapnik/memory_datasource.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/feature_factory.hpp>
+#include <mapnik/query.hpp>
+#include <mapnik/geometry.hpp>
+
+// stl
+#include <random>
+#include <vector>
+
+class test : public benchmark::test_case
+{
+    std::shared_ptr<mapnik::memory_datasource> ds_;
+    std::vector<mapnik::geometry::point<double> > points_;
+    std::vector<mapnik::box2d<double> > tiles_;
+public:
+    test(mapnik::parameters const& params,
+         std::size_t num_points,
+         int zoom)
+     : test_case(params),
+       ds_(),
+       points_(),
+       tiles_()
+    {
+        mapnik::parameters p;
+        p["type"] = "memory";
+        ds_ = std::make_shared<mapnik::memory_datasource>(p);
+        mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+        std::mt19937 gen(1);
+        std::uniform_real_distribution<double> x(-180.0, 180.0);
+        std::uniform_real_distribution<double> y(-85.0, 85.0);
+        points_.reserve(num_points);
+        for (std::size_t i = 0; i < num_points; ++i)
+        {
+            mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, i + 1));
+            mapnik::geometry::point<double> pt(x(gen), y(gen));
+            points_.push_back(pt);
+            feature->set_geometry(mapnik::geometry::point<double>(pt));
+            ds_->push(feature);
+        }
+        // every tile of the zoom level, in lon/lat
+        int n = 1 << zoom;
+        double dx = 360.0 / n;
+        double dy = 170.0 / n;
+        for (int i = 0; i < n; ++i)
+        {
+            for (int j = 0; j < n; ++j)
+            {
+                tiles_.emplace_back(-180.0 + i * dx, -85.0 + j * dy,
+                                    -180.0 + (i + 1) * dx, -85.0 + (j + 1) * dy);
+            }
+        }
+    }
+
+    std::size_t query_all() const
+    {
+        std::size_t count = 0;
+        for (auto const& tile : tiles_)
+        {
+            mapnik::query q(tile);
+            mapnik::featureset_ptr fs = ds_->features(q);
+            while (fs->next()) ++count;
+        }
+        return count;
+    }
+
+    // the index has to give the same hits as a linear scan
+    bool validate() const
+    {
+        std::size_t expected = 0;
+        for (auto const& tile : tiles_)
+        {
+            for (auto const& pt : points_)
+            {
+                if (tile.intersects(pt.x, pt.y)) ++expected;
+            }
+        }
+        return expected > 0 && query_all() == expected;
+    }
+
+    bool operator()() const
+    {
+        for (std::size_t i=0;i<iterations_;++i) {
+            if (query_all() == 0) return false;
+        }
+        return true;
+    }
+};
+
+// queries 1M points (--points N to change) for every tile of a zoom level (--zoom, default 4)
+int main(int argc, char** argv)
+{
+    mapnik::parameters params;
+    benchmark::handle_args(argc,argv,params);
+    mapnik::value_integer points = *params.get<mapnik::value_integer>("points", 1000000);
+    mapnik::value_integer zoom = *params.get<mapnik::value_integer>("zoom", 4);
+    test test_runner(params, points, zoom);
+    return run(test_runner,"memory_datasource tile queries (" + std::to_string(points) + " points, "
+               + std::to_string(1 << zoom) + "x" + std::to_string(1 << zoom) + " tiles)");
+}
@@ -0,0 +1,167 @@
+#include "bench_framework.hpp"
+#include <mapnik/geometry.hpp>
+#include <mapnik/util/fs.hpp>
+#include "shape_io.hpp"
+
+// stl
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+const int exterior_points = 65;
+const int hole_points = 17;
+
+template <typename T>
+void put(std::vector<char> & buf, T val, bool big_endian = false)
+{
+    char bytes[sizeof(T)];
+    std::memcpy(bytes, &val, sizeof(T));
+    if (big_endian) std::reverse(bytes, bytes + sizeof(T));
+    buf.insert(buf.end(), bytes, bytes + sizeof(T));
+}
+
+void put_ring(std::vector<char> & buf, double cx, double cy, double r, int num_points, bool clockwise)
+{
+    for (int i = 0; i < num_points; ++i)
+    {
+        double a = 2 * M_PI * (i % (num_points - 1)) / (num_points - 1);
+        if (clockwise) a = -a;
+        put(buf, cx + r * std::cos(a));
+        put(buf, cy + r * std::sin(a));
+    }
+}
+
+// writes <name>.shp/.dbf with `count` polygons (with one hole each)
+void write_shapefile(std::string const& name, int count)
+{
+    int content_length = 4 + 32 + 8 + 8 + 16 * (exterior_points + hole_points);
+    std::int64_t file_length = 100 + std::int64_t(count) * (8 + content_length);
+    std::ofstream shp((name + ".shp").c_str(), std::ios::out | std::ios::binary);
+    std::vector<char> buf;
+    put(buf, std::int32_t(9994), true);
+    for (int i = 0; i < 5; ++i) put(buf, std::int32_t(0), true);
+    put(buf, std::int32_t(std::min<std::int64_t>(file_length / 2, 0x7fffffff)), true);
+    put(buf, std::int32_t(1000));
+    put(buf, std::int32_t(5));
+    put(buf, -180.0); put(buf, -90.0); put(buf, 180.0); put(buf, 90.0);
+    for (int i = 0; i < 4; ++i) put(buf, 0.0);
+    shp.write(buf.data(), buf.size());
+    for (int i = 0; i < count; ++i)
+    {
+        buf.clear();
+        double cx = -170 + (i % 340);
+        double cy = -80 + (i / 340) % 160;
+        put(buf, std::int32_t(i + 1), true);
+        put(buf, std::int32_t(content_length / 2), true);
+        put(buf, std::int32_t(5));
+        put(buf, cx - 0.5); put(buf, cy - 0.5); put(buf, cx + 0.5); put(buf, cy + 0.5);
+        put(buf, std::int32_t(2));
+        put(buf, std::int32_t(exterior_points + hole_points));
+        put(buf, std::int32_t(0));
+        put(buf, std::int32_t(exterior_points));
+        put_ring(buf, cx, cy, 0.5, exterior_points, true);
+        put_ring(buf, cx, cy, 0.25, hole_points, false);
+        shp.write(buf.data(), buf.size());
+    }
+    // a single numeric column
+    std::ofstream dbf((name + ".dbf").c_str(), std::ios::out | std::ios::binary);
+    char header[32] = {3, 115, 1, 1};
+    std::memcpy(header + 4, &count, 4);
+    header[8] = 65; header[10] = 11;
+    dbf.write(header, 32);
+    char field[32] = {'I', 'D'};
+    field[11] = 'N'; field[16] = 10;
+    dbf.write(field, 32);
+    dbf.put('\r');
+    char record[12];
+    for (int i = 1; i <= count; ++i)
+    {
+        std::snprintf(record, sizeof(record), " %10d", i);
+        dbf.write(record, 11);
+    }
+    dbf.put('\x1a');
+}
+
+}
+
+class test : public benchmark::test_case
+{
+    std::string name_;
+public:
+    test(mapnik::parameters const& params, std::string const& name)
+     : test_case(params),
+       name_(name) {}
+
+    std::size_t decode(bool first_only) const
+    {
+        shape_io shape(name_, false);
+        shape.shp().skip(24);
+        std::int64_t file_length = shape.shp().read_xdr_integer();
+        shape.shp().seek(100);
+        std::size_t vertices = 0;
+        while (shape.shp().pos() < std::streampos(file_length * 2))
+        {
+            shape.move_to(shape.shp().pos());
+            shape_file::record_type record(shape.reclength_ * 2);
+            shape.shp().read_record(record);
+            if (record.read_ndr_integer() != shape_io::shape_polygon) return 0;
+            mapnik::box2d<double> bbox;
+            shape_io::read_bbox(record, bbox);
+            mapnik::geometry::geometry<double> geom = shape_io::read_polygon(record);
+            if (!geom.is<mapnik::geometry::polygon<double> >()) return 0;
+            auto const& poly = geom.get<mapnik::geometry::polygon<double> >();
+            vertices += poly.exterior_ring.size();
+            for (auto const& ring : poly.interior_rings) vertices += ring.size();
+            if (first_only) break;
+        }
+        return vertices;
+    }
+
+    bool validate() const
+    {
+        return decode(true) == exterior_points + hole_points;
+    }
+
+    bool operator()() const
+    {
+        for (std::size_t i=0;i<iterations_;++i) {
+            if (decode(false) == 0) return false;
+        }
+        return true;
+    }
+};
+
+// decodes every polygon of a shapefile, by default a generated ~70MB one
+// (--records N to change its size, 2000000 for ~2.7GB) or any polygon
+// shapefile given with --file
+int main(int argc, char** argv)
+{
+    mapnik::parameters params;
+    benchmark::handle_args(argc,argv,params);
+    boost::optional<std::string> file = params.get<std::string>("file");
+    std::string name;
+    if (file)
+    {
+        name = *file;
+        if (name.size() > 4 && name.substr(name.size() - 4) == ".shp") name.resize(name.size() - 4);
+    }
+    else
+    {
+        mapnik::value_integer records = *params.get<mapnik::value_integer>("records", 50000);
+        name = "./benchmark/out/polygons_" + std::to_string(records);
+        if (!mapnik::util::exists(name + ".shp"))
+        {
+            write_shapefile(name, records);
+        }
+    }
+    test test_runner(params, name);
+    return run(test_runner, "shapefile polygon decoding");
+}
@@ -62,6 +62,27 @@ struct MAPNIK_DECL image_reader : private util::noncopyable
     virtual boost::optional<box2d<double> > bounding_box() const = 0;
     virtual void read(unsigned x,unsigned y,image_rgba8& image) = 0;
     virtual image_any read(unsigned x, unsigned y, unsigned width, unsigned height) = 0;
+    // Reduced resolution versions of the image (e.g internal TIFF overviews)
+    // numbered from the finest (1) to the coarsest, level 0 being the image
+    // itself. Readers without overviews only have level 0.
+    virtual unsigned overviews() const { return 0; }
+    virtual unsigned overview_width(unsigned) const { return width(); }
+    virtual unsigned overview_height(unsigned) const { return height(); }
+    virtual image_any read_overview(unsigned, unsigned x, unsigned y, unsigned width, unsigned height)
+    {
+        return read(x, y, width, height);
+    }
+    // coarsest level with no more than `scale` image pixels per output pixel
+    unsigned overview_for_scale(double scale) const
+    {
+        unsigned level = 0;
+        for (unsigned i = 1; i <= overviews(); ++i)
+        {
+            if (static_cast<double>(width()) / overview_width(i) > scale) break;
+            level = i;
+        }
+        return level;
+    }
     virtual ~image_reader() {}
 };
 
@@ -68,6 +68,22 @@ MAPNIK_DECL void scale_image_agg(T & target, T const& source,
                                  double x_off_f,
                                  double y_off_f,
                                  double filter_factor);
+
+namespace detail {
+
+// The AGG span filters scale_image_agg uses when its faster paths don't apply
+// (only instantiated for image_rgba8, to check them against).
+template <typename T>
+MAPNIK_DECL void scale_image_spans(T & target, T const& source,
+                                   scaling_method_e scaling_method,
+                                   double image_ratio_x,
+                                   double image_ratio_y,
+                                   double x_off_f,
+                                   double y_off_f,
+                                   double filter_factor);
+
+}
+
 }
 
 #endif // MAPNIK_IMAGE_SCALING_HPP
@@ -0,0 +1,65 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef MAPNIK_JSON_GEOJSON_READER_HPP
+#define MAPNIK_JSON_GEOJSON_READER_HPP
+
+// mapnik
+#include <mapnik/feature.hpp>
+#include <mapnik/unicode.hpp>
+#include <mapnik/geometry.hpp>
+// stl
+#include <vector>
+#include <cstddef>
+
+// Hand written GeoJSON reader, an alternative to the Spirit grammars in this
+// directory which gives the same features for the same input. Coordinates are
+// parsed straight into the geometry containers and unescaped strings are
+// transcoded from the input buffer without being copied first.
+//
+// Like qi::phrase_parse the functions advance `start` past what they consumed
+// and return false on malformed input. Unlike the grammars they skip unknown
+// members of geometry objects (e.g "bbox") instead of failing, and nested
+// objects/arrays stored as attributes keep the whitespace inside their strings.
+
+namespace mapnik { namespace json {
+
+// a geometry object, a GeometryCollection or null
+bool read_geometry(char const*& start, char const* end,
+                   mapnik::geometry::geometry<double> & geom);
+
+// a Feature object, attribute strings are transcoded with `tr`
+bool read_feature(char const*& start, char const* end,
+                   mapnik::feature_impl & feature,
+                   mapnik::transcoder const& tr);
+
+// a FeatureCollection, a single Feature or a bare geometry (as accepted by the
+// feature_collection_grammar). Features are created with ids counting up from `start_id`.
+bool read_features(char const*& start, char const* end,
+                   mapnik::context_ptr const& ctx,
+                   std::size_t & start_id,
+                   mapnik::transcoder const& tr,
+                   std::vector<mapnik::feature_ptr> & features);
+
+}}
+
+#endif // MAPNIK_JSON_GEOJSON_READER_HPP
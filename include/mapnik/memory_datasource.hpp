@@ -27,8 +27,15 @@
 #include <mapnik/datasource.hpp>
 #include <mapnik/feature_layer_desc.hpp>
 
+#include <mapnik/box2d.hpp>
+#ifdef MAPNIK_THREADSAFE
+#include <mapnik/unique_lock.hpp>
+#endif
+
 // stl
 #include <deque>
+#include <vector>
+#include <memory>
 
 namespace mapnik {
 
@@ -51,11 +58,22 @@ public:
     size_t size() const;
     void clear();
 private:
+    struct spatial_index;
+    // positions (ascending, i.e in push order) of the features whose envelope intersects `box`
+    void find_intersecting(box2d<double> const& box, std::vector<std::size_t> & positions) const;
+
     std::deque<feature_ptr> features_;
+    // envelope of each feature, computed when it is pushed
+    std::deque<box2d<double> > envelopes_;
     mapnik::layer_descriptor desc_;
     datasource::datasource_t type_;
     bool bbox_check_;
     mutable box2d<double> extent_;
+    // R-tree over envelopes_, built by the first query and then kept up to date by push()
+    mutable std::unique_ptr<spatial_index> index_;
+#ifdef MAPNIK_THREADSAFE
+    mutable std::mutex mutex_;
+#endif
 };
 
 }
@@ -34,6 +34,7 @@
 #include <mapnik/raster.hpp>
 
 #include <deque>
+#include <vector>
 
 namespace mapnik {
 
@@ -45,21 +46,41 @@ public:
           pos_(ds.features_.begin()),
           end_(ds.features_.end()),
           type_(ds.type()),
-          bbox_check_(bbox_check)
-    {}
+          bbox_check_(bbox_check),
+          features_(&ds.features_),
+          positions_(),
+          position_(0)
+    {
+        if (bbox_check_)
+        {
+            // the datasource's spatial index gives the hits, so next() doesn't need to check them
+            ds.find_intersecting(bbox_, positions_);
+        }
+    }
 
     memory_featureset(box2d<double> const& bbox, std::deque<feature_ptr> const& features, bool bbox_check = true)
         : bbox_(bbox),
           pos_(features.begin()),
           end_(features.end()),
           type_(datasource::Vector),
-          bbox_check_(bbox_check)
+          bbox_check_(bbox_check),
+          features_(nullptr),
+          positions_(),
+          position_(0)
     {}
 
     virtual ~memory_featureset() {}
 
     feature_ptr next()
     {
+        if (features_ && bbox_check_)
+        {
+            if (position_ < positions_.size())
+            {
+                return (*features_)[positions_[position_++]];
+            }
+            return feature_ptr();
+        }
         while (pos_ != end_)
         {
             if (!bbox_check_)
@@ -96,6 +117,10 @@ private:
     std::deque<feature_ptr>::const_iterator end_;
     datasource::datasource_t type_;
     bool bbox_check_;
+    // set when the features come from a memory_datasource
+    std::deque<feature_ptr> const* features_;
+    std::vector<std::size_t> positions_;
+    std::size_t position_;
 };
 }
 
@@ -32,132 +32,392 @@
 #include <memory>
 #ifdef MAPNIK_THREADSAFE
 #include <mutex>
+#include <condition_variable>
 #endif
 
 // stl
 #include <algorithm> // std::max
-#include <deque>
+#include <chrono>
+#include <iterator>
+#include <ostream>
+#include <vector>
 
 namespace mapnik
 {
+
+struct pool_stats
+{
+    unsigned size = 0;          // connections currently open (idle + in use)
+    unsigned in_use = 0;        // connections currently borrowed
+    unsigned idle = 0;          // connections ready to be borrowed
+    std::size_t borrows = 0;    // successful borrowObject calls
+    std::size_t created = 0;    // connections opened
+    std::size_t waits = 0;      // borrowObject calls which had to wait for a connection
+    std::chrono::microseconds wait_time = std::chrono::microseconds(0); // total time spent waiting
+    std::size_t timeouts = 0;   // borrowObject calls which gave up without a connection
+    std::size_t failures = 0;   // connections which could not be opened
+    std::size_t broken = 0;     // broken connections discarded
+    std::size_t reaped = 0;     // idle connections closed by the idle timeout
+};
+
+inline std::ostream & operator<<(std::ostream & out, pool_stats const& stats)
+{
+    out << "size=" << stats.size
+        << " in_use=" << stats.in_use
+        << " idle=" << stats.idle
+        << " borrows=" << stats.borrows
+        << " created=" << stats.created
+        << " waits=" << stats.waits
+        << " wait_time=" << stats.wait_time.count() << "us"
+        << " timeouts=" << stats.timeouts
+        << " failures=" << stats.failures
+        << " broken=" << stats.broken
+        << " reaped=" << stats.reaped;
+    return out;
+}
+
+// Pool of reusable objects (database connections). Idle objects are kept on
+// a stack so borrowing and returning is O(1); a borrowed object goes back to
+// the pool automatically when the last copy of the returned holder is gone.
+// T must provide isOK() which is used as health check on borrow and return.
 template <typename T,template <typename> class Creator>
 class Pool : private util::noncopyable
 {
     using HolderType = std::shared_ptr<T>;
-    using ContType = std::deque<HolderType>;
+    using clock_type = std::chrono::steady_clock;
+
+    struct idle_entry
+    {
+        idle_entry(T * obj_, clock_type::time_point since_)
+            : obj(obj_), since(since_) {}
+        std::unique_ptr<T> obj;
+        clock_type::time_point since;
+    };
+
+    // shared with the deleters of borrowed objects, which may outlive the pool
+    struct pool_state
+    {
+        unsigned initialSize;
+        unsigned maxSize;
+        unsigned size = 0; // idle + in use
+        std::chrono::milliseconds wait_timeout;
+        std::chrono::seconds idle_timeout;
+        std::vector<idle_entry> idle;
+        pool_stats stats;
+#ifdef MAPNIK_THREADSAFE
+        std::mutex mutex;
+        std::condition_variable cond;
+#endif
+        pool_state(unsigned initialSize_, unsigned maxSize_)
+            : initialSize(initialSize_),
+              maxSize(maxSize_),
+              wait_timeout(0),
+              idle_timeout(0) {}
+
+        void release(T * obj)
+        {
+            std::unique_ptr<T> discard;
+            {
+#ifdef MAPNIK_THREADSAFE
+                mapnik::scoped_lock lock(mutex);
+#endif
+                --stats.in_use;
+                if (obj->isOK() && size <= maxSize)
+                {
+                    idle.emplace_back(obj, clock_type::now());
+                }
+                else
+                {
+                    if (!obj->isOK()) ++stats.broken;
+                    discard.reset(obj);
+                    --size;
+                }
+            }
+#ifdef MAPNIK_THREADSAFE
+            cond.notify_one();
+#endif
+        }
+    };
+
+    struct returner
+    {
+        std::weak_ptr<pool_state> state;
+        void operator()(T * obj) const
+        {
+            std::shared_ptr<pool_state> s = state.lock();
+            if (s) s->release(obj);
+            else delete obj;
+        }
+    };
 
     Creator<T> creator_;
-    unsigned initialSize_;
-    unsigned maxSize_;
-    ContType pool_;
+    std::shared_ptr<pool_state> state_;
+
+    HolderType wrap(T * obj) const
+    {
+        return HolderType(obj, returner{state_});
+    }
+
+    // moves idle objects past the idle timeout (oldest are at the bottom of
+    // the stack) into `expired`, keeping at least initialSize open.
+    // caller holds the lock
+    void reap_idle(std::vector<idle_entry> & expired)
+    {
+        pool_state & s = *state_;
+        if (s.idle_timeout.count() <= 0) return;
+        clock_type::time_point limit = clock_type::now() - s.idle_timeout;
+        std::size_t count = 0;
+        while (count < s.idle.size()
+               && s.idle[count].since < limit
+               && s.size - count > s.initialSize)
+        {
+            ++count;
+        }
+        if (count > 0)
+        {
+            std::move(s.idle.begin(), s.idle.begin() + count, std::back_inserter(expired));
+            s.idle.erase(s.idle.begin(), s.idle.begin() + count);
+            s.size -= count;
+            s.stats.reaped += count;
+        }
+    }
+
+    // opens a new object for a slot already accounted for in size/in_use
+    HolderType create()
+    {
+        T * obj = nullptr;
+        try
+        {
+            obj = creator_();
+        }
+        catch (...)
+        {
+            discard_slot();
+            throw;
+        }
+        if (!obj->isOK())
+        {
+            delete obj;
+            discard_slot();
+            return HolderType();
+        }
+        {
 #ifdef MAPNIK_THREADSAFE
-    mutable std::mutex mutex_;
+            mapnik::scoped_lock lock(state_->mutex);
 #endif
+            ++state_->stats.created;
+            ++state_->stats.borrows;
+        }
+        return wrap(obj);
+    }
+
+    void discard_slot()
+    {
+        {
+#ifdef MAPNIK_THREADSAFE
+            mapnik::scoped_lock lock(state_->mutex);
+#endif
+            --state_->size;
+            --state_->stats.in_use;
+            ++state_->stats.failures;
+        }
+#ifdef MAPNIK_THREADSAFE
+        state_->cond.notify_one();
+#endif
+    }
+
 public:
 
     Pool(const Creator<T>& creator,unsigned initialSize, unsigned maxSize)
         :creator_(creator),
-         initialSize_(initialSize),
-         maxSize_(maxSize)
+         state_(std::make_shared<pool_state>(initialSize, maxSize))
     {
-        for (unsigned i=0; i < initialSize_; ++i)
+        for (unsigned i=0; i < initialSize; ++i)
         {
-            HolderType conn(creator_());
+            std::unique_ptr<T> conn(creator_());
             if (conn->isOK())
-                pool_.push_back(conn);
+            {
+                state_->idle.emplace_back(conn.release(), clock_type::now());
+                ++state_->size;
+                ++state_->stats.created;
+            }
         }
     }
 
+    // Returns an idle object, or opens a new one while below max_size. When the
+    // pool is exhausted waits for a returned object up to wait_timeout() and
+    // returns a null holder if none became available. Broken idle objects are
+    // discarded and transparently replaced by a new connection.
     HolderType borrowObject()
     {
+        return borrowObject(wait_timeout());
+    }
+
+    HolderType borrowObject(std::chrono::milliseconds timeout)
+    {
+        std::vector<idle_entry> discard;
+        pool_state & s = *state_;
 #ifdef MAPNIK_THREADSAFE
-        mapnik::scoped_lock lock(mutex_);
+        mapnik::scoped_lock lock(s.mutex);
+        clock_type::time_point deadline = clock_type::now() + timeout;
+        bool waited = false;
 #endif
-
-        typename ContType::iterator itr=pool_.begin();
-        while ( itr!=pool_.end())
+        reap_idle(discard);
+        for (;;)
         {
-            if (!itr->unique())
-            {
-                ++itr;
-            }
-            else if ((*itr)->isOK())
+            while (!s.idle.empty())
             {
-                return *itr;
+                idle_entry entry(std::move(s.idle.back()));
+                s.idle.pop_back();
+                if (entry.obj->isOK())
+                {
+                    ++s.stats.in_use;
+                    ++s.stats.borrows;
+                    return wrap(entry.obj.release());
+                }
+                --s.size;
+                ++s.stats.broken;
+                discard.push_back(std::move(entry));
             }
-            else
+            // all objects have been taken, check if we are allowed to grow the pool
+            if (s.size < s.maxSize)
             {
-                itr=pool_.erase(itr);
+                ++s.size;
+                ++s.stats.in_use;
+#ifdef MAPNIK_THREADSAFE
+                lock.unlock();
+#endif
+                // connect without holding the lock
+                return create();
             }
-        }
-        // all connection have been taken, check if we allowed to grow pool
-        if (pool_.size() < maxSize_)
-        {
-            HolderType conn(creator_());
-            if (conn->isOK())
+#ifdef MAPNIK_THREADSAFE
+            if (timeout.count() > 0 && clock_type::now() < deadline)
             {
-                pool_.push_back(conn);
-                return conn;
+                clock_type::time_point start = clock_type::now();
+                if (!waited)
+                {
+                    ++s.stats.waits;
+                    waited = true;
+                }
+                s.cond.wait_until(lock, deadline);
+                s.stats.wait_time += std::chrono::duration_cast<std::chrono::microseconds>(clock_type::now() - start);
+                continue;
             }
+#endif
+            ++s.stats.timeouts;
+            return HolderType();
         }
-        return HolderType();
+    }
+
+    pool_stats stats() const
+    {
+#ifdef MAPNIK_THREADSAFE
+        mapnik::scoped_lock lock(state_->mutex);
+#endif
+        pool_stats result = state_->stats;
+        result.size = state_->size;
+        result.idle = state_->idle.size();
+        return result;
     }
 
     unsigned size() const
     {
 #ifdef MAPNIK_THREADSAFE
-        mapnik::scoped_lock lock(mutex_);
+        mapnik::scoped_lock lock(state_->mutex);
 #endif
-        return pool_.size();
+        return state_->size;
     }
 
     unsigned max_size() const
     {
 #ifdef MAPNIK_THREADSAFE
-        mapnik::scoped_lock lock(mutex_);
+        mapnik::scoped_lock lock(state_->mutex);
 #endif
-        return maxSize_;
+        return state_->maxSize;
     }
 
     void set_max_size(unsigned size)
     {
+        {
+#ifdef MAPNIK_THREADSAFE
+            mapnik::scoped_lock lock(state_->mutex);
+#endif
+            state_->maxSize = std::max(state_->maxSize,size);
+        }
 #ifdef MAPNIK_THREADSAFE
-        mapnik::scoped_lock lock(mutex_);
+        state_->cond.notify_all();
 #endif
-        maxSize_ = std::max(maxSize_,size);
     }
 
     unsigned initial_size() const
     {
 #ifdef MAPNIK_THREADSAFE
-        mapnik::scoped_lock lock(mutex_);
+        mapnik::scoped_lock lock(state_->mutex);
 #endif
-        return initialSize_;
+        return state_->initialSize;
     }
 
     void set_initial_size(unsigned size)
     {
 #ifdef MAPNIK_THREADSAFE
-        mapnik::scoped_lock lock(mutex_);
+        mapnik::scoped_lock lock(state_->mutex);
 #endif
-        if (size > initialSize_)
+        if (size > state_->initialSize)
         {
-            initialSize_ = size;
-            unsigned total_size = pool_.size();
+            state_->initialSize = size;
+            unsigned total_size = state_->size;
             // ensure we don't have ghost obj's in the pool.
-            if (total_size < initialSize_)
+            if (total_size < state_->initialSize)
             {
-                unsigned grow_size = initialSize_ - total_size ;
+                unsigned grow_size = state_->initialSize - total_size ;
 
                 for (unsigned i=0; i < grow_size; ++i)
                 {
-                    HolderType conn(creator_());
+                    std::unique_ptr<T> conn(creator_());
                     if (conn->isOK())
-                        pool_.push_back(conn);
+                    {
+                        state_->idle.emplace_back(conn.release(), clock_type::now());
+                        ++state_->size;
+                        ++state_->stats.created;
+                    }
                 }
             }
         }
     }
+
+    std::chrono::milliseconds wait_timeout() const
+    {
+#ifdef MAPNIK_THREADSAFE
+        mapnik::scoped_lock lock(state_->mutex);
+#endif
+        return state_->wait_timeout;
+    }
+
+    // how long borrowObject() waits for a connection when the pool is exhausted
+    void set_wait_timeout(std::chrono::milliseconds timeout)
+    {
+#ifdef MAPNIK_THREADSAFE
+        mapnik::scoped_lock lock(state_->mutex);
+#endif
+        state_->wait_timeout = timeout;
+    }
+
+    std::chrono::seconds idle_timeout() const
+    {
+#ifdef MAPNIK_THREADSAFE
+        mapnik::scoped_lock lock(state_->mutex);
+#endif
+        return state_->idle_timeout;
+    }
+
+    // idle connections above initial_size are closed after this long, zero keeps them forever
+    void set_idle_timeout(std::chrono::seconds timeout)
+    {
+#ifdef MAPNIK_THREADSAFE
+        mapnik::scoped_lock lock(state_->mutex);
+#endif
+        state_->idle_timeout = timeout;
+    }
 };
 
 }
@@ -215,12 +215,24 @@ public:
     //! \return The epsilon value
     inline float get_epsilon() const { return epsilon_; }
 
+    //! \brief Set the size of the lookup table used for floating point data
+    //!
+    //! Integer data uses a table with a color per value when the range of
+    //! values is smaller than the image.
+    //! \param[in] size The number of entries, 0 to colorize every pixel with get_color()
+    inline void set_lut_size(unsigned size) { lut_size_ = size; }
+
+    //! \brief Get the size of the lookup table used for floating point data
+    //! \return The number of entries
+    inline unsigned get_lut_size() const { return lut_size_; }
+
 private:
     colorizer_stops stops_;         //!< The vector of stops
 
     colorizer_mode default_mode_;   //!< The default mode inherited by stops
     color default_color_;           //!< The default color
     float epsilon_;                 //!< The epsilon value for exact mode
+    unsigned lut_size_;             //!< The lookup table size for floating point data
 };
 
 
@@ -40,10 +40,84 @@
 #include "agg_scanline_u.h"
 #include "agg_renderer_scanline.h"
 
+// stl
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+
 namespace mapnik {
 
 namespace detail {
 
+template <typename T>
+struct nearest_pixel
+{
+    using pixel_type = typename T::pixel_type;
+    pixel_type operator() (pixel_type pixel) const { return pixel; }
+};
+
+// scale_image_agg() blends translucent pixels onto its transparent target like
+// agg::pixfmt_rgba32_pre, which rounds most of their alphas up by one
+template <>
+struct nearest_pixel<image_rgba8>
+{
+    std::uint32_t operator() (std::uint32_t pixel) const
+    {
+        unsigned a = pixel >> 24;
+        if (a == 255) return pixel;
+        if (a == 0) return 0;
+        unsigned alpha = 255 - (((255 - a) * 255) >> 8);
+        return (pixel & 0x00ffffff) | (alpha << 24);
+    }
+};
+
+// SCALING_NEAR by a whole factor, or its inverse, gives the same pixels as
+// scale_image_agg() into a transparent target without going through AGG.
+// Returns false for other ratios.
+template <typename T>
+bool scale_image_nearest(T & target, T const& source, double image_ratio_x, double image_ratio_y)
+{
+    double eps = 1e-5;
+    auto factor = [eps](double ratio) -> long {
+        double k = std::round(ratio >= 1.0 ? ratio : 1.0 / ratio);
+        if (k < 1.0 || std::fabs((ratio >= 1.0 ? ratio : 1.0 / ratio) - k) > eps) return 0;
+        return ratio >= 1.0 ? static_cast<long>(k) : -static_cast<long>(k);
+    };
+    // source pixel under the center of a target pixel
+    auto pick = [](std::size_t i, long k, std::size_t size) {
+        std::size_t index = k > 0 ? i / k : i * -k + -k / 2;
+        return std::min(index, size - 1);
+    };
+    long kx = factor(image_ratio_x);
+    long ky = factor(image_ratio_y);
+    if (kx == 0 || ky == 0 || source.width() == 0 || source.height() == 0) return false;
+
+    nearest_pixel<T> pixel;
+    std::vector<std::size_t> columns(target.width());
+    for (std::size_t x = 0; x < columns.size(); ++x)
+    {
+        columns[x] = pick(x, kx, source.width());
+    }
+    for (std::size_t y = 0; y < target.height(); ++y)
+    {
+        std::size_t row = pick(y, ky, source.height());
+        auto * target_row = target.getRow(y);
+        if (y > 0 && row == pick(y - 1, ky, source.height()))
+        {
+            auto const* previous = target.getRow(y - 1);
+            std::copy(previous, previous + target.width(), target_row);
+            continue;
+        }
+        auto const* source_row = source.getRow(row);
+        for (std::size_t x = 0; x < columns.size(); ++x)
+        {
+            target_row[x] = pixel(source_row[columns[x]]);
+        }
+    }
+    return true;
+}
+
 template <typename F>
 struct image_dispatcher
 {
@@ -72,8 +146,13 @@ struct image_dispatcher
     void operator() (image_null const& data_in) const {}  //no-op
     void operator() (image_rgba8 const& data_in) const
     {
+        if (unscaled(data_in))
+        {
+            composite_(data_in, comp_op_, opacity_, start_x_, start_y_);
+            return;
+        }
         image_rgba8 data_out(width_, height_, true, true);
-        scale_image_agg(data_out, data_in,  method_, scale_x_, scale_y_, 0.0, 0.0, filter_factor_);
+        scale(data_out, data_in);
         composite_(data_out, comp_op_, opacity_, start_x_, start_y_);
     }
 
@@ -81,15 +160,39 @@ struct image_dispatcher
     void operator() (T const& data_in) const
     {
         using image_type = T;
-        image_type data_out(width_, height_);
-        scale_image_agg(data_out, data_in,  method_, scale_x_, scale_y_, 0.0, 0.0, filter_factor_);
         image_rgba8 dst(width_, height_);
         raster_colorizer_ptr colorizer = get<raster_colorizer_ptr>(sym_, keys::colorizer);
-        if (colorizer) colorizer->colorize(dst, data_out, nodata_, feature_);
+        if (unscaled(data_in))
+        {
+            if (colorizer) colorizer->colorize(dst, data_in, nodata_, feature_);
+        }
+        else
+        {
+            image_type data_out(width_, height_);
+            scale(data_out, data_in);
+            if (colorizer) colorizer->colorize(dst, data_out, nodata_, feature_);
+        }
         premultiply_alpha(dst);
         composite_(dst, comp_op_, opacity_, start_x_, start_y_);
     }
 private:
+    // source pixels map 1:1 onto the target (e.g pre-tiled imagery in the map srs)
+    template <typename T>
+    bool unscaled(T const& data_in) const
+    {
+        double eps = 1e-5;
+        return std::fabs(scale_x_ - 1.0) <= eps && std::fabs(scale_y_ - 1.0) <= eps &&
+            static_cast<std::size_t>(width_) == data_in.width() &&
+            static_cast<std::size_t>(height_) == data_in.height();
+    }
+
+    template <typename T>
+    void scale(T & data_out, T const& data_in) const
+    {
+        if (method_ == SCALING_NEAR && scale_image_nearest(data_out, data_in, scale_x_, scale_y_)) return;
+        scale_image_agg(data_out, data_in, method_, scale_x_, scale_y_, 0.0, 0.0, filter_factor_);
+    }
+
     int start_x_;
     int start_y_;
     int width_;
@@ -230,25 +333,12 @@ void render_raster_symbolizer(raster_symbolizer const& sym,
             {
                 double image_ratio_x = ext.width() / source->data_.width();
                 double image_ratio_y = ext.height() / source->data_.height();
-                double eps = 1e-5;
-                if ( (std::fabs(image_ratio_x - 1.0) <= eps) &&
-                     (std::fabs(image_ratio_y - 1.0) <= eps) &&
-                     (std::abs(start_x) <= eps) &&
-                     (std::abs(start_y) <= eps) )
-                {
-                    if (source->data_.is<image_rgba8>())
-                    {
-                        composite(util::get<image_rgba8>(source->data_), comp_op, opacity, start_x, start_y);
-                    }
-                }
-                else
-                {
-                    detail::image_dispatcher<F> dispatcher(start_x, start_y, raster_width, raster_height,
-                                                                image_ratio_x, image_ratio_y,
-                                                                scaling_method, source->get_filter_factor(),
-                                                                opacity, comp_op, sym, feature, composite, source->nodata());
-                    util::apply_visitor(dispatcher, source->data_);
-                }
+                // composites the source as is at 1:1, see image_dispatcher
+                detail::image_dispatcher<F> dispatcher(start_x, start_y, raster_width, raster_height,
+                                                            image_ratio_x, image_ratio_y,
+                                                            scaling_method, source->get_filter_factor(),
+                                                            opacity, comp_op, sym, feature, composite, source->nodata());
+                util::apply_visitor(dispatcher, source->data_);
             }
         }
     }
@@ -27,6 +27,7 @@
 #include <mapnik/config.hpp>
 
 // stl
+#include <ctime>
 #include <string>
 #include <vector>
 
@@ -36,6 +37,8 @@ MAPNIK_DECL bool exists(std::string const& value);
 MAPNIK_DECL bool is_directory(std::string const& value);
 MAPNIK_DECL bool is_regular_file(std::string const& value);
 MAPNIK_DECL bool remove(std::string const& value);
+// modification time of a file, 0 if it can not be read
+MAPNIK_DECL std::time_t last_write_time(std::string const& value);
 MAPNIK_DECL bool is_relative(std::string const& value);
 MAPNIK_DECL std::string make_relative(std::string const& filepath, std::string const& base);
 MAPNIK_DECL std::string make_absolute(std::string const& filepath, std::string const& base);
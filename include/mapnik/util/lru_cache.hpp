@@ -0,0 +1,171 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef MAPNIK_UTIL_LRU_CACHE_HPP
+#define MAPNIK_UTIL_LRU_CACHE_HPP
+
+// mapnik
+#include <mapnik/util/noncopyable.hpp>
+#ifdef MAPNIK_THREADSAFE
+#include <mapnik/unique_lock.hpp>
+#endif
+
+// stl
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+
+namespace mapnik { namespace util {
+
+// Least recently used cache of immutable shared values, bounded by the sum of
+// the sizes given for them (usually bytes), a max_size of 0 disables it.
+// Values are created by the caller without holding the lock: when several
+// threads miss the same key at once the first value inserted is kept, returned
+// to the others, and counted once.
+template <typename Key, typename Value, typename Hash = std::hash<Key> >
+class lru_cache : private util::noncopyable
+{
+public:
+    using value_ptr = std::shared_ptr<const Value>;
+
+    explicit lru_cache(std::size_t max_size)
+        : max_size_(max_size),
+          size_(0),
+          lru_(),
+          entries_() {}
+
+    // the cached value of `key` (now the most recently used) or null
+    value_ptr find(Key const& key)
+    {
+#ifdef MAPNIK_THREADSAFE
+        mapnik::scoped_lock lock(mutex_);
+#endif
+        auto itr = entries_.find(key);
+        if (itr == entries_.end()) return value_ptr();
+        lru_.splice(lru_.begin(), lru_, itr->second.pos);
+        return itr->second.value;
+    }
+
+    // caches `value` unless `key` already is, returns the cached value
+    value_ptr insert(Key const& key, value_ptr const& value, std::size_t size)
+    {
+#ifdef MAPNIK_THREADSAFE
+        mapnik::scoped_lock lock(mutex_);
+#endif
+        auto itr = entries_.find(key);
+        if (itr != entries_.end())
+        {
+            lru_.splice(lru_.begin(), lru_, itr->second.pos);
+            return itr->second.value;
+        }
+        if (size > max_size_) return value;
+        lru_.push_front(key);
+        entries_.emplace(key, entry{value, size, lru_.begin()});
+        size_ += size;
+        shrink();
+        return value;
+    }
+
+    // the cached value of `key`, or create() cached with the size size_of(*value)
+    template <typename Create, typename SizeOf>
+    value_ptr get(Key const& key, Create && create, SizeOf && size_of)
+    {
+        if (max_size() == 0) return value_ptr(create());
+        value_ptr value = find(key);
+        if (value) return value;
+        value = create();
+        return insert(key, value, size_of(*value));
+    }
+
+    void set_max_size(std::size_t max_size)
+    {
+#ifdef MAPNIK_THREADSAFE
+        mapnik::scoped_lock lock(mutex_);
+#endif
+        max_size_ = max_size;
+        shrink();
+    }
+
+    std::size_t max_size() const
+    {
+#ifdef MAPNIK_THREADSAFE
+        mapnik::scoped_lock lock(mutex_);
+#endif
+        return max_size_;
+    }
+
+    // sum of the sizes of the cached values
+    std::size_t size() const
+    {
+#ifdef MAPNIK_THREADSAFE
+        mapnik::scoped_lock lock(mutex_);
+#endif
+        return size_;
+    }
+
+    void clear()
+    {
+#ifdef MAPNIK_THREADSAFE
+        mapnik::scoped_lock lock(mutex_);
+#endif
+        entries_.clear();
+        lru_.clear();
+        size_ = 0;
+    }
+
+private:
+    using lru_type = std::list<Key>;
+    struct entry
+    {
+        value_ptr value;
+        std::size_t size;
+        typename lru_type::iterator pos;
+    };
+
+    // caller holds the lock
+    void shrink()
+    {
+        while (size_ > max_size_)
+        {
+            auto last = entries_.find(lru_.back());
+            size_ -= last->second.size;
+            entries_.erase(last);
+            lru_.pop_back();
+        }
+    }
+
+    std::size_t max_size_;
+    std::size_t size_;
+    // most recently used first
+    lru_type lru_;
+    std::unordered_map<Key, entry, Hash> entries_;
+#ifdef MAPNIK_THREADSAFE
+    mutable std::mutex mutex_;
+#endif
+};
+
+}}
+
+#endif // MAPNIK_UTIL_LRU_CACHE_HPP
@@ -0,0 +1,423 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef MAPNIK_UTIL_PACKED_RTREE_HPP
+#define MAPNIK_UTIL_PACKED_RTREE_HPP
+
+// mapnik
+#include <mapnik/box2d.hpp>
+
+// stl
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+namespace mapnik { namespace util {
+
+// Packed Hilbert R-tree, the on-disk spatial index of the shape plugin
+// (.hrtree) and of large GeoJSON files (.index).
+//
+// Items are sorted by the Hilbert value of their box centre and packed
+// bottom-up into nodes of a fixed size, so the whole tree is one flat array
+// which can be queried straight from a memory mapped file:
+//
+//   header                         64 bytes, see packed_rtree_header
+//   format specific fields         (none for .hrtree, 32 bytes for GeoJSON)
+//   entries [num_nodes]            32 + 8 * N bytes, see packed_rtree_entry
+//
+// The first num_items entries are the leaves (values hold the item, e.g. a
+// byte offset), followed by each level of parent nodes up to the root which
+// is stored last (values[0] holds the position of the first child).
+// Every field is stored in little endian byte order: the structs below match
+// the file layout as is on little endian hosts, big endian hosts (defining
+// MAPNIK_BIG_ENDIAN) swap each field when writing and reading it.
+
+struct packed_rtree_header
+{
+    char magic[8];              // identifies the format
+    std::uint16_t version;      // of the format
+    std::uint16_t flags;        // defined by the format
+    std::uint32_t node_size;
+    std::uint64_t num_items;
+    std::uint64_t num_nodes;
+    double extent[4];           // minx, miny, maxx, maxy
+};
+
+template <std::size_t N>
+struct packed_rtree_entry
+{
+    double box[4];              // minx, miny, maxx, maxy
+    std::uint64_t values[N];
+};
+
+static_assert(sizeof(packed_rtree_header) == 64, "unexpected packed_rtree_header layout");
+static_assert(sizeof(packed_rtree_entry<1>) == 40, "unexpected packed_rtree_entry layout");
+
+// converts between the file and host byte order, in place (both ways)
+template <typename T>
+inline void packed_rtree_swap_bytes(T & val)
+{
+    char * bytes = reinterpret_cast<char*>(&val);
+    std::reverse(bytes, bytes + sizeof(T));
+}
+
+inline void packed_rtree_little_endian(packed_rtree_header & header)
+{
+#ifdef MAPNIK_BIG_ENDIAN
+    packed_rtree_swap_bytes(header.version);
+    packed_rtree_swap_bytes(header.flags);
+    packed_rtree_swap_bytes(header.node_size);
+    packed_rtree_swap_bytes(header.num_items);
+    packed_rtree_swap_bytes(header.num_nodes);
+    for (double & val : header.extent) packed_rtree_swap_bytes(val);
+#else
+    (void)header;
+#endif
+}
+
+template <std::size_t N>
+inline void packed_rtree_little_endian(packed_rtree_entry<N> & entry)
+{
+#ifdef MAPNIK_BIG_ENDIAN
+    for (double & val : entry.box) packed_rtree_swap_bytes(val);
+    for (std::uint64_t & val : entry.values) packed_rtree_swap_bytes(val);
+#else
+    (void)entry;
+#endif
+}
+
+// writes a header or an entry (anything with a packed_rtree_little_endian overload)
+template <typename T>
+inline void packed_rtree_write(std::ostream & out, T val)
+{
+    packed_rtree_little_endian(val);
+    out.write(reinterpret_cast<const char*>(&val), sizeof(val));
+}
+
+// end positions (exclusive) of every level, leaves first
+inline std::vector<std::uint64_t> packed_rtree_level_bounds(std::uint64_t num_items, std::uint32_t node_size)
+{
+    std::vector<std::uint64_t> bounds;
+    if (num_items == 0 || node_size < 2) return bounds;
+    std::uint64_t count = num_items;
+    std::uint64_t num_nodes = num_items;
+    bounds.push_back(num_nodes);
+    do
+    {
+        count = (count + node_size - 1) / node_size;
+        num_nodes += count;
+        bounds.push_back(num_nodes);
+    }
+    while (count != 1);
+    return bounds;
+}
+
+// checks a header (in host byte order) against the expected format and the
+// size of the file holding `entries_offset` bytes of headers and the entries
+inline bool packed_rtree_valid(packed_rtree_header const& header,
+                               char const (&magic)[8], std::uint16_t version,
+                               std::size_t entries_offset, std::size_t entry_size,
+                               std::size_t file_size)
+{
+    if (std::memcmp(header.magic, magic, sizeof(magic)) != 0) return false;
+    if (header.version != version) return false;
+    std::vector<std::uint64_t> bounds = packed_rtree_level_bounds(header.num_items, header.node_size);
+    std::uint64_t num_nodes = bounds.empty() ? 0 : bounds.back();
+    return header.num_nodes == num_nodes
+        && file_size >= entries_offset
+        && (file_size - entries_offset) / entry_size >= num_nodes;
+}
+
+// Walks the tree down from the root and calls visit(leaf entry) for every
+// leaf whose box passes filter(box2d<double>), until visit returns false.
+// load_nodes(first, last) returns the entries [first, last) of one node in
+// host byte order.
+template <typename Entry, typename Filter, typename LoadNodes, typename Visit>
+void packed_rtree_query(packed_rtree_header const& header, Filter const& filter,
+                        LoadNodes && load_nodes, Visit && visit)
+{
+    std::vector<std::uint64_t> bounds = packed_rtree_level_bounds(header.num_items, header.node_size);
+    if (bounds.empty()) return;
+    std::vector<std::uint64_t> queue;
+    // the root is a group of its own on the top level
+    std::uint64_t node = header.num_nodes - 1;
+    for (;;)
+    {
+        std::uint64_t level_end = *std::upper_bound(bounds.begin(), bounds.end(), node);
+        std::uint64_t end = std::min(node + header.node_size, level_end);
+        Entry const* entries = load_nodes(node, end);
+        for (std::uint64_t i = 0; i < end - node; ++i)
+        {
+            Entry const& entry = entries[i];
+            if (!filter(box2d<double>(entry.box[0], entry.box[1], entry.box[2], entry.box[3]))) continue;
+            if (node < header.num_items)
+            {
+                if (!visit(entry)) return;
+            }
+            else if (entry.values[0] < node)
+            {
+                // children always live on a lower level, anything else is corrupt
+                queue.push_back(entry.values[0]);
+            }
+        }
+        if (queue.empty()) break;
+        node = queue.back();
+        queue.pop_back();
+    }
+}
+
+// load_nodes of packed_rtree_query for entries held in memory in file order,
+// e.g. a mapped file, which big endian hosts convert node by node
+template <typename Entry>
+class packed_rtree_memory_nodes
+{
+public:
+    explicit packed_rtree_memory_nodes(Entry const* entries)
+        : entries_(entries) {}
+
+    Entry const* operator()(std::uint64_t first, std::uint64_t last)
+    {
+#ifndef MAPNIK_BIG_ENDIAN
+        (void)last;
+        return entries_ + first;
+#else
+        buffer_.assign(entries_ + first, entries_ + last);
+        for (Entry & entry : buffer_) packed_rtree_little_endian(entry);
+        return buffer_.data();
+#endif
+    }
+
+private:
+    Entry const* entries_;
+#ifdef MAPNIK_BIG_ENDIAN
+    std::vector<Entry> buffer_;
+#endif
+};
+
+// position of (x,y) on a Hilbert curve filling a 2^16 x 2^16 grid
+inline std::uint32_t hilbert_value(std::uint32_t x, std::uint32_t y)
+{
+    std::uint32_t a = x ^ y;
+    std::uint32_t b = 0xFFFF ^ a;
+    std::uint32_t c = 0xFFFF ^ (x | y);
+    std::uint32_t d = x & (y ^ 0xFFFF);
+
+    std::uint32_t A = a | (b >> 1);
+    std::uint32_t B = (a >> 1) ^ a;
+    std::uint32_t C = ((c >> 1) ^ (b & (d >> 1))) ^ c;
+    std::uint32_t D = ((a & (c >> 1)) ^ (d >> 1)) ^ d;
+
+    a = A; b = B; c = C; d = D;
+    A = ((a & (a >> 2)) ^ (b & (b >> 2)));
+    B = ((a & (b >> 2)) ^ (b & ((a ^ b) >> 2)));
+    C ^= ((a & (c >> 2)) ^ (b & (d >> 2)));
+    D ^= ((b & (c >> 2)) ^ ((a ^ b) & (d >> 2)));
+
+    a = A; b = B; c = C; d = D;
+    A = ((a & (a >> 4)) ^ (b & (b >> 4)));
+    B = ((a & (b >> 4)) ^ (b & ((a ^ b) >> 4)));
+    C ^= ((a & (c >> 4)) ^ (b & (d >> 4)));
+    D ^= ((b & (c >> 4)) ^ ((a ^ b) & (d >> 4)));
+
+    a = A; b = B; c = C; d = D;
+    C ^= ((a & (c >> 8)) ^ (b & (d >> 8)));
+    D ^= ((b & (c >> 8)) ^ ((a ^ b) & (d >> 8)));
+
+    a = C ^ (C >> 1);
+    b = D ^ (D >> 1);
+
+    std::uint32_t i0 = x ^ y;
+    std::uint32_t i1 = b | (0xFFFF ^ (i0 | a));
+
+    i0 = (i0 | (i0 << 8)) & 0x00FF00FF;
+    i0 = (i0 | (i0 << 4)) & 0x0F0F0F0F;
+    i0 = (i0 | (i0 << 2)) & 0x33333333;
+    i0 = (i0 | (i0 << 1)) & 0x55555555;
+
+    i1 = (i1 | (i1 << 8)) & 0x00FF00FF;
+    i1 = (i1 | (i1 << 4)) & 0x0F0F0F0F;
+    i1 = (i1 | (i1 << 2)) & 0x33333333;
+    i1 = (i1 | (i1 << 1)) & 0x55555555;
+
+    return (i1 << 1) | i0;
+}
+
+// Builds the tree in memory (used by the index utilities), the formats write
+// its header() followed by an entry per node with box(i) and offset(i)
+class packed_rtree
+{
+private:
+    struct item
+    {
+        std::uint32_t hilbert;
+        std::uint64_t offset;
+        box2d<double> ext;
+        bool operator<(item const& other) const
+        {
+            return hilbert < other.hilbert;
+        }
+    };
+
+    box2d<double> extent_;
+    unsigned node_size_;
+    std::vector<item> items_;
+    std::vector<box2d<double> > boxes_;
+    std::vector<std::uint64_t> indices_;
+
+public:
+    packed_rtree(box2d<double> const& extent, unsigned node_size)
+        : extent_(extent),
+          node_size_(std::max(2u, node_size)) {}
+
+    void insert(std::uint64_t offset, box2d<double> const& item_ext)
+    {
+        items_.push_back(item{0, offset, item_ext});
+    }
+
+    // sorts the items along the Hilbert curve, with `jobs` threads, and packs the nodes
+    void build(unsigned jobs = 1)
+    {
+        std::size_t num_items = items_.size();
+        jobs = std::max(1u, std::min<unsigned>(jobs, num_items / 4096 + 1));
+        std::size_t chunk = (num_items + jobs - 1) / jobs;
+        auto sort_range = [this](std::size_t first, std::size_t last)
+        {
+            double width = extent_.width() > 0 ? extent_.width() : 1.0;
+            double height = extent_.height() > 0 ? extent_.height() : 1.0;
+            for (std::size_t i = first; i < last; ++i)
+            {
+                item & it = items_[i];
+                double x = 0xFFFF * ((it.ext.minx() + it.ext.maxx()) / 2 - extent_.minx()) / width;
+                double y = 0xFFFF * ((it.ext.miny() + it.ext.maxy()) / 2 - extent_.miny()) / height;
+                it.hilbert = hilbert_value(static_cast<std::uint32_t>(std::max(0.0, std::min(x, 65535.0))),
+                                           static_cast<std::uint32_t>(std::max(0.0, std::min(y, 65535.0))));
+            }
+            std::sort(items_.begin() + first, items_.begin() + last);
+        };
+        if (jobs == 1)
+        {
+            sort_range(0, num_items);
+        }
+        else
+        {
+            std::vector<std::thread> threads;
+            for (unsigned i = 0; i < jobs; ++i)
+            {
+                threads.emplace_back(sort_range, std::min(num_items, i * chunk), std::min(num_items, (i + 1) * chunk));
+            }
+            for (auto & t : threads) t.join();
+            // merge the sorted chunks pairwise
+            for (std::size_t width = chunk; width < num_items; width *= 2)
+            {
+                for (std::size_t first = 0; first + width < num_items; first += 2 * width)
+                {
+                    std::inplace_merge(items_.begin() + first,
+                                       items_.begin() + first + width,
+                                       items_.begin() + std::min(num_items, first + 2 * width));
+                }
+            }
+        }
+
+        std::vector<std::uint64_t> bounds = packed_rtree_level_bounds(num_items, node_size_);
+        boxes_.clear();
+        indices_.clear();
+        if (bounds.empty()) return;
+        boxes_.reserve(bounds.back());
+        indices_.reserve(bounds.back());
+        for (auto const& it : items_)
+        {
+            boxes_.push_back(it.ext);
+            indices_.push_back(it.offset);
+        }
+        // every group of node_size entries on a level gets a parent on the next
+        std::uint64_t first = 0;
+        for (std::size_t level = 0; level + 1 < bounds.size(); ++level)
+        {
+            std::uint64_t end = bounds[level];
+            for (std::uint64_t pos = first; pos < end; pos += node_size_)
+            {
+                box2d<double> node_ext = boxes_[pos];
+                std::uint64_t last = std::min<std::uint64_t>(pos + node_size_, end);
+                for (std::uint64_t i = pos + 1; i < last; ++i)
+                {
+                    node_ext.expand_to_include(boxes_[i]);
+                }
+                boxes_.push_back(node_ext);
+                indices_.push_back(pos);
+            }
+            first = end;
+        }
+    }
+
+    std::size_t count() const
+    {
+        return boxes_.size();
+    }
+
+    std::size_t count_items() const
+    {
+        return items_.size();
+    }
+
+    // offset stored for the leaf at position `i` (in Hilbert order) after build(),
+    // for parent nodes the position of their first child
+    std::uint64_t offset(std::size_t i) const
+    {
+        return indices_[i];
+    }
+
+    // box of the node at position `i` after build()
+    box2d<double> const& box(std::size_t i) const
+    {
+        return boxes_[i];
+    }
+
+    void set_offset(std::size_t i, std::uint64_t offset)
+    {
+        indices_[i] = offset;
+    }
+
+    // the header of the built tree, in host byte order
+    packed_rtree_header header(char const (&magic)[8], std::uint16_t version, std::uint16_t flags = 0) const
+    {
+        packed_rtree_header header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, magic, sizeof(header.magic));
+        header.version = version;
+        header.flags = flags;
+        header.node_size = node_size_;
+        header.num_items = items_.size();
+        header.num_nodes = boxes_.size();
+        header.extent[0] = extent_.minx();
+        header.extent[1] = extent_.miny();
+        header.extent[2] = extent_.maxx();
+        header.extent[3] = extent_.maxy();
+        return header;
+    }
+};
+
+}}
+
+#endif // MAPNIK_UTIL_PACKED_RTREE_HPP
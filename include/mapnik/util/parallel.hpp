@@ -0,0 +1,117 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef MAPNIK_UTIL_PARALLEL_HPP
+#define MAPNIK_UTIL_PARALLEL_HPP
+
+// mapnik
+#include <mapnik/config.hpp>
+
+// stl
+#include <cstddef>
+#ifdef MAPNIK_THREADSAFE
+#include <algorithm>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+#endif
+
+namespace mapnik { namespace util {
+
+// Process wide limit on the threads started by parallel_for besides the
+// calling ones, shared by all the callers (default the number of cores - 1,
+// 0 runs everything on the calling threads).
+MAPNIK_DECL void set_parallel_threads(unsigned threads);
+MAPNIK_DECL unsigned parallel_threads();
+
+namespace detail {
+
+// takes up to `wanted` of the threads left under the limit, returns how many
+MAPNIK_DECL unsigned acquire_parallel_threads(unsigned wanted);
+MAPNIK_DECL void release_parallel_threads(unsigned count);
+
+}
+
+// Calls func(first, last) over bands of [0, count) of at least `min_chunk`
+// items each, on the calling thread and on as many other threads as the
+// limit leaves (no more than max_jobs - 1 when max_jobs isn't 0). The bands
+// that could not be given a thread run on the calling thread, and the first
+// exception thrown by func is rethrown once all the bands are done.
+template <typename Func>
+void parallel_for(std::size_t count, std::size_t min_chunk, Func && func, unsigned max_jobs = 0)
+{
+    if (count == 0) return;
+#ifdef MAPNIK_THREADSAFE
+    std::size_t wanted = count / std::max(min_chunk, std::size_t(1));
+    if (max_jobs > 0) wanted = std::min(wanted, static_cast<std::size_t>(max_jobs));
+    unsigned threads = wanted > 1 ? detail::acquire_parallel_threads(static_cast<unsigned>(wanted - 1)) : 0;
+    if (threads > 0)
+    {
+        std::size_t bands = threads + 1;
+        std::exception_ptr error;
+        std::mutex error_mutex;
+        auto run = [&](std::size_t n) {
+            try
+            {
+                func(count * n / bands, count * (n + 1) / bands);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(error_mutex);
+                if (!error) error = std::current_exception();
+            }
+        };
+        std::vector<std::thread> workers;
+        std::size_t n = 1;
+        try
+        {
+            workers.reserve(threads);
+            for (; n < bands; ++n)
+            {
+                workers.emplace_back(run, n);
+            }
+        }
+        catch (...)
+        {
+            // out of threads, the remaining bands run here
+        }
+        run(0);
+        for (; n < bands; ++n)
+        {
+            run(n);
+        }
+        for (auto & worker : workers)
+        {
+            worker.join();
+        }
+        detail::release_parallel_threads(threads);
+        if (error) std::rethrow_exception(error);
+        return;
+    }
+#endif
+    func(std::size_t(0), count);
+}
+
+}}
+
+#endif // MAPNIK_UTIL_PARALLEL_HPP
@@ -62,6 +62,10 @@ public:
     static mapnik::geometry::geometry<double> from_wkb(const char* wkb,
                                                    unsigned size,
                                                    wkbFormat format = wkbGeneric);
+
+    // Tiny Well-known Binary, e.g. the output of PostGIS ST_AsTWKB
+    static mapnik::geometry::geometry<double> from_twkb(const char* twkb,
+                                                        unsigned size);
 };
 
 }
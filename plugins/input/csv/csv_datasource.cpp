@@ -21,6 +21,8 @@
  *****************************************************************************/
 
 #include "csv_datasource.hpp"
+#include "csv_featureset.hpp"
+#include "csv_index_featureset.hpp"
 #include "csv_utils.hpp"
 
 // boost
@@ -35,14 +37,19 @@
 #include <mapnik/feature_factory.hpp>
 #include <mapnik/geometry.hpp>
 #include <mapnik/geometry_correct.hpp>
-#include <mapnik/memory_featureset.hpp>
+#include <mapnik/make_unique.hpp>
 #include <mapnik/wkt/wkt_factory.hpp>
 #include <mapnik/json/geometry_parser.hpp>
 #include <mapnik/util/conversions.hpp>
 #include <mapnik/boolean.hpp>
 #include <mapnik/util/trim.hpp>
 #include <mapnik/util/geometry_to_ds_type.hpp>
+#include <mapnik/util/parallel.hpp>
 #include <mapnik/value_types.hpp>
+#if defined(SHAPE_MEMORY_MAPPED_FILE)
+#include <mapnik/mapped_memory_cache.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#endif
 
 // stl
 #include <sstream>
@@ -51,12 +58,175 @@
 #include <vector>
 #include <string>
 #include <algorithm>
+#include <cstring>
+#include <functional>
 
 using mapnik::datasource;
 using mapnik::parameters;
 
 DATASOURCE_PLUGIN(csv_datasource)
 
+namespace {
+
+// chunks smaller than this are not worth a thread
+std::size_t const min_chunk_size = 1 << 16;
+
+// a row parsed off the loading thread, merged in file order afterwards
+struct parsed_row
+{
+    csv_row_parser::result_type result;
+    std::size_t offset;
+    std::size_t size;
+    int line_number;
+    csv_datasource::box_type box;
+    mapnik::feature_ptr feature; // only kept when features are cached
+    std::string error;
+};
+
+// a range of whole rows parsed by one thread
+struct csv_chunk
+{
+    std::size_t begin;
+    std::size_t end;
+    int line_number; // of the first row
+    std::vector<parsed_row> rows;
+};
+
+bool is_blank_row(std::string const& csv_line)
+{
+    if (csv_line.length() > 10) return false;
+    std::string trimmed = csv_line;
+    boost::trim_if(trimmed,boost::algorithm::is_any_of("\",'\r\n "));
+    return trimmed.empty();
+}
+
+// splits the rows in [begin, end) into up to `jobs` chunks. Rows are lines, as
+// when reading serially, but chunks only start after a newline outside of quoted
+// text. The quotes and newlines of the nominal chunks are counted in parallel so
+// that only the bytes up to the next safe newline are scanned to place a split.
+std::vector<csv_chunk> split_chunks(char const* data,
+                                    std::size_t begin,
+                                    std::size_t end,
+                                    char newline,
+                                    std::string const& quote,
+                                    std::string const& escape,
+                                    int line_number,
+                                    unsigned jobs)
+{
+    auto is_quote = [&quote](char c) { return quote.find(c) != std::string::npos; };
+    auto is_escape = [&quote,&escape](char c)
+    {
+        return escape.find(c) != std::string::npos && quote.find(c) == std::string::npos;
+    };
+
+    std::size_t size = end - begin;
+    jobs = std::max(1u, std::min<unsigned>(jobs, size / min_chunk_size + 1));
+    std::size_t step = (size + jobs - 1) / jobs;
+    std::vector<std::size_t> quotes(jobs, 0);
+    std::vector<std::size_t> lines(jobs, 0);
+    auto count_range = [&](unsigned i)
+    {
+        std::size_t first = std::min(end, begin + i * step);
+        std::size_t last = std::min(end, first + step);
+        bool escaped = first > begin && is_escape(data[first - 1]);
+        for (std::size_t pos = first; pos < last; ++pos)
+        {
+            char c = data[pos];
+            if (c == newline) ++lines[i];
+            if (escaped) escaped = false;
+            else if (is_escape(c)) escaped = true;
+            else if (is_quote(c)) ++quotes[i];
+        }
+    };
+    mapnik::util::parallel_for(jobs, 1, [&count_range](std::size_t first, std::size_t last) {
+            for (std::size_t i = first; i < last; ++i) count_range(static_cast<unsigned>(i));
+        }, jobs);
+
+    std::vector<csv_chunk> chunks;
+    std::size_t chunk_begin = begin;
+    int chunk_line = line_number;
+    std::size_t quote_count = 0;
+    for (unsigned i = 1; i < jobs; ++i)
+    {
+        // quotes and lines before the nominal start of this chunk
+        quote_count += quotes[i - 1];
+        line_number += lines[i - 1];
+        std::size_t pos = begin + i * step;
+        std::size_t next = std::min(end, pos + step);
+        bool in_quotes = (quote_count % 2) != 0;
+        bool escaped = is_escape(data[pos - 1]);
+        int scanned_lines = 0;
+        std::size_t split = 0;
+        for (; pos < next; ++pos)
+        {
+            char c = data[pos];
+            if (c == newline)
+            {
+                escaped = false;
+                ++scanned_lines;
+                if (!in_quotes)
+                {
+                    split = pos + 1;
+                    break;
+                }
+            }
+            else if (escaped) escaped = false;
+            else if (is_escape(c)) escaped = true;
+            else if (is_quote(c)) in_quotes = !in_quotes;
+        }
+        // without a safe newline the range stays with the previous chunk
+        if (split == 0 || split >= end) continue;
+        chunks.push_back(csv_chunk{chunk_begin, split, chunk_line, {}});
+        chunk_begin = split;
+        chunk_line = line_number + scanned_lines;
+    }
+    chunks.push_back(csv_chunk{chunk_begin, end, chunk_line, {}});
+    return chunks;
+}
+
+void parse_chunk(char const* data,
+                 csv_chunk & chunk,
+                 char newline,
+                 csv_row_parser const& parser,
+                 std::string const& encoding,
+                 mapnik::context_ptr const& ctx,
+                 bool attributes,
+                 bool strict)
+{
+    mapnik::transcoder tr(encoding);
+    std::string csv_line;
+    std::vector<std::string> values;
+    int line_number = chunk.line_number;
+    std::size_t pos = chunk.begin;
+    while (pos < chunk.end)
+    {
+        char const* found = static_cast<char const*>(std::memchr(data + pos, newline, chunk.end - pos));
+        std::size_t line_end = found ? static_cast<std::size_t>(found - data) : chunk.end;
+        csv_line.assign(data + pos, line_end - pos);
+        parsed_row row;
+        row.offset = pos;
+        row.size = csv_line.size();
+        row.line_number = line_number++;
+        pos = line_end + 1;
+        if (is_blank_row(csv_line)) continue;
+        row.result = parser.parse_row(csv_line, row.line_number, tr, ctx, row.feature,
+                                      nullptr, attributes, values, row.error);
+        if (row.result == csv_row_parser::row_ok)
+        {
+            row.box = row.feature->envelope();
+        }
+        if (row.result != csv_row_parser::row_ok || !attributes)
+        {
+            row.feature.reset();
+        }
+        chunk.rows.push_back(std::move(row));
+        // the merge stops at the first error
+        if (strict && !chunk.rows.back().error.empty()) break;
+    }
+}
+
+}
+
 csv_datasource::csv_datasource(parameters const& params)
   : datasource(params),
     desc_(csv_datasource::name(), *params.get<std::string>("encoding", "utf-8")),
@@ -74,7 +244,11 @@ csv_datasource::csv_datasource(parameters const& params)
     strict_(*params.get<mapnik::boolean_type>("strict", false)),
     filesize_max_(*params.get<double>("filesize_max", 20.0)),  // MB
     ctx_(std::make_shared<mapnik::context_type>()),
-    extent_initialized_(false)
+    extent_initialized_(false),
+    parser_(),
+    tree_(nullptr),
+    cache_features_(true),
+    jobs_(std::max<mapnik::value_integer>(1, *params.get<mapnik::value_integer>("jobs", 1)))
 {
     /* TODO:
        general:
@@ -88,8 +262,6 @@ csv_datasource::csv_datasource(parameters const& params)
        speed:
        - add properties for wkt/json/lon/lat at parse time
        - add ability to pass 'filter' keyword to drop attributes at layer init
-       - create quad tree on the fly for small/med size files
-       - memory map large files for reading
        - smaller features (less memory overhead)
        usability:
        - enforce column names without leading digit
@@ -127,6 +299,8 @@ csv_datasource::csv_datasource(parameters const& params)
     }
     else
     {
+        // keep only the byte range of each row and re-parse them on demand
+        cache_features_ = *params.get<mapnik::boolean_type>("cache_features", true);
 #if defined (_WINDOWS)
         std::ifstream in(mapnik::utf8_to_utf16(filename_),std::ios_base::in | std::ios_base::binary);
 #else
@@ -153,7 +327,8 @@ void csv_datasource::parse_csv(T & stream,
     stream.seekg(0, std::ios::end);
     file_length_ = stream.tellg();
 
-    if (filesize_max_ > 0)
+    // without the cache rows are not held in memory
+    if (filesize_max_ > 0 && cache_features_)
     {
         double file_mb = static_cast<double>(file_length_)/1048576;
 
@@ -267,6 +442,8 @@ void csv_datasource::parse_csv(T & stream,
     using Tokenizer = boost::tokenizer< escape_type >;
 
     int line_number(1);
+    // byte offset of the next line
+    std::size_t offset = 0;
     bool has_wkt_field = false;
     bool has_json_field = false;
     bool has_lat_field = false;
@@ -321,6 +498,7 @@ void csv_datasource::parse_csv(T & stream,
     {
         while (std::getline(stream,csv_line,newline))
         {
+            offset += csv_line.size() + 1;
             try
             {
                 Tokenizer tok(csv_line, grammer);
@@ -413,11 +591,22 @@ void csv_datasource::parse_csv(T & stream,
         throw mapnik::datasource_exception("CSV Plugin: could not detect column headers with the name of wkt, geojson, x/y, or latitude/longitude - this is required for reading geometry data");
     }
 
+    parser_.headers = headers_;
+    parser_.grammar = grammer;
+    parser_.quote = quo;
+    parser_.strict = strict_;
+    parser_.has_wkt_field = has_wkt_field;
+    parser_.has_json_field = has_json_field;
+    parser_.has_lat_field = has_lat_field;
+    parser_.has_lon_field = has_lon_field;
+    parser_.wkt_idx = wkt_idx;
+    parser_.json_idx = json_idx;
+    parser_.lat_idx = lat_idx;
+    parser_.lon_idx = lon_idx;
+
     mapnik::value_integer feature_count(0);
     bool extent_started = false;
 
-    std::size_t num_headers = headers_.size();
-
     for (std::size_t i = 0; i < headers_.size(); ++i)
     {
         ctx_->push(headers_[i]);
@@ -434,487 +623,603 @@ void csv_datasource::parse_csv(T & stream,
         if (!csv_line.empty())
         {
             is_first_row = true;
+            // the offset of that line is unknown, but there is only one
+            cache_features_ = true;
         }
     }
-    while (std::getline(stream,csv_line,newline) || is_first_row)
+    std::vector<std::string> values;
+    std::vector<item_type> rows;
+    // numbers a parsed row in file order and adds it to the index,
+    // returns false if the row was skipped
+    auto add_row = [&](csv_row_parser::result_type result,
+                       mapnik::feature_ptr const& feature,
+                       box_type const& box,
+                       std::string const& error,
+                       std::size_t line_offset,
+                       std::size_t line_size) -> bool
     {
-        is_first_row = false;
-        if ((row_limit_ > 0) && (line_number > row_limit_))
+        if (!error.empty())
         {
-            MAPNIK_LOG_DEBUG(csv) << "csv_datasource: row limit hit, exiting at feature: " << feature_count;
-            break;
-        }
-
-        // skip blank lines
-        unsigned line_length = csv_line.length();
-        if (line_length <= 10)
-        {
-            std::string trimmed = csv_line;
-            boost::trim_if(trimmed,boost::algorithm::is_any_of("\",'\r\n "));
-            if (trimmed.empty())
+            if (strict_)
             {
-                ++line_number;
-                MAPNIK_LOG_DEBUG(csv) << "csv_datasource: empty row encountered at line: " << line_number;
-                continue;
+                throw mapnik::datasource_exception(error);
             }
+            MAPNIK_LOG_ERROR(csv) << error;
         }
-
-        try
+        if (result == csv_row_parser::row_no_geometry)
+        {
+            // with no geometry we will never
+            // add this feature so drop the count
+            feature_count--;
+            return false;
+        }
+        if (result != csv_row_parser::row_ok)
+        {
+            return false;
+        }
+        if (!extent_initialized_)
         {
-            // special handling for varieties of quoting that we will enounter with json
-            // TODO - test with custom "quo" option
-            if (has_json_field && (quo == "\"") && (std::count(csv_line.begin(), csv_line.end(), '"') >= 6))
+            if (!extent_started)
             {
-                csv_utils::fix_json_quoting(csv_line);
+                extent_started = true;
+                extent_ = box;
             }
-
-            Tokenizer tok(csv_line, grammer);
-            Tokenizer::iterator beg = tok.begin();
-
-            unsigned num_fields = std::distance(beg,tok.end());
-            if (num_fields > num_headers)
+            else
             {
-                std::ostringstream s;
-                s << "CSV Plugin: # of columns("
-                  << num_fields << ") > # of headers("
-                  << num_headers << ") parsed for row " << line_number << "\n";
-                throw mapnik::datasource_exception(s.str());
+                extent_.expand_to_include(box);
             }
-            else if (num_fields < num_headers)
-            {
-                std::ostringstream s;
-                s << "CSV Plugin: # of headers("
-                  << num_headers << ") > # of columns("
-                  << num_fields << ") parsed for row " << line_number << "\n";
-                if (strict_)
+        }
+        if (cache_features_)
+        {
+            feature->set_id(feature_count);
+            rows.emplace_back(box, row_type{features_.size(), 0, feature_count});
+            features_.push_back(feature);
+        }
+        else
+        {
+            rows.emplace_back(box, row_type{line_offset, line_size, feature_count});
+        }
+        return true;
+    };
+
+    // row limits count the rows as they are read, so they are always read serially
+    if (jobs_ > 1 && has_newline && row_limit_ == 0 && !filename_.empty())
+    {
+        std::size_t file_length = file_length_;
+#if defined(SHAPE_MEMORY_MAPPED_FILE)
+        // the mapping is only kept when rows are re-read from it later
+        boost::optional<mapnik::mapped_region_ptr> memory =
+            mapnik::mapped_memory_cache::instance().find(filename_, !cache_features_);
+        if (!memory)
+        {
+            throw mapnik::datasource_exception("CSV Plugin: could not get file mapping for '" + filename_ + "'");
+        }
+        char const* data = static_cast<char const*>((*memory)->get_address());
+        file_length = std::min(file_length, (*memory)->get_size());
+#else
+        std::vector<char> buffer(file_length);
+        stream.clear();
+        stream.seekg(0, std::ios::beg);
+        stream.read(buffer.data(), buffer.size());
+        file_length = stream.gcount();
+        char const* data = buffer.data();
+#endif
+        offset = std::min(offset, file_length);
+        int first_line = static_cast<int>(std::count(data, data + offset, newline)) + 1;
+        std::vector<csv_chunk> chunks = split_chunks(data, offset, file_length, newline,
+                                                     quo, esc, first_line, jobs_);
+        MAPNIK_LOG_DEBUG(csv) << "csv_datasource: parsing rows in " << chunks.size() << " chunks";
+
+        mapnik::util::parallel_for(chunks.size(), 1, [&](std::size_t first, std::size_t last) {
+                for (std::size_t i = first; i < last; ++i)
                 {
-                    throw mapnik::datasource_exception(s.str());
+                    parse_chunk(data, chunks[i], newline, parser_, desc_.get_encoding(), ctx_, cache_features_, strict_);
                 }
-                else
+            }, jobs_);
+
+        // merge the chunks in file order so that ids, the extent and the attribute
+        // types come out the same as when the rows are read serially
+        for (auto & chunk : chunks)
+        {
+            for (auto const& row : chunk.rows)
+            {
+                if (row.result != csv_row_parser::row_tokenize_error && ++feature_count == 1)
                 {
-                    MAPNIK_LOG_WARN(csv) << s.str();
+                    // the attributes are described by the first row
+                    mapnik::feature_ptr feature;
+                    std::string error;
+                    csv_line.assign(data + row.offset, row.size);
+                    parser_.parse_row(csv_line, row.line_number, tr, ctx_, feature, &desc_, true, values, error);
                 }
+                add_row(row.result, row.feature, row.box, row.error, row.offset, row.size);
             }
+            std::vector<parsed_row>().swap(chunk.rows);
+        }
+    }
+    else while (std::getline(stream,csv_line,newline) || is_first_row)
+    {
+        is_first_row = false;
+        std::size_t line_offset = offset;
+        std::size_t line_size = csv_line.size();
+        offset += line_size + 1;
+        if ((row_limit_ > 0) && (line_number > row_limit_))
+        {
+            MAPNIK_LOG_DEBUG(csv) << "csv_datasource: row limit hit, exiting at feature: " << feature_count;
+            break;
+        }
 
-            // NOTE: we use ++feature_count here because feature id's should start at 1;
-            mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx_,++feature_count));
-            double x(0);
-            double y(0);
-            bool parsed_x = false;
-            bool parsed_y = false;
-            bool parsed_wkt = false;
-            bool parsed_json = false;
-            std::vector<std::string> collected;
-            for (unsigned i = 0; i < num_headers; ++i)
+        // skip blank lines
+        if (is_blank_row(csv_line))
+        {
+            ++line_number;
+            MAPNIK_LOG_DEBUG(csv) << "csv_datasource: empty row encountered at line: " << line_number;
+            continue;
+        }
+
+        mapnik::feature_ptr feature;
+        std::string error;
+        // NOTE: feature id's start at 1 and are assigned in add_row, the first
+        // row describes the attributes (and is the only one read without the cache)
+        csv_row_parser::result_type result = parser_.parse_row(csv_line, line_number, tr, ctx_, feature,
+                                                               feature_count == 0 ? &desc_ : nullptr,
+                                                               cache_features_ || feature_count == 0,
+                                                               values, error);
+        if (result != csv_row_parser::row_tokenize_error)
+        {
+            ++feature_count;
+        }
+        box_type box;
+        if (result == csv_row_parser::row_ok)
+        {
+            box = feature->envelope();
+        }
+        if (add_row(result, feature, box, error, line_offset, line_size))
+        {
+            ++line_number;
+        }
+    }
+    if (feature_count < 1)
+    {
+        MAPNIK_LOG_ERROR(csv) << "CSV Plugin: could not parse any lines of data";
+    }
+    // packing algorithm
+    tree_ = std::make_unique<spatial_index_type>(rows);
+}
+
+csv_row_parser::csv_row_parser()
+    : headers(),
+      grammar(),
+      quote("\""),
+      strict(false),
+      has_wkt_field(false),
+      has_json_field(false),
+      has_lat_field(false),
+      has_lon_field(false),
+      wkt_idx(0),
+      json_idx(0),
+      lat_idx(0),
+      lon_idx(0) {}
+
+void csv_row_parser::tokenize(std::string & csv_line, int line_number, std::vector<std::string> & values) const
+{
+    // special handling for varieties of quoting that we will enounter with json
+    // TODO - test with custom "quo" option
+    if (has_json_field && (quote == "\"") && (std::count(csv_line.begin(), csv_line.end(), '"') >= 6))
+    {
+        csv_utils::fix_json_quoting(csv_line);
+    }
+
+    using Tokenizer = boost::tokenizer< boost::escaped_list_separator<char> >;
+    Tokenizer tok(csv_line, grammar);
+    values.clear();
+    for (Tokenizer::iterator beg = tok.begin(); beg != tok.end(); ++beg)
+    {
+        values.push_back(mapnik::util::trim_copy(*beg));
+    }
+
+    std::size_t num_fields = values.size();
+    std::size_t num_headers = headers.size();
+    if (num_fields > num_headers)
+    {
+        std::ostringstream s;
+        s << "CSV Plugin: # of columns("
+          << num_fields << ") > # of headers("
+          << num_headers << ") parsed for row " << line_number << "\n";
+        throw mapnik::datasource_exception(s.str());
+    }
+    else if (num_fields < num_headers)
+    {
+        std::ostringstream s;
+        s << "CSV Plugin: # of headers("
+          << num_headers << ") > # of columns("
+          << num_fields << ") parsed for row " << line_number << "\n";
+        if (strict)
+        {
+            throw mapnik::datasource_exception(s.str());
+        }
+        else
+        {
+            MAPNIK_LOG_WARN(csv) << s.str();
+        }
+    }
+}
+
+csv_row_parser::result_type csv_row_parser::parse_row(std::string & csv_line,
+                                                      int line_number,
+                                                      mapnik::transcoder const& tr,
+                                                      mapnik::context_ptr const& ctx,
+                                                      mapnik::feature_ptr & feature,
+                                                      mapnik::layer_descriptor * desc,
+                                                      bool attributes,
+                                                      std::vector<std::string> & values,
+                                                      std::string & error) const
+{
+    result_type result = row_tokenize_error;
+    error.clear();
+    try
+    {
+        tokenize(csv_line, line_number, values);
+        result = row_error;
+        feature = mapnik::feature_factory::create(ctx, 0);
+        return parse(values, csv_line, line_number, tr, *feature, desc, attributes);
+    }
+    catch (mapnik::datasource_exception const& ex)
+    {
+        error = ex.what();
+    }
+    catch (std::exception const& ex)
+    {
+        std::ostringstream s;
+        s << "CSV Plugin: unexpected error parsing line: " << line_number
+          << " - found " << headers.size() << " with values like: " << csv_line << "\n"
+          << " and got error like: " << ex.what();
+        error = s.str();
+    }
+    return result;
+}
+
+csv_row_parser::result_type csv_row_parser::parse(std::vector<std::string> const& values,
+                                                  std::string const& csv_line,
+                                                  int line_number,
+                                                  mapnik::transcoder const& tr,
+                                                  mapnik::feature_impl & feature,
+                                                  mapnik::layer_descriptor * desc,
+                                                  bool attributes) const
+{
+    double x(0);
+    double y(0);
+    bool parsed_x = false;
+    bool parsed_y = false;
+    bool parsed_wkt = false;
+    bool parsed_json = false;
+    std::size_t num_headers = headers.size();
+    for (unsigned i = 0; i < num_headers; ++i)
+    {
+        std::string const& fld_name = headers[i];
+        if (i >= values.size()) // there are more headers than column values for this row
+        {
+            if (!attributes) continue;
+            // add an empty string here to represent a missing value
+            // not using null type here since nulls are not a csv thing
+            feature.put(fld_name,tr.transcode(""));
+            if (desc)
             {
-                std::string fld_name(headers_.at(i));
-                collected.push_back(fld_name);
-                std::string value;
-                if (beg == tok.end()) // there are more headers than column values for this row
-                {
-                    // add an empty string here to represent a missing value
-                    // not using null type here since nulls are not a csv thing
-                    feature->put(fld_name,tr.transcode(value.c_str()));
-                    if (feature_count == 1)
-                    {
-                        desc_.add_descriptor(mapnik::attribute_descriptor(fld_name,mapnik::String));
-                    }
-                    // continue here instead of break so that all missing values are
-                    // encoded consistenly as empty strings
-                    continue;
-                }
-                else
-                {
-                    value = mapnik::util::trim_copy(*beg);
-                    ++beg;
-                }
+                desc->add_descriptor(mapnik::attribute_descriptor(fld_name,mapnik::String));
+            }
+            // continue here instead of break so that all missing values are
+            // encoded consistenly as empty strings
+            continue;
+        }
+        std::string const& value = values[i];
 
-                int value_length = value.length();
+        int value_length = value.length();
 
-                // parse wkt
-                if (has_wkt_field)
+        // parse wkt
+        if (has_wkt_field)
+        {
+            if (i == wkt_idx)
+            {
+                // skip empty geoms
+                if (value.empty())
                 {
-                    if (i == wkt_idx)
-                    {
-                        // skip empty geoms
-                        if (value.empty())
-                        {
-                            break;
-                        }
-                        mapnik::geometry::geometry<double> geom;
-                        if (mapnik::from_wkt(value, geom))
-                        {
-                            // correct orientations etc
-                            mapnik::geometry::correct(geom);
-                            // set geometry
-                            feature->set_geometry(std::move(geom));
-                            parsed_wkt = true;
-                        }
-                        else
-                        {
-                            std::ostringstream s;
-                            s << "CSV Plugin: expected well known text geometry: could not parse row "
-                              << line_number
-                              << ",column "
-                              << i << " - found: '"
-                              << value << "'";
-                            if (strict_)
-                            {
-                                throw mapnik::datasource_exception(s.str());
-                            }
-                            else
-                            {
-                                MAPNIK_LOG_ERROR(csv) << s.str();
-                            }
-                        }
-                    }
+                    break;
                 }
-                // TODO - support both wkt/geojson columns
-                // at once to create multi-geoms?
-                // parse as geojson
-                else if (has_json_field)
+                mapnik::geometry::geometry<double> geom;
+                if (mapnik::from_wkt(value, geom))
                 {
-                    if (i == json_idx)
-                    {
-                        // skip empty geoms
-                        if (value.empty())
-                        {
-                            break;
-                        }
-                        mapnik::geometry::geometry<double> geom;
-                        if (mapnik::json::from_geojson(value, geom))
-                        {
-                            feature->set_geometry(std::move(geom));
-                            parsed_json = true;
-                        }
-                        else
-                        {
-                            std::ostringstream s;
-                            s << "CSV Plugin: expected geojson geometry: could not parse row "
-                              << line_number
-                              << ",column "
-                              << i << " - found: '"
-                              << value << "'";
-                            if (strict_)
-                            {
-                                throw mapnik::datasource_exception(s.str());
-                            }
-                            else
-                            {
-                                MAPNIK_LOG_ERROR(csv) << s.str();
-                            }
-                        }
-                    }
+                    // correct orientations etc
+                    mapnik::geometry::correct(geom);
+                    // set geometry
+                    feature.set_geometry(std::move(geom));
+                    parsed_wkt = true;
                 }
                 else
                 {
-                    // longitude
-                    if (i == lon_idx)
+                    std::ostringstream s;
+                    s << "CSV Plugin: expected well known text geometry: could not parse row "
+                      << line_number
+                      << ",column "
+                      << i << " - found: '"
+                      << value << "'";
+                    if (strict)
                     {
-                        // skip empty geoms
-                        if (value.empty())
-                        {
-                            break;
-                        }
-
-                        if (mapnik::util::string2double(value,x))
-                        {
-                            parsed_x = true;
-                        }
-                        else
-                        {
-                            std::ostringstream s;
-                            s << "CSV Plugin: expected a float value for longitude: could not parse row "
-                              << line_number
-                              << ", column "
-                              << i << " - found: '"
-                              << value << "'";
-                            if (strict_)
-                            {
-                                throw mapnik::datasource_exception(s.str());
-                            }
-                            else
-                            {
-                                MAPNIK_LOG_ERROR(csv) << s.str();
-                            }
-                        }
+                        throw mapnik::datasource_exception(s.str());
                     }
-                    // latitude
-                    else if (i == lat_idx)
+                    else
                     {
-                        // skip empty geoms
-                        if (value.empty())
-                        {
-                            break;
-                        }
-
-                        if (mapnik::util::string2double(value,y))
-                        {
-                            parsed_y = true;
-                        }
-                        else
-                        {
-                            std::ostringstream s;
-                            s << "CSV Plugin: expected a float value for latitude: could not parse row "
-                              << line_number
-                              << ", column "
-                              << i << " - found: '"
-                              << value << "'";
-                            if (strict_)
-                            {
-                                throw mapnik::datasource_exception(s.str());
-                            }
-                            else
-                            {
-                                MAPNIK_LOG_ERROR(csv) << s.str();
-                            }
-                        }
+                        MAPNIK_LOG_ERROR(csv) << s.str();
                     }
                 }
-
-                // now, add attributes, skipping any WKT or JSON fields
-                if ((has_wkt_field) && (i == wkt_idx)) continue;
-                if ((has_json_field) && (i == json_idx)) continue;
-                /* First we detect likely strings,
-                   then try parsing likely numbers,
-                   then try converting to bool,
-                   finally falling back to string type.
-                   An empty string or a string of "null" will be parsed
-                   as a string rather than a true null value.
-                   Likely strings are either empty values, very long values
-                   or values with leading zeros like 001 (which are not safe
-                   to assume are numbers)
-                */
-
-                bool matched = false;
-                bool has_dot = value.find(".") != std::string::npos;
-                if (value.empty() ||
-                    (value_length > 20) ||
-                    (value_length > 1 && !has_dot && value[0] == '0'))
+            }
+        }
+        // TODO - support both wkt/geojson columns
+        // at once to create multi-geoms?
+        // parse as geojson
+        else if (has_json_field)
+        {
+            if (i == json_idx)
+            {
+                // skip empty geoms
+                if (value.empty())
                 {
-                    matched = true;
-                    feature->put(fld_name,std::move(tr.transcode(value.c_str())));
-                    if (feature_count == 1)
-                    {
-                        desc_.add_descriptor(mapnik::attribute_descriptor(fld_name,mapnik::String));
-                    }
+                    break;
                 }
-                else if (csv_utils::is_likely_number(value))
+                mapnik::geometry::geometry<double> geom;
+                if (mapnik::json::from_geojson(value, geom))
                 {
-                    bool has_e = value.find("e") != std::string::npos;
-                    if (has_dot || has_e)
-                    {
-                        double float_val = 0.0;
-                        if (mapnik::util::string2double(value,float_val))
-                        {
-                            matched = true;
-                            feature->put(fld_name,float_val);
-                            if (feature_count == 1)
-                            {
-                                desc_.add_descriptor(
-                                    mapnik::attribute_descriptor(
-                                        fld_name,mapnik::Double));
-                            }
-                        }
-                    }
-                    else
-                    {
-                        mapnik::value_integer int_val = 0;
-                        if (mapnik::util::string2int(value,int_val))
-                        {
-                            matched = true;
-                            feature->put(fld_name,int_val);
-                            if (feature_count == 1)
-                            {
-                                desc_.add_descriptor(
-                                    mapnik::attribute_descriptor(
-                                        fld_name,mapnik::Integer));
-                            }
-                        }
-                    }
+                    feature.set_geometry(std::move(geom));
+                    parsed_json = true;
                 }
-                if (!matched)
+                else
                 {
-                    // NOTE: we don't use mapnik::util::string2bool
-                    // here because we don't want to treat 'on' and 'off'
-                    // as booleans, only 'true' and 'false'
-                    bool bool_val = false;
-                    std::string lower_val = value;
-                    std::transform(lower_val.begin(), lower_val.end(), lower_val.begin(), ::tolower);
-                    if (lower_val == "true")
-                    {
-                        matched = true;
-                        bool_val = true;
-                    }
-                    else if (lower_val == "false")
-                    {
-                        matched = true;
-                        bool_val = false;
-                    }
-                    if (matched)
+                    std::ostringstream s;
+                    s << "CSV Plugin: expected geojson geometry: could not parse row "
+                      << line_number
+                      << ",column "
+                      << i << " - found: '"
+                      << value << "'";
+                    if (strict)
                     {
-                        feature->put(fld_name,bool_val);
-                        if (feature_count == 1)
-                        {
-                            desc_.add_descriptor(
-                                mapnik::attribute_descriptor(
-                                    fld_name,mapnik::Boolean));
-                        }
+                        throw mapnik::datasource_exception(s.str());
                     }
                     else
                     {
-                        // fallback to normal string
-                        feature->put(fld_name,std::move(tr.transcode(value.c_str())));
-                        if (feature_count == 1)
-                        {
-                            desc_.add_descriptor(
-                                mapnik::attribute_descriptor(
-                                    fld_name,mapnik::String));
-                        }
+                        MAPNIK_LOG_ERROR(csv) << s.str();
                     }
                 }
             }
-
-            bool null_geom = true;
-            if (has_wkt_field || has_json_field)
+        }
+        else
+        {
+            // longitude
+            if (i == lon_idx)
             {
-                if (parsed_wkt || parsed_json)
+                // skip empty geoms
+                if (value.empty())
                 {
-                    if (!extent_initialized_)
-                    {
-                        if (!extent_started)
-                        {
-                            extent_started = true;
-                            extent_ = feature->envelope();
-                        }
-                        else
-                        {
-                            extent_.expand_to_include(feature->envelope());
-                        }
-                    }
-                    features_.push_back(feature);
-                    null_geom = false;
+                    break;
+                }
+
+                if (mapnik::util::string2double(value,x))
+                {
+                    parsed_x = true;
                 }
                 else
                 {
                     std::ostringstream s;
-                    s << "CSV Plugin: could not read WKT or GeoJSON geometry "
-                      << "for line " << line_number << " - found " <<  headers_.size()
-                      << " with values like: " << csv_line << "\n";
-                    if (strict_)
+                    s << "CSV Plugin: expected a float value for longitude: could not parse row "
+                      << line_number
+                      << ", column "
+                      << i << " - found: '"
+                      << value << "'";
+                    if (strict)
                     {
                         throw mapnik::datasource_exception(s.str());
                     }
                     else
                     {
                         MAPNIK_LOG_ERROR(csv) << s.str();
-                        continue;
                     }
                 }
             }
-            else if (has_lat_field || has_lon_field)
+            // latitude
+            else if (i == lat_idx)
             {
-                if (parsed_x && parsed_y)
+                // skip empty geoms
+                if (value.empty())
                 {
-                    mapnik::geometry::point<double> pt(x,y);
-                    feature->set_geometry(std::move(pt));
-                    features_.push_back(feature);
-                    null_geom = false;
-                    if (!extent_initialized_)
-                    {
-                        if (!extent_started)
-                        {
-                            extent_started = true;
-                            extent_ = feature->envelope();
-                        }
-                        else
-                        {
-                            extent_.expand_to_include(feature->envelope());
-                        }
-                    }
+                    break;
                 }
-                else if (parsed_x || parsed_y)
+
+                if (mapnik::util::string2double(value,y))
+                {
+                    parsed_y = true;
+                }
+                else
                 {
                     std::ostringstream s;
-                    s << "CSV Plugin: does your csv have valid headers?\n";
-                    if (!parsed_x)
-                    {
-                        s << "Could not detect or parse any rows named 'x' or 'longitude' "
-                          << "for line " << line_number << " but found " <<  headers_.size()
-                          << " with values like: " << csv_line << "\n"
-                          << "for: " << boost::algorithm::join(collected, ",") << "\n";
-                    }
-                    if (!parsed_y)
-                    {
-                        s << "Could not detect or parse any rows named 'y' or 'latitude' "
-                          << "for line " << line_number << " but found " <<  headers_.size()
-                          << " with values like: " << csv_line << "\n"
-                          << "for: " << boost::algorithm::join(collected, ",") << "\n";
-                    }
-                    if (strict_)
+                    s << "CSV Plugin: expected a float value for latitude: could not parse row "
+                      << line_number
+                      << ", column "
+                      << i << " - found: '"
+                      << value << "'";
+                    if (strict)
                     {
                         throw mapnik::datasource_exception(s.str());
                     }
                     else
                     {
                         MAPNIK_LOG_ERROR(csv) << s.str();
-                        continue;
                     }
                 }
             }
+        }
+
+        // now, add attributes, skipping any WKT or JSON fields
+        if (!attributes) continue;
+        if ((has_wkt_field) && (i == wkt_idx)) continue;
+        if ((has_json_field) && (i == json_idx)) continue;
+        /* First we detect likely strings,
+           then try parsing likely numbers,
+           then try converting to bool,
+           finally falling back to string type.
+           An empty string or a string of "null" will be parsed
+           as a string rather than a true null value.
+           Likely strings are either empty values, very long values
+           or values with leading zeros like 001 (which are not safe
+           to assume are numbers)
+        */
 
-            if (null_geom)
+        bool matched = false;
+        bool has_dot = value.find(".") != std::string::npos;
+        if (value.empty() ||
+            (value_length > 20) ||
+            (value_length > 1 && !has_dot && value[0] == '0'))
+        {
+            matched = true;
+            feature.put(fld_name,std::move(tr.transcode(value.c_str())));
+            if (desc)
             {
-                std::ostringstream s;
-                s << "CSV Plugin: could not detect and parse valid lat/lon fields or wkt/json geometry for line "
-                  << line_number;
-                if (strict_)
+                desc->add_descriptor(mapnik::attribute_descriptor(fld_name,mapnik::String));
+            }
+        }
+        else if (csv_utils::is_likely_number(value))
+        {
+            bool has_e = value.find("e") != std::string::npos;
+            if (has_dot || has_e)
+            {
+                double float_val = 0.0;
+                if (mapnik::util::string2double(value,float_val))
                 {
-                    throw mapnik::datasource_exception(s.str());
+                    matched = true;
+                    feature.put(fld_name,float_val);
+                    if (desc)
+                    {
+                        desc->add_descriptor(
+                            mapnik::attribute_descriptor(
+                                fld_name,mapnik::Double));
+                    }
                 }
-                else
+            }
+            else
+            {
+                mapnik::value_integer int_val = 0;
+                if (mapnik::util::string2int(value,int_val))
                 {
-                    MAPNIK_LOG_ERROR(csv) << s.str();
-                    // with no geometry we will never
-                    // add this feature so drop the count
-                    feature_count--;
-                    continue;
+                    matched = true;
+                    feature.put(fld_name,int_val);
+                    if (desc)
+                    {
+                        desc->add_descriptor(
+                            mapnik::attribute_descriptor(
+                                fld_name,mapnik::Integer));
+                    }
                 }
             }
-
-            ++line_number;
         }
-        catch(mapnik::datasource_exception const& ex )
+        if (!matched)
         {
-            if (strict_)
+            // NOTE: we don't use mapnik::util::string2bool
+            // here because we don't want to treat 'on' and 'off'
+            // as booleans, only 'true' and 'false'
+            bool bool_val = false;
+            std::string lower_val = value;
+            std::transform(lower_val.begin(), lower_val.end(), lower_val.begin(), ::tolower);
+            if (lower_val == "true")
             {
-                throw mapnik::datasource_exception(ex.what());
+                matched = true;
+                bool_val = true;
+            }
+            else if (lower_val == "false")
+            {
+                matched = true;
+                bool_val = false;
+            }
+            if (matched)
+            {
+                feature.put(fld_name,bool_val);
+                if (desc)
+                {
+                    desc->add_descriptor(
+                        mapnik::attribute_descriptor(
+                            fld_name,mapnik::Boolean));
+                }
             }
             else
             {
-                MAPNIK_LOG_ERROR(csv) << ex.what();
+                // fallback to normal string
+                feature.put(fld_name,std::move(tr.transcode(value.c_str())));
+                if (desc)
+                {
+                    desc->add_descriptor(
+                        mapnik::attribute_descriptor(
+                            fld_name,mapnik::String));
+                }
             }
         }
-        catch(std::exception const& ex)
+    }
+
+    if (has_wkt_field || has_json_field)
+    {
+        if (parsed_wkt || parsed_json)
+        {
+            return row_ok;
+        }
+        std::ostringstream s;
+        s << "CSV Plugin: could not read WKT or GeoJSON geometry "
+          << "for line " << line_number << " - found " <<  headers.size()
+          << " with values like: " << csv_line << "\n";
+        if (strict)
+        {
+            throw mapnik::datasource_exception(s.str());
+        }
+        MAPNIK_LOG_ERROR(csv) << s.str();
+        return row_invalid;
+    }
+    else if (has_lat_field || has_lon_field)
+    {
+        if (parsed_x && parsed_y)
+        {
+            mapnik::geometry::point<double> pt(x,y);
+            feature.set_geometry(std::move(pt));
+            return row_ok;
+        }
+        else if (parsed_x || parsed_y)
         {
             std::ostringstream s;
-            s << "CSV Plugin: unexpected error parsing line: " << line_number
-              << " - found " << headers_.size() << " with values like: " << csv_line << "\n"
-              << " and got error like: " << ex.what();
-            if (strict_)
+            s << "CSV Plugin: does your csv have valid headers?\n";
+            if (!parsed_x)
             {
-                throw mapnik::datasource_exception(s.str());
+                s << "Could not detect or parse any rows named 'x' or 'longitude' "
+                  << "for line " << line_number << " but found " <<  headers.size()
+                  << " with values like: " << csv_line << "\n"
+                  << "for: " << boost::algorithm::join(headers, ",") << "\n";
             }
-            else
+            if (!parsed_y)
             {
-                MAPNIK_LOG_ERROR(csv) << s.str();
+                s << "Could not detect or parse any rows named 'y' or 'latitude' "
+                  << "for line " << line_number << " but found " <<  headers.size()
+                  << " with values like: " << csv_line << "\n"
+                  << "for: " << boost::algorithm::join(headers, ",") << "\n";
             }
+            if (strict)
+            {
+                throw mapnik::datasource_exception(s.str());
+            }
+            MAPNIK_LOG_ERROR(csv) << s.str();
+            return row_invalid;
         }
     }
-    if (feature_count < 1)
+
+    std::ostringstream s;
+    s << "CSV Plugin: could not detect and parse valid lat/lon fields or wkt/json geometry for line "
+      << line_number;
+    if (strict)
     {
-        MAPNIK_LOG_ERROR(csv) << "CSV Plugin: could not parse any lines of data";
+        throw mapnik::datasource_exception(s.str());
     }
+    MAPNIK_LOG_ERROR(csv) << s.str();
+    return row_no_geometry;
 }
 
 const char * csv_datasource::name()
@@ -941,10 +1246,34 @@ boost::optional<mapnik::datasource_geometry_t> csv_datasource::get_geometry_type
 {
     boost::optional<mapnik::datasource_geometry_t> result;
     int multi_type = 0;
-    unsigned num_features = features_.size();
-    for (unsigned i = 0; i < num_features && i < 5; ++i)
+    mapnik::featureset_ptr fs;
+    if (cache_features_)
     {
-        result = mapnik::util::to_ds_type(features_[i]->get_geometry());
+        unsigned num_features = features_.size();
+        csv_featureset::array_type index_array;
+        for (unsigned i = 0; i < num_features && i < 5; ++i)
+        {
+            index_array.emplace_back(features_[i]->envelope(), row_type{i, 0, features_[i]->id()});
+        }
+        fs = std::make_shared<csv_featureset>(features_, std::move(index_array));
+    }
+    else if (tree_)
+    {
+        csv_index_featureset::array_type index_array;
+        auto itr = tree_->qbegin(boost::geometry::index::intersects(extent_));
+        auto end = tree_->qend();
+        for (std::size_t count = 0; itr != end && count < 5; ++itr,++count)
+        {
+            index_array.push_back(*itr);
+        }
+        fs = std::make_shared<csv_index_featureset>(filename_, parser_, desc_.get_encoding(),
+                                                    ctx_, std::move(index_array));
+    }
+    if (!fs) return result;
+    mapnik::feature_ptr feature;
+    while ((feature = fs->next()))
+    {
+        result = mapnik::util::to_ds_type(feature->get_geometry());
         if (result)
         {
             int type = static_cast<int>(*result);
@@ -983,10 +1312,37 @@ mapnik::featureset_ptr csv_datasource::features(mapnik::query const& q) const
         }
         ++pos;
     }
-    return std::make_shared<mapnik::memory_featureset>(q.get_bbox(),features_);
+
+    csv_featureset::array_type index_array;
+    if (tree_)
+    {
+        tree_->query(boost::geometry::index::intersects(q.get_bbox()),std::back_inserter(index_array));
+        // features are returned in file order
+        std::sort(index_array.begin(),index_array.end(),
+                  [] (item_type const& item0, item_type const& item1)
+                  {
+                      return item0.second.offset < item1.second.offset;
+                  });
+    }
+    if (cache_features_)
+    {
+        return std::make_shared<csv_featureset>(features_, std::move(index_array));
+    }
+    return std::make_shared<csv_index_featureset>(filename_, parser_, desc_.get_encoding(),
+                                                  ctx_, std::move(index_array));
 }
 
 mapnik::featureset_ptr csv_datasource::features_at_point(mapnik::coord2d const& pt, double tol) const
 {
-    throw mapnik::datasource_exception("CSV Plugin: features_at_point is not supported yet");
+    mapnik::box2d<double> query_bbox(pt, pt);
+    query_bbox.pad(tol);
+    mapnik::query q(query_bbox);
+    std::vector<mapnik::attribute_descriptor> const& desc = desc_.get_descriptors();
+    std::vector<mapnik::attribute_descriptor>::const_iterator itr = desc.begin();
+    std::vector<mapnik::attribute_descriptor>::const_iterator end = desc.end();
+    for ( ;itr!=end;++itr)
+    {
+        q.add_property_name(itr->get_name());
+    }
+    return features(q);
 }
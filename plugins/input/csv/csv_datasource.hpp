@@ -32,18 +32,115 @@
 #include <mapnik/coord.hpp>
 #include <mapnik/feature_layer_desc.hpp>
 #include <mapnik/value_types.hpp>
+#include <mapnik/unicode.hpp>
+#include <mapnik/geometry_adapters.hpp>
 
 // boost
 #include <boost/optional.hpp>
+#include <boost/tokenizer.hpp>
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-parameter"
+#pragma GCC diagnostic ignored "-Wunused-variable"
+#pragma GCC diagnostic ignored "-Wunused-local-typedef"
+#include <boost/version.hpp>
+#include <boost/geometry/index/rtree.hpp>
+#pragma GCC diagnostic pop
 
 // stl
+#include <memory>
 #include <vector>
-#include <deque>
 #include <string>
 
+template <std::size_t Max, std::size_t Min>
+struct csv_linear : boost::geometry::index::linear<Max,Min> {};
+
+namespace boost { namespace geometry { namespace index { namespace detail { namespace rtree {
+
+template <std::size_t Max, std::size_t Min>
+struct options_type<csv_linear<Max,Min> >
+{
+    using type = options<csv_linear<Max, Min>,
+                         insert_default_tag,
+                         choose_by_content_diff_tag,
+                         split_default_tag,
+                         linear_tag,
+#if BOOST_VERSION >= 105700
+                         node_variant_static_tag>;
+#else
+                         node_s_mem_static_tag>;
+
+#endif
+};
+
+}}}}}
+
+// Reads the geometry and attributes of a data row once the headers are known,
+// shared by csv_datasource and csv_index_featureset (which re-parses rows)
+struct csv_row_parser
+{
+    enum result_type
+    {
+        row_ok,
+        row_invalid,        // the geometry could not be parsed
+        row_no_geometry,    // no geometry columns were found
+        row_tokenize_error, // the values of the row could not be split
+        row_error           // parsing threw after the row was split
+    };
+
+    csv_row_parser();
+
+    // splits a row into its trimmed values, throws if it has more values than headers
+    void tokenize(std::string & csv_line, int line_number, std::vector<std::string> & values) const;
+    // fills `feature`; attribute types are added to `desc` when given and only the
+    // geometry is read unless `attributes` is set
+    result_type parse(std::vector<std::string> const& values,
+                      std::string const& csv_line,
+                      int line_number,
+                      mapnik::transcoder const& tr,
+                      mapnik::feature_impl & feature,
+                      mapnik::layer_descriptor * desc,
+                      bool attributes = true) const;
+    // tokenizes and parses a row into a new `feature`, errors are returned in `error`
+    // instead of being thrown so that rows can be parsed off the calling thread
+    result_type parse_row(std::string & csv_line,
+                          int line_number,
+                          mapnik::transcoder const& tr,
+                          mapnik::context_ptr const& ctx,
+                          mapnik::feature_ptr & feature,
+                          mapnik::layer_descriptor * desc,
+                          bool attributes,
+                          std::vector<std::string> & values,
+                          std::string & error) const;
+
+    std::vector<std::string> headers;
+    boost::escaped_list_separator<char> grammar;
+    std::string quote;
+    bool strict;
+    bool has_wkt_field;
+    bool has_json_field;
+    bool has_lat_field;
+    bool has_lon_field;
+    unsigned wkt_idx;
+    unsigned json_idx;
+    unsigned lat_idx;
+    unsigned lon_idx;
+};
+
 class csv_datasource : public mapnik::datasource
 {
 public:
+    using box_type = mapnik::box2d<double>;
+    // a row of the file: its position in features_ when features are cached,
+    // otherwise the byte range of the line and the id of its feature
+    struct row_type
+    {
+        std::size_t offset;
+        std::size_t size;
+        mapnik::value_integer id;
+    };
+    using item_type = std::pair<box_type, row_type>;
+    using spatial_index_type = boost::geometry::index::rtree<item_type,csv_linear<16,4> >;
+
     csv_datasource(mapnik::parameters const& params);
     virtual ~csv_datasource ();
     mapnik::datasource::datasource_t type() const;
@@ -66,7 +163,7 @@ private:
     std::string inline_string_;
     unsigned file_length_;
     mapnik::value_integer row_limit_;
-    std::deque<mapnik::feature_ptr> features_;
+    std::vector<mapnik::feature_ptr> features_;
     std::string escape_;
     std::string separator_;
     std::string quote_;
@@ -76,6 +173,10 @@ private:
     double filesize_max_;
     mapnik::context_ptr ctx_;
     bool extent_initialized_;
+    csv_row_parser parser_;
+    std::unique_ptr<spatial_index_type> tree_;
+    bool cache_features_;
+    unsigned jobs_;
 };
 
 #endif // MAPNIK_CSV_DATASOURCE_HPP
@@ -0,0 +1,49 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2014 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef CSV_FEATURESET_HPP
+#define CSV_FEATURESET_HPP
+
+#include <mapnik/feature.hpp>
+#include "csv_datasource.hpp"
+
+#include <vector>
+#include <deque>
+
+// iterates the cached features of the rows found in the index
+class csv_featureset : public mapnik::Featureset
+{
+public:
+    using array_type = std::deque<csv_datasource::item_type>;
+    csv_featureset(std::vector<mapnik::feature_ptr> const& features,
+                   array_type && index_array);
+    virtual ~csv_featureset();
+    mapnik::feature_ptr next();
+
+private:
+    std::vector<mapnik::feature_ptr> const& features_;
+    const array_type index_array_;
+    array_type::const_iterator index_itr_;
+    array_type::const_iterator index_end_;
+};
+
+#endif // CSV_FEATURESET_HPP
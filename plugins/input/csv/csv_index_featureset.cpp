@@ -0,0 +1,112 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2014 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+// mapnik
+#include <mapnik/debug.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/feature_factory.hpp>
+#include <mapnik/utils.hpp>
+#include <mapnik/datasource.hpp>
+#if defined(SHAPE_MEMORY_MAPPED_FILE)
+#include <boost/interprocess/mapped_region.hpp>
+#endif
+// stl
+#include <string>
+#include <vector>
+#include <deque>
+
+#include "csv_index_featureset.hpp"
+
+csv_index_featureset::csv_index_featureset(std::string const& filename,
+                                           csv_row_parser const& parser,
+                                           std::string const& encoding,
+                                           mapnik::context_ptr const& ctx,
+                                           array_type && index_array)
+    :
+#if defined(SHAPE_MEMORY_MAPPED_FILE)
+      mapped_region_(),
+#elif defined(_WINDOWS)
+      file_(_wfopen(mapnik::utf8_to_utf16(filename).c_str(), L"rb"), std::fclose),
+#else
+      file_(std::fopen(filename.c_str(),"rb"), std::fclose),
+#endif
+      parser_(parser),
+      tr_(encoding),
+      ctx_(ctx),
+      index_array_(std::move(index_array)),
+      index_itr_(index_array_.begin()),
+      index_end_(index_array_.end())
+{
+#if defined(SHAPE_MEMORY_MAPPED_FILE)
+    boost::optional<mapnik::mapped_region_ptr> memory =
+        mapnik::mapped_memory_cache::instance().find(filename, true);
+    if (!memory) throw mapnik::datasource_exception("CSV Plugin: could not get file mapping for '" + filename + "'");
+    mapped_region_ = *memory;
+#else
+    if (!file_) throw mapnik::datasource_exception("CSV Plugin: could not open: '" + filename + "'");
+#endif
+}
+
+csv_index_featureset::~csv_index_featureset() {}
+
+bool csv_index_featureset::read_line(csv_datasource::row_type const& row)
+{
+#if defined(SHAPE_MEMORY_MAPPED_FILE)
+    char const* data = static_cast<char const*>(mapped_region_->get_address());
+    std::size_t size = mapped_region_->get_size();
+    if (row.offset + row.size > size) return false;
+    line_.assign(data + row.offset, row.size);
+#else
+    line_.resize(row.size);
+    if (std::fseek(file_.get(), row.offset, SEEK_SET) != 0) return false;
+    if (row.size > 0 && std::fread(&line_[0], row.size, 1, file_.get()) != 1) return false;
+#endif
+    return true;
+}
+
+mapnik::feature_ptr csv_index_featureset::next()
+{
+    while (index_itr_ != index_end_)
+    {
+        csv_datasource::row_type const& row = (*index_itr_++).second;
+        if (!read_line(row))
+        {
+            MAPNIK_LOG_ERROR(csv) << "csv_index_featureset: could not read row of feature " << row.id;
+            continue;
+        }
+        try
+        {
+            parser_.tokenize(line_, row.id, values_);
+            mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx_, row.id));
+            if (parser_.parse(values_, line_, row.id, tr_, *feature, nullptr) == csv_row_parser::row_ok)
+            {
+                return feature;
+            }
+        }
+        catch (std::exception const& ex)
+        {
+            // the rows were checked when the index was built, so the file has changed since
+            MAPNIK_LOG_ERROR(csv) << "csv_index_featureset: could not parse feature " << row.id << ": " << ex.what();
+        }
+    }
+    return mapnik::feature_ptr();
+}
@@ -0,0 +1,72 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2014 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef CSV_INDEX_FEATURESET_HPP
+#define CSV_INDEX_FEATURESET_HPP
+
+#include <mapnik/feature.hpp>
+#include <mapnik/unicode.hpp>
+#include "csv_datasource.hpp"
+
+#if defined(SHAPE_MEMORY_MAPPED_FILE)
+#include <mapnik/mapped_memory_cache.hpp>
+#endif
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <cstdio>
+
+// re-parses the rows found in the index from the file (`cache_features=false`)
+class csv_index_featureset : public mapnik::Featureset
+{
+public:
+    using array_type = std::deque<csv_datasource::item_type>;
+    using file_ptr = std::unique_ptr<std::FILE, int (*)(std::FILE *)>;
+
+    csv_index_featureset(std::string const& filename,
+                         csv_row_parser const& parser,
+                         std::string const& encoding,
+                         mapnik::context_ptr const& ctx,
+                         array_type && index_array);
+    virtual ~csv_index_featureset();
+    mapnik::feature_ptr next();
+
+private:
+    bool read_line(csv_datasource::row_type const& row);
+
+#if defined(SHAPE_MEMORY_MAPPED_FILE)
+    mapnik::mapped_region_ptr mapped_region_;
+#else
+    file_ptr file_;
+#endif
+    csv_row_parser const& parser_;
+    mapnik::transcoder tr_;
+    mapnik::context_ptr ctx_;
+    const array_type index_array_;
+    array_type::const_iterator index_itr_;
+    array_type::const_iterator index_end_;
+    std::string line_;
+    std::vector<std::string> values_;
+};
+
+#endif // CSV_INDEX_FEATURESET_HPP
@@ -0,0 +1,123 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2014 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef GDAL_DATASET_POOL_HPP
+#define GDAL_DATASET_POOL_HPP
+
+// mapnik
+#include <mapnik/debug.hpp>
+#include <mapnik/pool.hpp>
+#include <mapnik/datasource.hpp>
+#include <mapnik/util/noncopyable.hpp>
+
+// stl
+#include <string>
+#include <memory>
+#include <sstream>
+
+// gdal
+#include <gdal_priv.h>
+#include <gdal_version.h>
+
+// An open dataset. GDAL datasets must not be used by more than one thread at
+// a time, so each concurrent reader borrows its own from a gdal_dataset_pool.
+// Shared datasets are the same for all the opens of a file, their pool holds
+// only one.
+class gdal_dataset_handle : private mapnik::util::noncopyable
+{
+public:
+    gdal_dataset_handle(std::string const& name, bool shared)
+        : dataset_(nullptr)
+    {
+#if GDAL_VERSION_NUM >= 1600
+        if (shared)
+        {
+            dataset_ = reinterpret_cast<GDALDataset*>(GDALOpenShared(name.c_str(), GA_ReadOnly));
+        }
+        else
+#endif
+        {
+            dataset_ = reinterpret_cast<GDALDataset*>(GDALOpen(name.c_str(), GA_ReadOnly));
+        }
+        MAPNIK_LOG_DEBUG(gdal) << "gdal_dataset_handle: opened Dataset=" << dataset_;
+    }
+
+    ~gdal_dataset_handle()
+    {
+        if (dataset_)
+        {
+            MAPNIK_LOG_DEBUG(gdal) << "gdal_dataset_handle: Closing Dataset=" << dataset_;
+            GDALClose(dataset_);
+        }
+    }
+
+    bool isOK() const
+    {
+        return dataset_ != nullptr;
+    }
+
+    GDALDataset & dataset() const
+    {
+        return *dataset_;
+    }
+
+private:
+    GDALDataset * dataset_;
+};
+
+template <typename T>
+class gdal_dataset_creator
+{
+public:
+    gdal_dataset_creator(std::string const& name, bool shared)
+        : name_(name),
+          shared_(shared) {}
+
+    T* operator()() const
+    {
+        return new T(name_, shared_);
+    }
+
+private:
+    std::string name_;
+    bool shared_;
+};
+
+using gdal_dataset_pool = mapnik::Pool<gdal_dataset_handle, gdal_dataset_creator>;
+using gdal_dataset_pool_ptr = std::shared_ptr<gdal_dataset_pool>;
+using gdal_dataset_ptr = std::shared_ptr<gdal_dataset_handle>;
+
+// Borrows a dataset for one read, waiting up to the pool's wait timeout
+// for another reader to return one.
+inline gdal_dataset_ptr borrow_gdal_dataset(gdal_dataset_pool & pool)
+{
+    gdal_dataset_ptr handle = pool.borrowObject();
+    if (! handle)
+    {
+        std::ostringstream s;
+        s << "GDAL Plugin: no dataset available (" << pool.stats() << ")";
+        throw mapnik::datasource_exception(s.str());
+    }
+    return handle;
+}
+
+#endif // GDAL_DATASET_POOL_HPP
@@ -32,6 +32,12 @@
 
 #include <gdal_version.h>
 
+// stl
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <sstream>
+
 using mapnik::datasource;
 using mapnik::parameters;
 
@@ -47,7 +53,7 @@ using mapnik::datasource_exception;
 
 gdal_datasource::gdal_datasource(parameters const& params)
     : datasource(params),
-      dataset_(nullptr),
+      pool_(),
       desc_(gdal_datasource::name(), "utf-8"),
       nodata_value_(params.get<double>("nodata")),
       nodata_tolerance_(*params.get<double>("nodata_tolerance",1e-12))
@@ -76,27 +82,34 @@ gdal_datasource::gdal_datasource(parameters const& params)
     shared_dataset_ = *params.get<mapnik::boolean_type>("shared", false);
     band_ = *params.get<mapnik::value_integer>("band", -1);
 
-#if GDAL_VERSION_NUM >= 1600
-    if (shared_dataset_)
+    // datasets are opened on demand, up to one for each concurrent read
+    mapnik::value_integer max_size = *params.get<mapnik::value_integer>("max_size",
+        std::max(1u, std::thread::hardware_concurrency()));
+    mapnik::value_integer wait_timeout = *params.get<mapnik::value_integer>("pool_wait_timeout", 5000);
+    if (max_size < 1)
     {
-        dataset_ = reinterpret_cast<GDALDataset*>(GDALOpenShared((dataset_name_).c_str(), GA_ReadOnly));
+        throw datasource_exception("GDAL Plugin: max_size must be at least 1");
     }
-    else
-#endif
+    if (shared_dataset_)
     {
-        dataset_ = reinterpret_cast<GDALDataset*>(GDALOpen((dataset_name_).c_str(), GA_ReadOnly));
+        // GDALOpenShared gives the same GDALDataset to every open of the file
+        // from a thread, several pooled handles could be read at once
+        max_size = 1;
     }
+    pool_ = std::make_shared<gdal_dataset_pool>(gdal_dataset_creator<gdal_dataset_handle>(dataset_name_, shared_dataset_),
+                                                1, static_cast<unsigned>(max_size));
+    pool_->set_wait_timeout(std::chrono::milliseconds(wait_timeout));
 
-    if (! dataset_)
+    gdal_dataset_ptr handle = pool_->borrowObject();
+    if (! handle)
     {
         throw datasource_exception(CPLGetLastErrorMsg());
     }
+    GDALDataset & dataset = handle->dataset();
 
-    MAPNIK_LOG_DEBUG(gdal) << "gdal_featureset: opened Dataset=" << dataset_;
-
-    nbands_ = dataset_->GetRasterCount();
-    width_ = dataset_->GetRasterXSize();
-    height_ = dataset_->GetRasterYSize();
+    nbands_ = dataset.GetRasterCount();
+    width_ = dataset.GetRasterXSize();
+    height_ = dataset.GetRasterYSize();
     desc_.add_descriptor(mapnik::attribute_descriptor("nodata", mapnik::Double));
 
     double tr[6];
@@ -128,7 +141,7 @@ gdal_datasource::gdal_datasource(parameters const& params)
     }
     else
     {
-        if (dataset_->GetGeoTransform(tr) != CPLE_None)
+        if (dataset.GetGeoTransform(tr) != CPLE_None)
         {
             MAPNIK_LOG_DEBUG(gdal) << "gdal_datasource GetGeotransform failure gives="
                                    << tr[0] << "," << tr[1] << ","
@@ -182,8 +195,12 @@ gdal_datasource::gdal_datasource(parameters const& params)
 
 gdal_datasource::~gdal_datasource()
 {
-    MAPNIK_LOG_DEBUG(gdal) << "gdal_featureset: Closing Dataset=" << dataset_;
-    GDALClose(dataset_);
+    MAPNIK_LOG_DEBUG(gdal) << "gdal_datasource: dataset pool " << pool_->stats();
+}
+
+mapnik::pool_stats gdal_datasource::dataset_pool_stats() const
+{
+    return pool_->stats();
 }
 
 datasource::datasource_t gdal_datasource::type() const
@@ -220,7 +237,7 @@ featureset_ptr gdal_datasource::features(query const& q) const
     gdal_query gq = q;
 
     // TODO - move to std::make_shared, but must reduce # of args to <= 9
-    return featureset_ptr(new gdal_featureset(*dataset_,
+    return featureset_ptr(new gdal_featureset(pool_,
                                               band_,
                                               gq,
                                               extent_,
@@ -242,7 +259,7 @@ featureset_ptr gdal_datasource::features_at_point(coord2d const& pt, double tol)
     gdal_query gq = pt;
 
     // TODO - move to std::make_shared, but must reduce # of args to <= 9
-    return featureset_ptr(new gdal_featureset(*dataset_,
+    return featureset_ptr(new gdal_featureset(pool_,
                                               band_,
                                               gq,
                                               extent_,
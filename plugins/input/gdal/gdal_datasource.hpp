@@ -38,10 +38,13 @@
 // stl
 #include <vector>
 #include <string>
+#include <memory>
 
 // gdal
 #include <gdal_priv.h>
 
+#include "gdal_dataset_pool.hpp"
+
 class gdal_datasource : public mapnik::datasource
 {
 public:
@@ -54,9 +57,9 @@ public:
     mapnik::box2d<double> envelope() const;
     boost::optional<mapnik::datasource_geometry_t> get_geometry_type() const;
     mapnik::layer_descriptor get_descriptor() const;
+    mapnik::pool_stats dataset_pool_stats() const;
 private:
-    GDALDataset* open_dataset() const;
-    GDALDataset* dataset_;
+    gdal_dataset_pool_ptr pool_;
     mapnik::box2d<double> extent_;
     std::string dataset_name_;
     int band_;
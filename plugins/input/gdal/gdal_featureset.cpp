@@ -35,6 +35,7 @@
 #include <cmath>
 #include <memory>
 #include <sstream>
+#include <algorithm>
 
 #include "gdal_featureset.hpp"
 #include <gdal_priv.h>
@@ -47,7 +48,7 @@ using mapnik::view_transform;
 using mapnik::datasource_exception;
 using mapnik::feature_factory;
 
-gdal_featureset::gdal_featureset(GDALDataset& dataset,
+gdal_featureset::gdal_featureset(gdal_dataset_pool_ptr const& pool,
                                  int band,
                                  gdal_query q,
                                  mapnik::box2d<double> extent,
@@ -58,7 +59,8 @@ gdal_featureset::gdal_featureset(GDALDataset& dataset,
                                  double dy,
                                  boost::optional<double> const& nodata,
                                  double nodata_tolerance)
-    : dataset_(dataset),
+    : pool_(pool),
+      dataset_(nullptr),
       ctx_(std::make_shared<mapnik::context_type>()),
       band_(band),
       gquery_(q),
@@ -77,7 +79,7 @@ gdal_featureset::gdal_featureset(GDALDataset& dataset,
 
 gdal_featureset::~gdal_featureset()
 {
-    MAPNIK_LOG_DEBUG(gdal) << "gdal_featureset: Closing Dataset=" << &dataset_;
+    MAPNIK_LOG_DEBUG(gdal) << "gdal_featureset: Releasing";
 
 }
 
@@ -86,8 +88,13 @@ feature_ptr gdal_featureset::next()
     if (first_)
     {
         first_ = false;
-        MAPNIK_LOG_DEBUG(gdal) << "gdal_featureset: Next feature in Dataset=" << &dataset_;
-        return mapnik::util::apply_visitor(query_dispatch(*this), gquery_);
+        // returned to the pool as soon as the feature is read
+        gdal_dataset_ptr handle = borrow_gdal_dataset(*pool_);
+        dataset_ = &handle->dataset();
+        MAPNIK_LOG_DEBUG(gdal) << "gdal_featureset: Next feature in Dataset=" << dataset_;
+        feature_ptr feature = mapnik::util::apply_visitor(query_dispatch(*this), gquery_);
+        dataset_ = nullptr;
+        return feature;
     }
     return feature_ptr();
 }
@@ -107,7 +114,7 @@ feature_ptr gdal_featureset::get_feature(mapnik::query const& q)
     /*
 #ifdef MAPNIK_LOG
       double tr[6];
-      dataset_.GetGeoTransform(tr);
+      dataset_->GetGeoTransform(tr);
 
       const double dx = tr[1];
       const double dy = tr[5];
@@ -197,11 +204,15 @@ feature_ptr gdal_featureset::get_feature(mapnik::query const& q)
 
         if (im_width > 0 && im_height > 0)
         {
+            fit_to_overview(x_off, y_off, width, height, im_width, im_height);
+            feature_raster_extent.init(x_off, y_off, x_off + width, y_off + height);
+            intersect = t.backward(feature_raster_extent);
+
             MAPNIK_LOG_DEBUG(gdal) << "gdal_featureset: Image Size=(" << im_width << "," << im_height << ")";
             MAPNIK_LOG_DEBUG(gdal) << "gdal_featureset: Reading band=" << band_;
             if (band_ > 0) // we are querying a single band
             {
-                GDALRasterBand * band = dataset_.GetRasterBand(band_);
+                GDALRasterBand * band = dataset_->GetRasterBand(band_);
                 if (band_ > nbands_)
                 {
                     std::ostringstream s;
@@ -297,7 +308,7 @@ feature_ptr gdal_featureset::get_feature(mapnik::query const& q)
                 image.set(std::numeric_limits<std::uint32_t>::max());
                 for (int i = 0; i < nbands_; ++i)
                 {
-                    GDALRasterBand * band = dataset_.GetRasterBand(i + 1);
+                    GDALRasterBand * band = dataset_->GetRasterBand(i + 1);
 #ifdef MAPNIK_LOG
                     get_overview_meta(band);
 #endif
@@ -404,41 +415,22 @@ feature_ptr gdal_featureset::get_feature(mapnik::query const& q)
                         }
                     }
 
-                    /* Use dataset RasterIO in priority in 99.9% of the cases */
-                    if( red->GetBand() == 1 && green->GetBand() == 2 && blue->GetBand() == 3 )
+                    /* Use a single dataset RasterIO for all bands, in whatever order they are */
+                    int band_map[4] = { red->GetBand(), green->GetBand(), blue->GetBand(), 0 };
+                    int nBandsToRead = 3;
+                    if( alpha != NULL && !raster_has_nodata )
                     {
-                        int nBandsToRead = 3;
-                        if( alpha != NULL && alpha->GetBand() == 4 && !raster_has_nodata )
-                        {
-                            nBandsToRead = 4;
-                            alpha = NULL; // to avoid reading it again afterwards
-                        }
-                        raster_io_error = dataset_.RasterIO(GF_Read, x_off, y_off, width, height,
-                                                            image.getBytes(),
-                                                            image.width(), image.height(), GDT_Byte,
-                                                            nBandsToRead, NULL,
-                                                            4, 4 * image.width(), 1);
-                        if (raster_io_error == CE_Failure) {
-                            throw datasource_exception(CPLGetLastErrorMsg());
-                        }
+                        band_map[3] = alpha->GetBand();
+                        nBandsToRead = 4;
+                        alpha = NULL; // to avoid reading it again afterwards
                     }
-                    else
-                    {
-                        raster_io_error = red->RasterIO(GF_Read, x_off, y_off, width, height, image.getBytes() + 0,
-                                                        image.width(), image.height(), GDT_Byte, 4, 4 * image.width());
-                        if (raster_io_error == CE_Failure) {
-                            throw datasource_exception(CPLGetLastErrorMsg());
-                        }
-                        raster_io_error = green->RasterIO(GF_Read, x_off, y_off, width, height, image.getBytes() + 1,
-                                                        image.width(), image.height(), GDT_Byte, 4, 4 * image.width());
-                        if (raster_io_error == CE_Failure) {
-                            throw datasource_exception(CPLGetLastErrorMsg());
-                        }
-                        raster_io_error = blue->RasterIO(GF_Read, x_off, y_off, width, height, image.getBytes() + 2,
-                                                        image.width(), image.height(), GDT_Byte, 4, 4 * image.width());
-                        if (raster_io_error == CE_Failure) {
-                            throw datasource_exception(CPLGetLastErrorMsg());
-                        }
+                    raster_io_error = dataset_->RasterIO(GF_Read, x_off, y_off, width, height,
+                                                        image.getBytes(),
+                                                        image.width(), image.height(), GDT_Byte,
+                                                        nBandsToRead, band_map,
+                                                        4, 4 * image.width(), 1);
+                    if (raster_io_error == CE_Failure) {
+                        throw datasource_exception(CPLGetLastErrorMsg());
                     }
 
                     // In the case we skipped initializing the alpha channel
@@ -494,23 +486,21 @@ feature_ptr gdal_featureset::get_feature(mapnik::query const& q)
                         }
                     }
 
-                    raster_io_error = grey->RasterIO(GF_Read, x_off, y_off, width, height, image.getBytes() + 0,
-                                                     image.width(), image.height(), GDT_Byte, 4, 4 * image.width());
-                    if (raster_io_error == CE_Failure)
+                    // the gray band goes to r, g and b (and the alpha band, unless the
+                    // color table sets it, to a) in one read
+                    int band_map[4] = { grey->GetBand(), grey->GetBand(), grey->GetBand(), 0 };
+                    int bands_to_read = 3;
+                    if (alpha && !raster_has_nodata && !color_table)
                     {
-                        throw datasource_exception(CPLGetLastErrorMsg());
+                        band_map[3] = alpha->GetBand();
+                        bands_to_read = 4;
+                        alpha = nullptr;
                     }
-
-                    raster_io_error = grey->RasterIO(GF_Read,x_off, y_off, width, height, image.getBytes() + 1,
-                                                     image.width(), image.height(), GDT_Byte, 4, 4 * image.width());
-                    if (raster_io_error == CE_Failure)
-                    {
-                        throw datasource_exception(CPLGetLastErrorMsg());
-                    }
-
-                    raster_io_error = grey->RasterIO(GF_Read,x_off, y_off, width, height, image.getBytes() + 2,
-                                                     image.width(), image.height(), GDT_Byte, 4, 4 * image.width());
-
+                    raster_io_error = dataset_->RasterIO(GF_Read, x_off, y_off, width, height,
+                                                        image.getBytes(),
+                                                        image.width(), image.height(), GDT_Byte,
+                                                        bands_to_read, band_map,
+                                                        4, 4 * image.width(), 1);
                     if (raster_io_error == CE_Failure)
                     {
                         throw datasource_exception(CPLGetLastErrorMsg());
@@ -573,6 +563,70 @@ feature_ptr gdal_featureset::get_feature(mapnik::query const& q)
     return feature_ptr();
 }
 
+// Picks the coarsest overview which still has at least the requested resolution and,
+// when it is less than twice as fine, moves the source window onto whole pixels (and
+// whole blocks, if they aren't larger than the window) of that level and sets the image
+// size to match, so that GDAL copies decoded blocks instead of resampling them.
+// Otherwise, or without such an overview, the window is left alone and GDAL resamples
+// to the requested size: reading the full resolution pixels would take up to four times
+// the memory for the symbolizer to scale down.
+void gdal_featureset::fit_to_overview(int & x_off, int & y_off, int & width, int & height,
+                                      int & im_width, int & im_height) const
+{
+    GDALRasterBand * band = dataset_->GetRasterBand(band_ > 0 ? band_ : 1);
+    if (band == nullptr) return;
+    double scale = std::min(static_cast<double>(width) / im_width,
+                            static_cast<double>(height) / im_height);
+    GDALRasterBand * level = band;
+    double fx = 1.0;
+    double fy = 1.0;
+    int overviews = band->GetOverviewCount();
+    for (int i = 0; i < overviews; ++i)
+    {
+        GDALRasterBand * overview = band->GetOverview(i);
+        if (overview == nullptr || overview->GetXSize() <= 0 || overview->GetYSize() <= 0) continue;
+        double ox = static_cast<double>(raster_width_) / overview->GetXSize();
+        double oy = static_cast<double>(raster_height_) / overview->GetYSize();
+        if (ox <= scale && oy <= scale && ox > fx)
+        {
+            level = overview;
+            fx = ox;
+            fy = oy;
+        }
+    }
+    if (level == band || scale >= 2.0 * std::max(fx, fy)) return;
+
+    int level_width = level->GetXSize();
+    int level_height = level->GetYSize();
+    int x0 = static_cast<int>(std::floor(x_off / fx));
+    int y0 = static_cast<int>(std::floor(y_off / fy));
+    int x1 = std::min(level_width, static_cast<int>(std::ceil((x_off + width) / fx)));
+    int y1 = std::min(level_height, static_cast<int>(std::ceil((y_off + height) / fy)));
+    int block_x = 0;
+    int block_y = 0;
+    level->GetBlockSize(&block_x, &block_y);
+    if (block_x > 0 && block_x <= x1 - x0)
+    {
+        x0 -= x0 % block_x;
+        x1 = std::min(level_width, ((x1 + block_x - 1) / block_x) * block_x);
+    }
+    if (block_y > 0 && block_y <= y1 - y0)
+    {
+        y0 -= y0 % block_y;
+        y1 = std::min(level_height, ((y1 + block_y - 1) / block_y) * block_y);
+    }
+    if (x1 <= x0 || y1 <= y0) return;
+
+    MAPNIK_LOG_DEBUG(gdal) << "gdal_featureset: Reading overview level=" << fx << "x" << fy
+                           << " window=" << x0 << "," << y0 << "," << x1 << "," << y1
+                           << " block=" << block_x << "x" << block_y;
+    x_off = static_cast<int>(x0 * fx + 0.5);
+    y_off = static_cast<int>(y0 * fy + 0.5);
+    width = std::min(static_cast<int>(raster_width_), static_cast<int>(x1 * fx + 0.5)) - x_off;
+    height = std::min(static_cast<int>(raster_height_), static_cast<int>(y1 * fy + 0.5)) - y_off;
+    im_width = x1 - x0;
+    im_height = y1 - y0;
+}
 
 feature_ptr gdal_featureset::get_feature_at_point(mapnik::coord2d const& pt)
 {
@@ -580,11 +634,11 @@ feature_ptr gdal_featureset::get_feature_at_point(mapnik::coord2d const& pt)
 
     if (band_ > 0)
     {
-        unsigned raster_xsize = dataset_.GetRasterXSize();
-        unsigned raster_ysize = dataset_.GetRasterYSize();
+        unsigned raster_xsize = dataset_->GetRasterXSize();
+        unsigned raster_ysize = dataset_->GetRasterYSize();
 
         double gt[6];
-        dataset_.GetGeoTransform(gt);
+        dataset_->GetGeoTransform(gt);
 
         double det = gt[1] * gt[5] - gt[2] * gt[4];
         // subtract half a pixel width & height because gdal coord reference
@@ -601,7 +655,7 @@ feature_ptr gdal_featureset::get_feature_at_point(mapnik::coord2d const& pt)
             MAPNIK_LOG_DEBUG(gdal) << "gdal_featureset: pt.x=" << pt.x << " pt.y=" << pt.y;
             MAPNIK_LOG_DEBUG(gdal) << "gdal_featureset: x=" << x << " y=" << y;
 
-            GDALRasterBand* band = dataset_.GetRasterBand(band_);
+            GDALRasterBand* band = dataset_->GetRasterBand(band_);
             int raster_has_nodata;
             double nodata = band->GetNoDataValue(&raster_has_nodata);
             double value;
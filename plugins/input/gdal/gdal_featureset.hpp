@@ -30,6 +30,7 @@
 #include <boost/optional.hpp>
 
 #include "gdal_datasource.hpp"
+#include "gdal_dataset_pool.hpp"
 
 class GDALDataset;
 class GDALRasterBand;
@@ -57,7 +58,7 @@ class gdal_featureset : public mapnik::Featureset
     };
 
 public:
-    gdal_featureset(GDALDataset& dataset,
+    gdal_featureset(gdal_dataset_pool_ptr const& pool,
                     int band,
                     gdal_query q,
                     mapnik::box2d<double> extent,
@@ -74,12 +75,17 @@ public:
 private:
     mapnik::feature_ptr get_feature(mapnik::query const& q);
     mapnik::feature_ptr get_feature_at_point(mapnik::coord2d const& p);
+    void fit_to_overview(int & x_off, int & y_off, int & width, int & height,
+                         int & im_width, int & im_height) const;
 
 #ifdef MAPNIK_LOG
     void get_overview_meta(GDALRasterBand * band);
 #endif
 
-    GDALDataset & dataset_;
+    // a dataset is borrowed from the pool for the duration of a read only,
+    // so that the featuresets of all the styles of a layer can be open at once
+    gdal_dataset_pool_ptr pool_;
+    GDALDataset * dataset_;
     mapnik::context_ptr ctx_;
     int band_;
     gdal_query gquery_;
@@ -43,6 +43,7 @@ else:
       %(PLUGIN_NAME)s_datasource.cpp
       %(PLUGIN_NAME)s_featureset.cpp
       large_%(PLUGIN_NAME)s_featureset.cpp
+      %(PLUGIN_NAME)s_index.cpp
       """ % locals()
     )
 
@@ -23,6 +23,7 @@
 #include "geojson_datasource.hpp"
 #include "geojson_featureset.hpp"
 #include "large_geojson_featureset.hpp"
+#include "geojson_index.hpp"
 #include <fstream>
 #include <algorithm>
 
@@ -46,6 +47,7 @@
 #include <mapnik/util/geometry_to_ds_type.hpp>
 #include <mapnik/make_unique.hpp>
 #include <mapnik/json/feature_collection_grammar.hpp>
+#include <mapnik/json/geojson_reader.hpp>
 #include <mapnik/json/extract_bounding_box_grammar_impl.hpp>
 
 #if defined(SHAPE_MEMORY_MAPPED_FILE)
@@ -105,7 +107,8 @@ geojson_datasource::geojson_datasource(parameters const& params)
     inline_string_(),
     extent_(),
     features_(),
-    tree_(nullptr)
+    tree_(nullptr),
+    index_(nullptr)
 {
     boost::optional<std::string> inline_string = params.get<std::string>("inline");
     if (inline_string)
@@ -123,6 +126,15 @@ geojson_datasource::geojson_datasource(parameters const& params)
         else
             filename_ = *file;
     }
+    boost::optional<std::string> parser = params.get<std::string>("parser");
+    if (parser)
+    {
+        if (*parser == "fast") fast_parser_ = true;
+        else if (*parser != "spirit")
+        {
+            throw mapnik::datasource_exception("GeoJSON Plugin: unknown parser '" + *parser + "', expected 'spirit' or 'fast'");
+        }
+    }
     if (!inline_string_.empty())
     {
         char const* start = inline_string_.c_str();
@@ -132,45 +144,57 @@ geojson_datasource::geojson_datasource(parameters const& params)
     else
     {
         cache_features_ = *params.get<mapnik::boolean_type>("cache_features", true);
-#if !defined(SHAPE_MEMORY_MAPPED_FILE)
-        mapnik::util::file file(filename_);
-        if (!file.open())
+        parse_ahead_ = std::max<mapnik::value_integer>(0, *params.get<mapnik::value_integer>("parse_ahead", 0));
+        if (!cache_features_)
         {
-            throw mapnik::datasource_exception("GeoJSON Plugin: could not open: '" + filename_ + "'");
+            index_ = geojson_index::open(filename_);
         }
-
-        std::string file_buffer;
-        file_buffer.resize(file.size());
-        std::fread(&file_buffer[0], file.size(), 1, file.get());
-        char const* start = file_buffer.c_str();
-        char const* end = start + file_buffer.length();
-        if (cache_features_)
+        if (index_)
         {
-            parse_geojson(start, end);
+            initialise_from_index();
         }
         else
         {
-            initialise_index(start, end);
-        }
+#if !defined(SHAPE_MEMORY_MAPPED_FILE)
+            mapnik::util::file file(filename_);
+            if (!file.open())
+            {
+                throw mapnik::datasource_exception("GeoJSON Plugin: could not open: '" + filename_ + "'");
+            }
+
+            std::string file_buffer;
+            file_buffer.resize(file.size());
+            std::fread(&file_buffer[0], file.size(), 1, file.get());
+            char const* start = file_buffer.c_str();
+            char const* end = start + file_buffer.length();
+            if (cache_features_)
+            {
+                parse_geojson(start, end);
+            }
+            else
+            {
+                initialise_index(start, end);
+            }
 #else
-        boost::optional<mapnik::mapped_region_ptr> mapped_region =
-            mapnik::mapped_memory_cache::instance().find(filename_, false);
-        if (!mapped_region)
-        {
-            throw std::runtime_error("could not get file mapping for "+ filename_);
-        }
+            boost::optional<mapnik::mapped_region_ptr> mapped_region =
+                mapnik::mapped_memory_cache::instance().find(filename_, false);
+            if (!mapped_region)
+            {
+                throw std::runtime_error("could not get file mapping for "+ filename_);
+            }
 
-        char const* start = reinterpret_cast<char const*>((*mapped_region)->get_address());
-        char const* end = start + (*mapped_region)->get_size();
-        if (cache_features_)
-        {
-            parse_geojson(start, end);
-        }
-        else
-        {
-            initialise_index(start, end);
-        }
+            char const* start = reinterpret_cast<char const*>((*mapped_region)->get_address());
+            char const* end = start + (*mapped_region)->get_size();
+            if (cache_features_)
+            {
+                parse_geojson(start, end);
+            }
+            else
+            {
+                initialise_index(start, end);
+            }
 #endif
+        }
     }
 }
 
@@ -182,6 +206,24 @@ const mapnik::json::feature_grammar<base_iterator_type, mapnik::feature_impl> ge
 const mapnik::json::extract_bounding_box_grammar<base_iterator_type> geojson_datasource_static_bbox_grammar;
 }
 
+void geojson_datasource::parse_feature(char const* start, char const* end, mapnik::feature_impl & feature) const
+{
+    bool result;
+    if (fast_parser_)
+    {
+        result = mapnik::json::read_feature(start, end, feature, geojson_datasource_static_tr);
+    }
+    else
+    {
+        boost::spirit::ascii::space_type space;
+        result = boost::spirit::qi::phrase_parse(start, end, (geojson_datasource_static_feature_grammar)(boost::phoenix::ref(feature)), space);
+    }
+    if (!result)
+    {
+        throw std::runtime_error("Failed to parse geojson feature");
+    }
+}
+
 template <typename Iterator>
 void geojson_datasource::initialise_index(Iterator start, Iterator end)
 {
@@ -208,11 +250,7 @@ void geojson_datasource::initialise_index(Iterator start, Iterator end)
             Iterator end = itr + geometry_index.second;
             mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
             mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx,1));
-            boost::spirit::ascii::space_type space;
-            if (!boost::spirit::qi::phrase_parse(itr, end, (geojson_datasource_static_feature_grammar)(boost::phoenix::ref(*feature)), space))
-            {
-                throw std::runtime_error("Failed to parse geojson feature");
-            }
+            parse_feature(itr, end, *feature);
             for ( auto const& kv : *feature)
             {
                 desc_.add_descriptor(mapnik::attribute_descriptor(std::get<0>(kv),
@@ -227,18 +265,56 @@ void geojson_datasource::initialise_index(Iterator start, Iterator end)
     }
 }
 
+void geojson_datasource::initialise_from_index()
+{
+    extent_ = index_->extent();
+    if (index_->size() == 0) return;
+    // parse first feature to extract attributes schema.
+    // NOTE: this doesn't yield correct answer for geoJSON in general, just an indication
+    mapnik::util::file file(filename_);
+    if (!file.open())
+    {
+        throw mapnik::datasource_exception("GeoJSON Plugin: could not open: '" + filename_ + "'");
+    }
+    std::pair<std::size_t, std::size_t> first = index_->first_feature();
+    std::vector<char> json(first.second);
+    std::fseek(file.get(), first.first, SEEK_SET);
+    if (std::fread(json.data(), json.size(), 1, file.get()) != 1)
+    {
+        throw mapnik::datasource_exception("GeoJSON Plugin: could not read: '" + filename_ + "'");
+    }
+    char const* start = json.data();
+    char const* end = start + json.size();
+    mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+    mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx,1));
+    parse_feature(start, end, *feature);
+    for ( auto const& kv : *feature)
+    {
+        desc_.add_descriptor(mapnik::attribute_descriptor(std::get<0>(kv),
+                                                          mapnik::util::apply_visitor(attr_value_converter(),
+                                                                                      std::get<1>(kv))));
+    }
+}
+
 template <typename Iterator>
 void geojson_datasource::parse_geojson(Iterator start, Iterator end)
 {
-    boost::spirit::ascii::space_type space;
     mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
     std::size_t start_id = 1;
 
-    mapnik::json::default_feature_callback callback(features_);
-
-    bool result = boost::spirit::qi::phrase_parse(start, end, (geojson_datasource_static_fc_grammar)
-                                                  (boost::phoenix::ref(ctx),boost::phoenix::ref(start_id), boost::phoenix::ref(callback)),
-                                                  space);
+    bool result;
+    if (fast_parser_)
+    {
+        result = mapnik::json::read_features(start, end, ctx, start_id, geojson_datasource_static_tr, features_);
+    }
+    else
+    {
+        boost::spirit::ascii::space_type space;
+        mapnik::json::default_feature_callback callback(features_);
+        result = boost::spirit::qi::phrase_parse(start, end, (geojson_datasource_static_fc_grammar)
+                                                 (boost::phoenix::ref(ctx),boost::phoenix::ref(start_id), boost::phoenix::ref(callback)),
+                                                 space);
+    }
     if (!result)
     {
         if (!inline_string_.empty()) throw mapnik::datasource_exception("geojson_datasource: Failed parse GeoJSON file from in-memory string");
@@ -325,36 +401,29 @@ boost::optional<mapnik::datasource_geometry_t> geojson_datasource::get_geometry_
     }
     else
     {
-        mapnik::util::file file(filename_);
-        if (!file.open())
+        large_geojson_featureset::array_type items;
+        if (index_)
         {
-            throw mapnik::datasource_exception("GeoJSON Plugin: could not open: '" + filename_ + "'");
+            index_->query(extent_, std::back_inserter(items), 5);
         }
-        auto itr = tree_->qbegin(boost::geometry::index::intersects(extent_));
-        auto end = tree_->qend();
-        mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
-        for (std::size_t count = 0; itr !=end &&  count < 5; ++itr,++count)
+        else if (tree_)
         {
-            geojson_datasource::item_type const& item = *itr;
-            std::size_t file_offset = item.second.first;
-            std::size_t size = item.second.second;
-
-            std::fseek(file.get(), file_offset, SEEK_SET);
-            std::vector<char> json;
-            json.resize(size);
-            std::fread(json.data(), size, 1, file.get());
-
-            using chr_iterator_type = char const*;
-            chr_iterator_type start = json.data();
-            chr_iterator_type end = start + json.size();
-
-            using namespace boost::spirit;
-            ascii::space_type space;
-            mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx,1));
-            if (!qi::phrase_parse(start, end, (geojson_datasource_static_feature_grammar)(boost::phoenix::ref(*feature)), space))
+            auto itr = tree_->qbegin(boost::geometry::index::intersects(extent_));
+            auto end = tree_->qend();
+            for (std::size_t count = 0; itr !=end &&  count < 5; ++itr,++count)
             {
-                throw std::runtime_error("Failed to parse geojson feature");
+                items.push_back(*itr);
             }
+        }
+        std::sort(items.begin(), items.end(),
+                  [] (item_type const& item0, item_type const& item1)
+                  {
+                      return item0.second.first < item1.second.first;
+                  });
+        large_geojson_featureset fs(filename_, std::move(items), 0, fast_parser_);
+        mapnik::feature_ptr feature;
+        while ((feature = fs.next()))
+        {
             result = mapnik::util::to_ds_type(feature->get_geometry());
             if (result)
             {
@@ -393,9 +462,19 @@ mapnik::featureset_ptr geojson_datasource::features(mapnik::query const& q) cons
                           {
                               return item0.second.first < item1.second.first;
                           });
-                return std::make_shared<large_geojson_featureset>(filename_, std::move(index_array));
+                return std::make_shared<large_geojson_featureset>(filename_, std::move(index_array), parse_ahead_, fast_parser_);
             }
         }
+        else if (index_)
+        {
+            index_->query(box, std::back_inserter(index_array));
+            std::sort(index_array.begin(),index_array.end(),
+                      [] (item_type const& item0, item_type const& item1)
+                      {
+                          return item0.second.first < item1.second.first;
+                      });
+            return std::make_shared<large_geojson_featureset>(filename_, std::move(index_array), parse_ahead_, fast_parser_);
+        }
     }
     // otherwise return an empty featureset pointer
     return mapnik::featureset_ptr();
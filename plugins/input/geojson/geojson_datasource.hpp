@@ -78,6 +78,8 @@ struct options_type<geojson_linear<Max,Min> >
 
 }}}}}
 
+class geojson_index;
+
 class geojson_datasource : public mapnik::datasource
 {
 public:
@@ -99,7 +101,9 @@ public:
     void parse_geojson(Iterator start, Iterator end);
     template <typename Iterator>
     void initialise_index(Iterator start, Iterator end);
+    void initialise_from_index();
 private:
+    void parse_feature(char const* start, char const* end, mapnik::feature_impl & feature) const;
     mapnik::datasource::datasource_t type_;
     mapnik::layer_descriptor desc_;
     std::string filename_;
@@ -107,7 +111,13 @@ private:
     mapnik::box2d<double> extent_;
     std::vector<mapnik::feature_ptr> features_;
     std::unique_ptr<spatial_index_type> tree_;
+    // prebuilt sidecar index, used instead of tree_ when present and up to date
+    std::unique_ptr<geojson_index> index_;
     bool cache_features_ = true;
+    // features parsed ahead of the consumer when not cached
+    std::size_t parse_ahead_ = 0;
+    // parse with mapnik::json::read_* instead of the Spirit grammars
+    bool fast_parser_ = false;
 };
 
 
@@ -0,0 +1,78 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+// mapnik
+#include <mapnik/debug.hpp>
+#include <mapnik/util/fs.hpp>
+#include <mapnik/util/file_io.hpp>
+#if defined(SHAPE_MEMORY_MAPPED_FILE)
+#include <boost/interprocess/mapped_region.hpp>
+#endif
+
+#include "geojson_index.hpp"
+
+std::unique_ptr<geojson_index> geojson_index::open(std::string const& filename)
+{
+    std::unique_ptr<geojson_index> index;
+    std::string index_name = filename + ".index";
+    if (!mapnik::util::exists(index_name)) return index;
+
+    mapnik::util::file source(filename);
+    if (!source.open()) return index;
+
+    index.reset(new geojson_index());
+    geojson_index_header & header = index->header_;
+#if defined(SHAPE_MEMORY_MAPPED_FILE)
+    boost::optional<mapnik::mapped_region_ptr> memory =
+        mapnik::mapped_memory_cache::instance().find(index_name, true);
+    if (!memory) return nullptr;
+    char const* data = static_cast<char const*>((*memory)->get_address());
+    std::size_t index_size = (*memory)->get_size();
+    if (index_size < sizeof(header)) return nullptr;
+    std::memcpy(&header, data, sizeof(header));
+    geojson_index_little_endian(header);
+    if (!geojson_index_valid(header, index_size)) return nullptr;
+    index->region_ = *memory;
+    index->entries_ = reinterpret_cast<geojson_index_entry const*>(data + sizeof(header));
+#else
+    mapnik::util::file file(index_name);
+    if (!file.open() || file.size() < sizeof(header)) return nullptr;
+    if (std::fread(&header, sizeof(header), 1, file.get()) != 1) return nullptr;
+    geojson_index_little_endian(header);
+    if (!geojson_index_valid(header, file.size())) return nullptr;
+    index->buffer_.resize(header.tree.num_nodes);
+    if (header.tree.num_nodes > 0
+        && std::fread(index->buffer_.data(), sizeof(geojson_index_entry), header.tree.num_nodes, file.get()) != header.tree.num_nodes)
+    {
+        return nullptr;
+    }
+    index->entries_ = index->buffer_.data();
+#endif
+    if (header.source_size != source.size()
+        || header.source_mtime != static_cast<std::int64_t>(mapnik::util::last_write_time(filename)))
+    {
+        MAPNIK_LOG_WARN(geojson) << "geojson_index: ignoring '" << index_name
+                                 << "' which is out of date, rebuild it with geojsonindex";
+        return nullptr;
+    }
+    return index;
+}
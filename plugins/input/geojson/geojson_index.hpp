@@ -0,0 +1,142 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef GEOJSON_INDEX_HPP
+#define GEOJSON_INDEX_HPP
+
+// mapnik
+#include <mapnik/box2d.hpp>
+#include <mapnik/util/packed_rtree.hpp>
+#if defined(SHAPE_MEMORY_MAPPED_FILE)
+#include <mapnik/mapped_memory_cache.hpp>
+#endif
+
+// stl
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Spatial index sidecar (<file>.index) for large GeoJSON files, written by
+// `geojsonindex` and read by geojson_datasource when cache_features=false,
+// so the file does not have to be scanned at startup.
+//
+// It is a packed Hilbert R-tree in the layout of mapnik/util/packed_rtree.hpp,
+// whose leaves hold the byte range (offset, size) of a feature in the file.
+// The format specific fields record the size and modification time of the
+// GeoJSON file, so a stale index is ignored, and the byte range of the first
+// feature which is read to describe the attributes.
+
+struct geojson_index_header
+{
+    mapnik::util::packed_rtree_header tree;
+    std::uint64_t source_size;
+    std::int64_t source_mtime;
+    std::uint64_t first_offset;
+    std::uint64_t first_size;
+};
+
+using geojson_index_entry = mapnik::util::packed_rtree_entry<2>;
+
+static_assert(sizeof(geojson_index_header) == 96, "unexpected geojson_index_header layout");
+static_assert(sizeof(geojson_index_entry) == 48, "unexpected geojson_index_entry layout");
+
+static const char geojson_index_magic[8] = {'m','a','p','n','i','k','g','j'};
+static const std::uint16_t geojson_index_version = 2;
+
+// converts between the file and host byte order, in place (both ways)
+inline void geojson_index_little_endian(geojson_index_header & header)
+{
+    mapnik::util::packed_rtree_little_endian(header.tree);
+#ifdef MAPNIK_BIG_ENDIAN
+    mapnik::util::packed_rtree_swap_bytes(header.source_size);
+    mapnik::util::packed_rtree_swap_bytes(header.source_mtime);
+    mapnik::util::packed_rtree_swap_bytes(header.first_offset);
+    mapnik::util::packed_rtree_swap_bytes(header.first_size);
+#endif
+}
+
+// checks a header read (and converted to host byte order) from a file of `index_size` bytes
+inline bool geojson_index_valid(geojson_index_header const& header, std::size_t index_size)
+{
+    return mapnik::util::packed_rtree_valid(header.tree, geojson_index_magic, geojson_index_version,
+                                            sizeof(geojson_index_header), sizeof(geojson_index_entry),
+                                            index_size);
+}
+
+class geojson_index
+{
+public:
+    // opens the index of `filename`, returns nothing if there is none or it is out of date
+    static std::unique_ptr<geojson_index> open(std::string const& filename);
+
+    mapnik::box2d<double> extent() const
+    {
+        return mapnik::box2d<double>(header_.tree.extent[0], header_.tree.extent[1],
+                                     header_.tree.extent[2], header_.tree.extent[3]);
+    }
+
+    std::size_t size() const
+    {
+        return header_.tree.num_items;
+    }
+
+    std::pair<std::size_t, std::size_t> first_feature() const
+    {
+        return std::make_pair(header_.first_offset, header_.first_size);
+    }
+
+    // appends (box, (offset, size)) for up to `limit` features intersecting `box`
+    template <typename OutputIterator>
+    void query(mapnik::box2d<double> const& box, OutputIterator out,
+               std::size_t limit = std::numeric_limits<std::size_t>::max()) const
+    {
+        if (limit == 0) return;
+        std::size_t count = 0;
+        mapnik::util::packed_rtree_query<geojson_index_entry>(
+            header_.tree,
+            [&box](mapnik::box2d<double> const& entry_box) { return entry_box.intersects(box); },
+            mapnik::util::packed_rtree_memory_nodes<geojson_index_entry>(entries_),
+            [&](geojson_index_entry const& entry)
+            {
+                *out++ = std::make_pair(mapnik::box2d<double>(entry.box[0], entry.box[1], entry.box[2], entry.box[3]),
+                                        std::make_pair(std::size_t(entry.values[0]), std::size_t(entry.values[1])));
+                return ++count < limit;
+            });
+    }
+
+private:
+    geojson_index() {}
+
+    geojson_index_header header_;
+    // in file byte order
+    geojson_index_entry const* entries_ = nullptr;
+#if defined(SHAPE_MEMORY_MAPPED_FILE)
+    mapnik::mapped_region_ptr region_;
+#else
+    std::vector<geojson_index_entry> buffer_;
+#endif
+};
+
+#endif // GEOJSON_INDEX_HPP
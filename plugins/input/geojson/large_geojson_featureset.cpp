@@ -25,58 +25,197 @@
 #include <mapnik/feature_factory.hpp>
 #include <mapnik/json/geometry_grammar.hpp>
 #include <mapnik/json/feature_grammar.hpp>
+#include <mapnik/json/geojson_reader.hpp>
 #include <mapnik/utils.hpp>
+#if defined(SHAPE_MEMORY_MAPPED_FILE)
+#include <boost/interprocess/mapped_region.hpp>
+#elif !defined(_WINDOWS)
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
 // stl
 #include <string>
 #include <vector>
 #include <deque>
+#include <iterator>
+#include <algorithm>
 
 #include "large_geojson_featureset.hpp"
 
+namespace {
+// features closer than this are read together, skipping the bytes in between
+const std::size_t max_read_gap = 1 << 15;
+// reads are not grown beyond this unless a single feature is larger
+const std::size_t max_read_size = 1 << 20;
+}
+
+geojson_feature_parser::geojson_feature_parser(bool fast)
+    : tr("utf8"),
+      grammar(tr),
+      fast(fast) {}
+
+void geojson_feature_parser::parse(iterator_type start, iterator_type end, mapnik::feature_impl & feature) const
+{
+    bool result;
+    if (fast)
+    {
+        result = mapnik::json::read_feature(start, end, feature, tr);
+    }
+    else
+    {
+        using namespace boost::spirit;
+        ascii::space_type space;
+        result = qi::phrase_parse(start, end, (grammar)(boost::phoenix::ref(feature)), space);
+    }
+    if (!result)
+    {
+        throw std::runtime_error("Failed to parse geojson feature");
+    }
+}
+
 large_geojson_featureset::large_geojson_featureset(std::string const& filename,
-                                                   array_type && index_array)
+                                                   array_type && index_array,
+                                                   std::size_t parse_ahead,
+                                                   bool fast_parser)
 :
-#ifdef _WINDOWS
+#if defined(SHAPE_MEMORY_MAPPED_FILE)
+    mapped_region_(),
+#elif defined(_WINDOWS)
     file_(_wfopen(mapnik::utf8_to_utf16(filename).c_str(), L"rb"), std::fclose),
 #else
-    file_(std::fopen(filename.c_str(),"rb"), std::fclose),
+    fd_(::open(filename.c_str(), O_RDONLY)),
 #endif
     index_array_(std::move(index_array)),
     index_itr_(index_array_.begin()),
     index_end_(index_array_.end()),
-    ctx_(std::make_shared<mapnik::context_type>())
+    parse_ahead_(parse_ahead),
+    parser_(fast_parser),
+    buffer_(),
+    batch_(),
+    batch_itr_(batch_.end()),
+    next_batch_()
 {
+#if defined(SHAPE_MEMORY_MAPPED_FILE)
+    boost::optional<mapnik::mapped_region_ptr> memory =
+        mapnik::mapped_memory_cache::instance().find(filename, true);
+    if (!memory) throw std::runtime_error("could not get file mapping for " + filename);
+    mapped_region_ = *memory;
+#elif defined(_WINDOWS)
     if (!file_) throw std::runtime_error("Can't open " + filename);
+#else
+    if (fd_ < 0) throw std::runtime_error("Can't open " + filename);
+#endif
 }
 
-large_geojson_featureset::~large_geojson_featureset() {}
+large_geojson_featureset::~large_geojson_featureset()
+{
+    // a batch parsed ahead may still be reading the file
+    if (next_batch_.valid()) next_batch_.wait();
+#if !defined(SHAPE_MEMORY_MAPPED_FILE) && !defined(_WINDOWS)
+    ::close(fd_);
+#endif
+}
 
-mapnik::feature_ptr large_geojson_featureset::next()
+#if !defined(SHAPE_MEMORY_MAPPED_FILE)
+void large_geojson_featureset::read(std::size_t offset, std::size_t size)
 {
-    if (index_itr_ != index_end_)
+    // the buffer keeps its capacity, so it is only grown for larger reads
+    buffer_.resize(size);
+    if (size == 0) return;
+#if defined(_WINDOWS)
+    if (std::fseek(file_.get(), offset, SEEK_SET) != 0
+        || std::fread(buffer_.data(), size, 1, file_.get()) != 1)
+    {
+        throw std::runtime_error("Failed to read geojson feature");
+    }
+#else
+    std::size_t done = 0;
+    while (done < size)
     {
-        geojson_datasource::item_type const& item = *index_itr_++;
-        std::size_t file_offset = item.second.first;
-        std::size_t size = item.second.second;
-        std::fseek(file_.get(), file_offset, SEEK_SET);
-        std::vector<char> json;
-        json.resize(size);
-        std::fread(json.data(), size, 1, file_.get());
+        ssize_t count = ::pread(fd_, buffer_.data() + done, size - done, offset + done);
+        if (count < 0 && errno == EINTR) continue;
+        if (count <= 0) throw std::runtime_error("Failed to read geojson feature");
+        done += count;
+    }
+#endif
+}
+#endif
 
-        using chr_iterator_type = char const*;
-        chr_iterator_type start = json.data();
-        chr_iterator_type end = start + json.size();
+large_geojson_featureset::batch_type large_geojson_featureset::parse_batch()
+{
+    batch_type batch;
+    // the consumer may still be reading the features of the previous batch,
+    // so each batch gets a context of its own
+    mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+    while (index_itr_ != index_end_ && (batch.empty() || batch.size() < parse_ahead_))
+    {
+#if defined(SHAPE_MEMORY_MAPPED_FILE)
+        char const* data = static_cast<char const*>(mapped_region_->get_address());
+        std::size_t file_size = mapped_region_->get_size();
+        std::pair<std::size_t, std::size_t> const& range = (*index_itr_++).second;
+        if (range.first + range.second > file_size)
+        {
+            throw std::runtime_error("Failed to read geojson feature");
+        }
+        mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx,1));
+        parser_.parse(data + range.first, data + range.first + range.second, *feature);
+        batch.push_back(feature);
+#else
+        // read the features close to the next one along with it
+        std::size_t first = index_itr_->second.first;
+        std::size_t last = first + index_itr_->second.second;
+        array_type::const_iterator end = std::next(index_itr_);
+        std::size_t count = batch.size() + 1;
+        for (; end != index_end_ && (parse_ahead_ == 0 || count < parse_ahead_); ++end, ++count)
+        {
+            std::size_t offset = end->second.first;
+            std::size_t end_offset = offset + end->second.second;
+            if (offset < first
+                || offset > last + max_read_gap
+                || std::max(last, end_offset) - first > max_read_size)
+            {
+                break;
+            }
+            last = std::max(last, end_offset);
+        }
+        read(first, last - first);
+        for (; index_itr_ != end; ++index_itr_)
+        {
+            std::pair<std::size_t, std::size_t> const& range = index_itr_->second;
+            char const* start = buffer_.data() + (range.first - first);
+            mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx,1));
+            parser_.parse(start, start + range.second, *feature);
+            batch.push_back(feature);
+        }
+        // without parse ahead a batch is one read
+        if (parse_ahead_ == 0) break;
+#endif
+    }
+    return batch;
+}
 
-        static const mapnik::transcoder tr("utf8");
-        static const mapnik::json::feature_grammar<chr_iterator_type,mapnik::feature_impl> grammar(tr);
-        using namespace boost::spirit;
-        ascii::space_type space;
-        mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx_,1));
-        if (!qi::phrase_parse(start, end, (grammar)(boost::phoenix::ref(*feature)), space))
+mapnik::feature_ptr large_geojson_featureset::next()
+{
+    while (batch_itr_ == batch_.end())
+    {
+        if (next_batch_.valid())
+        {
+            batch_ = next_batch_.get();
+        }
+        else if (index_itr_ != index_end_)
+        {
+            batch_ = parse_batch();
+        }
+        else
+        {
+            return mapnik::feature_ptr();
+        }
+        batch_itr_ = batch_.begin();
+        if (parse_ahead_ > 0 && index_itr_ != index_end_)
         {
-            throw std::runtime_error("Failed to parse geojson feature");
+            next_batch_ = std::async(std::launch::async, &large_geojson_featureset::parse_batch, this);
         }
-        return feature;
     }
-    return mapnik::feature_ptr();
+    return *batch_itr_++;
 }
@@ -24,31 +24,75 @@
 #define LARGE_GEOJSON_FEATURESET_HPP
 
 #include <mapnik/feature.hpp>
+#include <mapnik/unicode.hpp>
+#include <mapnik/json/feature_grammar.hpp>
 #include "geojson_datasource.hpp"
 
+#if defined(SHAPE_MEMORY_MAPPED_FILE)
+#include <mapnik/mapped_memory_cache.hpp>
+#endif
+
 #include <vector>
 #include <deque>
-#include <fstream>
+#include <future>
 #include <cstdio>
 
+// parses single features, a parser (its transcoder) must not be shared between threads
+struct geojson_feature_parser
+{
+    using iterator_type = char const*;
+    explicit geojson_feature_parser(bool fast = false);
+    void parse(iterator_type start, iterator_type end, mapnik::feature_impl & feature) const;
+
+    mapnik::transcoder tr;
+    mapnik::json::feature_grammar<iterator_type, mapnik::feature_impl> grammar;
+    // use mapnik::json::read_feature instead of the grammar
+    const bool fast;
+};
+
+// Reads the features of `index_array` (sorted by file offset) straight from the
+// mapped file, or otherwise with positional reads which coalesce nearby features.
+// With `parse_ahead` > 0 up to that many features are parsed on a background
+// thread while the previous batch is consumed.
 class large_geojson_featureset : public mapnik::Featureset
 {
 public:
     using array_type = std::deque<geojson_datasource::item_type>;
-    using file_ptr = std::unique_ptr<std::FILE, int (*)(std::FILE *)>;
+    using batch_type = std::vector<mapnik::feature_ptr>;
 
     large_geojson_featureset(std::string const& filename,
-                             array_type && index_array);
+                             array_type && index_array,
+                             std::size_t parse_ahead = 0,
+                             bool fast_parser = false);
     virtual ~large_geojson_featureset();
     mapnik::feature_ptr next();
 
 private:
-    file_ptr file_;
+    // parses the features from index_itr_ on, reading as few ranges of the file as possible
+    batch_type parse_batch();
+#if !defined(SHAPE_MEMORY_MAPPED_FILE)
+    void read(std::size_t offset, std::size_t size);
+#endif
 
+#if defined(SHAPE_MEMORY_MAPPED_FILE)
+    mapnik::mapped_region_ptr mapped_region_;
+#elif defined(_WINDOWS)
+    using file_ptr = std::unique_ptr<std::FILE, int (*)(std::FILE *)>;
+    file_ptr file_;
+#else
+    int fd_;
+#endif
     const array_type index_array_;
     array_type::const_iterator index_itr_;
     array_type::const_iterator index_end_;
-    mapnik::context_ptr ctx_;
+    const std::size_t parse_ahead_;
+    // only used by one batch at a time, which may be on the background thread
+    geojson_feature_parser parser_;
+    std::vector<char> buffer_;
+    batch_type batch_;
+    batch_type::iterator batch_itr_;
+    // declared last so that a pending batch is finished before anything it uses is destroyed
+    std::future<batch_type> next_batch_;
 };
 
 #endif // LARGE_GEOJSON_FEATURESET_HPP
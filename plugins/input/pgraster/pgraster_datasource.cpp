@@ -101,6 +101,8 @@ pgraster_datasource::pgraster_datasource(parameters const& params)
       pixel_width_token_("!pixel_width!"),
       pixel_height_token_("!pixel_height!"),
       pool_max_size_(*params_.get<value_integer>("max_size", 10)),
+      pool_wait_timeout_(*params.get<value_integer>("pool_wait_timeout", 1000)),
+      pool_idle_timeout_(*params.get<value_integer>("pool_idle_timeout", 0)),
       persist_connection_(*params.get<mapnik::boolean_type>("persist_connection", true)),
       extent_from_subquery_(*params.get<mapnik::boolean_type>("extent_from_subquery", false)),
       estimate_extent_(*params.get<mapnik::boolean_type>("estimate_extent", false)),
@@ -141,7 +143,9 @@ pgraster_datasource::pgraster_datasource(parameters const& params)
     boost::optional<value_integer> initial_size = params.get<value_integer>("initial_size", 1);
     boost::optional<mapnik::boolean_type> autodetect_key_field = params.get<mapnik::boolean_type>("autodetect_key_field", false);
 
-    ConnectionManager::instance().registerPool(creator_, *initial_size, pool_max_size_);
+    ConnectionManager::instance().registerPool(creator_, *initial_size, pool_max_size_,
+                                               std::chrono::milliseconds(pool_wait_timeout_),
+                                               std::chrono::seconds(pool_idle_timeout_));
     CnxPool_ptr pool = ConnectionManager::instance().getPool(creator_.id());
     if (pool)
     {
@@ -582,13 +586,17 @@ pgraster_datasource::pgraster_datasource(parameters const& params)
 
 pgraster_datasource::~pgraster_datasource()
 {
+    CnxPool_ptr pool = ConnectionManager::instance().getPool(creator_.id());
+    if (pool)
+    {
+        MAPNIK_LOG_DEBUG(pgraster) << "pgraster_datasource: connection pool " << pool->stats();
+    }
     if (! persist_connection_)
     {
-        CnxPool_ptr pool = ConnectionManager::instance().getPool(creator_.id());
         if (pool)
         {
             try {
-              shared_ptr<Connection> conn = pool->borrowObject();
+              shared_ptr<Connection> conn = pool->borrowObject(std::chrono::milliseconds(0));
               if (conn)
               {
                   conn->close();
@@ -834,17 +842,19 @@ featureset_ptr pgraster_datasource::features_with_context(query const& q,process
             std::shared_ptr<postgis_processor_context> pgis_ctxt = std::static_pointer_cast<postgis_processor_context>(proc_ctx);
             if ( pgis_ctxt->num_async_requests_ < max_async_connections_ )
             {
-                conn = pool->borrowObject();
+                // do not wait: without a connection the request is queued on the context
+                conn = pool->borrowObject(std::chrono::milliseconds(0));
                 pgis_ctxt->num_async_requests_++;
             }
         }
         else
         {
-            // Always get a connection in synchronous mode
+            // Always get a connection in synchronous mode, waiting
+            // up to pool_wait_timeout for one when the pool is exhausted
             conn = pool->borrowObject();
             if(!conn )
             {
-                throw mapnik::datasource_exception("Pgraster Plugin: Null connection");
+                throw mapnik::datasource_exception("Pgraster Plugin: Null connection (connection pool exhausted)");
             }
         }
 
@@ -134,6 +134,8 @@ private:
     const std::string pixel_width_token_;
     const std::string pixel_height_token_;
     int pool_max_size_;
+    int pool_wait_timeout_;
+    int pool_idle_timeout_;
     bool persist_connection_;
     bool extent_from_subquery_;
     bool estimate_extent_;
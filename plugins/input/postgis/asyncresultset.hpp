@@ -30,6 +30,9 @@
 #include "resultset.hpp"
 #include <queue>
 #include <memory>
+#include <map>
+#include <string>
+#include <vector>
 
 class postgis_processor_context;
 using postgis_processor_context_ptr = std::shared_ptr<postgis_processor_context>;
@@ -39,11 +42,13 @@ class AsyncResultSet : public IResultSet, private mapnik::util::noncopyable
 public:
     AsyncResultSet(postgis_processor_context_ptr const& ctx,
                      std::shared_ptr< Pool<Connection,ConnectionCreator> > const& pool,
-                     std::shared_ptr<Connection> const& conn, std::string const& sql )
+                     std::shared_ptr<Connection> const& conn, std::string const& sql,
+                     std::vector<std::string> const& params = std::vector<std::string>())
         : ctx_(ctx),
           pool_(pool),
           conn_(conn),
           sql_(sql),
+          params_(params),
           is_closed_(false)
     {
     }
@@ -165,6 +170,7 @@ private:
     std::shared_ptr< Pool<Connection,ConnectionCreator> > pool_;
     std::shared_ptr<Connection> conn_;
     std::string sql_;
+    std::vector<std::string> params_;
     std::shared_ptr<ResultSet> rs_;
     bool is_closed_;
 
@@ -173,7 +179,8 @@ private:
         conn_ = pool_->borrowObject();
         if (conn_ && conn_->isOK())
         {
-            conn_->executeAsyncQuery(sql_, 1);
+            if (params_.empty()) conn_->executeAsyncQuery(sql_, 1);
+            else conn_->executeAsyncPrepared(sql_, params_);
         }
         else
         {
@@ -209,12 +216,152 @@ public:
         return r;
     }
 
+    // Connection to pipeline the next query on: borrows up to `max_connections`
+    // from `pool` (without waiting, as the connections already taken keep
+    // being usable) and then hands them out round robin.
+    std::shared_ptr<Connection> pipeline_connection(std::shared_ptr< Pool<Connection,ConnectionCreator> > const& pool,
+                                                    std::string const& pool_id,
+                                                    int max_connections)
+    {
+        pipeline & p = pipelines_[pool_id];
+        if (static_cast<int>(p.connections.size()) < max_connections)
+        {
+            std::shared_ptr<Connection> conn = p.connections.empty() ?
+                pool->borrowObject() : pool->borrowObject(std::chrono::milliseconds(0));
+            if (conn && conn->isOK())
+            {
+                p.connections.push_back(conn);
+            }
+        }
+        if (p.connections.empty())
+        {
+            return std::shared_ptr<Connection>();
+        }
+        std::shared_ptr<Connection> conn = p.connections[p.next % p.connections.size()];
+        ++p.next;
+        return conn;
+    }
+
     int num_async_requests_;
 
 private:
     using async_queue = std::queue<std::shared_ptr<AsyncResultSet> >;
     async_queue q_;
 
+    struct pipeline
+    {
+        pipeline() : next(0) {}
+        std::vector<std::shared_ptr<Connection> > connections;
+        std::size_t next;
+    };
+    // keyed by connection pool, the context is shared by all postgis layers
+    std::map<std::string, pipeline> pipelines_;
+
+};
+
+// Reads back one query queued with Connection::sendPipelined. Layers are
+// usually rendered in the order their queries were issued; results read
+// ahead for another reader are kept by the connection until it asks.
+class PipelinedResultSet : public IResultSet, private mapnik::util::noncopyable
+{
+public:
+    PipelinedResultSet(std::shared_ptr<Connection> const& conn, int seq)
+        : conn_(conn),
+          seq_(seq),
+          is_closed_(false)
+    {
+    }
+
+    virtual ~PipelinedResultSet()
+    {
+        close();
+    }
+
+    virtual void close()
+    {
+        if (!is_closed_)
+        {
+            rs_.reset();
+            is_closed_ = true;
+            conn_->finishPipelined(seq_);
+            conn_.reset();
+        }
+    }
+
+    virtual int getNumFields() const
+    {
+        return rs_->getNumFields();
+    }
+
+    virtual bool next()
+    {
+        if (is_closed_) return false;
+        if (!rs_)
+        {
+            if (!conn_->isOK())
+            {
+                throw mapnik::datasource_exception("invalid connection in PipelinedResultSet::next");
+            }
+            rs_ = conn_->getPipelinedResult(seq_);
+            if (!rs_)
+            {
+                close();
+                return false;
+            }
+        }
+        if (rs_->next())
+        {
+            return true;
+        }
+        close();
+        return false;
+    }
+
+    virtual const char* getFieldName(int index) const
+    {
+        return rs_->getFieldName(index);
+    }
+
+    virtual int getFieldLength(int index) const
+    {
+        return rs_->getFieldLength(index);
+    }
+
+    virtual int getFieldLength(const char* name) const
+    {
+        return rs_->getFieldLength(name);
+    }
+
+    virtual int getTypeOID(int index) const
+    {
+        return rs_->getTypeOID(index);
+    }
+
+    virtual int getTypeOID(const char* name) const
+    {
+        return rs_->getTypeOID(name);
+    }
+
+    virtual bool isNull(int index) const
+    {
+        return rs_->isNull(index);
+    }
+
+    virtual const char* getValue(int index) const
+    {
+        return rs_->getValue(index);
+    }
+
+    virtual const char* getValue(const char* name) const
+    {
+        return rs_->getValue(name);
+    }
+
+private:
+    std::shared_ptr<Connection> conn_;
+    int seq_;
+    std::shared_ptr<ResultSet> rs_;
+    bool is_closed_;
 };
 
 inline void AsyncResultSet::prepare_next()
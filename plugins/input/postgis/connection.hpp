@@ -32,6 +32,12 @@
 #include <memory>
 #include <sstream>
 #include <iostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <set>
+#include <unordered_map>
 
 extern "C" {
 #include "libpq-fe.h"
@@ -44,8 +50,12 @@ class Connection
 public:
     Connection(std::string const& connection_str,boost::optional<std::string> const& password)
         : cursorId(0),
+          statementId_(0),
           closed_(false),
-          pending_(false)
+          pending_(false),
+          pipeline_sent_(0),
+          pipeline_consumed_(0),
+          pipeline_outstanding_(0)
     {
         std::string connect_with_pass = connection_str;
         if (password && !password->empty())
@@ -108,6 +118,42 @@ public:
         return ok;
     }
 
+    // Like execute, with `params` ($1..$n) bound as text, e.g to DECLARE a
+    // cursor over a query with statement parameters.
+    bool execute(std::string const& sql, std::vector<std::string> const& params)
+    {
+        if (params.empty()) return execute(sql);
+#ifdef MAPNIK_STATS
+        mapnik::progress_timer __stats__(std::clog, std::string("postgis_connection::execute ") + sql);
+#endif
+        std::vector<const char*> values;
+        values.reserve(params.size());
+        for (auto const& param : params)
+        {
+            values.push_back(param.c_str());
+        }
+        if (PQsendQueryParams(conn_, sql.c_str(), static_cast<int>(values.size()), 0, &values[0], 0, 0, 0) != 1)
+        {
+            std::string err_msg = "Postgis Plugin: ";
+            err_msg += status();
+            err_msg += "in execute Full sql was: '";
+            err_msg += sql;
+            err_msg += "'\n";
+            clearAsyncResult(PQgetResult(conn_));
+            close();
+            throw mapnik::datasource_exception(err_msg);
+        }
+        pending_ = true;
+        PGresult *result = 0;
+        while ( PGresult *tmp = getResult() ) {
+          if ( result ) PQclear(result);
+          result = tmp;
+        }
+        bool ok = (result && (PQresultStatus(result) == PGRES_COMMAND_OK));
+        if ( result ) PQclear(result);
+        return ok;
+    }
+
     std::shared_ptr<ResultSet> executeQuery(std::string const& sql, int type = 0)
     {
 #ifdef MAPNIK_STATS
@@ -137,6 +183,184 @@ public:
         return std::make_shared<ResultSet>(result);
     }
 
+    // Like executeQuery, but sends `sql` as a prepared statement with
+    // `params` ($1..$n) bound as text and results requested in binary.
+    std::shared_ptr<ResultSet> executePrepared(std::string const& sql, std::vector<std::string> const& params)
+    {
+#ifdef MAPNIK_STATS
+        mapnik::progress_timer __stats__(std::clog, std::string("postgis_connection::execute_prepared ") + sql);
+#endif
+        PGresult* result = 0;
+        if ( executeAsyncPrepared(sql, params) ) {
+          while ( PGresult *tmp = getResult() ) {
+            if ( result ) PQclear(result);
+            result = tmp;
+          }
+        }
+
+        if (! result || (PQresultStatus(result) != PGRES_TUPLES_OK))
+        {
+            std::string err_msg = "Postgis Plugin: ";
+            err_msg += status();
+            err_msg += "in executePrepared Full sql was: '";
+            err_msg += sql;
+            err_msg += "'\n";
+            if ( result ) PQclear(result);
+            forgetPrepared(sql);
+            throw mapnik::datasource_exception(err_msg);
+        }
+
+        return std::make_shared<ResultSet>(result);
+    }
+
+    bool executeAsyncPrepared(std::string const& sql, std::vector<std::string> const& params)
+    {
+        std::vector<const char*> values;
+        values.reserve(params.size());
+        for (auto const& param : params)
+        {
+            values.push_back(param.c_str());
+        }
+        int nparams = static_cast<int>(values.size());
+        const char* const* param_values = values.empty() ? nullptr : &values[0];
+
+        int result = 0;
+        std::string const* name = preparedStatement(sql, nparams);
+        if (name)
+        {
+            result = PQsendQueryPrepared(conn_, name->c_str(), nparams, param_values, 0, 0, 1);
+        }
+        else
+        {
+            result = PQsendQueryParams(conn_, sql.c_str(), nparams, 0, param_values, 0, 0, 1);
+        }
+        if (result != 1)
+        {
+            std::string err_msg = "Postgis Plugin: ";
+            err_msg += status();
+            err_msg += "in executeAsyncPrepared Full sql was: '";
+            err_msg += sql;
+            err_msg += "'\n";
+            clearAsyncResult(PQgetResult(conn_));
+            close();
+            throw mapnik::datasource_exception(err_msg);
+        }
+        pending_ = true;
+        return result;
+    }
+
+    static bool supportsPipeline()
+    {
+#ifdef LIBPQ_HAS_PIPELINING
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    // Queues `sql` on the connection's pipeline (entering pipeline mode if
+    // needed) followed by a sync point, so a failing query does not abort
+    // the ones queued after it. Returns the sequence number of the query,
+    // results are read back in that order with getPipelinedResult.
+    int sendPipelined(std::string const& sql, std::vector<std::string> const& params)
+    {
+#ifdef LIBPQ_HAS_PIPELINING
+        if (PQpipelineStatus(conn_) == PQ_PIPELINE_OFF)
+        {
+            if (PQenterPipelineMode(conn_) != 1)
+            {
+                std::string err_msg = "Postgis Plugin: ";
+                err_msg += status();
+                err_msg += "in sendPipelined, could not enter pipeline mode";
+                throw mapnik::datasource_exception(err_msg);
+            }
+        }
+        if (params.empty()) executeAsyncQuery(sql, 1);
+        else executeAsyncPrepared(sql, params);
+        if (PQpipelineSync(conn_) != 1)
+        {
+            std::string err_msg = "Postgis Plugin: ";
+            err_msg += status();
+            err_msg += "in sendPipelined Full sql was: '";
+            err_msg += sql;
+            err_msg += "'\n";
+            close();
+            throw mapnik::datasource_exception(err_msg);
+        }
+        pipeline_sql_.push_back(sql);
+        ++pipeline_outstanding_;
+        return pipeline_sent_++;
+#else
+        throw mapnik::datasource_exception("Postgis Plugin: libpq has no pipeline support, sql was: '" + sql + "'");
+#endif
+    }
+
+    // Returns the rows of pipelined query `seq`. The results of queries
+    // queued before it are read first and kept for their own readers, so
+    // queries can be read back in any order. Throws if the query failed.
+    std::shared_ptr<ResultSet> getPipelinedResult(int seq)
+    {
+        while (pipeline_consumed_ <= seq && isOK())
+        {
+            readPipelined();
+        }
+        auto itr = pipeline_results_.find(seq);
+        if (itr == pipeline_results_.end())
+        {
+            std::string err_msg = "Postgis Plugin: ";
+            err_msg += status();
+            err_msg += "in getPipelinedResult, no results left for pipelined query ";
+            err_msg += std::to_string(seq);
+            throw mapnik::datasource_exception(err_msg);
+        }
+        pipelined_result result = std::move(itr->second);
+        pipeline_results_.erase(itr);
+        if (!result.rows)
+        {
+            std::string err_msg = "Postgis Plugin: ";
+            err_msg += result.error;
+            err_msg += "in getPipelinedResult Full sql was: '";
+            err_msg += result.sql;
+            err_msg += "'\n";
+            throw mapnik::datasource_exception(err_msg);
+        }
+        return result.rows;
+    }
+
+    // Called once by the reader of every pipelined query when done with it.
+    // Leaves pipeline mode once nobody is waiting for results anymore.
+    void finishPipelined(int seq)
+    {
+#ifdef LIBPQ_HAS_PIPELINING
+        if (seq < pipeline_consumed_)
+        {
+            pipeline_results_.erase(seq);
+        }
+        else
+        {
+            // not read yet, dropped when it is
+            pipeline_discarded_.insert(seq);
+        }
+        if (--pipeline_outstanding_ == 0)
+        {
+            while (pipeline_consumed_ < pipeline_sent_ && isOK())
+            {
+                readPipelined();
+            }
+            pipeline_results_.clear();
+            pipeline_discarded_.clear();
+            if (isOK() && PQexitPipelineMode(conn_) != 1)
+            {
+                MAPNIK_LOG_WARN(postgis) << "postgis_connection: could not leave pipeline mode, closing connection";
+                close();
+            }
+            pending_ = false;
+        }
+#else
+        (void)seq;
+#endif
+    }
+
     std::string status() const
     {
         std::string status;
@@ -258,10 +482,149 @@ public:
     }
 
 private:
+    // cap on cached statements per connection, queries past it are sent unprepared
+    static const std::size_t max_prepared_statements = 256;
+
     PGconn *conn_;
     int cursorId;
+    int statementId_;
     bool closed_;
     bool pending_;
+    std::unordered_map<std::string, std::string> prepared_;
+    int pipeline_sent_;
+    int pipeline_consumed_;
+    int pipeline_outstanding_;
+    std::deque<std::string> pipeline_sql_;
+    // results read ahead of their readers, by sequence number
+    struct pipelined_result
+    {
+        std::shared_ptr<ResultSet> rows; // null if the query failed
+        std::string error;
+        std::string sql;
+    };
+    std::map<int, pipelined_result> pipeline_results_;
+    // queries whose readers were closed before reading them
+    std::set<int> pipeline_discarded_;
+
+    // Returns the name of the prepared statement for `sql`, preparing it
+    // first when it is not cached yet. Returns nullptr if the cache is full.
+    std::string const* preparedStatement(std::string const& sql, int nparams)
+    {
+        auto itr = prepared_.find(sql);
+        if (itr != prepared_.end())
+        {
+            return &itr->second;
+        }
+        if (prepared_.size() >= max_prepared_statements)
+        {
+            return nullptr;
+        }
+        std::ostringstream s;
+        s << "mapnik_stmt_" << (statementId_++);
+        std::string name = s.str();
+#ifdef LIBPQ_HAS_PIPELINING
+        if (PQpipelineStatus(conn_) != PQ_PIPELINE_OFF)
+        {
+            // the prepare result arrives ahead of the query's own results
+            if (PQsendPrepare(conn_, name.c_str(), sql.c_str(), nparams, 0) != 1)
+            {
+                return nullptr;
+            }
+            return &prepared_.emplace(sql, name).first->second;
+        }
+#endif
+        PGresult *result = PQprepare(conn_, name.c_str(), sql.c_str(), nparams, 0);
+        bool ok = (result && (PQresultStatus(result) == PGRES_COMMAND_OK));
+        if ( result ) PQclear(result);
+        if (!ok)
+        {
+            MAPNIK_LOG_WARN(postgis) << "postgis_connection: could not prepare statement, " << status();
+            return nullptr;
+        }
+        return &prepared_.emplace(sql, name).first->second;
+    }
+
+    void forgetPrepared(std::string const& sql)
+    {
+        // the statement may have failed to prepare, let the next attempt redo it
+        // under a new name rather than reusing a possibly missing one
+        prepared_.erase(sql);
+    }
+
+    // Reads the results of the oldest unread pipelined query, up to its sync
+    // point, and keeps them until its reader asks for them (or is closed).
+    void readPipelined()
+    {
+        int seq = pipeline_consumed_++;
+        std::string sql;
+        if (!pipeline_sql_.empty())
+        {
+            sql = pipeline_sql_.front();
+            pipeline_sql_.pop_front();
+        }
+        PGresult *rows = 0;
+        std::string error;
+#ifdef LIBPQ_HAS_PIPELINING
+        // each statement of the segment (the query, and maybe its prepare)
+        // ends with a null result, the segment with PGRES_PIPELINE_SYNC
+        bool after_null = false;
+        while (isOK())
+        {
+            PGresult *result = getResult();
+            if (!result)
+            {
+                if (after_null)
+                {
+                    // two in a row, there is nothing left to read
+                    MAPNIK_LOG_WARN(postgis) << "postgis_connection: lost track of the pipeline, closing connection";
+                    close();
+                    break;
+                }
+                after_null = true;
+                continue;
+            }
+            after_null = false;
+            ExecStatusType st = PQresultStatus(result);
+            if (st == PGRES_PIPELINE_SYNC)
+            {
+                PQclear(result);
+                break;
+            }
+            if (st == PGRES_TUPLES_OK && !rows && error.empty())
+            {
+                rows = result;
+                continue;
+            }
+            // an error (or PGRES_PIPELINE_ABORTED after one), or the
+            // PGRES_COMMAND_OK of a statement prepared in the segment
+            if (st != PGRES_COMMAND_OK && error.empty())
+            {
+                char const* msg = PQresultErrorMessage(result);
+                error = (msg && *msg) ? msg : "pipelined query failed\n";
+            }
+            PQclear(result);
+        }
+#endif
+        if (rows && !error.empty())
+        {
+            PQclear(rows);
+            rows = 0;
+        }
+        if (!rows)
+        {
+            forgetPrepared(sql);
+            if (error.empty()) error = status();
+        }
+        if (pipeline_discarded_.erase(seq) > 0)
+        {
+            if (rows) PQclear(rows);
+            return;
+        }
+        pipelined_result & result = pipeline_results_[seq];
+        result.sql = sql;
+        result.error = error;
+        if (rows) result.rows = std::make_shared<ResultSet>(rows);
+    }
 
     void clearAsyncResult(PGresult *result)
     {
@@ -37,6 +37,7 @@
 #include <string>
 #include <sstream>
 #include <memory>
+#include <chrono>
 
 using mapnik::Pool;
 using mapnik::singleton;
@@ -113,7 +114,11 @@ private:
 
 public:
 
-    bool registerPool(const ConnectionCreator<Connection>& creator,unsigned initialSize,unsigned maxSize)
+    bool registerPool(const ConnectionCreator<Connection>& creator,
+                      unsigned initialSize,
+                      unsigned maxSize,
+                      std::chrono::milliseconds waitTimeout = std::chrono::milliseconds(0),
+                      std::chrono::seconds idleTimeout = std::chrono::seconds(0))
     {
         ContType::const_iterator itr = pools_.find(creator.id());
 
@@ -121,12 +126,17 @@ public:
         {
             itr->second->set_initial_size(initialSize);
             itr->second->set_max_size(maxSize);
+            // pools are shared by all datasources using the same connection,
+            // the most patient/most recent timeouts win
+            itr->second->set_wait_timeout(std::max(itr->second->wait_timeout(), waitTimeout));
+            itr->second->set_idle_timeout(idleTimeout);
         }
         else
         {
-            return pools_.insert(
-                std::make_pair(creator.id(),
-                               std::make_shared<PoolType>(creator,initialSize,maxSize))).second;
+            std::shared_ptr<PoolType> pool = std::make_shared<PoolType>(creator,initialSize,maxSize);
+            pool->set_wait_timeout(waitTimeout);
+            pool->set_idle_timeout(idleTimeout);
+            return pools_.insert(std::make_pair(creator.id(), pool)).second;
         }
         return false;
 
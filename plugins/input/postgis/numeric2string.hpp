@@ -24,6 +24,8 @@
 #define MAPNIK_NUMERIC_2_STRING_HPP
 
 #include <mapnik/global.hpp>
+#include <mapnik/util/conversions.hpp>
+#include <cstdint>
 #include <string>
 #include <sstream>
 #include <memory>
@@ -141,4 +143,40 @@ static inline std::string numeric2string(const char* buf)
     return ss.str();
 }
 
+// Decode a binary numeric straight into a double without going through a
+// string. Up to four base-10000 digits form an exact integer mantissa and
+// scaling that by an exactly representable power of ten is correctly
+// rounded. Anything else takes the numeric2string path.
+static inline bool numeric2double(const char* buf, double & val)
+{
+    static const double powers_of_ten[] = {
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+    std::int16_t ndigits = int2net(buf);
+    std::int16_t weight  = int2net(buf+2);
+    std::uint16_t sign   = static_cast<std::uint16_t>(int2net(buf+4));
+
+    if (sign == 0xC000) return false; // NaN
+
+    if (ndigits <= 4)
+    {
+        std::uint64_t mantissa = 0;
+        for (int n = 0; n < ndigits; ++n)
+        {
+            mantissa = mantissa * 10000 + static_cast<std::uint16_t>(int2net(buf+8+n*2));
+        }
+        int exponent = 4 * (weight - ndigits + 1);
+        if (mantissa < (std::uint64_t(1) << 53) && exponent >= -22 && exponent <= 22)
+        {
+            double result = static_cast<double>(mantissa);
+            if (exponent < 0) result /= powers_of_ten[-exponent];
+            else result *= powers_of_ten[exponent];
+            val = (sign == 0x4000) ? -result : result;
+            return true;
+        }
+    }
+    return mapnik::util::string2double(numeric2string(buf), val);
+}
+
 #endif
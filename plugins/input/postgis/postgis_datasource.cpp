@@ -51,6 +51,7 @@
 #include <set>
 #include <sstream>
 #include <iomanip>
+#include <cmath>
 
 DATASOURCE_PLUGIN(postgis_datasource)
 
@@ -74,6 +75,12 @@ postgis_datasource::postgis_datasource(parameters const& params)
       srid_(*params.get<mapnik::value_integer>("srid", 0)),
       extent_initialized_(false),
       simplify_geometries_(false),
+      twkb_encoding_(false),
+      twkb_rounding_adjustment_(*params.get<mapnik::value_double>("twkb_rounding_adjustment", 0.0)),
+      simplify_snap_ratio_(*params.get<mapnik::value_double>("simplify_snap_ratio", 0.0)),
+      simplify_dp_ratio_(*params.get<mapnik::value_double>("simplify_dp_ratio", 0.05)),
+      simplify_dp_preserve_(false),
+      simplify_clip_resolution_(*params.get<mapnik::value_double>("simplify_clip_resolution", 0.0)),
       desc_(postgis_datasource::name(), "utf-8"),
       creator_(params.get<std::string>("host"),
              params.get<std::string>("port"),
@@ -86,10 +93,14 @@ postgis_datasource::postgis_datasource(parameters const& params)
       pixel_width_token_("!pixel_width!"),
       pixel_height_token_("!pixel_height!"),
       pool_max_size_(*params_.get<mapnik::value_integer>("max_size", 10)),
+      pool_wait_timeout_(*params.get<mapnik::value_integer>("pool_wait_timeout", 1000)),
+      pool_idle_timeout_(*params.get<mapnik::value_integer>("pool_idle_timeout", 0)),
       persist_connection_(*params.get<mapnik::boolean_type>("persist_connection", true)),
       extent_from_subquery_(*params.get<mapnik::boolean_type>("extent_from_subquery", false)),
       max_async_connections_(*params_.get<mapnik::value_integer>("max_async_connection", 1)),
       asynchronous_request_(false),
+      prepared_statements_(*params.get<mapnik::boolean_type>("prepared_statements", false)),
+      pipeline_queries_(*params.get<mapnik::boolean_type>("pipeline_queries", false)),
       // TODO - use for known tokens too: "(@\\w+|!\\w+!)"
       pattern_(boost::regex("(@\\w+)",boost::regex::normal | boost::regbase::icase)),
       // params below are for testing purposes only and may be removed at any time
@@ -124,14 +135,42 @@ postgis_datasource::postgis_datasource(parameters const& params)
         asynchronous_request_ = true;
     }
 
+    if (pipeline_queries_)
+    {
+        if (Connection::supportsPipeline())
+        {
+            // pipelined queries are issued through the asynchronous machinery,
+            // but also work on a single connection
+            asynchronous_request_ = true;
+        }
+        else
+        {
+            MAPNIK_LOG_WARN(postgis) << "postgis_datasource: pipeline_queries requires libpq >= 14, option ignored";
+            pipeline_queries_ = false;
+        }
+    }
+
+    if (prepared_statements_ && cursor_fetch_size_ > 0 && !asynchronous_request_)
+    {
+        // each query declares a cursor of its own name, there is no statement to reuse
+        MAPNIK_LOG_WARN(postgis) << "postgis_datasource: prepared_statements does not apply to cursor_size queries, option ignored";
+        prepared_statements_ = false;
+    }
+
     boost::optional<mapnik::value_integer> initial_size = params.get<mapnik::value_integer>("initial_size", 1);
     boost::optional<mapnik::boolean_type> autodetect_key_field = params.get<mapnik::boolean_type>("autodetect_key_field", false);
     boost::optional<mapnik::boolean_type> estimate_extent = params.get<mapnik::boolean_type>("estimate_extent", false);
     estimate_extent_ = estimate_extent && *estimate_extent;
     boost::optional<mapnik::boolean_type> simplify_opt = params.get<mapnik::boolean_type>("simplify_geometries", false);
     simplify_geometries_ = simplify_opt && *simplify_opt;
-
-    ConnectionManager::instance().registerPool(creator_, *initial_size, pool_max_size_);
+    boost::optional<mapnik::boolean_type> twkb_opt = params.get<mapnik::boolean_type>("twkb_encoding", false);
+    twkb_encoding_ = twkb_opt && *twkb_opt;
+    boost::optional<mapnik::boolean_type> simplify_preserve_opt = params.get<mapnik::boolean_type>("simplify_dp_preserve", false);
+    simplify_dp_preserve_ = simplify_preserve_opt && *simplify_preserve_opt;
+
+    ConnectionManager::instance().registerPool(creator_, *initial_size, pool_max_size_,
+                                               std::chrono::milliseconds(pool_wait_timeout_),
+                                               std::chrono::seconds(pool_idle_timeout_));
     CnxPool_ptr pool = ConnectionManager::instance().getPool(creator_.id());
     if (pool)
     {
@@ -470,13 +509,17 @@ postgis_datasource::postgis_datasource(parameters const& params)
 
 postgis_datasource::~postgis_datasource()
 {
+    CnxPool_ptr pool = ConnectionManager::instance().getPool(creator_.id());
+    if (pool)
+    {
+        MAPNIK_LOG_DEBUG(postgis) << "postgis_datasource: connection pool " << pool->stats();
+    }
     if (! persist_connection_)
     {
-        CnxPool_ptr pool = ConnectionManager::instance().getPool(creator_.id());
         if (pool)
         {
             try {
-              shared_ptr<Connection> conn = pool->borrowObject();
+              shared_ptr<Connection> conn = pool->borrowObject(std::chrono::milliseconds(0));
               if (conn)
               {
                   conn->close();
@@ -517,10 +560,7 @@ std::string postgis_datasource::sql_bbox(box2d<double> const& env) const
         b << "ST_SetSRID(";
     }
 
-    b << "'BOX3D(";
-    b << std::setprecision(16);
-    b << env.minx() << " " << env.miny() << ",";
-    b << env.maxx() << " " << env.maxy() << ")'::box3d";
+    b << "'" << box3d_text(env) << "'::box3d";
 
     if (srid_ > 0)
     {
@@ -530,6 +570,47 @@ std::string postgis_datasource::sql_bbox(box2d<double> const& env) const
     return b.str();
 }
 
+std::string postgis_datasource::box3d_text(box2d<double> const& env) const
+{
+    std::ostringstream b;
+    b << std::setprecision(16);
+    b << "BOX3D(" << env.minx() << " " << env.miny() << ",";
+    b << env.maxx() << " " << env.maxy() << ")";
+    return b.str();
+}
+
+// Same type and value as sql_bbox(env), with the box bound as a text parameter
+std::string postgis_datasource::sql_bbox(box2d<double> const& env, std::vector<std::string> * params) const
+{
+    if (!params)
+    {
+        return sql_bbox(env);
+    }
+    params->push_back(box3d_text(env));
+    std::ostringstream b;
+    if (srid_ > 0)
+    {
+        b << "ST_SetSRID(";
+    }
+    b << "$" << params->size() << "::box3d";
+    if (srid_ > 0)
+    {
+        b << ", " << srid_ << ")";
+    }
+    return b.str();
+}
+
+// Appends `value` to the statement parameters and returns its placeholder
+std::string postgis_datasource::sql_param(double value, std::vector<std::string> * params) const
+{
+    std::ostringstream v;
+    v << std::setprecision(16) << value;
+    params->push_back(v.str());
+    std::ostringstream p;
+    p << "$" << params->size() << "::float8";
+    return p.str();
+}
+
 std::string postgis_datasource::populate_tokens(std::string const& sql) const
 {
     std::string populated_sql = sql;
@@ -577,34 +658,40 @@ std::string postgis_datasource::populate_tokens(
                                 box2d<double> const& env,
                                 double pixel_width,
                                 double pixel_height,
-                                mapnik::attributes const& vars) const
+                                mapnik::attributes const& vars,
+                                std::vector<std::string> * params) const
 {
+    // with `params` the tile dependent values become statement parameters,
+    // so the SQL text stays the same for every tile of a layer
     std::string populated_sql = sql;
-    std::string box = sql_bbox(env);
 
     if (boost::algorithm::icontains(populated_sql, scale_denom_token_))
     {
         std::ostringstream ss;
-        ss << scale_denom;
+        if (params) ss << sql_param(scale_denom, params);
+        else ss << scale_denom;
         boost::algorithm::replace_all(populated_sql, scale_denom_token_, ss.str());
     }
 
     if (boost::algorithm::icontains(sql, pixel_width_token_))
     {
         std::ostringstream ss;
-        ss << pixel_width;
+        if (params) ss << sql_param(pixel_width, params);
+        else ss << pixel_width;
         boost::algorithm::replace_all(populated_sql, pixel_width_token_, ss.str());
     }
 
     if (boost::algorithm::icontains(sql, pixel_height_token_))
     {
         std::ostringstream ss;
-        ss << pixel_height;
+        if (params) ss << sql_param(pixel_height, params);
+        else ss << pixel_height;
         boost::algorithm::replace_all(populated_sql, pixel_height_token_, ss.str());
     }
 
     if (boost::algorithm::icontains(populated_sql, bbox_token_))
     {
+        std::string box = sql_bbox(env, params);
         boost::algorithm::replace_all(populated_sql, bbox_token_, box);
     }
     else
@@ -613,7 +700,7 @@ std::string postgis_datasource::populate_tokens(
 
         if (intersect_min_scale_ > 0 && (scale_denom <= intersect_min_scale_))
         {
-            s << " WHERE ST_Intersects(\"" << geometryColumn_ << "\"," << box << ")";
+            s << " WHERE ST_Intersects(\"" << geometryColumn_ << "\"," << sql_bbox(env, params) << ")";
         }
         else if (intersect_max_scale_ > 0 && (scale_denom >= intersect_max_scale_))
         {
@@ -621,7 +708,7 @@ std::string postgis_datasource::populate_tokens(
         }
         else
         {
-            s << " WHERE \"" << geometryColumn_ << "\" && " << box;
+            s << " WHERE \"" << geometryColumn_ << "\" && " << sql_bbox(env, params);
         }
         populated_sql += s.str();
     }
@@ -647,7 +734,7 @@ std::string postgis_datasource::populate_tokens(
 }
 
 
-std::shared_ptr<IResultSet> postgis_datasource::get_resultset(std::shared_ptr<Connection> &conn, std::string const& sql, CnxPool_ptr const& pool, processor_context_ptr ctx) const
+std::shared_ptr<IResultSet> postgis_datasource::get_resultset(std::shared_ptr<Connection> &conn, std::string const& sql, CnxPool_ptr const& pool, processor_context_ptr ctx, std::vector<std::string> const& params) const
 {
 
     if (!ctx)
@@ -661,7 +748,8 @@ std::shared_ptr<IResultSet> postgis_datasource::get_resultset(std::shared_ptr<Co
 
             csql << "DECLARE " << cursor_name << " BINARY INSENSITIVE NO SCROLL CURSOR WITH HOLD FOR " << sql << " FOR READ ONLY";
 
-            if (! conn->execute(csql.str()))
+            // the statement parameters are bound to the query of the cursor
+            if (! conn->execute(csql.str(), params))
             {
                 // TODO - better error
                 throw mapnik::datasource_exception("Postgis Plugin: error creating cursor for data select." );
@@ -670,12 +758,23 @@ std::shared_ptr<IResultSet> postgis_datasource::get_resultset(std::shared_ptr<Co
             return std::make_shared<CursorResultSet>(conn, cursor_name, cursor_fetch_size_);
 
         }
+        else if (!params.empty())
+        {
+            // no cursor, cached prepared statement
+            return conn->executePrepared(sql, params);
+        }
         else
         {
             // no cursor
             return conn->executeQuery(sql, 1);
         }
     }
+    else if (pipeline_queries_)
+    {
+        // queue behind the queries of previous layers on the same connection
+        int seq = conn->sendPipelined(sql, params);
+        return std::make_shared<PipelinedResultSet>(conn, seq);
+    }
     else
     {   // asynchronous requests
 
@@ -683,13 +782,14 @@ std::shared_ptr<IResultSet> postgis_datasource::get_resultset(std::shared_ptr<Co
         if (conn)
         {
             // lauch async req & create asyncresult with conn
-            conn->executeAsyncQuery(sql, 1);
-            return std::make_shared<AsyncResultSet>(pgis_ctxt, pool, conn, sql);
+            if (params.empty()) conn->executeAsyncQuery(sql, 1);
+            else conn->executeAsyncPrepared(sql, params);
+            return std::make_shared<AsyncResultSet>(pgis_ctxt, pool, conn, sql, params);
         }
         else
         {
             // create asyncresult  with  null connection
-            std::shared_ptr<AsyncResultSet> res = std::make_shared<AsyncResultSet>(pgis_ctxt, pool,  conn, sql);
+            std::shared_ptr<AsyncResultSet> res = std::make_shared<AsyncResultSet>(pgis_ctxt, pool,  conn, sql, params);
             pgis_ctxt->add_request(res);
             return res;
         }
@@ -745,23 +845,35 @@ featureset_ptr postgis_datasource::features_with_context(query const& q,processo
     {
         shared_ptr<Connection> conn;
 
-        if ( asynchronous_request_ )
+        if ( pipeline_queries_ )
+        {
+            // spread the queries of all layers over up to max_async_connection connections
+            std::shared_ptr<postgis_processor_context> pgis_ctxt = std::static_pointer_cast<postgis_processor_context>(proc_ctx);
+            conn = pgis_ctxt->pipeline_connection(pool, creator_.id(), max_async_connections_);
+            if (!conn)
+            {
+                throw mapnik::datasource_exception("Postgis Plugin: Null connection (connection pool exhausted)");
+            }
+        }
+        else if ( asynchronous_request_ )
         {
             // limit use to num_async_request_ => if reached don't borrow the last connexion object
             std::shared_ptr<postgis_processor_context> pgis_ctxt = std::static_pointer_cast<postgis_processor_context>(proc_ctx);
             if ( pgis_ctxt->num_async_requests_ < max_async_connections_ )
             {
-                conn = pool->borrowObject();
+                // do not wait: without a connection the request is queued on the context
+                conn = pool->borrowObject(std::chrono::milliseconds(0));
                 pgis_ctxt->num_async_requests_++;
             }
         }
         else
         {
-            // Always get a connection in synchronous mode
+            // Always get a connection in synchronous mode, waiting
+            // up to pool_wait_timeout for one when the pool is exhausted
             conn = pool->borrowObject();
             if(!conn )
             {
-                throw mapnik::datasource_exception("Postgis Plugin: Null connection");
+                throw mapnik::datasource_exception("Postgis Plugin: Null connection (connection pool exhausted)");
             }
         }
 
@@ -789,27 +901,65 @@ featureset_ptr postgis_datasource::features_with_context(query const& q,processo
         }
 
         std::ostringstream s;
+        // tile dependent values bound to the cached prepared statement
+        std::vector<std::string> params;
+        std::vector<std::string> * stmt_params = prepared_statements_ ? &params : nullptr;
 
         const double px_gw = 1.0 / std::get<0>(q.resolution());
         const double px_gh = 1.0 / std::get<1>(q.resolution());
 
-        s << "SELECT ST_AsBinary(";
+        // size of one pixel in map units
+        const double px_sz = std::min(px_gw, px_gh);
+        // TWKB output always goes through the pixel based reduction
+        const bool reduce_geometries = simplify_geometries_ || twkb_encoding_;
 
-        if (simplify_geometries_) {
-          s << "ST_Simplify(";
-        }
+        std::ostringstream g;
+        g << "\"" << geometryColumn_ << "\"";
+
+        if (reduce_geometries)
+        {
+            // snap vertices to a fraction of the pixel grid first, this is
+            // cheap and collapses runs of vertices falling into the same spot
+            if (simplify_snap_ratio_ > 0.0)
+            {
+                std::string snapped = g.str();
+                g.str("");
+                g << "ST_SnapToGrid(" << snapped << ", " << px_sz * simplify_snap_ratio_ << ")";
+            }
 
-        s << "\"" << geometryColumn_ << "\"";
+            // 1/20 of pixel (the default simplify_dp_ratio) seems to be a good
+            // compromise to avoid drop of collapsed polygons.
+            // See https://github.com/mapnik/mapnik/issues/1639
+            if (simplify_dp_ratio_ > 0.0)
+            {
+                std::string simplified = g.str();
+                g.str("");
+                g << (simplify_dp_preserve_ ? "ST_SimplifyPreserveTopology(" : "ST_Simplify(")
+                  << simplified << ", " << px_sz * simplify_dp_ratio_ << ")";
+            }
 
-        if (simplify_geometries_) {
-          // 1/20 of pixel seems to be a good compromise to avoid
-          // drop of collapsed polygons.
-          // See https://github.com/mapnik/mapnik/issues/1639
-          const double tolerance = std::min(px_gw, px_gh) / 20.0;
-          s << ", " << tolerance << ")";
+            // clip to the (buffered) query extent at low zoom levels, where single
+            // features such as coastlines extend far outside of the rendered area
+            if (simplify_clip_resolution_ > 0.0 && px_sz >= simplify_clip_resolution_)
+            {
+                std::string clipped = g.str();
+                g.str("");
+                g << "ST_ClipByBox2D(" << clipped << ", " << sql_bbox(box, stmt_params) << ")";
+            }
         }
 
-        s << ") AS geom";
+        if (twkb_encoding_)
+        {
+            // number of decimal digits which still resolves a tenth of a pixel,
+            // TWKB can store precisions in the range [-8,7]
+            long twkb_precision = -1 * std::lround(std::log10(px_sz) + twkb_rounding_adjustment_) + 1;
+            twkb_precision = std::max(-8L, std::min(7L, twkb_precision));
+            s << "SELECT ST_AsTWKB(" << g.str() << ", " << twkb_precision << ") AS geom";
+        }
+        else
+        {
+            s << "SELECT ST_AsBinary(" << g.str() << ") AS geom";
+        }
 
         mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
         std::set<std::string> const& props = q.property_names();
@@ -839,7 +989,7 @@ featureset_ptr postgis_datasource::features_with_context(query const& q,processo
             }
         }
 
-        std::string table_with_bbox = populate_tokens(table_, scale_denom, box, px_gw, px_gh, q.variables());
+        std::string table_with_bbox = populate_tokens(table_, scale_denom, box, px_gw, px_gh, q.variables(), stmt_params);
 
         s << " FROM " << table_with_bbox;
 
@@ -848,8 +998,8 @@ featureset_ptr postgis_datasource::features_with_context(query const& q,processo
             s << " LIMIT " << row_limit_;
         }
 
-        std::shared_ptr<IResultSet> rs = get_resultset(conn, s.str(), pool, proc_ctx);
-        return std::make_shared<postgis_featureset>(rs, ctx, desc_.get_encoding(), !key_field_.empty());
+        std::shared_ptr<IResultSet> rs = get_resultset(conn, s.str(), pool, proc_ctx, params);
+        return std::make_shared<postgis_featureset>(rs, ctx, desc_.get_encoding(), !key_field_.empty(), twkb_encoding_);
 
     }
 
@@ -78,15 +78,21 @@ public:
     layer_descriptor get_descriptor() const;
 
 private:
+    std::string box3d_text(box2d<double> const& env) const;
     std::string sql_bbox(box2d<double> const& env) const;
+    std::string sql_bbox(box2d<double> const& env, std::vector<std::string> * params) const;
+    std::string sql_param(double value, std::vector<std::string> * params) const;
     std::string populate_tokens(std::string const& sql,
                                 double scale_denom,
                                 box2d<double> const& env,
                                 double pixel_width,
                                 double pixel_height,
-                                mapnik::attributes const& vars) const;
+                                mapnik::attributes const& vars,
+                                std::vector<std::string> * params = nullptr) const;
     std::string populate_tokens(std::string const& sql) const;
-    std::shared_ptr<IResultSet> get_resultset(std::shared_ptr<Connection> &conn, std::string const& sql, CnxPool_ptr const& pool, processor_context_ptr ctx= processor_context_ptr()) const;
+    std::shared_ptr<IResultSet> get_resultset(std::shared_ptr<Connection> &conn, std::string const& sql, CnxPool_ptr const& pool,
+                                              processor_context_ptr ctx= processor_context_ptr(),
+                                              std::vector<std::string> const& params = std::vector<std::string>()) const;
     static const std::string GEOMETRY_COLUMNS;
     static const std::string SPATIAL_REF_SYS;
     static const double FMAX;
@@ -107,6 +113,12 @@ private:
     mutable bool extent_initialized_;
     mutable mapnik::box2d<double> extent_;
     bool simplify_geometries_;
+    bool twkb_encoding_;
+    double twkb_rounding_adjustment_;
+    double simplify_snap_ratio_;
+    double simplify_dp_ratio_;
+    bool simplify_dp_preserve_;
+    double simplify_clip_resolution_;
     layer_descriptor desc_;
     ConnectionCreator<Connection> creator_;
     const std::string bbox_token_;
@@ -114,11 +126,15 @@ private:
     const std::string pixel_width_token_;
     const std::string pixel_height_token_;
     int pool_max_size_;
+    int pool_wait_timeout_;
+    int pool_idle_timeout_;
     bool persist_connection_;
     bool extent_from_subquery_;
     bool estimate_extent_;
     int max_async_connections_;
     bool asynchronous_request_;
+    bool prepared_statements_;
+    bool pipeline_queries_;
     boost::regex pattern_;
     int intersect_min_scale_;
     int intersect_max_scale_;
@@ -40,6 +40,7 @@
 #include <sstream>
 #include <string>
 #include <memory>
+#include <algorithm>
 
 using mapnik::byte;
 using mapnik::geometry_utils;
@@ -49,27 +50,43 @@ using mapnik::context_ptr;
 postgis_featureset::postgis_featureset(std::shared_ptr<IResultSet> const& rs,
                                        context_ptr const& ctx,
                                        std::string const& encoding,
-                                       bool key_field)
+                                       bool key_field,
+                                       bool twkb_encoding)
     : rs_(rs),
       ctx_(ctx),
       tr_(new transcoder(encoding)),
       totalGeomSize_(0),
       feature_id_(1),
-      key_field_(key_field)
+      key_field_(key_field),
+      twkb_encoding_(twkb_encoding)
 {
 }
 
+void postgis_featureset::init_columns()
+{
+    unsigned num_attrs = ctx_->size() + 1;
+    names_.reserve(num_attrs);
+    oids_.reserve(num_attrs);
+    for (unsigned pos = 0; pos < num_attrs; ++pos)
+    {
+        names_.emplace_back(rs_->getFieldName(pos));
+        oids_.push_back(rs_->getTypeOID(pos));
+    }
+}
+
 feature_ptr postgis_featureset::next()
 {
     while (rs_->next())
     {
+        if (names_.empty()) init_columns();
+
         // new feature
         unsigned pos = 1;
         feature_ptr feature;
 
         if (key_field_)
         {
-            std::string name = rs_->getFieldName(pos);
+            std::string const& name = names_[pos];
 
             // null feature id is not acceptable
             if (rs_->isNull(pos))
@@ -78,7 +95,7 @@ feature_ptr postgis_featureset::next()
                 continue;
             }
             // create feature with user driven id from attribute
-            int oid = rs_->getTypeOID(pos);
+            int oid = oids_[pos];
             const char* buf = rs_->getValue(pos);
 
             // validation happens of this type at initialization
@@ -122,21 +139,23 @@ feature_ptr postgis_featureset::next()
         int size = rs_->getFieldLength(0);
         const char *data = rs_->getValue(0);
 
-        mapnik::geometry::geometry<double> geometry = geometry_utils::from_wkb(data, size);
+        mapnik::geometry::geometry<double> geometry = twkb_encoding_ ?
+            geometry_utils::from_twkb(data, size) :
+            geometry_utils::from_wkb(data, size);
         feature->set_geometry(std::move(geometry));
 
         totalGeomSize_ += size;
-        unsigned num_attrs = ctx_->size() + 1;
+        unsigned num_attrs = names_.size();
         for (; pos < num_attrs; ++pos)
         {
-            std::string name = rs_->getFieldName(pos);
+            std::string const& name = names_[pos];
 
             // NOTE: we intentionally do not store null here
             // since it is equivalent to the attribute not existing
             if (!rs_->isNull(pos))
             {
                 const char* buf = rs_->getValue(pos);
-                const int oid = rs_->getTypeOID(pos);
+                const int oid = oids_[pos];
                 switch (oid)
                 {
                     case 16: //bool
@@ -183,22 +202,24 @@ feature_ptr postgis_featureset::next()
                     case 1043: //varchar
                     case 705:  //literal
                     {
-                        feature->put(name, tr_->transcode(buf));
+                        feature->put(name, tr_->transcode(buf, rs_->getFieldLength(pos)));
                         break;
                     }
 
                     case 1042: //bpchar
                     {
-                        std::string str = mapnik::util::trim_copy(buf);
-                        feature->put(name, tr_->transcode(str.c_str()));
+                        // trim blank padding in place rather than on a copy
+                        const char* end = buf + rs_->getFieldLength(pos);
+                        const char* begin = std::find_if(buf, end, mapnik::util::not_whitespace);
+                        while (end > begin && !mapnik::util::not_whitespace(*(end - 1))) --end;
+                        feature->put(name, tr_->transcode(begin, static_cast<std::int32_t>(end - begin)));
                         break;
                     }
 
                     case 1700: //numeric
                     {
                         double val;
-                        std::string str = numeric2string(buf);
-                        if (mapnik::util::string2double(str, val))
+                        if (numeric2double(buf, val))
                         {
                             feature->put(name, val);
                         }
@@ -29,6 +29,10 @@
 #include <mapnik/feature.hpp>
 #include <mapnik/unicode.hpp>
 
+// stl
+#include <string>
+#include <vector>
+
 using mapnik::Featureset;
 using mapnik::box2d;
 using mapnik::feature_ptr;
@@ -43,17 +47,25 @@ public:
     postgis_featureset(std::shared_ptr<IResultSet> const& rs,
                        context_ptr const& ctx,
                        std::string const& encoding,
-                       bool key_field = false);
+                       bool key_field = false,
+                       bool twkb_encoding = false);
     feature_ptr next();
     ~postgis_featureset();
 
 private:
+    void init_columns();
+
     std::shared_ptr<IResultSet> rs_;
     context_ptr ctx_;
     const std::unique_ptr<mapnik::transcoder> tr_;
     unsigned totalGeomSize_;
     mapnik::value_integer feature_id_;
     bool key_field_;
+    bool twkb_encoding_;
+    // column names and type oids are constant for the whole result,
+    // so they are looked up once instead of for every row
+    std::vector<std::string> names_;
+    std::vector<int> oids_;
 };
 
 #endif // POSTGIS_FEATURESET_HPP
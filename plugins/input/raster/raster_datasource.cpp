@@ -33,6 +33,10 @@
 #include "raster_featureset.hpp"
 #include "raster_info.hpp"
 #include "raster_datasource.hpp"
+#include "raster_tile_cache.hpp"
+
+// stl
+#include <thread>
 
 using mapnik::layer_descriptor;
 using mapnik::featureset_ptr;
@@ -48,7 +52,9 @@ DATASOURCE_PLUGIN(raster_datasource)
 raster_datasource::raster_datasource(parameters const& params)
   : datasource(params),
     desc_(raster_datasource::name(), "utf-8"),
-    extent_initialized_(false)
+    extent_initialized_(false),
+    tile_cache_(),
+    jobs_(1)
 {
     MAPNIK_LOG_DEBUG(raster) << "raster_datasource: Initializing...";
 
@@ -117,6 +123,12 @@ raster_datasource::raster_datasource(parameters const& params)
 
         width_ = x_width.get() * tile_size_;
         height_ = y_width.get() * tile_size_;
+
+        // tile_cache_size is in MB
+        mapnik::value_integer cache_size = *params.get<mapnik::value_integer>("tile_cache_size", 64);
+        tile_cache_ = std::make_shared<raster_tile_cache>(cache_size > 0 ? static_cast<std::size_t>(cache_size) << 20 : 0);
+        mapnik::value_integer jobs = *params.get<mapnik::value_integer>("jobs", std::thread::hardware_concurrency());
+        jobs_ = jobs > 1 ? static_cast<unsigned>(jobs) : 1;
     }
     else
     {
@@ -198,7 +210,7 @@ featureset_ptr raster_datasource::features(query const& q) const
 
         tiled_multi_file_policy policy(filename_, format_, tile_size_, extent_, q.get_bbox(), width_, height_, tile_stride_);
 
-        return std::make_shared<raster_featureset<tiled_multi_file_policy> >(policy, extent_, q);
+        return std::make_shared<raster_featureset<tiled_multi_file_policy> >(policy, extent_, q, tile_cache_, jobs_);
     }
     else if (width * height > static_cast<int>(tile_size_ * tile_size_ << 2))
     {
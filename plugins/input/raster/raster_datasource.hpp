@@ -39,6 +39,9 @@
 // stl
 #include <vector>
 #include <string>
+#include <memory>
+
+class raster_tile_cache;
 
 
 class raster_datasource : public mapnik::datasource
@@ -66,6 +69,9 @@ private:
     unsigned tile_stride_;
     unsigned width_;
     unsigned height_;
+    // decoded tiles of multi tiled rasters
+    std::shared_ptr<raster_tile_cache> tile_cache_;
+    unsigned jobs_;
 };
 
 #endif // RASTER_DATASOURCE_HPP
@@ -29,6 +29,7 @@
 #include <mapnik/image_util.hpp>
 #include <mapnik/feature_factory.hpp>
 #include <mapnik/util/variant.hpp>
+#include <mapnik/util/parallel.hpp>
 
 // boost
 #pragma GCC diagnostic push
@@ -40,6 +41,9 @@
 
 #include "raster_featureset.hpp"
 
+// stl
+#include <algorithm>
+
 using mapnik::query;
 using mapnik::image_reader;
 using mapnik::feature_ptr;
@@ -50,14 +54,21 @@ using mapnik::feature_factory;
 template <typename LookupPolicy>
 raster_featureset<LookupPolicy>::raster_featureset(LookupPolicy const& policy,
                                                    box2d<double> const& extent,
-                                                   query const& q)
+                                                   query const& q,
+                                                   std::shared_ptr<raster_tile_cache> const& cache,
+                                                   unsigned jobs)
     : policy_(policy),
       feature_id_(1),
       ctx_(std::make_shared<mapnik::context_type>()),
       extent_(extent),
       bbox_(q.get_bbox()),
+      resolution_(std::get<0>(q.resolution())),
       curIter_(policy_.begin()),
-      endIter_(policy_.end())
+      endIter_(policy_.end()),
+      cache_(cache),
+      jobs_(jobs),
+      rasters_(),
+      index_(0)
 {
 }
 
@@ -72,72 +83,152 @@ feature_ptr raster_featureset<LookupPolicy>::next()
     if (curIter_ != endIter_)
     {
         feature_ptr feature(feature_factory::create(ctx_,feature_id_++));
-
-        try
+        mapnik::raster_ptr raster;
+        if (jobs_ > 1)
         {
-            std::unique_ptr<image_reader> reader(mapnik::get_image_reader(curIter_->file(),curIter_->format()));
-
-            MAPNIK_LOG_DEBUG(raster) << "raster_featureset: Reader=" << curIter_->format() << "," << curIter_->file()
-                                     << ",size(" << curIter_->width() << "," << curIter_->height() << ")";
+            if (index_ == 0) read_all();
+            raster = rasters_[index_++];
+        }
+        else
+        {
+            raster = read_raster(*curIter_);
+        }
+        if (raster) feature->set_raster(raster);
+        ++curIter_;
+        return feature;
+    }
+    return feature_ptr();
+}
 
-            if (reader.get())
+template <typename LookupPolicy>
+void raster_featureset<LookupPolicy>::read_all()
+{
+    std::vector<raster_info const*> infos;
+    for (iterator_type itr = curIter_; itr != endIter_; ++itr)
+    {
+        infos.push_back(&(*itr));
+    }
+    rasters_.resize(infos.size());
+    // also bounded by the threads left under mapnik::util::parallel_threads()
+    mapnik::util::parallel_for(infos.size(), 1, [&](std::size_t first, std::size_t last) {
+            for (std::size_t i = first; i < last; ++i)
             {
-                int image_width = policy_.img_width(reader->width());
-                int image_height = policy_.img_height(reader->height());
-
-                if (image_width > 0 && image_height > 0)
-                {
-                    mapnik::view_transform t(image_width, image_height, extent_, 0, 0);
-                    box2d<double> intersect = bbox_.intersect(curIter_->envelope());
-                    box2d<double> ext = t.forward(intersect);
-                    box2d<double> rem = policy_.transform(ext);
-                    if (ext.width() > 0.5 && ext.height() > 0.5 )
-                    {
-                        // select minimum raster containing whole ext
-                        int x_off = static_cast<int>(std::floor(ext.minx()));
-                        int y_off = static_cast<int>(std::floor(ext.miny()));
-                        int end_x = static_cast<int>(std::ceil(ext.maxx()));
-                        int end_y = static_cast<int>(std::ceil(ext.maxy()));
-
-                        // clip to available data
-                        if (x_off < 0) x_off = 0;
-                        if (y_off < 0) y_off = 0;
-                        if (end_x > image_width)  end_x = image_width;
-                        if (end_y > image_height) end_y = image_height;
-
-                        int width = end_x - x_off;
-                        int height = end_y - y_off;
-
-                        // calculate actual box2d of returned raster
-                        box2d<double> feature_raster_extent(rem.minx() + x_off,
-                                                            rem.miny() + y_off,
-                                                            rem.maxx() + x_off + width,
-                                                            rem.maxy() + y_off + height);
-                        intersect = t.backward(feature_raster_extent);
-                        mapnik::image_any data = reader->read(x_off, y_off, width, height);
-                        mapnik::raster_ptr raster = std::make_shared<mapnik::raster>(intersect, std::move(data), 1.0);
-                        feature->set_raster(raster);
-                    }
-                }
+                rasters_[i] = read_raster(*infos[i]);
             }
-        }
-        catch (mapnik::image_reader_exception const& ex)
+        }, jobs_);
+    MAPNIK_LOG_DEBUG(raster) << "raster_featureset: Read " << infos.size() << " rasters with up to " << jobs_ << " jobs";
+}
+
+template <typename LookupPolicy>
+mapnik::raster_ptr raster_featureset<LookupPolicy>::read_raster(raster_info const& info) const
+{
+    try
+    {
+        std::unique_ptr<image_reader> reader;
+        int image_width = 0;
+        int image_height = 0;
+        if (cache_)
         {
-            MAPNIK_LOG_ERROR(raster) << "Raster Plugin: image reader exception caught: " << ex.what();
+            // the reader is only needed on a cache miss
+            image_width = policy_.img_width(0);
+            image_height = policy_.img_height(0);
         }
-        catch (std::exception const& ex)
+        else
         {
-            MAPNIK_LOG_ERROR(raster) << "Raster Plugin: " << ex.what();
+            reader.reset(mapnik::get_image_reader(info.file(),info.format()));
+
+            MAPNIK_LOG_DEBUG(raster) << "raster_featureset: Reader=" << info.format() << "," << info.file()
+                                     << ",size(" << info.width() << "," << info.height() << ")";
+
+            if (!reader) return mapnik::raster_ptr();
+            image_width = policy_.img_width(reader->width());
+            image_height = policy_.img_height(reader->height());
         }
-        catch (...)
+
+        if (image_width > 0 && image_height > 0)
         {
-            MAPNIK_LOG_ERROR(raster) << "Raster Plugin: exception caught";
-        }
+            mapnik::view_transform t(image_width, image_height, extent_, 0, 0);
+            box2d<double> intersect = bbox_.intersect(info.envelope());
+            box2d<double> ext = t.forward(intersect);
+            box2d<double> rem = policy_.transform(ext);
+            if (ext.width() > 0.5 && ext.height() > 0.5 )
+            {
+                // select minimum raster containing whole ext
+                int x_off = static_cast<int>(std::floor(ext.minx()));
+                int y_off = static_cast<int>(std::floor(ext.miny()));
+                int end_x = static_cast<int>(std::ceil(ext.maxx()));
+                int end_y = static_cast<int>(std::ceil(ext.maxy()));
+
+                // clip to available data
+                if (x_off < 0) x_off = 0;
+                if (y_off < 0) y_off = 0;
+                if (end_x > image_width)  end_x = image_width;
+                if (end_y > image_height) end_y = image_height;
+
+                int width = end_x - x_off;
+                int height = end_y - y_off;
+
+                // calculate actual box2d of returned raster
+                box2d<double> feature_raster_extent(rem.minx() + x_off,
+                                                    rem.miny() + y_off,
+                                                    rem.maxx() + x_off + width,
+                                                    rem.maxy() + y_off + height);
+                intersect = t.backward(feature_raster_extent);
+                if (cache_)
+                {
+                    raster_tile_cache::image_ptr image = cache_->get(info.file(), x_off, y_off, width, height, [&]() {
+                        std::unique_ptr<image_reader> tile_reader(mapnik::get_image_reader(info.file(),info.format()));
 
-        ++curIter_;
-        return feature;
+                        MAPNIK_LOG_DEBUG(raster) << "raster_featureset: Reader=" << info.format() << "," << info.file()
+                                                 << ",size(" << info.width() << "," << info.height() << ")";
+
+                        if (!tile_reader) return mapnik::image_any();
+                        return tile_reader->read(x_off, y_off, width, height);
+                    });
+                    if (image->is<mapnik::image_null>()) return mapnik::raster_ptr();
+                    return std::make_shared<mapnik::raster>(intersect, mapnik::image_any(*image), 1.0);
+                }
+                // overviews are only used when the image is the whole raster
+                // rather than one tile of a larger one (tiled_multi_file_policy)
+                unsigned level = 0;
+                if (resolution_ > 0 && image_width == int(reader->width()) && image_height == int(reader->height()))
+                {
+                    level = reader->overview_for_scale(t.scale_x() / resolution_);
+                }
+                if (level > 0)
+                {
+                    // the window snapped to the pixels of the overview
+                    double fx = static_cast<double>(image_width) / reader->overview_width(level);
+                    double fy = static_cast<double>(image_height) / reader->overview_height(level);
+                    int level_x = static_cast<int>(std::floor(x_off / fx));
+                    int level_y = static_cast<int>(std::floor(y_off / fy));
+                    int level_end_x = std::min(static_cast<int>(std::ceil(end_x / fx)), static_cast<int>(reader->overview_width(level)));
+                    int level_end_y = std::min(static_cast<int>(std::ceil(end_y / fy)), static_cast<int>(reader->overview_height(level)));
+                    MAPNIK_LOG_DEBUG(raster) << "raster_featureset: Overview=" << level << ",size("
+                                             << reader->overview_width(level) << "," << reader->overview_height(level) << ")";
+                    intersect = t.backward(box2d<double>(level_x * fx, level_y * fy, level_end_x * fx, level_end_y * fy));
+                    mapnik::image_any data = reader->read_overview(level, level_x, level_y,
+                                                                   level_end_x - level_x, level_end_y - level_y);
+                    return std::make_shared<mapnik::raster>(intersect, std::move(data), 1.0);
+                }
+                mapnik::image_any data = reader->read(x_off, y_off, width, height);
+                return std::make_shared<mapnik::raster>(intersect, std::move(data), 1.0);
+            }
+        }
     }
-    return feature_ptr();
+    catch (mapnik::image_reader_exception const& ex)
+    {
+        MAPNIK_LOG_ERROR(raster) << "Raster Plugin: image reader exception caught: " << ex.what();
+    }
+    catch (std::exception const& ex)
+    {
+        MAPNIK_LOG_ERROR(raster) << "Raster Plugin: " << ex.what();
+    }
+    catch (...)
+    {
+        MAPNIK_LOG_ERROR(raster) << "Raster Plugin: exception caught";
+    }
+    return mapnik::raster_ptr();
 }
 
 std::string tiled_multi_file_policy::interpolate(std::string const& pattern, int x, int y) const
@@ -25,13 +25,16 @@
 
 #include "raster_datasource.hpp"
 #include "raster_info.hpp"
+#include "raster_tile_cache.hpp"
 
 // mapnik
 #include <mapnik/feature.hpp>
 #include <mapnik/debug.hpp>
+#include <mapnik/raster.hpp>
 
 // stl
 #include <vector>
+#include <memory>
 
 // boost
 #include <boost/utility.hpp>
@@ -307,20 +310,34 @@ class raster_featureset : public mapnik::Featureset
     using iterator_type = typename LookupPolicy::const_iterator;
 
 public:
+    // With a `cache` the image size must not depend on the reader (see
+    // tiled_multi_file_policy); with `jobs` > 1 all the rasters are read
+    // on the first call to next(), by up to that many threads (see
+    // mapnik::util::parallel_for)
     raster_featureset(LookupPolicy const& policy,
                       box2d<double> const& exttent,
-                      mapnik::query const& q);
+                      mapnik::query const& q,
+                      std::shared_ptr<raster_tile_cache> const& cache = nullptr,
+                      unsigned jobs = 1);
     virtual ~raster_featureset();
     mapnik::feature_ptr next();
 
 private:
+    mapnik::raster_ptr read_raster(raster_info const& info) const;
+    void read_all();
+
     LookupPolicy policy_;
     mapnik::value_integer feature_id_;
     mapnik::context_ptr ctx_;
     mapnik::box2d<double> extent_;
     mapnik::box2d<double> bbox_;
+    double resolution_;
     iterator_type curIter_;
     iterator_type endIter_;
+    std::shared_ptr<raster_tile_cache> cache_;
+    unsigned jobs_;
+    std::vector<mapnik::raster_ptr> rasters_;
+    std::size_t index_;
 };
 
 #endif // RASTER_FEATURESET_HPP
@@ -0,0 +1,47 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2014 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#include "raster_tile_cache.hpp"
+
+// stl
+#include <sstream>
+
+raster_tile_cache::raster_tile_cache(std::size_t max_size)
+    : cache_(max_size) {}
+
+raster_tile_cache::image_ptr raster_tile_cache::get(std::string const& file,
+                                                    int x_off, int y_off, int width, int height,
+                                                    decoder_type const& decode) const
+{
+    std::ostringstream s;
+    s << file << '|' << x_off << ',' << y_off << ',' << width << ',' << height;
+    std::string key = s.str();
+    // decoded outside the lock, another thread may do the same meanwhile
+    return cache_.get(key,
+                      [&decode]() { return std::make_shared<const mapnik::image_any>(decode()); },
+                      [&key](mapnik::image_any const& image) { return sizeof(mapnik::image_any) + key.size() + image.getSize(); });
+}
+
+std::size_t raster_tile_cache::size() const
+{
+    return cache_.size();
+}
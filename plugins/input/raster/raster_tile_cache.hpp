@@ -0,0 +1,58 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2014 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef RASTER_TILE_CACHE_HPP
+#define RASTER_TILE_CACHE_HPP
+
+// mapnik
+#include <mapnik/image_any.hpp>
+#include <mapnik/util/lru_cache.hpp>
+#include <mapnik/util/noncopyable.hpp>
+
+// stl
+#include <string>
+#include <memory>
+#include <functional>
+
+// Decoded windows of source tiles, keyed by file and window, kept in a least
+// recently used cache of up to `max_size` bytes (0 disables it). It is shared
+// by all the featuresets of a datasource, so neighbouring map tiles which need
+// the same source tile only decode it once.
+class raster_tile_cache : private mapnik::util::noncopyable
+{
+public:
+    using image_ptr = std::shared_ptr<const mapnik::image_any>;
+    using decoder_type = std::function<mapnik::image_any()>;
+
+    explicit raster_tile_cache(std::size_t max_size);
+
+    // the image of the window, from `decode` if it is not cached
+    image_ptr get(std::string const& file, int x_off, int y_off, int width, int height,
+                  decoder_type const& decode) const;
+
+    std::size_t size() const;
+
+private:
+    mutable mapnik::util::lru_cache<std::string, mapnik::image_any> cache_;
+};
+
+#endif // RASTER_TILE_CACHE_HPP
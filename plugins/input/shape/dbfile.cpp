@@ -40,16 +40,43 @@
 #pragma GCC diagnostic pop
 
 // stl
+#include <algorithm>
 #include <cstdint>
 #include <string>
 #include <cstring>
 #include <stdexcept>
 
+namespace {
+
+// amount of data read at once from unmapped files in batch mode
+const std::size_t batch_read_size = 65536;
+
+inline bool is_blank(char ch)
+{
+    return ch == ' ' || ch == '\n' || ch == '\r' || ch == '\t';
+}
+
+// narrows [begin, end) to the text value of a character field: the value
+// ends at the first NUL (some writers pad with NUL instead of blanks) and
+// surrounding whitespace is dropped, all without copying
+inline void trim_field(const char* & begin, const char* & end)
+{
+    const char* nul = static_cast<const char*>(std::memchr(begin, 0, end - begin));
+    if (nul) end = nul;
+    while (begin != end && is_blank(*begin)) ++begin;
+    while (end != begin && is_blank(*(end - 1))) --end;
+}
+
+}
+
 dbf_file::dbf_file()
     : num_records_(0),
       num_fields_(0),
       record_length_(0),
-      record_(0) {}
+      record_(nullptr),
+      buffer_first_(0),
+      buffer_count_(0),
+      batch_mode_(false) {}
 
 dbf_file::dbf_file(std::string const& file_name)
     :num_records_(0),
@@ -62,7 +89,10 @@ dbf_file::dbf_file(std::string const& file_name)
 #else
      file_(file_name.c_str() ,std::ios::in | std::ios::binary),
 #endif
-     record_(0)
+     record_(nullptr),
+     buffer_first_(0),
+     buffer_count_(0),
+     batch_mode_(false)
 {
 
 #ifdef SHAPE_MEMORY_MAPPED_FILE
@@ -84,10 +114,7 @@ dbf_file::dbf_file(std::string const& file_name)
 }
 
 
-dbf_file::~dbf_file()
-{
-    ::operator delete(record_);
-}
+dbf_file::~dbf_file() {}
 
 
 bool dbf_file::is_open()
@@ -111,20 +138,64 @@ int dbf_file::num_fields() const
 }
 
 
+std::size_t dbf_file::record_offset(int index) const
+{
+    // header, field descriptors, terminator and the deletion flag of the record
+    return (num_fields_<<5) + 34 + static_cast<std::size_t>(index - 1) * (record_length_ + 1);
+}
+
 void dbf_file::move_to(int index)
 {
-    if (index>0 && index<=num_records_)
+    record_ = nullptr;
+    if (index>0 && index<=num_records_ && record_length_>0)
     {
-        std::streampos pos=(num_fields_<<5)+34+(index-1)*(record_length_+1);
-        file_.seekg(pos,std::ios::beg);
-        file_.read(record_,record_length_);
+#ifdef SHAPE_MEMORY_MAPPED_FILE
+        // decode straight from the mapped file, no copy
+        std::size_t pos = record_offset(index);
+        if (pos + record_length_ <= file_.buffer().second)
+        {
+            record_ = file_.buffer().first + pos;
+        }
+#else
+        if (index < buffer_first_ || index >= buffer_first_ + buffer_count_)
+        {
+            read_records(index);
+        }
+        if (index >= buffer_first_ && index < buffer_first_ + buffer_count_)
+        {
+            record_ = buffer_.data() + (index - buffer_first_) * (record_length_ + 1);
+        }
+#endif
+    }
+}
+
+void dbf_file::set_batch_mode(bool batch_mode)
+{
+    batch_mode_ = batch_mode;
+}
+
+void dbf_file::read_records(int index)
+{
+    std::size_t stride = record_length_ + 1;
+    int count = 1;
+    if (batch_mode_)
+    {
+        count = std::max(1, static_cast<int>(batch_read_size / stride));
+        count = std::min(count, num_records_ - index + 1);
     }
+    // records are separated by the deletion flag of the next one
+    buffer_.resize((count - 1) * stride + record_length_);
+    file_.clear();
+    file_.seekg(record_offset(index), std::ios::beg);
+    file_.read(buffer_.data(), buffer_.size());
+    buffer_first_ = index;
+    buffer_count_ = static_cast<int>((file_.gcount() + 1) / stride);
 }
 
 
 std::string dbf_file::string_value(int col) const
 {
-    if (col>=0 && col<num_fields_)
+    if (record_ && col>=0 && col<num_fields_)
     {
         return std::string(record_+fields_[col].offset_,fields_[col].length_);
     }
@@ -143,7 +214,7 @@ void dbf_file::add_attribute(int col, mapnik::transcoder const& tr, mapnik::feat
 {
     using namespace boost::spirit;
 
-    if (col>=0 && col<num_fields_)
+    if (record_ && col>=0 && col<num_fields_)
     {
         std::string const& name=fields_[col].name_;
 
@@ -153,10 +224,10 @@ void dbf_file::add_attribute(int col, mapnik::transcoder const& tr, mapnik::feat
         case 'C':
         case 'D':
         {
-            // FIXME - avoid constructing std::string on stack
-            std::string str(record_+fields_[col].offset_,fields_[col].length_);
-            mapnik::util::trim(str);
-            f.put(name,tr.transcode(str.c_str()));
+            const char *itr = record_+fields_[col].offset_;
+            const char *end = itr + fields_[col].length_;
+            trim_field(itr, end);
+            f.put(name,tr.transcode(itr, static_cast<std::int32_t>(end - itr)));
             break;
         }
         case 'L':
@@ -202,7 +273,8 @@ void dbf_file::add_attribute(int col, mapnik::transcoder const& tr, mapnik::feat
                 const char *itr = record_+fields_[col].offset_;
                 const char *end = itr + fields_[col].length_;
                 ascii::space_type space;
-                qi::int_type int_;
+                // wide numeric fields do not fit into int
+                qi::int_parser<mapnik::value_integer> int_;
                 if (qi::phrase_parse(itr,end,int_,space,val))
                 {
                     f.put(name,val);
@@ -214,6 +286,17 @@ void dbf_file::add_attribute(int col, mapnik::transcoder const& tr, mapnik::feat
     }
 }
 
+void dbf_file::add_attributes(std::vector<int> const& cols, mapnik::transcoder const& tr, mapnik::feature_impl & f) const throw()
+{
+    if (record_)
+    {
+        for (int col : cols)
+        {
+            add_attribute(col, tr, f);
+        }
+    }
+}
+
 void dbf_file::read_header()
 {
     char c=file_.get();
@@ -249,10 +332,6 @@ void dbf_file::read_header()
             fields_.push_back(desc);
         }
         record_length_=offset;
-        if (record_length_>0)
-        {
-            record_=static_cast<char*>(::operator new (sizeof(char)*record_length_));
-        }
     }
 }
 
@@ -65,7 +65,13 @@ private:
 #else
     std::ifstream file_;
 #endif
-    char* record_;
+    // current record, points into the mapped file or into buffer_
+    const char* record_;
+    // window of consecutive records read from the file (unmapped files only)
+    std::vector<char> buffer_;
+    int buffer_first_;
+    int buffer_count_;
+    bool batch_mode_;
 public:
     dbf_file();
     dbf_file(std::string const& file_name);
@@ -75,9 +81,16 @@ public:
     int num_fields() const;
     field_descriptor const& descriptor(int col) const;
     void move_to(int index);
+    // when enabled, records are expected to be visited in file order and
+    // unmapped files are read in blocks of records instead of one by one
+    void set_batch_mode(bool batch_mode);
     std::string string_value(int col) const;
     void add_attribute(int col, mapnik::transcoder const& tr, mapnik::feature_impl & f) const throw();
+    // decodes only the given columns of the current record
+    void add_attributes(std::vector<int> const& cols, mapnik::transcoder const& tr, mapnik::feature_impl & f) const throw();
 private:
+    std::size_t record_offset(int index) const;
+    void read_records(int index);
     void read_header();
     int read_short();
     int read_int();
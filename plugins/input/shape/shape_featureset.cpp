@@ -55,6 +55,8 @@ shape_featureset<filterT>::shape_featureset(filterT const& filter,
 {
     shape_.shp().skip(100);
     setup_attributes(ctx_, attribute_names, shape_name, shape_,attr_ids_);
+    // records are visited in file order
+    shape_.dbf().set_batch_mode(true);
 }
 
 template <typename filterT>
@@ -98,11 +100,9 @@ feature_ptr shape_featureset<filterT>::next()
             if (!filter_.pass(feature_bbox_)) continue;
             int num_points = record.read_ndr_integer();
             mapnik::geometry::multi_point<double> multi_point;
-            for (int i = 0; i < num_points; ++i)
+            if (num_points > 0 && record.remains() >= 16L * num_points)
             {
-                double x = record.read_double();
-                double y = record.read_double();
-                multi_point.emplace_back(mapnik::geometry::point<double>(x, y));
+                record.read_points(multi_point, num_points);
             }
             feature->set_geometry(std::move(multi_point));
             break;
@@ -136,14 +136,9 @@ feature_ptr shape_featureset<filterT>::next()
         if (attr_ids_.size())
         {
             shape_.dbf().move_to(shape_.id_);
-            std::vector<int>::const_iterator itr = attr_ids_.begin();
-            std::vector<int>::const_iterator end = attr_ids_.end();
             try
             {
-                for (; itr != end; ++itr)
-                {
-                    shape_.dbf().add_attribute(*itr, *tr_, *feature); //TODO optimize!!!
-                }
+                shape_.dbf().add_attributes(attr_ids_, *tr_, *feature);
             }
             catch (...)
             {
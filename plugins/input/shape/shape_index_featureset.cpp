@@ -40,6 +40,7 @@
 #include "shape_index_featureset.hpp"
 #include "shape_utils.hpp"
 #include "shp_index.hpp"
+#include "shp_packed_index.hpp"
 
 using mapnik::feature_factory;
 
@@ -62,7 +63,11 @@ shape_index_featureset<filterT>::shape_index_featureset(filterT const& filter,
     setup_attributes(ctx_, attribute_names, shape_name, *shape_ptr_,attr_ids_);
 
     auto index = shape_ptr_->index();
-    if (index)
+    if (index && shape_ptr_->has_packed_index())
+    {
+        shp_packed_index<filterT>::query(filter, index->file(), offsets_);
+    }
+    else if (index)
     {
 #ifdef SHAPE_MEMORY_MAPPED_FILE
         //shp_index<filterT,stream<mapped_file_source> >::query(filter, index->file(), offsets_);
@@ -74,6 +79,14 @@ shape_index_featureset<filterT>::shape_index_featureset(filterT const& filter,
 
     std::sort(offsets_.begin(), offsets_.end());
 
+    if (shape_ptr_->is_sorted())
+    {
+        // records (and dbf rows) of a spatially sorted file come in runs,
+        // so read them in larger blocks instead of one by one
+        shape_ptr_->shp().set_read_ahead(16384);
+        shape_ptr_->dbf().set_batch_mode(true);
+    }
+
     MAPNIK_LOG_DEBUG(shape) << "shape_index_featureset: Query size=" << offsets_.size();
 
     itr_ = offsets_.begin();
@@ -114,11 +127,9 @@ feature_ptr shape_index_featureset<filterT>::next()
             if (!filter_.pass(feature_bbox_)) continue;
             int num_points = record.read_ndr_integer();
             mapnik::geometry::multi_point<double> multi_point;
-            for (int i = 0; i < num_points; ++i)
+            if (num_points > 0 && record.remains() >= 16L * num_points)
             {
-                double x = record.read_double();
-                double y = record.read_double();
-                multi_point.emplace_back(mapnik::geometry::point<double>(x, y));
+                record.read_points(multi_point, num_points);
             }
             feature->set_geometry(std::move(multi_point));
             break;
@@ -151,14 +162,9 @@ feature_ptr shape_index_featureset<filterT>::next()
         if (attr_ids_.size())
         {
             shape_ptr_->dbf().move_to(shape_ptr_->id_);
-            std::vector<int>::const_iterator itr = attr_ids_.begin();
-            std::vector<int>::const_iterator end = attr_ids_.end();
             try
             {
-                for (; itr!=end; ++itr)
-                {
-                    shape_ptr_->dbf().add_attribute(*itr, *tr_, *feature);
-                }
+                shape_ptr_->dbf().add_attributes(attr_ids_, *tr_, *feature);
             }
             catch (...)
             {
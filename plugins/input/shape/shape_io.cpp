@@ -21,22 +21,27 @@
  *****************************************************************************/
 
 #include "shape_io.hpp"
+#include "shp_packed_index.hpp"
 
 // mapnik
 #include <mapnik/debug.hpp>
 #include <mapnik/make_unique.hpp>
 #include <mapnik/datasource.hpp>
 #include <mapnik/util/is_clockwise.hpp>
+#include <mapnik/util/fs.hpp>
 
 using mapnik::datasource_exception;
 const std::string shape_io::SHP = ".shp";
 const std::string shape_io::DBF = ".dbf";
 const std::string shape_io::INDEX = ".index";
+const std::string shape_io::PACKED_INDEX = ".hrtree";
 
 shape_io::shape_io(std::string const& shape_name, bool open_index)
     : type_(shape_null),
       shp_(shape_name + SHP),
       dbf_(shape_name + DBF),
+      packed_index_(false),
+      sorted_(false),
       reclength_(0),
       id_(0)
 {
@@ -48,22 +53,59 @@ shape_io::shape_io(std::string const& shape_name, bool open_index)
 
     if (open_index)
     {
-        try
+        // prefer the packed Hilbert R-tree over the quadtree index
+        if (mapnik::util::exists(shape_name + PACKED_INDEX))
         {
-            index_ = std::make_unique<shape_file>(shape_name + INDEX);
+            try
+            {
+                index_ = std::make_unique<shape_file>(shape_name + PACKED_INDEX);
+                packed_index_ = check_packed_index(*index_, sorted_);
+                if (!packed_index_)
+                {
+                    MAPNIK_LOG_WARN(shape) << "shape_io: Invalid packed index=" << shape_name << PACKED_INDEX;
+                    index_.reset();
+                }
+            }
+            catch (...)
+            {
+                MAPNIK_LOG_WARN(shape) << "shape_io: Could not open index=" << shape_name << PACKED_INDEX;
+            }
         }
-        catch (...)
+        if (!index_)
         {
-            MAPNIK_LOG_WARN(shape) << "shape_io: Could not open index=" << shape_name << INDEX;
+            try
+            {
+                index_ = std::make_unique<shape_file>(shape_name + INDEX);
+            }
+            catch (...)
+            {
+                MAPNIK_LOG_WARN(shape) << "shape_io: Could not open index=" << shape_name << INDEX;
+            }
         }
     }
 }
 
 shape_io::~shape_io() {}
 
+bool shape_io::check_packed_index(shape_file & index, bool & sorted)
+{
+    sorted = false;
+    if (!index.is_open()) return false;
+    packed_index_header header;
+    index.file().seekg(0, std::ios::end);
+    std::size_t size = index.file().tellg();
+    index.file().seekg(0, std::ios::beg);
+    index.file().read(reinterpret_cast<char*>(&header), sizeof(header));
+    mapnik::util::packed_rtree_little_endian(header);
+    if (!index.file() || !packed_index_valid(header, size)) return false;
+    sorted = (header.flags & packed_index_sorted) != 0;
+    return true;
+}
+
 void shape_io::move_to(std::streampos pos)
 {
-    shp_.seek(pos);
+    // consecutive records need no seek, which would drop any buffered data
+    if (shp_.pos() != pos) shp_.seek(pos);
     id_ = shp_.read_xdr_integer();
     reclength_ = shp_.read_xdr_integer();
 }
@@ -93,49 +135,33 @@ mapnik::geometry::geometry<double> shape_io::read_polyline(shape_file::record_ty
     int num_parts = record.read_ndr_integer();
     int num_points = record.read_ndr_integer();
 
+    // skip corrupt records instead of reading past their end
+    if (num_parts <= 0 || num_points < 0 ||
+        record.remains() < 4L * num_parts + 16L * num_points)
+    {
+        return geom;
+    }
+    // part starts are read in place
+    size_t parts_pos = record.pos;
+    record.skip(4 * num_parts);
+
     if (num_parts == 1)
     {
         mapnik::geometry::line_string<double> line;
-        line.reserve(num_points);
-        record.skip(4);
-        for (int i = 0; i < num_points; ++i)
-        {
-            double x = record.read_double();
-            double y = record.read_double();
-            line.add_coord(x, y);
-        }
+        record.read_points(line, num_points);
         geom = std::move(line);
     }
     else
     {
-        std::vector<int> parts(num_parts);
-        for (int i = 0; i < num_parts; ++i)
-        {
-            parts[i] = record.read_ndr_integer();
-        }
-
-        int start, end;
         mapnik::geometry::multi_line_string<double> multi_line;
+        multi_line.reserve(num_parts);
         for (int k = 0; k < num_parts; ++k)
         {
-            start = parts[k];
-            if (k == num_parts - 1)
-            {
-                end = num_points;
-            }
-            else
-            {
-                end = parts[k + 1];
-            }
-
+            int start = record.ndr_integer_at(parts_pos + 4 * k);
+            int end = (k == num_parts - 1) ? num_points : record.ndr_integer_at(parts_pos + 4 * (k + 1));
+            if (start < 0 || end < start || end > num_points) return mapnik::geometry::geometry<double>();
             mapnik::geometry::line_string<double> line;
-            line.reserve(end - start);
-            for (int j = start; j < end; ++j)
-            {
-                double x = record.read_double();
-                double y = record.read_double();
-                line.add_coord(x, y);
-            }
+            record.read_points(line, end - start);
             multi_line.push_back(std::move(line));
         }
         geom = std::move(multi_line);
@@ -150,29 +176,25 @@ mapnik::geometry::geometry<double> shape_io::read_polygon(shape_file::record_typ
     int num_parts = record.read_ndr_integer();
     int num_points = record.read_ndr_integer();
 
-    std::vector<int> parts(num_parts);
-
-    for (int i = 0; i < num_parts; ++i)
+    // skip corrupt records instead of reading past their end
+    if (num_parts <= 0 || num_points < 0 ||
+        record.remains() < 4L * num_parts + 16L * num_points)
     {
-        parts[i] = record.read_ndr_integer();
+        return geom;
     }
+    // part starts are read in place
+    size_t parts_pos = record.pos;
+    record.skip(4 * num_parts);
 
     mapnik::geometry::multi_polygon<double> multi_poly;
     mapnik::geometry::polygon<double> poly;
     for (int k = 0; k < num_parts; ++k)
     {
-        int start = parts[k];
-        int end;
-        if (k == num_parts - 1) end = num_points;
-        else end = parts[k + 1];
+        int start = record.ndr_integer_at(parts_pos + 4 * k);
+        int end = (k == num_parts - 1) ? num_points : record.ndr_integer_at(parts_pos + 4 * (k + 1));
+        if (start < 0 || end < start || end > num_points) return mapnik::geometry::geometry<double>();
         mapnik::geometry::linear_ring<double> ring;
-        ring.reserve(end - start);
-        for (int j = start; j < end; ++j)
-        {
-            double x = record.read_double();
-            double y = record.read_double();
-            ring.emplace_back(x, y);
-        }
+        record.read_points(ring, end - start);
         if (k == 0)
         {
             poly.set_exterior_ring(std::move(ring));
@@ -74,7 +74,20 @@ public:
         return (index_ && index_->is_open());
     }
 
+    // true when index() is a packed Hilbert R-tree rather than the quadtree
+    inline bool has_packed_index() const
+    {
+        return packed_index_ && has_index();
+    }
+
+    // true when the records are stored in the order of the packed index (see shapesort)
+    inline bool is_sorted() const
+    {
+        return sorted_ && has_packed_index();
+    }
+
     void move_to(std::streampos pos);
+    static bool check_packed_index(shape_file & index, bool & sorted);
     static void read_bbox(shape_file::record_type & record, mapnik::box2d<double> & bbox);
     static mapnik::geometry::geometry<double> read_polyline(shape_file::record_type & record);
     static mapnik::geometry::geometry<double> read_polygon(shape_file::record_type & record);
@@ -83,6 +96,8 @@ public:
     shape_file shp_;
     dbf_file   dbf_;
     std::unique_ptr<shape_file> index_;
+    bool packed_index_;
+    bool sorted_;
     unsigned reclength_;
     unsigned id_;
     box2d<double> cur_extent_;
@@ -90,6 +105,7 @@ public:
     static const std::string SHP;
     static const std::string DBF;
     static const std::string INDEX;
+    static const std::string PACKED_INDEX;
 };
 
 #endif //SHAPE_IO_HPP
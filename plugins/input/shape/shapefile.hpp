@@ -26,6 +26,8 @@
 // stl
 #include <cstring>
 #include <fstream>
+#include <memory>
+#include <string>
 #include <stdexcept>
 #include <cstdint>
 
@@ -125,6 +127,35 @@ struct shape_record
         return val;
     }
 
+    // integer at an absolute offset, leaves the read position alone
+    int ndr_integer_at(size_t offset) const
+    {
+        std::int32_t val;
+        read_int32_ndr(&data[offset], val);
+        return val;
+    }
+
+    // appends num_points x,y pairs to a container of geometry::point<double>,
+    // straight from the record bytes
+    template <typename Points>
+    void read_points(Points & points, size_t num_points)
+    {
+        if (num_points == 0) return;
+        size_t first = points.size();
+        points.resize(first + num_points);
+#ifndef MAPNIK_BIG_ENDIAN
+        static_assert(sizeof(typename Points::value_type) == 2 * sizeof(double), "expected packed x,y points");
+        std::memcpy(&points[first], &data[pos], num_points * 2 * sizeof(double));
+        pos += num_points * 2 * sizeof(double);
+#else
+        for (size_t i = first; i < first + num_points; ++i)
+        {
+            points[i].x = read_double();
+            points[i].y = read_double();
+        }
+#endif
+    }
+
     long remains()
     {
         return (size - pos);
@@ -142,6 +173,8 @@ public:
 #else
     using file_source_type = std::ifstream;
     using record_type = shape_record<RecordTag>;
+    std::string file_name_;
+    std::unique_ptr<char[]> read_ahead_;
 #endif
 
     file_source_type file_;
@@ -152,8 +185,10 @@ public:
 #ifdef SHAPE_MEMORY_MAPPED_FILE
         file_()
 #elif defined (_WINDOWS)
+        file_name_(file_name),
         file_(mapnik::utf8_to_utf16(file_name), std::ios::in | std::ios::binary)
 #else
+        file_name_(file_name),
         file_(file_name.c_str(), std::ios::in | std::ios::binary)
 #endif
     {
@@ -175,6 +210,26 @@ public:
 
     ~shape_file() {}
 
+    // Reads through a stream buffer of `bytes`, so runs of adjacent records
+    // (e.g. query results on a file written by shapesort) cost one read.
+    // A mapped file is left to the kernel's own read ahead.
+    inline void set_read_ahead(std::size_t bytes)
+    {
+#ifndef SHAPE_MEMORY_MAPPED_FILE
+        // the buffer can only be replaced while the file is closed
+        std::streampos pos = file_.tellg();
+        file_.close();
+        read_ahead_.reset(new char[bytes]);
+        file_.rdbuf()->pubsetbuf(read_ahead_.get(), bytes);
+#if defined (_WINDOWS)
+        file_.open(mapnik::utf8_to_utf16(file_name_), std::ios::in | std::ios::binary);
+#else
+        file_.open(file_name_.c_str(), std::ios::in | std::ios::binary);
+#endif
+        if (pos > 0) file_.seekg(pos, std::ios::beg);
+#endif
+    }
+
     inline file_source_type& file()
     {
         return file_;
@@ -0,0 +1,136 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef SHP_PACKED_INDEX_HPP
+#define SHP_PACKED_INDEX_HPP
+
+// stl
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <ostream>
+#include <vector>
+
+// mapnik
+#include <mapnik/box2d.hpp>
+#include <mapnik/util/packed_rtree.hpp>
+#include <boost/interprocess/streams/bufferstream.hpp>
+
+using mapnik::box2d;
+
+// Packed Hilbert R-tree index (.hrtree), written by `shapeindex --packed` and
+// `shapesort`, in the layout of mapnik/util/packed_rtree.hpp with no format
+// specific header fields. Leaves hold the byte offset of a record in the .shp.
+// Shapefiles rewritten by shapesort keep their records in leaf order, which
+// is flagged in the header so readers can expect hits to be adjacent.
+
+using packed_index_header = mapnik::util::packed_rtree_header;
+using packed_index_entry = mapnik::util::packed_rtree_entry<1>;
+
+static const char packed_index_magic[8] = {'m','a','p','n','i','k','h','r'};
+static const std::uint16_t packed_index_version = 1;
+// the .shp records are stored in the order of the leaves (see shapesort)
+static const std::uint16_t packed_index_sorted = 0x1;
+// flags this version knows about, a later one adding flags bumps the version
+static const std::uint16_t packed_index_flags = packed_index_sorted;
+
+// checks a header read (and converted to host byte order) from a file of `file_size` bytes
+inline bool packed_index_valid(packed_index_header const& header, std::size_t file_size)
+{
+    return (header.flags & ~packed_index_flags) == 0
+        && mapnik::util::packed_rtree_valid(header, packed_index_magic, packed_index_version,
+                                            sizeof(packed_index_header), sizeof(packed_index_entry),
+                                            file_size);
+}
+
+// writes the .hrtree of a built tree
+inline void write_packed_index(std::ostream & out, mapnik::util::packed_rtree const& tree, std::uint16_t flags = 0)
+{
+    mapnik::util::packed_rtree_write(out, tree.header(packed_index_magic, packed_index_version, flags));
+    for (std::size_t i = 0; i < tree.count(); ++i)
+    {
+        box2d<double> const& box = tree.box(i);
+        packed_index_entry entry = {{ box.minx(), box.miny(), box.maxx(), box.maxy() }, { tree.offset(i) }};
+        mapnik::util::packed_rtree_write(out, entry);
+    }
+}
+
+template <typename filterT>
+class shp_packed_index
+{
+public:
+    // reads the tree straight from the mapped file
+    static void query(filterT const& filter, boost::interprocess::ibufferstream & file, std::vector<std::streampos>& pos)
+    {
+        const char* data = file.buffer().first;
+        std::size_t size = file.buffer().second;
+        if (size < sizeof(packed_index_header)) return;
+        packed_index_header header;
+        std::memcpy(&header, data, sizeof(header));
+        mapnik::util::packed_rtree_little_endian(header);
+        if (!packed_index_valid(header, size)) return;
+        const packed_index_entry* entries = reinterpret_cast<const packed_index_entry*>(data + sizeof(header));
+        query_nodes(filter, header, pos, mapnik::util::packed_rtree_memory_nodes<packed_index_entry>(entries));
+    }
+
+    // without a mapping every visited node is read in one go
+    static void query(filterT const& filter, std::ifstream & file, std::vector<std::streampos>& pos)
+    {
+        packed_index_header header;
+        file.seekg(0, std::ios::end);
+        std::size_t size = file.tellg();
+        file.seekg(0, std::ios::beg);
+        if (size < sizeof(packed_index_header)) return;
+        file.read(reinterpret_cast<char*>(&header), sizeof(header));
+        mapnik::util::packed_rtree_little_endian(header);
+        if (!file || !packed_index_valid(header, size)) return;
+        std::vector<packed_index_entry> buffer(header.node_size);
+        query_nodes(filter, header, pos,
+                    [&](std::uint64_t first, std::uint64_t last)
+                    {
+                        file.seekg(sizeof(header) + sizeof(packed_index_entry) * first, std::ios::beg);
+                        file.read(reinterpret_cast<char*>(buffer.data()), sizeof(packed_index_entry) * (last - first));
+                        for (std::uint64_t i = 0; i < last - first; ++i) mapnik::util::packed_rtree_little_endian(buffer[i]);
+                        return static_cast<const packed_index_entry*>(buffer.data());
+                    });
+    }
+
+private:
+    shp_packed_index();
+
+    template <typename LoadNodes>
+    static void query_nodes(filterT const& filter, packed_index_header const& header,
+                            std::vector<std::streampos>& pos, LoadNodes && load_nodes)
+    {
+        mapnik::util::packed_rtree_query<packed_index_entry>(
+            header,
+            [&filter](box2d<double> const& box) { return filter.pass(box); },
+            load_nodes,
+            [&pos](packed_index_entry const& entry)
+            {
+                pos.push_back(static_cast<std::streamoff>(entry.values[0]));
+                return true;
+            });
+    }
+};
+
+#endif // SHP_PACKED_INDEX_HPP
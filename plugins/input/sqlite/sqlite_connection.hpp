@@ -26,11 +26,16 @@
 // stl
 #include <string.h>
 #include <memory>
+#include <map>
+#include <vector>
 
 // mapnik
 #include <mapnik/datasource.hpp>
 #include <mapnik/params.hpp>
 #include <mapnik/timer.hpp>
+#ifdef MAPNIK_THREADSAFE
+#include <mapnik/unique_lock.hpp>
+#endif
 
 // boost
 #pragma GCC diagnostic push
@@ -49,13 +54,16 @@ extern "C" {
 
 //==============================================================================
 
-class sqlite_connection
+class sqlite_connection : public std::enable_shared_from_this<sqlite_connection>
 {
 public:
+    // prepared statements kept for reuse by execute_cached_query
+    static const std::size_t max_cached_statements = 32;
 
     sqlite_connection (std::string const& file)
         : db_(0),
-          file_(file)
+          file_(file),
+          statements_()
     {
 #if SQLITE_VERSION_NUMBER >= 3005000
         int mode = SQLITE_OPEN_READWRITE;
@@ -85,7 +93,8 @@ public:
 
     sqlite_connection (std::string const& file, int flags)
         : db_(0),
-          file_(file)
+          file_(file),
+          statements_()
     {
 #if SQLITE_VERSION_NUMBER >= 3005000
         const int rc = sqlite3_open_v2 (file_.c_str(), &db_, flags, 0);
@@ -103,6 +112,10 @@ public:
 
     virtual ~sqlite_connection ()
     {
+        for (auto const& item : statements_)
+        {
+            sqlite3_finalize (item.second);
+        }
         if (db_)
         {
             sqlite3_close (db_);
@@ -140,6 +153,38 @@ public:
         return std::make_shared<sqlite_resultset>(stmt);
     }
 
+    // Like execute_query but the statement is taken from (and given back to)
+    // a cache keyed by `sql`, so a query which only differs by its bound
+    // parameters is parsed once. The connection must be held by a shared_ptr.
+    std::shared_ptr<sqlite_resultset> execute_cached_query(std::string const& sql)
+    {
+#ifdef MAPNIK_STATS
+        mapnik::progress_timer __stats__(std::clog, std::string("sqlite_resultset::execute_cached_query ") + sql);
+#endif
+        sqlite3_stmt* stmt = 0;
+        {
+#ifdef MAPNIK_THREADSAFE
+            mapnik::scoped_lock lock(mutex_);
+#endif
+            auto itr = statements_.find(sql);
+            if (itr != statements_.end())
+            {
+                stmt = itr->second;
+                statements_.erase(itr);
+            }
+        }
+        if (stmt == 0)
+        {
+            const int rc = sqlite3_prepare_v2 (db_, sql.c_str(), -1, &stmt, 0);
+            if (rc != SQLITE_OK)
+            {
+                throw_sqlite_error(sql);
+            }
+        }
+        std::shared_ptr<sqlite_connection> self = shared_from_this();
+        return std::make_shared<sqlite_resultset>(stmt, [self, sql](sqlite3_stmt* s) { self->release(sql, s); });
+    }
+
     void execute(std::string const& sql)
     {
 #ifdef MAPNIK_STATS
@@ -168,6 +213,12 @@ public:
         return db_;
     }
 
+    // health check of mapnik::Pool
+    bool isOK() const
+    {
+        return db_ != 0;
+    }
+
     bool load_extension(std::string const& ext_path)
     {
         sqlite3_enable_load_extension(db_, 1);
@@ -177,8 +228,60 @@ public:
 
 private:
 
+    void release(std::string const& sql, sqlite3_stmt* stmt)
+    {
+        sqlite3_reset(stmt);
+        sqlite3_clear_bindings(stmt);
+        {
+#ifdef MAPNIK_THREADSAFE
+            mapnik::scoped_lock lock(mutex_);
+#endif
+            if (statements_.size() < max_cached_statements)
+            {
+                statements_.emplace(sql, stmt);
+                return;
+            }
+        }
+        sqlite3_finalize(stmt);
+    }
+
     sqlite3* db_;
     std::string file_;
+    // statements which are not in use, several per query if it runs concurrently
+    std::multimap<std::string, sqlite3_stmt*> statements_;
+#ifdef MAPNIK_THREADSAFE
+    std::mutex mutex_;
+#endif
+};
+
+// Opens the pooled connections of a datasource and runs `statements` (pragmas
+// and attached databases) on each of them
+template <typename T>
+class sqlite_connection_creator
+{
+public:
+    sqlite_connection_creator(std::string const& file,
+                              int flags,
+                              std::vector<std::string> const& statements)
+        : file_(file),
+          flags_(flags),
+          statements_(statements) {}
+
+    T* operator()() const
+    {
+        std::unique_ptr<T> conn(new T(file_, flags_));
+        sqlite3_busy_timeout(**conn, 5000);
+        for (auto const& sql : statements_)
+        {
+            conn->execute(sql);
+        }
+        return conn.release();
+    }
+
+private:
+    std::string file_;
+    int flags_;
+    std::vector<std::string> statements_;
 };
 
 #endif // MAPNIK_SQLITE_CONNECTION_HPP
@@ -68,7 +68,9 @@ sqlite_datasource::sqlite_datasource(parameters const& params)
       row_limit_(*params.get<mapnik::value_integer>("row_limit", 0)),
       intersects_token_("!intersects!"),
       desc_(sqlite_datasource::name(), *params.get<std::string>("encoding", "utf-8")),
-      format_(mapnik::wkbAuto)
+      format_(mapnik::wkbAuto),
+      init_statements_(),
+      pool_()
 {
     /* TODO
        - throw if no primary key but spatial index is present?
@@ -120,12 +122,27 @@ sqlite_datasource::sqlite_datasource(parameters const& params)
     }
 
     // Populate init_statements_
-    //   1. Build attach database statements from the "attachdb" parameter
-    //   2. Add explicit init statements from "initdb" parameter
+    //   1. Add pragmas from the "mmap_size" (bytes) and "cache_size" (pages,
+    //      or KiB if negative) parameters
+    //   2. Build attach database statements from the "attachdb" parameter
+    // The explicit init statements from the "initdb" parameter run once,
+    // after them, on the main connection.
     // Note that we do some extra work to make sure that any attached
     // databases are relative to directory containing dataset_name_.  Sqlite
     // will default to attaching from cwd.  Typicaly usage means that the
     // map loader will produce full paths here.
+    boost::optional<mapnik::value_integer> mmap_size = params.get<mapnik::value_integer>("mmap_size");
+    if (mmap_size)
+    {
+        init_statements_.push_back("PRAGMA mmap_size=" + std::to_string(*mmap_size));
+    }
+
+    boost::optional<mapnik::value_integer> cache_size = params.get<mapnik::value_integer>("cache_size");
+    if (cache_size)
+    {
+        init_statements_.push_back("PRAGMA cache_size=" + std::to_string(*cache_size));
+    }
+
     boost::optional<std::string> attachdb = params.get<std::string>("attachdb");
     if (attachdb)
     {
@@ -133,10 +150,6 @@ sqlite_datasource::sqlite_datasource(parameters const& params)
     }
 
     boost::optional<std::string> initdb = params.get<std::string>("initdb");
-    if (initdb)
-    {
-        init_statements_.push_back(*initdb);
-    }
 
     // now actually create the connection and start executing setup sql
     dataset_ = std::make_shared<sqlite_connection>(dataset_name_);
@@ -207,6 +220,13 @@ sqlite_datasource::sqlite_datasource(parameters const& params)
         dataset_->execute(*iter);
     }
 
+    if (initdb)
+    {
+        MAPNIK_LOG_DEBUG(sqlite) << "sqlite_datasource: Execute init sql=" << *initdb;
+
+        dataset_->execute(*initdb);
+    }
+
     bool found_types_via_subquery = false;
     if (using_subquery_)
     {
@@ -282,7 +302,8 @@ sqlite_datasource::sqlite_datasource(parameters const& params)
         bool index_db_attached = false;
         if (mapnik::util::exists(index_db))
         {
-            dataset_->execute("attach database '" + index_db + "' as " + index_table_);
+            init_statements_.push_back("attach database '" + index_db + "' as " + index_table_);
+            dataset_->execute(init_statements_.back());
             index_db_attached = true;
         }
         has_spatial_index_ = sqlite_utils::has_rtree(index_table_,dataset_);
@@ -309,7 +330,8 @@ sqlite_datasource::sqlite_datasource(parameters const& params)
                     has_spatial_index_ = true;
                     if (!index_db_attached && mapnik::util::exists(index_db))
                     {
-                        dataset_->execute("attach database '" + index_db + "' as " + index_table_);
+                        init_statements_.push_back("attach database '" + index_db + "' as " + index_table_);
+                        dataset_->execute(init_statements_.back());
                     }
                 }
             }
@@ -354,6 +376,35 @@ sqlite_datasource::sqlite_datasource(parameters const& params)
         }
     }
 
+    // Featuresets borrow a read only connection, replaying init_statements_,
+    // from a pool of at most "max_size" so concurrent renders don't share one
+    // handle. The effects of "initdb" only exist on the main connection, so
+    // then (and for :memory: databases or max_size=0) all queries use it.
+    mapnik::value_integer max_size = *params.get<mapnik::value_integer>("max_size", 10);
+    if (max_size > 0 && !initdb && dataset_name_.compare(":memory:") != 0)
+    {
+        int flags = SQLITE_OPEN_READONLY;
+#if SQLITE_VERSION_NUMBER >= 3006018
+        flags |= SQLITE_OPEN_NOMUTEX | SQLITE_OPEN_PRIVATECACHE;
+#endif
+        sqlite_connection_creator<sqlite_connection> creator(dataset_name_, flags, init_statements_);
+        pool_ = std::make_shared<mapnik::Pool<sqlite_connection, sqlite_connection_creator> >(
+            creator, 0, static_cast<unsigned>(max_size));
+    }
+}
+
+std::shared_ptr<sqlite_connection> sqlite_datasource::connection() const
+{
+    if (pool_)
+    {
+        // never wait: a thread rendering several styles holds several featuresets
+        std::shared_ptr<sqlite_connection> conn = pool_->borrowObject(std::chrono::milliseconds(0));
+        if (conn)
+        {
+            return conn;
+        }
+    }
+    return dataset_;
 }
 
 std::string sqlite_datasource::populate_tokens(std::string const& sql) const
@@ -439,7 +490,9 @@ boost::optional<mapnik::datasource_geometry_t> sqlite_datasource::get_geometry_t
         {
             s << " LIMIT 5";
         }
-        std::shared_ptr<sqlite_resultset> rs = dataset_->execute_query(s.str());
+        // keep the connection borrowed while stepping through the result
+        std::shared_ptr<sqlite_connection> conn = connection();
+        std::shared_ptr<sqlite_resultset> rs = conn->execute_query(s.str());
         int multi_type = 0;
         while (rs->is_valid() && rs->step_next())
         {
@@ -509,17 +562,17 @@ featureset_ptr sqlite_datasource::features(query const& q) const
         s << " FROM ";
 
         std::string query(table_);
+        bool spatial_filter = false;
 
         if (! key_field_.empty() && has_spatial_index_)
         {
             // TODO - debug warn if fails
-            sqlite_utils::apply_spatial_filter(query,
-                                               e,
-                                               table_,
-                                               key_field_,
-                                               index_table_,
-                                               geometry_table_,
-                                               intersects_token_);
+            spatial_filter = sqlite_utils::apply_spatial_filter(query,
+                                                                table_,
+                                                                key_field_,
+                                                                index_table_,
+                                                                geometry_table_,
+                                                                intersects_token_);
         }
         else
         {
@@ -540,7 +593,11 @@ featureset_ptr sqlite_datasource::features(query const& q) const
 
         MAPNIK_LOG_DEBUG(sqlite) << "sqlite_datasource: " << s.str();
 
-        std::shared_ptr<sqlite_resultset> rs(dataset_->execute_query(s.str()));
+        std::shared_ptr<sqlite_resultset> rs(connection()->execute_cached_query(s.str()));
+        if (spatial_filter)
+        {
+            rs->bind(e);
+        }
 
         return std::make_shared<sqlite_featureset>(rs,
                                                      ctx,
@@ -590,17 +647,17 @@ featureset_ptr sqlite_datasource::features_at_point(coord2d const& pt, double to
         s << " FROM ";
 
         std::string query(table_);
+        bool spatial_filter = false;
 
         if (! key_field_.empty() && has_spatial_index_)
         {
             // TODO - debug warn if fails
-            sqlite_utils::apply_spatial_filter(query,
-                                               e,
-                                               table_,
-                                               key_field_,
-                                               index_table_,
-                                               geometry_table_,
-                                               intersects_token_);
+            spatial_filter = sqlite_utils::apply_spatial_filter(query,
+                                                                table_,
+                                                                key_field_,
+                                                                index_table_,
+                                                                geometry_table_,
+                                                                intersects_token_);
         }
         else
         {
@@ -621,7 +678,11 @@ featureset_ptr sqlite_datasource::features_at_point(coord2d const& pt, double to
 
         MAPNIK_LOG_DEBUG(sqlite) << "sqlite_datasource: " << s.str();
 
-        std::shared_ptr<sqlite_resultset> rs(dataset_->execute_query(s.str()));
+        std::shared_ptr<sqlite_resultset> rs(connection()->execute_cached_query(s.str()));
+        if (spatial_filter)
+        {
+            rs->bind(e);
+        }
 
         return std::make_shared<sqlite_featureset>(rs,
                                                      ctx,
@@ -33,6 +33,7 @@
 #include <mapnik/feature_layer_desc.hpp>
 #include <mapnik/wkb.hpp>
 #include <mapnik/value_types.hpp>
+#include <mapnik/pool.hpp>
 
 // boost
 #include <boost/optional.hpp>
@@ -63,6 +64,8 @@ private:
     // needed to attach auxillary databases
     void parse_attachdb(std::string const& attachdb) const;
     std::string populate_tokens(std::string const& sql) const;
+    // a pooled connection for one featureset, dataset_ when none is free
+    std::shared_ptr<sqlite_connection> connection() const;
 
     mapnik::box2d<double> extent_;
     bool extent_initialized_;
@@ -85,7 +88,10 @@ private:
     bool use_spatial_index_;
     bool has_spatial_index_;
     bool using_subquery_;
+    // pragmas and attached databases, run on every connection
     mutable std::vector<std::string> init_statements_;
+    // connections lent to one featureset at a time, null when queries share dataset_
+    std::shared_ptr<mapnik::Pool<sqlite_connection, sqlite_connection_creator> > pool_;
 };
 
 #endif // MAPNIK_SQLITE_DATASOURCE_HPP
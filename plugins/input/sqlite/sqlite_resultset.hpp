@@ -27,9 +27,11 @@
 #include <mapnik/debug.hpp>
 #include <mapnik/datasource.hpp>
 #include <mapnik/params.hpp>
+#include <mapnik/box2d.hpp>
 
 // stl
 #include <string.h>
+#include <functional>
 
 // sqlite
 extern "C" {
@@ -44,8 +46,18 @@ class sqlite_resultset
 {
 public:
 
+    using release_type = std::function<void(sqlite3_stmt*)>;
+
     sqlite_resultset (sqlite3_stmt* stmt)
-        : stmt_(stmt)
+        : stmt_(stmt),
+          release_()
+    {
+    }
+
+    // the statement is handed to `release` instead of being finalized
+    sqlite_resultset (sqlite3_stmt* stmt, release_type const& release)
+        : stmt_(stmt),
+          release_(release)
     {
     }
 
@@ -53,7 +65,26 @@ public:
     {
         if (stmt_)
         {
-            sqlite3_finalize (stmt_);
+            if (release_)
+            {
+                release_(stmt_);
+            }
+            else
+            {
+                sqlite3_finalize (stmt_);
+            }
+        }
+    }
+
+    // binds ?1 to ?4 as minx, maxx, miny, maxy
+    void bind (mapnik::box2d<double> const& bbox)
+    {
+        if ((sqlite3_bind_double(stmt_, 1, bbox.minx()) != SQLITE_OK) ||
+            (sqlite3_bind_double(stmt_, 2, bbox.maxx()) != SQLITE_OK) ||
+            (sqlite3_bind_double(stmt_, 3, bbox.miny()) != SQLITE_OK) ||
+            (sqlite3_bind_double(stmt_, 4, bbox.maxy()) != SQLITE_OK))
+        {
+            throw mapnik::datasource_exception("SQLite Plugin: binding query extent failed");
         }
     }
 
@@ -140,6 +171,7 @@ public:
 private:
 
     sqlite3_stmt* stmt_;
+    release_type release_;
 };
 
 #endif // MAPNIK_SQLITE_RESULTSET_HPP
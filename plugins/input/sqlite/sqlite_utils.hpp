@@ -114,8 +114,9 @@ public:
         //}
     }
 
+    // The extent is left as parameters ?1 to ?4 (minx, maxx, miny, maxy, see
+    // sqlite_resultset::bind) so the statement can be reused for any extent.
     static bool apply_spatial_filter(std::string & query,
-                                     mapnik::box2d<double> const& e,
                                      std::string const& table,
                                      std::string const& key_field,
                                      std::string const& index_table,
@@ -123,10 +124,9 @@ public:
                                      std::string const& intersects_token)
     {
         std::ostringstream spatial_sql;
-        spatial_sql << std::setprecision(16);
         spatial_sql << key_field << " IN (SELECT pkid FROM " << index_table;
-        spatial_sql << " WHERE xmax>=" << e.minx() << " AND xmin<=" << e.maxx() ;
-        spatial_sql << " AND ymax>=" << e.miny() << " AND ymin<=" << e.maxy() << ")";
+        spatial_sql << " WHERE xmax>=?1 AND xmin<=?2";
+        spatial_sql << " AND ymax>=?3 AND ymin<=?4)";
         if (boost::algorithm::ifind_first(query,  intersects_token))
         {
             boost::algorithm::ireplace_all(query, intersects_token, spatial_sql.str());
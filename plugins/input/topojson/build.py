@@ -41,6 +41,7 @@ else:
       """
       %(PLUGIN_NAME)s_datasource.cpp
       %(PLUGIN_NAME)s_featureset.cpp
+      %(PLUGIN_NAME)s_geometry_cache.cpp
       """ % locals()
     )
 
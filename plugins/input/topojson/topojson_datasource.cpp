@@ -22,6 +22,7 @@
 
 #include "topojson_datasource.hpp"
 #include "topojson_featureset.hpp"
+#include "topojson_geometry_cache.hpp"
 
 #include <fstream>
 #include <algorithm>
@@ -34,7 +35,6 @@
 #include <mapnik/value_types.hpp>
 #include <mapnik/box2d.hpp>
 #include <mapnik/json/topojson_grammar.hpp>
-#include <mapnik/json/topojson_utils.hpp>
 #include <mapnik/util/variant.hpp>
 #include <mapnik/util/file_io.hpp>
 #include <mapnik/make_unique.hpp>
@@ -146,6 +146,7 @@ topojson_datasource::topojson_datasource(parameters const& params)
     inline_string_(),
     extent_(),
     tr_(new mapnik::transcoder(*params.get<std::string>("encoding","utf-8"))),
+    cache_(nullptr),
     tree_(nullptr)
 {
     boost::optional<std::string> inline_string = params.get<std::string>("inline");
@@ -197,6 +198,11 @@ void topojson_datasource::parse_topojson(T const& buffer)
         throw mapnik::datasource_exception("topojson_datasource: Failed parse TopoJSON file '" + filename_ + "'");
     }
 
+    // geometries are assembled from the decoded arcs on demand, so the parsed ones are not needed any more
+    mapnik::value_integer cache_size = *params_.get<mapnik::value_integer>("geometry_cache_size", 64);
+    cache_ = std::make_unique<topojson_geometry_cache>(topo_, std::max<mapnik::value_integer>(0, cache_size) << 20);
+    std::vector<mapnik::topojson::arc>().swap(topo_.arcs);
+
     using values_container = std::vector< std::pair<box_type, std::size_t> >;
     values_container values;
     values.reserve(topo_.geometries.size());
@@ -205,7 +211,7 @@ void topojson_datasource::parse_topojson(T const& buffer)
 
     for (auto const& geom : topo_.geometries)
     {
-        mapnik::box2d<double> box = mapnik::util::apply_visitor(mapnik::topojson::bounding_box_visitor(topo_), geom);
+        mapnik::box2d<double> box = cache_->envelope(geom);
         if (box.valid())
         {
             if (geometry_index == 0)
@@ -286,7 +292,7 @@ mapnik::featureset_ptr topojson_datasource::features(mapnik::query const& q) con
         if (tree_)
         {
             tree_->query(boost::geometry::index::intersects(box),std::back_inserter(index_array));
-            return std::make_shared<topojson_featureset>(topo_, *tr_, std::move(index_array));
+            return std::make_shared<topojson_featureset>(topo_, *cache_, *tr_, std::move(index_array));
         }
     }
     // otherwise return an empty featureset pointer
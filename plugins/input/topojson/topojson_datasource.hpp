@@ -54,6 +54,8 @@
 #include <deque>
 #include <memory>
 
+class topojson_geometry_cache;
+
 class topojson_datasource : public mapnik::datasource
 {
 public:
@@ -85,6 +87,8 @@ private:
     mapnik::box2d<double> extent_;
     std::unique_ptr<mapnik::transcoder> tr_;
     mapnik::topojson::topology topo_;
+    // dequantized arcs and assembled geometries of topo_
+    std::unique_ptr<topojson_geometry_cache> cache_;
     std::unique_ptr<spatial_index_type> tree_;
 };
 
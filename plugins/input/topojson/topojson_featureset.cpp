@@ -25,21 +25,11 @@
 #include <mapnik/feature_factory.hpp>
 #include <mapnik/json/topology.hpp>
 #include <mapnik/util/variant.hpp>
-#include <mapnik/geometry_adapters.hpp>
 // stl
 #include <string>
 #include <vector>
 #include <fstream>
 
-// boost
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wunused-parameter"
-#pragma GCC diagnostic ignored "-Wunused-variable"
-#pragma GCC diagnostic ignored "-Wunused-local-typedef"
-#include <boost/range/adaptor/reversed.hpp>
-#include <boost/geometry.hpp>
-#pragma GCC diagnostic pop
-
 #include "topojson_featureset.hpp"
 
 namespace mapnik { namespace topojson {
@@ -77,264 +67,33 @@ void assign_properties(mapnik::feature_impl & feature, T const& geom, mapnik::tr
     }
 }
 
-template <typename Context>
-struct feature_generator
+struct assign_properties_visitor
 {
-    feature_generator(Context & ctx,  mapnik::transcoder const& tr, topology const& topo, std::size_t feature_id)
-        : ctx_(ctx),
-          tr_(tr),
-          topo_(topo),
-          feature_id_(feature_id) {}
-
-    feature_ptr operator() (point const& pt) const
-    {
-        mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx_,feature_id_));
-        double x = pt.coord.x;
-        double y = pt.coord.y;
-        if (topo_.tr)
-        {
-            x =  x * (*topo_.tr).scale_x + (*topo_.tr).translate_x;
-            y =  y * (*topo_.tr).scale_y + (*topo_.tr).translate_y;
-        }
-        mapnik::geometry::point<double> point(x, y);
-        feature->set_geometry(std::move(point));
-        assign_properties(*feature, pt, tr_);
-        return feature;
-    }
-
-    feature_ptr operator() (multi_point const& multi_pt) const
-    {
-        mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx_,feature_id_));
-        mapnik::geometry::multi_point<double> multi_point;
-        multi_point.reserve(multi_pt.points.size());
-        for (auto const& pt : multi_pt.points)
-        {
-            double x = pt.x;
-            double y = pt.y;
-            if (topo_.tr)
-            {
-                x =  x * (*topo_.tr).scale_x + (*topo_.tr).translate_x;
-                y =  y * (*topo_.tr).scale_y + (*topo_.tr).translate_y;
-            }
-            multi_point.add_coord(x, y);
-        }
-        feature->set_geometry(std::move(multi_point));
-        assign_properties(*feature, multi_pt, tr_);
-        return feature;
-    }
-
-    feature_ptr operator() (linestring const& line) const
-    {
-        mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx_,feature_id_));
-        double px = 0, py = 0;
-        index_type arc_index = line.ring;
-
-        mapnik::geometry::line_string<double> line_string;
-        line_string.reserve( topo_.arcs[arc_index].coordinates.size());
-
-        for (auto pt : topo_.arcs[arc_index].coordinates)
-        {
-            double x = pt.x;
-            double y = pt.y;
-            if (topo_.tr)
-            {
-                x =  (px += x) * (*topo_.tr).scale_x + (*topo_.tr).translate_x;
-                y =  (py += y) * (*topo_.tr).scale_y + (*topo_.tr).translate_y;
-            }
-            line_string.add_coord(x,y);
-        }
-        feature->set_geometry(std::move(line_string));
-        assign_properties(*feature, line, tr_);
-        return feature;
-    }
-
-    feature_ptr operator() (multi_linestring const& multi_line) const
-    {
-        mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx_,feature_id_));
-
-        mapnik::geometry::multi_line_string<double> multi_line_string;
-        multi_line_string.reserve(multi_line.rings.size());
-        for (auto const& index : multi_line.rings)
-        {
-            double px = 0, py = 0;
-            bool reverse = index < 0;
-            index_type arc_index = reverse ? std::abs(index) - 1 : index;
-            mapnik::geometry::line_string<double> line_string;
-            line_string.reserve(topo_.arcs[arc_index].coordinates.size());
-            for (auto pt : topo_.arcs[arc_index].coordinates)
-            {
-                double x = pt.x;
-                double y = pt.y;
-                if (topo_.tr)
-                {
-                    x =  (px += x) * (*topo_.tr).scale_x + (*topo_.tr).translate_x;
-                    y =  (py += y) * (*topo_.tr).scale_y + (*topo_.tr).translate_y;
-                }
-                line_string.add_coord(x, y);
-            }
-            multi_line_string.push_back(std::move(line_string));
-        }
-        feature->set_geometry(std::move(multi_line_string));
-        assign_properties(*feature, multi_line, tr_);
-        return feature;
-    }
-
-    feature_ptr operator() (polygon const& poly) const
-    {
-        mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx_,feature_id_));
-        std::vector<mapnik::topojson::coordinate> processed_coords;
-        mapnik::geometry::polygon<double> polygon;
-        if (poly.rings.size() > 1) polygon.interior_rings.reserve(poly.rings.size() - 1);
-        bool first = true;
-        for (auto const& ring : poly.rings)
-        {
-            mapnik::geometry::linear_ring<double> linear_ring;
-            for (auto const& index : ring)
-            {
-                double px = 0, py = 0;
-                bool reverse = index < 0;
-                index_type arc_index = reverse ? std::abs(index) - 1 : index;
-                auto const& coords = topo_.arcs[arc_index].coordinates;
-                processed_coords.clear();
-                processed_coords.reserve(coords.size());
-                for (auto const& pt : coords )
-                {
-                    double x = pt.x;
-                    double y = pt.y;
+    assign_properties_visitor(mapnik::feature_impl & feature, mapnik::transcoder const& tr)
+        : feature_(feature),
+          tr_(tr) {}
 
-                    if (topo_.tr)
-                    {
-                        transform const& tr = *topo_.tr;
-                        x =  (px += x) * tr.scale_x + tr.translate_x;
-                        y =  (py += y) * tr.scale_y + tr.translate_y;
-                    }
-                    processed_coords.emplace_back(coordinate{x,y});
-                }
+    void operator() (invalid const&) const {}
 
-                using namespace boost::adaptors;
-
-                if (reverse)
-                {
-                    for (auto const& c : processed_coords | reversed)
-                    {
-                        linear_ring.emplace_back(c.x, c.y);
-                    }
-                }
-                else
-                {
-                    for (auto const& c : processed_coords)
-                    {
-                        linear_ring.emplace_back(c.x, c.y);
-                    }
-                }
-            }
-            if (first)
-            {
-                first = false;
-                polygon.set_exterior_ring(std::move(linear_ring));
-            }
-            else
-            {
-                polygon.add_hole(std::move(linear_ring));
-            }
-        }
-        boost::geometry::correct(polygon);
-        feature->set_geometry(std::move(polygon));
-        assign_properties(*feature, poly, tr_);
-        return feature;
-    }
-
-    feature_ptr operator() (multi_polygon const& multi_poly) const
-    {
-        mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx_,feature_id_));
-        std::vector<mapnik::topojson::coordinate> processed_coords;
-        mapnik::geometry::multi_polygon<double> multi_polygon;
-        multi_polygon.reserve(multi_poly.polygons.size());
-
-        for (auto const& poly : multi_poly.polygons)
-        {
-            bool first = true;
-            mapnik::geometry::polygon<double> polygon;
-            if (poly.size() > 1) polygon.interior_rings.reserve(poly.size() - 1);
-
-            for (auto const& ring : poly)
-            {
-                mapnik::geometry::linear_ring<double> linear_ring;
-                for (auto const& index : ring)
-                {
-                    double px = 0, py = 0;
-                    bool reverse = index < 0;
-                    index_type arc_index = reverse ? std::abs(index) - 1 : index;
-                    auto const& coords = topo_.arcs[arc_index].coordinates;
-                    processed_coords.clear();
-                    processed_coords.reserve(coords.size());
-                    for (auto const& pt : coords )
-                    {
-                        double x = pt.x;
-                        double y = pt.y;
-
-                        if (topo_.tr)
-                        {
-                            x =  (px += x) * (*topo_.tr).scale_x + (*topo_.tr).translate_x;
-                            y =  (py += y) * (*topo_.tr).scale_y + (*topo_.tr).translate_y;
-                        }
-                        processed_coords.emplace_back(coordinate{x,y});
-                    }
-
-                    using namespace boost::adaptors;
-
-                    if (reverse)
-                    {
-                        for (auto const& c : (processed_coords | reversed))
-                        {
-                            linear_ring.add_coord(c.x, c.y);
-                        }
-                    }
-                    else
-                    {
-                        for (auto const& c : processed_coords)
-                        {
-                            linear_ring.add_coord(c.x, c.y);
-                        }
-                    }
-                }
-                if (first)
-                {
-                    first = false;
-                    polygon.set_exterior_ring(std::move(linear_ring));
-                }
-                else
-                {
-                    polygon.add_hole(std::move(linear_ring));
-                }
-            }
-            boost::geometry::correct(polygon);
-            multi_polygon.push_back(std::move(polygon));
-        }
-        feature->set_geometry(std::move(multi_polygon));
-        assign_properties(*feature, multi_poly, tr_);
-        return feature;
-    }
-
-    template<typename T>
-    feature_ptr operator() (T const& ) const
+    template <typename T>
+    void operator() (T const& geom) const
     {
-        return feature_ptr();
+        assign_properties(feature_, geom, tr_);
     }
 
-    Context & ctx_;
+    mapnik::feature_impl & feature_;
     mapnik::transcoder const& tr_;
-    topology const& topo_;
-    std::size_t feature_id_;
 };
 
 }}
 
 topojson_featureset::topojson_featureset(mapnik::topojson::topology const& topo,
+                                         topojson_geometry_cache const& cache,
                                          mapnik::transcoder const& tr,
                                          array_type && index_array)
     : ctx_(std::make_shared<mapnik::context_type>()),
       topo_(topo),
+      cache_(cache),
       tr_(tr),
       index_array_(std::move(index_array)),
       index_itr_(index_array_.begin()),
@@ -345,16 +104,18 @@ topojson_featureset::~topojson_featureset() {}
 
 mapnik::feature_ptr topojson_featureset::next()
 {
-    if (index_itr_ != index_end_)
+    while (index_itr_ != index_end_)
     {
         topojson_datasource::item_type const& item = *index_itr_++;
         std::size_t index = item.second;
         if ( index < topo_.geometries.size())
         {
             mapnik::topojson::geometry const& geom = topo_.geometries[index];
-            mapnik::feature_ptr feature = mapnik::util::apply_visitor(
-                mapnik::topojson::feature_generator<mapnik::context_ptr>(ctx_, tr_, topo_, feature_id_++),
-                geom);
+            if (geom.is<mapnik::topojson::invalid>()) continue;
+            mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx_, feature_id_++));
+            // the cached geometry stays shared, the feature gets its own copy
+            feature->set_geometry_copy(*cache_.get(index));
+            mapnik::util::apply_visitor(mapnik::topojson::assign_properties_visitor(*feature, tr_), geom);
             return feature;
         }
     }
@@ -25,6 +25,7 @@
 
 #include <mapnik/feature.hpp>
 #include "topojson_datasource.hpp"
+#include "topojson_geometry_cache.hpp"
 
 #include <vector>
 #include <deque>
@@ -34,6 +35,7 @@ class topojson_featureset : public mapnik::Featureset
 public:
     typedef std::deque<topojson_datasource::item_type> array_type;
     topojson_featureset(mapnik::topojson::topology const& topo,
+                        topojson_geometry_cache const& cache,
                         mapnik::transcoder const& tr,
                         array_type && index_array);
 
@@ -44,6 +46,7 @@ private:
     mapnik::context_ptr ctx_;
     mapnik::box2d<double> box_;
     mapnik::topojson::topology const& topo_;
+    topojson_geometry_cache const& cache_;
     mapnik::transcoder const& tr_;
     const array_type index_array_;
     array_type::const_iterator index_itr_;
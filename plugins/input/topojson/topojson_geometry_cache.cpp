@@ -0,0 +1,363 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+// mapnik
+#include <mapnik/util/variant.hpp>
+#include <mapnik/geometry_adapters.hpp>
+// stl
+#include <cstdlib>
+
+// boost
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-parameter"
+#pragma GCC diagnostic ignored "-Wunused-variable"
+#pragma GCC diagnostic ignored "-Wunused-local-typedef"
+#include <boost/geometry.hpp>
+#pragma GCC diagnostic pop
+
+#include "topojson_geometry_cache.hpp"
+
+namespace {
+
+using arc_type = topojson_geometry_cache::arc_type;
+
+mapnik::geometry::point<double> transform_point(mapnik::topojson::topology const& topo,
+                                                mapnik::topojson::coordinate const& pt)
+{
+    if (topo.tr)
+    {
+        mapnik::topojson::transform const& tr = *topo.tr;
+        return mapnik::geometry::point<double>(pt.x * tr.scale_x + tr.translate_x,
+                                               pt.y * tr.scale_y + tr.translate_y);
+    }
+    return mapnik::geometry::point<double>(pt.x, pt.y);
+}
+
+// negative indices refer to arcs in reverse order
+template <typename T>
+T const* find_arc(std::vector<T> const& arcs, mapnik::topojson::index_type index, bool & reverse)
+{
+    reverse = index < 0;
+    std::size_t arc_index = reverse ? std::abs(index) - 1 : index;
+    return arc_index < arcs.size() ? &arcs[arc_index] : nullptr;
+}
+
+struct envelope_visitor
+{
+    envelope_visitor(mapnik::topojson::topology const& topo,
+                     std::vector<mapnik::box2d<double> > const& arc_boxes)
+        : topo_(topo),
+          arc_boxes_(arc_boxes) {}
+
+    mapnik::box2d<double> operator() (mapnik::topojson::point const& pt) const
+    {
+        mapnik::geometry::point<double> p = transform_point(topo_, pt.coord);
+        return mapnik::box2d<double>(p.x, p.y, p.x, p.y);
+    }
+
+    mapnik::box2d<double> operator() (mapnik::topojson::multi_point const& multi_pt) const
+    {
+        mapnik::box2d<double> bbox;
+        for (auto const& pt : multi_pt.points)
+        {
+            mapnik::geometry::point<double> p = transform_point(topo_, pt);
+            if (!bbox.valid()) bbox.init(p.x, p.y, p.x, p.y);
+            else bbox.expand_to_include(p.x, p.y);
+        }
+        return bbox;
+    }
+
+    mapnik::box2d<double> operator() (mapnik::topojson::linestring const& line) const
+    {
+        mapnik::box2d<double> bbox;
+        add(bbox, line.ring);
+        return bbox;
+    }
+
+    mapnik::box2d<double> operator() (mapnik::topojson::multi_linestring const& multi_line) const
+    {
+        mapnik::box2d<double> bbox;
+        for (auto index : multi_line.rings) add(bbox, index);
+        return bbox;
+    }
+
+    mapnik::box2d<double> operator() (mapnik::topojson::polygon const& poly) const
+    {
+        mapnik::box2d<double> bbox;
+        for (auto const& ring : poly.rings)
+        {
+            for (auto index : ring) add(bbox, index);
+        }
+        return bbox;
+    }
+
+    mapnik::box2d<double> operator() (mapnik::topojson::multi_polygon const& multi_poly) const
+    {
+        mapnik::box2d<double> bbox;
+        for (auto const& poly : multi_poly.polygons)
+        {
+            for (auto const& ring : poly)
+            {
+                for (auto index : ring) add(bbox, index);
+            }
+        }
+        return bbox;
+    }
+
+    mapnik::box2d<double> operator() (mapnik::topojson::invalid const&) const
+    {
+        return mapnik::box2d<double>();
+    }
+
+private:
+    void add(mapnik::box2d<double> & bbox, mapnik::topojson::index_type index) const
+    {
+        bool reverse;
+        mapnik::box2d<double> const* arc_box = find_arc(arc_boxes_, index, reverse);
+        if (!arc_box || !arc_box->valid()) return;
+        if (!bbox.valid()) bbox = *arc_box;
+        else bbox.expand_to_include(*arc_box);
+    }
+
+    mapnik::topojson::topology const& topo_;
+    std::vector<mapnik::box2d<double> > const& arc_boxes_;
+};
+
+struct assemble_visitor
+{
+    using geometry_type = topojson_geometry_cache::geometry_type;
+
+    assemble_visitor(mapnik::topojson::topology const& topo,
+                     std::vector<arc_type> const& arcs)
+        : topo_(topo),
+          arcs_(arcs) {}
+
+    geometry_type operator() (mapnik::topojson::point const& pt) const
+    {
+        return geometry_type(transform_point(topo_, pt.coord));
+    }
+
+    geometry_type operator() (mapnik::topojson::multi_point const& multi_pt) const
+    {
+        mapnik::geometry::multi_point<double> multi_point;
+        multi_point.reserve(multi_pt.points.size());
+        for (auto const& pt : multi_pt.points)
+        {
+            multi_point.push_back(transform_point(topo_, pt));
+        }
+        return geometry_type(std::move(multi_point));
+    }
+
+    geometry_type operator() (mapnik::topojson::linestring const& line) const
+    {
+        mapnik::geometry::line_string<double> line_string;
+        append_line(line_string, line.ring);
+        return geometry_type(std::move(line_string));
+    }
+
+    geometry_type operator() (mapnik::topojson::multi_linestring const& multi_line) const
+    {
+        mapnik::geometry::multi_line_string<double> multi_line_string;
+        multi_line_string.reserve(multi_line.rings.size());
+        for (auto index : multi_line.rings)
+        {
+            mapnik::geometry::line_string<double> line_string;
+            append_line(line_string, index);
+            multi_line_string.push_back(std::move(line_string));
+        }
+        return geometry_type(std::move(multi_line_string));
+    }
+
+    geometry_type operator() (mapnik::topojson::polygon const& poly) const
+    {
+        return geometry_type(make_polygon(poly.rings));
+    }
+
+    geometry_type operator() (mapnik::topojson::multi_polygon const& multi_poly) const
+    {
+        mapnik::geometry::multi_polygon<double> multi_polygon;
+        multi_polygon.reserve(multi_poly.polygons.size());
+        for (auto const& poly : multi_poly.polygons)
+        {
+            multi_polygon.push_back(make_polygon(poly));
+        }
+        return geometry_type(std::move(multi_polygon));
+    }
+
+    geometry_type operator() (mapnik::topojson::invalid const&) const
+    {
+        return geometry_type();
+    }
+
+private:
+    // lines keep the direction of their arc
+    void append_line(mapnik::geometry::line_string<double> & line, mapnik::topojson::index_type index) const
+    {
+        bool reverse;
+        arc_type const* arc = find_arc(arcs_, index, reverse);
+        if (arc) line.insert(line.end(), arc->begin(), arc->end());
+    }
+
+    mapnik::geometry::polygon<double> make_polygon(std::vector<std::vector<mapnik::topojson::index_type> > const& rings) const
+    {
+        mapnik::geometry::polygon<double> polygon;
+        if (rings.size() > 1) polygon.interior_rings.reserve(rings.size() - 1);
+        bool first = true;
+        for (auto const& ring : rings)
+        {
+            mapnik::geometry::linear_ring<double> linear_ring;
+            std::size_t size = 0;
+            bool reverse;
+            for (auto index : ring)
+            {
+                arc_type const* arc = find_arc(arcs_, index, reverse);
+                if (arc) size += arc->size();
+            }
+            linear_ring.reserve(size);
+            for (auto index : ring)
+            {
+                arc_type const* arc = find_arc(arcs_, index, reverse);
+                if (!arc) continue;
+                if (reverse) linear_ring.insert(linear_ring.end(), arc->rbegin(), arc->rend());
+                else linear_ring.insert(linear_ring.end(), arc->begin(), arc->end());
+            }
+            if (first)
+            {
+                first = false;
+                polygon.set_exterior_ring(std::move(linear_ring));
+            }
+            else
+            {
+                polygon.add_hole(std::move(linear_ring));
+            }
+        }
+        boost::geometry::correct(polygon);
+        return polygon;
+    }
+
+    mapnik::topojson::topology const& topo_;
+    std::vector<arc_type> const& arcs_;
+};
+
+// approximate memory held by a geometry
+struct geometry_size_visitor
+{
+    using point_type = mapnik::geometry::point<double>;
+
+    std::size_t operator() (mapnik::geometry::geometry_empty const&) const
+    {
+        return 0;
+    }
+
+    std::size_t operator() (point_type const&) const
+    {
+        return 0;
+    }
+
+    std::size_t operator() (mapnik::geometry::line_string<double> const& line) const
+    {
+        return line.capacity() * sizeof(point_type);
+    }
+
+    std::size_t operator() (mapnik::geometry::linear_ring<double> const& ring) const
+    {
+        return ring.capacity() * sizeof(point_type);
+    }
+
+    std::size_t operator() (mapnik::geometry::multi_point<double> const& points) const
+    {
+        return points.capacity() * sizeof(point_type);
+    }
+
+    std::size_t operator() (mapnik::geometry::polygon<double> const& poly) const
+    {
+        std::size_t size = (*this)(poly.exterior_ring);
+        for (auto const& ring : poly.interior_rings) size += (*this)(ring) + sizeof(ring);
+        return size;
+    }
+
+    template <typename Multi>
+    std::size_t operator() (Multi const& multi) const
+    {
+        std::size_t size = 0;
+        for (auto const& part : multi) size += (*this)(part) + sizeof(part);
+        return size;
+    }
+
+    std::size_t operator() (mapnik::geometry::geometry<double> const& geom) const
+    {
+        return mapnik::util::apply_visitor(*this, geom);
+    }
+};
+
+}
+
+topojson_geometry_cache::topojson_geometry_cache(mapnik::topojson::topology const& topo, std::size_t max_size)
+    : topo_(topo),
+      arcs_(),
+      arc_boxes_(),
+      cache_(max_size)
+{
+    arcs_.reserve(topo.arcs.size());
+    arc_boxes_.reserve(topo.arcs.size());
+    for (auto const& arc : topo.arcs)
+    {
+        arc_type points;
+        points.reserve(arc.coordinates.size());
+        mapnik::box2d<double> box;
+        // quantized arcs are delta encoded
+        double px = 0, py = 0;
+        for (auto const& pt : arc.coordinates)
+        {
+            double x = pt.x;
+            double y = pt.y;
+            if (topo.tr)
+            {
+                x = (px += x) * (*topo.tr).scale_x + (*topo.tr).translate_x;
+                y = (py += y) * (*topo.tr).scale_y + (*topo.tr).translate_y;
+            }
+            if (points.empty()) box.init(x, y, x, y);
+            else box.expand_to_include(x, y);
+            points.emplace_back(x, y);
+        }
+        arcs_.push_back(std::move(points));
+        arc_boxes_.push_back(box);
+    }
+}
+
+mapnik::box2d<double> topojson_geometry_cache::envelope(mapnik::topojson::geometry const& geom) const
+{
+    return mapnik::util::apply_visitor(envelope_visitor(topo_, arc_boxes_), geom);
+}
+
+topojson_geometry_cache::geometry_type topojson_geometry_cache::assemble(mapnik::topojson::geometry const& geom) const
+{
+    return mapnik::util::apply_visitor(assemble_visitor(topo_, arcs_), geom);
+}
+
+topojson_geometry_cache::geometry_ptr topojson_geometry_cache::get(std::size_t index) const
+{
+    // assembled outside the lock, another thread may do the same meanwhile
+    return cache_.get(index,
+                      [this, index]() { return std::make_shared<const geometry_type>(assemble(topo_.geometries[index])); },
+                      [](geometry_type const& geom) { return sizeof(geometry_type) + geometry_size_visitor()(geom); });
+}
@@ -0,0 +1,66 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef TOPOJSON_GEOMETRY_CACHE_HPP
+#define TOPOJSON_GEOMETRY_CACHE_HPP
+
+// mapnik
+#include <mapnik/box2d.hpp>
+#include <mapnik/geometry.hpp>
+#include <mapnik/json/topology.hpp>
+#include <mapnik/util/lru_cache.hpp>
+#include <mapnik/util/noncopyable.hpp>
+
+// stl
+#include <vector>
+#include <memory>
+
+// The arcs of a topology are dequantized once, when the cache is created, and
+// shared by every geometry which references them. Geometries are stitched
+// together from the arcs on first use and kept in a least recently used cache
+// of up to `max_size` bytes (0 disables it).
+class topojson_geometry_cache : private mapnik::util::noncopyable
+{
+public:
+    using geometry_type = mapnik::geometry::geometry<double>;
+    using geometry_ptr = std::shared_ptr<const geometry_type>;
+    using arc_type = std::vector<mapnik::geometry::point<double> >;
+
+    topojson_geometry_cache(mapnik::topojson::topology const& topo, std::size_t max_size);
+
+    // bounding box of a geometry from the boxes of its arcs
+    mapnik::box2d<double> envelope(mapnik::topojson::geometry const& geom) const;
+    // geometry of topo.geometries[index], assembled if it is not cached
+    geometry_ptr get(std::size_t index) const;
+
+    std::size_t size() const { return cache_.size(); }
+
+private:
+    geometry_type assemble(mapnik::topojson::geometry const& geom) const;
+
+    mapnik::topojson::topology const& topo_;
+    std::vector<arc_type> arcs_;
+    std::vector<mapnik::box2d<double> > arc_boxes_;
+    mutable mapnik::util::lru_cache<std::size_t, geometry_type> cache_;
+};
+
+#endif // TOPOJSON_GEOMETRY_CACHE_HPP
@@ -196,6 +196,7 @@ source = Split(
     rule.cpp
     save_map.cpp
     wkb.cpp
+    twkb.cpp
     projection.cpp
     proj_transform.cpp
     scale_denominator.cpp
@@ -208,6 +209,7 @@ source = Split(
     unicode.cpp
     raster_colorizer.cpp
     mapped_memory_cache.cpp
+    parallel.cpp
     marker_cache.cpp
     svg/svg_parser.cpp
     svg/svg_path_parser.cpp
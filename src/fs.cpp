@@ -71,6 +71,17 @@ namespace util {
 #endif
     }
 
+    std::time_t last_write_time(std::string const& filepath)
+    {
+        boost::system::error_code ec;
+#ifdef _WINDOWS
+        std::time_t time = boost::filesystem::last_write_time(mapnik::utf8_to_utf16(filepath), ec);
+#else
+        std::time_t time = boost::filesystem::last_write_time(filepath, ec);
+#endif
+        return ec ? 0 : time;
+    }
+
     bool is_relative(std::string const& filepath)
     {
 
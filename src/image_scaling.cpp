@@ -24,6 +24,7 @@
 #include <mapnik/image.hpp>
 #include <mapnik/image_scaling.hpp>
 #include <mapnik/image_scaling_traits.hpp>
+#include <mapnik/util/parallel.hpp>
 // does not handle alpha correctly
 //#include <mapnik/span_image_filter.hpp>
 
@@ -51,6 +52,11 @@
 #include "agg_trans_affine.h"
 #include "agg_image_filters.h"
 
+// stl
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+
 namespace mapnik
 {
 
@@ -97,11 +103,201 @@ boost::optional<std::string> scaling_method_to_string(scaling_method_e scaling_m
     return mode;
 }
 
+namespace detail {
+
+// source pixels contributing to each target pixel along one axis, taken from
+// agg::span_image_resample_affine and normalized
+struct scaling_weights
+{
+    unsigned taps = 0;           // weights per target pixel, zero padded
+    std::vector<int> first;      // first source pixel of each target pixel
+    std::vector<float> weights;
+};
+
+void scaling_radius(double scale_x, double scale_y, int & rx, int & rx_inv, int & ry, int & ry_inv)
+{
+    // as in agg::span_image_resample_affine::prepare()
+    double const scale_limit = 200.0;
+    if (scale_x * scale_y > scale_limit)
+    {
+        scale_x = scale_x * scale_limit / (scale_x * scale_y);
+        scale_y = scale_y * scale_limit / (scale_x * scale_y);
+    }
+    scale_x = std::min(std::max(scale_x, 1.0), scale_limit);
+    scale_y = std::min(std::max(scale_y, 1.0), scale_limit);
+    rx = agg::uround(scale_x * double(agg::image_subpixel_scale));
+    rx_inv = agg::uround(1.0 / scale_x * double(agg::image_subpixel_scale));
+    ry = agg::uround(scale_y * double(agg::image_subpixel_scale));
+    ry_inv = agg::uround(1.0 / scale_y * double(agg::image_subpixel_scale));
+}
+
+// `centers` are the source positions of the target pixel centers (in subpixels)
+void scaling_weights_init(scaling_weights & w, std::vector<int> const& centers, int source_size,
+                          int r, int r_inv, agg::image_filter_lut const& filter)
+{
+    int target_size = static_cast<int>(centers.size());
+    int diameter = static_cast<int>(filter.diameter());
+    int filter_scale = diameter << agg::image_subpixel_shift;
+    int radius = (diameter * r) >> 1;
+    agg::int16 const* weight_array = filter.weight_array();
+    int taps = std::min(filter_scale / r_inv + 2, source_size);
+    w.taps = static_cast<unsigned>(taps);
+    w.first.resize(target_size);
+    w.weights.assign(static_cast<std::size_t>(target_size) * taps, 0.0f);
+    for (int i = 0; i < target_size; ++i)
+    {
+        int x = centers[i] + agg::image_subpixel_scale / 2 - radius;
+        int x_lr = x >> agg::image_subpixel_shift;
+        int x_hr = ((agg::image_subpixel_mask - (x & agg::image_subpixel_mask)) * r_inv) >> agg::image_subpixel_shift;
+        // the source is clamped at its edges (agg::image_accessor_clone)
+        int first = std::min(std::min(std::max(x_lr, 0), source_size - 1), source_size - taps);
+        float * weights = &w.weights[static_cast<std::size_t>(i) * taps];
+        float total = 0.0f;
+        for (; x_hr < filter_scale; x_hr += r_inv, ++x_lr)
+        {
+            weights[std::min(std::max(x_lr, 0), source_size - 1) - first] += weight_array[x_hr];
+            total += weight_array[x_hr];
+        }
+        if (total != 0.0f)
+        {
+            for (int k = 0; k < taps; ++k) weights[k] /= total;
+        }
+        w.first[i] = first;
+    }
+}
 
+// Separable version of span_image_resample_rgba_affine: source rows are filtered
+// horizontally, then combined vertically into the target rows. Only handles
+// the whole target (no offsets), the other cases go through AGG.
 template <typename T>
-void scale_image_agg(T & target, T const& source, scaling_method_e scaling_method,
-                     double image_ratio_x, double image_ratio_y, double x_off_f, double y_off_f,
-                     double filter_factor)
+bool scale_image_separable(T &, T const&, scaling_method_e, double, double, double, double, double)
+{
+    return false;
+}
+
+bool scale_image_separable(image_rgba8 & target, image_rgba8 const& source, scaling_method_e scaling_method,
+                           double image_ratio_x, double image_ratio_y, double x_off_f, double y_off_f,
+                           double filter_factor)
+{
+    if (scaling_method == SCALING_NEAR || x_off_f != 0.0 || y_off_f != 0.0 ||
+        image_ratio_x <= 0.0 || image_ratio_y <= 0.0 ||
+        source.width() == 0 || source.height() == 0)
+    {
+        return false;
+    }
+    agg::image_filter_lut filter;
+    set_scaling_method(filter, scaling_method, filter_factor);
+    int rx, rx_inv, ry, ry_inv;
+    scaling_radius(1.0 / image_ratio_x, 1.0 / image_ratio_y, rx, rx_inv, ry, ry_inv);
+
+    std::size_t width = target.width();
+    std::size_t height = target.height();
+    std::size_t source_width = source.width();
+    // rows are one span for agg::span_interpolator_linear, which steps along x
+    std::vector<int> centers(width);
+    agg::dda2_line_interpolator li_x(agg::iround(0.5 / image_ratio_x * agg::image_subpixel_scale),
+                                     agg::iround((width + 0.5) / image_ratio_x * agg::image_subpixel_scale),
+                                     static_cast<int>(width));
+    for (std::size_t x = 0; x < width; ++x, ++li_x)
+    {
+        centers[x] = li_x.y();
+    }
+    scaling_weights wx;
+    scaling_weights_init(wx, centers, static_cast<int>(source_width), rx, rx_inv, filter);
+    centers.resize(height);
+    for (std::size_t y = 0; y < height; ++y)
+    {
+        centers[y] = agg::iround((y + 0.5) / image_ratio_y * agg::image_subpixel_scale);
+    }
+    scaling_weights wy;
+    scaling_weights_init(wy, centers, static_cast<int>(source.height()), ry, ry_inv, filter);
+
+    auto render_rows = [&](std::size_t row0, std::size_t row1)
+    {
+        std::vector<float> rows;
+        std::vector<float> acc(width * 4);
+        // chunks of target rows keep the horizontally filtered source rows small
+        for (std::size_t chunk0 = row0; chunk0 < row1; chunk0 += 64)
+        {
+            std::size_t chunk1 = std::min(chunk0 + 64, row1);
+            std::size_t src0 = wy.first[chunk0];
+            std::size_t src1 = wy.first[chunk1 - 1] + wy.taps;
+            rows.resize((src1 - src0) * width * 4);
+            for (std::size_t sy = src0; sy < src1; ++sy)
+            {
+                std::uint8_t const* src_row = source.getBytes() + sy * source_width * 4;
+                float * out = &rows[(sy - src0) * width * 4];
+                for (std::size_t x = 0; x < width; ++x)
+                {
+                    std::uint8_t const* p = src_row + wx.first[x] * 4;
+                    float const* w = &wx.weights[x * wx.taps];
+                    float r = 0.0f, g = 0.0f, b = 0.0f, a = 0.0f;
+                    for (unsigned k = 0; k < wx.taps; ++k, p += 4)
+                    {
+                        r += w[k] * p[0];
+                        g += w[k] * p[1];
+                        b += w[k] * p[2];
+                        a += w[k] * p[3];
+                    }
+                    out[x * 4] = r;
+                    out[x * 4 + 1] = g;
+                    out[x * 4 + 2] = b;
+                    out[x * 4 + 3] = a;
+                }
+            }
+            for (std::size_t y = chunk0; y < chunk1; ++y)
+            {
+                std::fill(acc.begin(), acc.end(), 0.0f);
+                float const* w = &wy.weights[y * wy.taps];
+                for (unsigned k = 0; k < wy.taps; ++k)
+                {
+                    if (w[k] == 0.0f) continue;
+                    float const* in = &rows[(wy.first[y] + k - src0) * width * 4];
+                    float weight = w[k];
+                    for (std::size_t i = 0; i < width * 4; ++i)
+                    {
+                        acc[i] += weight * in[i];
+                    }
+                }
+                std::uint8_t * p = target.getBytes() + y * width * 4;
+                for (std::size_t x = 0; x < width; ++x, p += 4)
+                {
+                    // clamped like span_image_resample_rgba_affine (premultiplied)
+                    int a = std::min(std::max(static_cast<int>(acc[x * 4 + 3] + 0.5f), 0), 255);
+                    int r = std::min(std::max(static_cast<int>(acc[x * 4] + 0.5f), 0), a);
+                    int g = std::min(std::max(static_cast<int>(acc[x * 4 + 1] + 0.5f), 0), a);
+                    int b = std::min(std::max(static_cast<int>(acc[x * 4 + 2] + 0.5f), 0), a);
+                    // blended like agg::pixfmt_rgba32_pre
+                    if (a == 255)
+                    {
+                        p[0] = r; p[1] = g; p[2] = b; p[3] = 255;
+                    }
+                    else if (a > 0)
+                    {
+                        unsigned alpha = 255 - a;
+                        p[0] = static_cast<std::uint8_t>(((p[0] * alpha) >> 8) + r);
+                        p[1] = static_cast<std::uint8_t>(((p[1] * alpha) >> 8) + g);
+                        p[2] = static_cast<std::uint8_t>(((p[2] * alpha) >> 8) + b);
+                        p[3] = static_cast<std::uint8_t>(255 - ((alpha * (255 - p[3])) >> 8));
+                    }
+                }
+            }
+        }
+    };
+
+    // bands of at least 64 rows, small targets are not worth the threads
+    mapnik::util::parallel_for(height, 64, render_rows);
+    return true;
+}
+
+}
+
+namespace detail {
+
+template <typename T>
+void scale_image_spans(T & target, T const& source, scaling_method_e scaling_method,
+                       double image_ratio_x, double image_ratio_y, double x_off_f, double y_off_f,
+                       double filter_factor)
 {
     // "the image filters should work namely in the premultiplied color space"
     // http://old.nabble.com/Re:--AGG--Basic-image-transformations-p1110665.html
@@ -165,6 +361,24 @@ void scale_image_agg(T & target, T const& source, scaling_method_e scaling_metho
 
 }
 
+template MAPNIK_DECL void scale_image_spans(image_rgba8 &, image_rgba8 const&, scaling_method_e,
+                                            double, double , double, double , double);
+
+}
+
+template <typename T>
+void scale_image_agg(T & target, T const& source, scaling_method_e scaling_method,
+                     double image_ratio_x, double image_ratio_y, double x_off_f, double y_off_f,
+                     double filter_factor)
+{
+    if (!detail::scale_image_separable(target, source, scaling_method, image_ratio_x, image_ratio_y,
+                                       x_off_f, y_off_f, filter_factor))
+    {
+        detail::scale_image_spans(target, source, scaling_method, image_ratio_x, image_ratio_y,
+                                  x_off_f, y_off_f, filter_factor);
+    }
+}
+
 template MAPNIK_DECL void scale_image_agg(image_rgba8 &, image_rgba8 const&, scaling_method_e,
                               double, double , double, double , double);
 
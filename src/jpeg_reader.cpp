@@ -87,8 +87,14 @@ public:
     inline bool has_alpha() const final { return false; }
     void read(unsigned x,unsigned y,image_rgba8& image) final;
     image_any read(unsigned x, unsigned y, unsigned width, unsigned height) final;
+    // decoded at 1/2, 1/4 or 1/8 of the size with libjpeg's scaled inverse DCT
+    unsigned overviews() const final { return 3; }
+    unsigned overview_width(unsigned level) const final;
+    unsigned overview_height(unsigned level) const final;
+    image_any read_overview(unsigned level, unsigned x, unsigned y, unsigned width, unsigned height) final;
 private:
     void init();
+    void read_scaled(unsigned level, unsigned x, unsigned y, image_rgba8& image);
     static void on_error(j_common_ptr cinfo);
     static void on_error_message(j_common_ptr cinfo);
     static void init_source(j_decompress_ptr cinfo);
@@ -264,9 +270,30 @@ boost::optional<box2d<double> > jpeg_reader<T>::bounding_box() const
     return boost::optional<box2d<double> >();
 }
 
+template <typename T>
+unsigned jpeg_reader<T>::overview_width(unsigned level) const
+{
+    if (level > overviews()) throw image_reader_exception("JPEG Reader: no such overview");
+    return (width_ + (1u << level) - 1) >> level;
+}
+
+template <typename T>
+unsigned jpeg_reader<T>::overview_height(unsigned level) const
+{
+    if (level > overviews()) throw image_reader_exception("JPEG Reader: no such overview");
+    return (height_ + (1u << level) - 1) >> level;
+}
+
 template <typename T>
 void jpeg_reader<T>::read(unsigned x0, unsigned y0, image_rgba8& image)
 {
+    read_scaled(0, x0, y0, image);
+}
+
+template <typename T>
+void jpeg_reader<T>::read_scaled(unsigned level, unsigned x0, unsigned y0, image_rgba8& image)
+{
+    if (level > overviews()) throw image_reader_exception("JPEG Reader: no such overview");
     stream_.clear();
     stream_.seekg(0, std::ios_base::beg);
 
@@ -280,26 +307,45 @@ void jpeg_reader<T>::read(unsigned x0, unsigned y0, image_rgba8& image)
     attach_stream(&cinfo, &stream_);
     int ret = jpeg_read_header(&cinfo, TRUE);
     if (ret != JPEG_HEADER_OK) throw image_reader_exception("JPEG Reader read(): failed to read header");
+    cinfo.scale_num = 1;
+    cinfo.scale_denom = 1u << level;
     jpeg_start_decompress(&cinfo);
+    if (x0 >= cinfo.output_width || y0 >= cinfo.output_height)
+    {
+        jpeg_abort_decompress(&cinfo);
+        return;
+    }
+    unsigned w = std::min(unsigned(image.width()), unsigned(cinfo.output_width) - x0);
+    unsigned h = std::min(unsigned(image.height()), unsigned(cinfo.output_height) - y0);
+    if (w == 0 || h == 0)
+    {
+        jpeg_abort_decompress(&cinfo);
+        return;
+    }
+    JDIMENSION crop_x = x0;
+#if defined(LIBJPEG_TURBO_VERSION_NUMBER)
+    // only decode the columns (from the iMCU boundary left of x0) and rows of the window
+    JDIMENSION crop_width = w;
+    jpeg_crop_scanline(&cinfo, &crop_x, &crop_width);
+    jpeg_skip_scanlines(&cinfo, y0);
+#endif
+    unsigned dx = x0 - crop_x;
     JSAMPARRAY buffer;
     int row_stride;
     unsigned char a,r,g,b;
     row_stride = cinfo.output_width * cinfo.output_components;
     buffer = (*cinfo.mem->alloc_sarray) ((j_common_ptr) &cinfo, JPOOL_IMAGE, row_stride, 1);
 
-    unsigned w = std::min(unsigned(image.width()),width_ - x0);
-    unsigned h = std::min(unsigned(image.height()),height_ - y0);
-
     const std::unique_ptr<unsigned int[]> out_row(new unsigned int[w]);
-    unsigned row = 0;
-    while (cinfo.output_scanline < cinfo.output_height)
+    while (cinfo.output_scanline < y0 + h)
     {
+        unsigned row = cinfo.output_scanline;
         jpeg_read_scanlines(&cinfo, buffer, 1);
-        if (row >= y0 && row < y0 + h)
+        if (row >= y0)
         {
             for (unsigned int x = 0; x < w; ++x)
             {
-                unsigned col = x + x0;
+                unsigned col = x + dx;
                 a = 255; // alpha not supported in jpg
                 r = buffer[0][cinfo.output_components * col];
                 if (cinfo.output_components > 2)
@@ -314,9 +360,9 @@ void jpeg_reader<T>::read(unsigned x0, unsigned y0, image_rgba8& image)
             }
             image.setRow(row - y0, out_row.get(), w);
         }
-        ++row;
     }
-    jpeg_finish_decompress(&cinfo);
+    // the rows below the window are never decoded
+    jpeg_abort_decompress(&cinfo);
 }
 
 template <typename T>
@@ -327,4 +373,12 @@ image_any jpeg_reader<T>::read(unsigned x, unsigned y, unsigned width, unsigned
     return image_any(std::move(data));
 }
 
+template <typename T>
+image_any jpeg_reader<T>::read_overview(unsigned level, unsigned x, unsigned y, unsigned width, unsigned height)
+{
+    image_rgba8 data(width,height, true, true);
+    read_scaled(level, x, y, data);
+    return image_any(std::move(data));
+}
+
 }
@@ -0,0 +1,901 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+// mapnik
+#include <mapnik/json/geojson_reader.hpp>
+#include <mapnik/feature_factory.hpp>
+#include <mapnik/geometry_types.hpp>
+#include <mapnik/value.hpp>
+#include <mapnik/util/conversions.hpp>
+// stl
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <limits>
+
+namespace mapnik { namespace json {
+
+namespace {
+
+enum char_class : std::uint8_t
+{
+    other = 0,
+    space = 1,
+    digit = 2
+};
+
+// classes of all 256 byte values, looked up instead of chains of comparisons
+struct char_class_table
+{
+    char_class_table()
+    {
+        std::memset(classes, other, sizeof(classes));
+        // same set as ascii::space
+        for (unsigned char c : {' ', '\t', '\n', '\v', '\f', '\r'}) classes[c] = space;
+        for (unsigned char c = '0'; c <= '9'; ++c) classes[c] = digit;
+    }
+    std::uint8_t classes[256];
+};
+
+const char_class_table char_classes;
+
+inline bool is_space(char c)
+{
+    return char_classes.classes[static_cast<unsigned char>(c)] == space;
+}
+
+inline bool is_digit(char c)
+{
+    return char_classes.classes[static_cast<unsigned char>(c)] == digit;
+}
+
+// a word has a zero byte when subtracting one from each byte borrows into a
+// byte whose high bit was clear, so xor with `c` in every byte finds `c`
+const std::uint64_t low_bits = 0x0101010101010101ULL;
+const std::uint64_t high_bits = 0x8080808080808080ULL;
+
+inline std::uint64_t has_byte(std::uint64_t word, unsigned char c)
+{
+    std::uint64_t v = word ^ (low_bits * c);
+    return (v - low_bits) & ~v & high_bits;
+}
+
+// first '"' or '\\' in [itr, end), eight bytes at a time while neither is found
+inline char const* find_quote_or_escape(char const* itr, char const* end)
+{
+    while (end - itr >= 8)
+    {
+        std::uint64_t word;
+        std::memcpy(&word, itr, 8);
+        if (has_byte(word, '"') | has_byte(word, '\\')) break;
+        itr += 8;
+    }
+    while (itr != end && *itr != '"' && *itr != '\\') ++itr;
+    return itr;
+}
+
+template <std::size_t N>
+inline bool equals(char const* begin, char const* end, char const (&str)[N])
+{
+    return static_cast<std::size_t>(end - begin) == N - 1 && std::memcmp(begin, str, N - 1) == 0;
+}
+
+void push_utf8(std::string & utf8, std::uint32_t code_point)
+{
+    if (code_point < 0x80)
+    {
+        utf8 += static_cast<char>(code_point);
+    }
+    else if (code_point < 0x800)
+    {
+        utf8 += static_cast<char>(0xC0 | (code_point >> 6));
+        utf8 += static_cast<char>(0x80 | (code_point & 0x3F));
+    }
+    else if (code_point < 0x10000)
+    {
+        utf8 += static_cast<char>(0xE0 | (code_point >> 12));
+        utf8 += static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+        utf8 += static_cast<char>(0x80 | (code_point & 0x3F));
+    }
+    else
+    {
+        utf8 += static_cast<char>(0xF0 | (code_point >> 18));
+        utf8 += static_cast<char>(0x80 | ((code_point >> 12) & 0x3F));
+        utf8 += static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+        utf8 += static_cast<char>(0x80 | (code_point & 0x3F));
+    }
+}
+
+inline int hex_digit(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// exactly `count` hex digits
+bool parse_hex(char const*& itr, char const* end, int count, std::uint32_t & code_point)
+{
+    if (end - itr < count) return false;
+    code_point = 0;
+    for (int i = 0; i < count; ++i)
+    {
+        int d = hex_digit(*itr++);
+        if (d < 0) return false;
+        code_point = (code_point << 4) | d;
+    }
+    return true;
+}
+
+// powers of ten which are exact doubles
+const double exact_powers_of_ten[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+class geojson_reader
+{
+public:
+    geojson_reader(char const* start, char const* end, mapnik::transcoder const* tr)
+        : itr_(start),
+          end_(end),
+          tr_(tr) {}
+
+    char const* position() const { return itr_; }
+
+    bool geometry(mapnik::geometry::geometry<double> & geom)
+    {
+        if (literal("null")) return true;
+        if (!consume('{')) return false;
+        int type = mapnik::geometry::geometry_types::Unknown;
+        // "coordinates"/"geometries" before "type" are parsed once the type is known
+        char const* deferred_coordinates = nullptr;
+        char const* deferred_geometries = nullptr;
+        if (!consume('}'))
+        {
+            do
+            {
+                char const* key_begin;
+                char const* key_end;
+                if (!key(key_begin, key_end)) return false;
+                if (equals(key_begin, key_end, "type"))
+                {
+                    char const* begin;
+                    char const* end;
+                    bool escaped;
+                    if (!string(begin, end, escaped)) return false;
+                    type = geometry_type(begin, end);
+                    if (type == mapnik::geometry::geometry_types::Unknown) return false;
+                }
+                else if (equals(key_begin, key_end, "coordinates") &&
+                         type != mapnik::geometry::geometry_types::GeometryCollection)
+                {
+                    if (type == mapnik::geometry::geometry_types::Unknown)
+                    {
+                        skip_space();
+                        deferred_coordinates = itr_;
+                        if (!skip_value()) return false;
+                    }
+                    else if (!coordinates(type, geom)) return false;
+                }
+                else if (equals(key_begin, key_end, "geometries") &&
+                         (type == mapnik::geometry::geometry_types::Unknown ||
+                          type == mapnik::geometry::geometry_types::GeometryCollection))
+                {
+                    if (type == mapnik::geometry::geometry_types::Unknown)
+                    {
+                        skip_space();
+                        deferred_geometries = itr_;
+                        if (!skip_value()) return false;
+                    }
+                    else if (!geometries(geom)) return false;
+                }
+                else if (!skip_value()) return false;
+            }
+            while (consume(','));
+            if (!consume('}')) return false;
+        }
+        bool collection = (type == mapnik::geometry::geometry_types::GeometryCollection);
+        char const* deferred = collection ? deferred_geometries : deferred_coordinates;
+        if (deferred && type != mapnik::geometry::geometry_types::Unknown)
+        {
+            char const* itr = itr_;
+            itr_ = deferred;
+            bool result = collection ? geometries(geom) : coordinates(type, geom);
+            itr_ = itr;
+            if (!result) return false;
+        }
+        return true;
+    }
+
+    bool feature(mapnik::feature_impl & feature)
+    {
+        if (!consume('{')) return false;
+        if (consume('}')) return true;
+        do
+        {
+            char const* key_begin;
+            char const* key_end;
+            if (!key(key_begin, key_end)) return false;
+            if (equals(key_begin, key_end, "geometry"))
+            {
+                mapnik::geometry::geometry<double> geom;
+                if (!geometry(geom)) return false;
+                feature.set_geometry(std::move(geom));
+            }
+            else if (equals(key_begin, key_end, "properties"))
+            {
+                if (!properties(feature)) return false;
+            }
+            else if (!skip_value()) return false;
+        }
+        while (consume(','));
+        return consume('}');
+    }
+
+    bool features(mapnik::context_ptr const& ctx, std::size_t & start_id,
+                  std::vector<mapnik::feature_ptr> & features)
+    {
+        enum { collection, single_feature, single_geometry } kind = collection;
+        skip_space();
+        char const* begin = itr_;
+        // find out what the top level object is from its "type" or "features" member,
+        // objects with neither are collections without features (as with the grammar)
+        if (literal("null"))
+        {
+            kind = single_geometry;
+        }
+        else
+        {
+            if (!consume('{')) return false;
+            if (!consume('}'))
+            {
+                do
+                {
+                    char const* key_begin;
+                    char const* key_end;
+                    if (!key(key_begin, key_end)) return false;
+                    if (equals(key_begin, key_end, "features")) break;
+                    if (equals(key_begin, key_end, "type"))
+                    {
+                        char const* type_begin;
+                        char const* type_end;
+                        bool escaped;
+                        if (!string(type_begin, type_end, escaped)) return false;
+                        if (equals(type_begin, type_end, "Feature")) kind = single_feature;
+                        else if (!equals(type_begin, type_end, "FeatureCollection")) kind = single_geometry;
+                        break;
+                    }
+                    if (!skip_value()) return false;
+                }
+                while (consume(','));
+            }
+        }
+        itr_ = begin;
+
+        if (kind == single_feature)
+        {
+            mapnik::feature_ptr f(mapnik::feature_factory::create(ctx, start_id));
+            if (!feature(*f)) return false;
+            features.push_back(f);
+            return true;
+        }
+        if (kind == single_geometry)
+        {
+            mapnik::feature_ptr f(mapnik::feature_factory::create(ctx, start_id));
+            mapnik::geometry::geometry<double> geom;
+            if (!geometry(geom)) return false;
+            f->set_geometry(std::move(geom));
+            features.push_back(f);
+            return true;
+        }
+
+        if (!consume('{')) return false;
+        if (consume('}')) return true;
+        do
+        {
+            char const* key_begin;
+            char const* key_end;
+            if (!key(key_begin, key_end)) return false;
+            if (equals(key_begin, key_end, "features"))
+            {
+                if (!consume('[')) return false;
+                if (!consume(']'))
+                {
+                    do
+                    {
+                        mapnik::feature_ptr f(mapnik::feature_factory::create(ctx, start_id));
+                        if (!feature(*f)) return false;
+                        features.push_back(f);
+                        ++start_id;
+                    }
+                    while (consume(','));
+                    if (!consume(']')) return false;
+                }
+            }
+            else if (!skip_value()) return false;
+        }
+        while (consume(','));
+        return consume('}');
+    }
+
+private:
+    void skip_space()
+    {
+        while (itr_ != end_ && is_space(*itr_)) ++itr_;
+    }
+
+    bool consume(char c)
+    {
+        skip_space();
+        if (itr_ != end_ && *itr_ == c)
+        {
+            ++itr_;
+            return true;
+        }
+        return false;
+    }
+
+    template <std::size_t N>
+    bool literal(char const (&str)[N])
+    {
+        skip_space();
+        if (static_cast<std::size_t>(end_ - itr_) >= N - 1 && std::memcmp(itr_, str, N - 1) == 0)
+        {
+            itr_ += N - 1;
+            return true;
+        }
+        return false;
+    }
+
+    // [begin, end) is the raw content between the quotes
+    bool string(char const*& begin, char const*& end, bool & escaped)
+    {
+        if (!consume('"')) return false;
+        begin = itr_;
+        escaped = false;
+        for (;;)
+        {
+            itr_ = find_quote_or_escape(itr_, end_);
+            if (itr_ == end_) return false;
+            if (*itr_ == '"') break;
+            escaped = true;
+            if (end_ - itr_ < 2) return false;
+            itr_ += 2;
+        }
+        end = itr_++;
+        return true;
+    }
+
+    // the escapes of the unicode_string grammar
+    bool unescape(char const* itr, char const* end, std::string & out) const
+    {
+        out.clear();
+        while (itr != end)
+        {
+            char const* next = static_cast<char const*>(std::memchr(itr, '\\', end - itr));
+            if (!next)
+            {
+                out.append(itr, end);
+                break;
+            }
+            out.append(itr, next);
+            itr = next + 1;
+            if (itr == end) return false;
+            std::uint32_t code_point = 0;
+            switch (*itr++)
+            {
+            case 'x':
+            {
+                int d;
+                if (itr == end || hex_digit(*itr) < 0) return false;
+                while (itr != end && (d = hex_digit(*itr)) >= 0)
+                {
+                    code_point = (code_point << 4) | d;
+                    if (code_point > 0x10FFFF) return false;
+                    ++itr;
+                }
+                push_utf8(out, code_point);
+                break;
+            }
+            case 'u':
+            {
+                if (!parse_hex(itr, end, 4, code_point)) return false;
+                // a surrogate pair is one code point
+                if (code_point >= 0xD800 && code_point < 0xDC00 && end - itr >= 6 &&
+                    itr[0] == '\\' && itr[1] == 'u')
+                {
+                    std::uint32_t low;
+                    char const* low_itr = itr + 2;
+                    if (parse_hex(low_itr, end, 4, low) && low >= 0xDC00 && low < 0xE000)
+                    {
+                        code_point = 0x10000 + ((code_point - 0xD800) << 10) + (low - 0xDC00);
+                        itr = low_itr;
+                    }
+                }
+                push_utf8(out, code_point);
+                break;
+            }
+            case 'U':
+                if (!parse_hex(itr, end, 8, code_point) || code_point > 0x10FFFF) return false;
+                push_utf8(out, code_point);
+                break;
+            case ' ': out += ' '; break;
+            case '\t': out += '\t'; break;
+            case '0': out += char(0); break;
+            case 'a': out += char(0x7); break;
+            case 'b': out += char(0x8); break;
+            case 't': out += char(0x9); break;
+            case 'n': out += char(0xA); break;
+            case 'v': out += char(0xB); break;
+            case 'f': out += char(0xC); break;
+            case 'r':  out += char(0xD); break;
+            case 'e': out += char(0x1B); break;
+            case '"': out += '"'; break;
+            case '/': out += '/'; break;
+            case '\\': out += '\\'; break;
+            case '_': push_utf8(out, 0xA0); break;
+            case 'N': push_utf8(out, 0x85); break;
+            case 'L': push_utf8(out, 0x2028); break;
+            case 'P': push_utf8(out, 0x2029); break;
+            case '\r':
+                // escaped end of line, continues on the next one
+                if (itr != end && *itr == '\n') ++itr;
+                break;
+            case '\n':
+                break;
+            default:
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // member name followed by ':', unescaped into key_ when needed
+    bool key(char const*& begin, char const*& end)
+    {
+        bool escaped;
+        if (!string(begin, end, escaped)) return false;
+        if (escaped)
+        {
+            if (!unescape(begin, end, key_)) return false;
+            begin = key_.data();
+            end = begin + key_.size();
+        }
+        return consume(':');
+    }
+
+    // numbers with a fraction or an exponent are doubles, others integers
+    // (when they fit) as with the strict_double | int_ alternative
+    bool number(double & value, mapnik::value_integer & integer, bool & is_integer)
+    {
+        skip_space();
+        char const* begin = itr_;
+        bool negative = false;
+        if (itr_ != end_ && (*itr_ == '-' || *itr_ == '+'))
+        {
+            negative = (*itr_ == '-');
+            ++itr_;
+        }
+        // up to 19 significant digits are exact in the mantissa
+        std::uint64_t mantissa = 0;
+        int significant = 0;
+        int exponent = 0;
+        bool truncated = false;
+        bool digits = false;
+        bool strict = false;
+        for (; itr_ != end_ && is_digit(*itr_); ++itr_)
+        {
+            digits = true;
+            if (significant < 19)
+            {
+                mantissa = mantissa * 10 + (*itr_ - '0');
+                if (mantissa != 0) ++significant;
+            }
+            else
+            {
+                truncated = truncated || *itr_ != '0';
+                ++exponent;
+            }
+        }
+        if (itr_ != end_ && *itr_ == '.')
+        {
+            strict = true;
+            for (++itr_; itr_ != end_ && is_digit(*itr_); ++itr_)
+            {
+                digits = true;
+                if (significant < 19)
+                {
+                    mantissa = mantissa * 10 + (*itr_ - '0');
+                    if (mantissa != 0) ++significant;
+                    --exponent;
+                }
+                else
+                {
+                    truncated = truncated || *itr_ != '0';
+                }
+            }
+        }
+        if (!digits)
+        {
+            itr_ = begin;
+            return false;
+        }
+        if (itr_ != end_ && (*itr_ == 'e' || *itr_ == 'E'))
+        {
+            // an 'e' without digits is not part of the number
+            char const* itr = itr_ + 1;
+            bool negative_exponent = false;
+            if (itr != end_ && (*itr == '-' || *itr == '+'))
+            {
+                negative_exponent = (*itr == '-');
+                ++itr;
+            }
+            if (itr != end_ && is_digit(*itr))
+            {
+                strict = true;
+                int e = 0;
+                for (; itr != end_ && is_digit(*itr); ++itr)
+                {
+                    if (e < 100000) e = e * 10 + (*itr - '0');
+                }
+                exponent += negative_exponent ? -e : e;
+                itr_ = itr;
+            }
+        }
+        is_integer = !strict && !truncated && exponent == 0 &&
+            mantissa <= static_cast<std::uint64_t>(std::numeric_limits<mapnik::value_integer>::max());
+        if (is_integer)
+        {
+            integer = negative ? -static_cast<mapnik::value_integer>(mantissa)
+                : static_cast<mapnik::value_integer>(mantissa);
+        }
+        if (!truncated && mantissa <= (std::uint64_t(1) << 53) && exponent >= -22 && exponent <= 22)
+        {
+            // both operands are exact, so the result is correctly rounded
+            value = static_cast<double>(mantissa);
+            if (exponent < 0) value /= exact_powers_of_ten[-exponent];
+            else value *= exact_powers_of_ten[exponent];
+            if (negative) value = -value;
+            return true;
+        }
+        return mapnik::util::string2double(begin, itr_, value);
+    }
+
+    bool number(double & value)
+    {
+        mapnik::value_integer integer;
+        bool is_integer;
+        return number(value, integer, is_integer);
+    }
+
+    // copies an object or array into `out` without the whitespace between tokens,
+    // or just skips it when `out` is null
+    bool structure(std::string * out)
+    {
+        int depth = 0;
+        skip_space();
+        do
+        {
+            if (itr_ == end_) return false;
+            char c = *itr_;
+            if (c == '"')
+            {
+                char const* begin = itr_;
+                char const* str_begin;
+                char const* str_end;
+                bool escaped;
+                if (!string(str_begin, str_end, escaped)) return false;
+                if (out) out->append(begin, itr_);
+                continue;
+            }
+            if (is_space(c))
+            {
+                ++itr_;
+                continue;
+            }
+            if (c == '{' || c == '[') ++depth;
+            else if (c == '}' || c == ']') --depth;
+            if (out) *out += c;
+            ++itr_;
+        }
+        while (depth > 0);
+        return depth == 0;
+    }
+
+    bool skip_value()
+    {
+        skip_space();
+        if (itr_ == end_) return false;
+        char c = *itr_;
+        if (c == '"')
+        {
+            char const* begin;
+            char const* end;
+            bool escaped;
+            return string(begin, end, escaped);
+        }
+        if (c == '{' || c == '[') return structure(nullptr);
+        if (literal("true") || literal("false") || literal("null")) return true;
+        double value;
+        return number(value);
+    }
+
+    bool properties(mapnik::feature_impl & feature)
+    {
+        if (literal("null")) return true;
+        if (!consume('{')) return false;
+        if (consume('}')) return true;
+        do
+        {
+            char const* begin;
+            char const* end;
+            bool escaped;
+            if (!string(begin, end, escaped)) return false;
+            if (escaped)
+            {
+                if (!unescape(begin, end, key_)) return false;
+            }
+            else
+            {
+                key_.assign(begin, end);
+            }
+            if (!consume(':') || !attribute(feature)) return false;
+        }
+        while (consume(','));
+        return consume('}');
+    }
+
+    bool attribute(mapnik::feature_impl & feature)
+    {
+        skip_space();
+        if (itr_ == end_) return false;
+        switch (*itr_)
+        {
+        case '"':
+        {
+            char const* begin;
+            char const* end;
+            bool escaped;
+            if (!string(begin, end, escaped)) return false;
+            if (!escaped)
+            {
+                // straight from the input
+                feature.put_new(key_, mapnik::value(tr_->transcode(begin, static_cast<std::int32_t>(end - begin))));
+                return true;
+            }
+            if (!unescape(begin, end, buffer_)) return false;
+            break;
+        }
+        case '{':
+        case '[':
+            buffer_.clear();
+            if (!structure(&buffer_)) return false;
+            break;
+        default:
+            if (literal("true")) feature.put_new(key_, mapnik::value(true));
+            else if (literal("false")) feature.put_new(key_, mapnik::value(false));
+            else if (literal("null")) feature.put_new(key_, mapnik::value(mapnik::value_null()));
+            else
+            {
+                double value;
+                mapnik::value_integer integer;
+                bool is_integer;
+                if (!number(value, integer, is_integer)) return false;
+                if (is_integer) feature.put_new(key_, mapnik::value(integer));
+                else feature.put_new(key_, mapnik::value(value));
+            }
+            return true;
+        }
+        feature.put_new(key_, mapnik::value(tr_->transcode(buffer_.data(), static_cast<std::int32_t>(buffer_.size()))));
+        return true;
+    }
+
+    static int geometry_type(char const* begin, char const* end)
+    {
+        using namespace mapnik::geometry;
+        if (equals(begin, end, "Point")) return geometry_types::Point;
+        if (equals(begin, end, "LineString")) return geometry_types::LineString;
+        if (equals(begin, end, "Polygon")) return geometry_types::Polygon;
+        if (equals(begin, end, "MultiPoint")) return geometry_types::MultiPoint;
+        if (equals(begin, end, "MultiLineString")) return geometry_types::MultiLineString;
+        if (equals(begin, end, "MultiPolygon")) return geometry_types::MultiPolygon;
+        if (equals(begin, end, "GeometryCollection")) return geometry_types::GeometryCollection;
+        return geometry_types::Unknown;
+    }
+
+    // [x, y, ...], further dimensions are ignored
+    bool position(double & x, double & y)
+    {
+        if (!consume('[') || !number(x) || !consume(',') || !number(y)) return false;
+        while (consume(','))
+        {
+            double z;
+            if (!number(z)) return false;
+        }
+        return consume(']');
+    }
+
+    template <typename Points>
+    bool positions(Points & points)
+    {
+        if (!consume('[')) return false;
+        if (consume(']')) return true;
+        do
+        {
+            double x, y;
+            if (!position(x, y)) return false;
+            points.emplace_back(x, y);
+        }
+        while (consume(','));
+        return consume(']');
+    }
+
+    bool rings(mapnik::geometry::polygon<double> & poly)
+    {
+        if (!consume('[')) return false;
+        if (consume(']')) return true;
+        if (!positions(poly.exterior_ring)) return false;
+        while (consume(','))
+        {
+            poly.interior_rings.emplace_back();
+            if (!positions(poly.interior_rings.back())) return false;
+        }
+        return consume(']');
+    }
+
+    template <typename Container, typename Parse>
+    bool sequence(Container & container, Parse parse)
+    {
+        if (!consume('[')) return false;
+        if (consume(']')) return true;
+        do
+        {
+            container.emplace_back();
+            if (!parse(container.back())) return false;
+        }
+        while (consume(','));
+        return consume(']');
+    }
+
+    bool coordinates(int type, mapnik::geometry::geometry<double> & geom)
+    {
+        using namespace mapnik::geometry;
+        skip_space();
+        char const* begin = itr_;
+        // empty coordinates give an empty geometry
+        if (consume('[') && consume(']')) return true;
+        itr_ = begin;
+        bool result = false;
+        switch (type)
+        {
+        case geometry_types::Point:
+        {
+            double x, y;
+            result = position(x, y);
+            if (result) geom = point<double>(x, y);
+            break;
+        }
+        case geometry_types::LineString:
+        {
+            line_string<double> line;
+            result = positions(line);
+            // as with create_linestring
+            if (result && line.size() > 1) geom = std::move(line);
+            break;
+        }
+        case geometry_types::Polygon:
+        {
+            polygon<double> poly;
+            result = rings(poly);
+            if (result) geom = std::move(poly);
+            break;
+        }
+        case geometry_types::MultiPoint:
+        {
+            multi_point<double> points;
+            result = positions(points);
+            if (result) geom = std::move(points);
+            break;
+        }
+        case geometry_types::MultiLineString:
+        {
+            multi_line_string<double> lines;
+            result = sequence(lines, [this](line_string<double> & line) { return positions(line); });
+            if (result) geom = std::move(lines);
+            break;
+        }
+        case geometry_types::MultiPolygon:
+        {
+            multi_polygon<double> polys;
+            result = sequence(polys, [this](polygon<double> & poly) { return rings(poly); });
+            if (result) geom = std::move(polys);
+            break;
+        }
+        default:
+            break;
+        }
+        if (!result)
+        {
+            // coordinates nested deeper or shallower than the type needs leave
+            // the geometry empty, as they do with the grammar
+            itr_ = begin;
+            geom = geometry_empty();
+            return skip_value();
+        }
+        return true;
+    }
+
+    bool geometries(mapnik::geometry::geometry<double> & geom)
+    {
+        mapnik::geometry::geometry_collection<double> collection;
+        if (!sequence(collection, [this](mapnik::geometry::geometry<double> & g) { return geometry(g); }))
+        {
+            return false;
+        }
+        geom = std::move(collection);
+        return true;
+    }
+
+    char const* itr_;
+    char const* end_;
+    mapnik::transcoder const* tr_;
+    // reused for unescaped member names and attribute values
+    std::string key_;
+    std::string buffer_;
+};
+
+} // anonymous namespace
+
+bool read_geometry(char const*& start, char const* end,
+                   mapnik::geometry::geometry<double> & geom)
+{
+    geojson_reader reader(start, end, nullptr);
+    bool result = reader.geometry(geom);
+    start = reader.position();
+    return result;
+}
+
+bool read_feature(char const*& start, char const* end,
+                  mapnik::feature_impl & feature,
+                  mapnik::transcoder const& tr)
+{
+    geojson_reader reader(start, end, &tr);
+    bool result = reader.feature(feature);
+    start = reader.position();
+    return result;
+}
+
+bool read_features(char const*& start, char const* end,
+                   mapnik::context_ptr const& ctx,
+                   std::size_t & start_id,
+                   mapnik::transcoder const& tr,
+                   std::vector<mapnik::feature_ptr> & features)
+{
+    geojson_reader reader(start, end, &tr);
+    bool result = reader.features(ctx, start_id, features);
+    start = reader.position();
+    return result;
+}
+
+}}
@@ -1443,6 +1443,13 @@ bool map_parser::parse_raster_colorizer(raster_colorizer_ptr const& rc,
             rc->set_epsilon(*eps);
         }
 
+        // lookup table size for floating point data
+        optional<unsigned> lut_size = node.get_opt_attr<unsigned>("lut-size");
+        if (lut_size)
+        {
+            rc->set_lut_size(*lut_size);
+        }
+
         float maximumValue = -std::numeric_limits<float>::max();
         for (auto const& n : node)
         {
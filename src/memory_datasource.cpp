@@ -28,9 +28,20 @@
 #include <mapnik/memory_featureset.hpp>
 #include <mapnik/boolean.hpp>
 #include <mapnik/geometry_envelope.hpp>
+#include <mapnik/geometry_adapters.hpp>
+#include <mapnik/make_unique.hpp>
+
+// boost
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-parameter"
+#pragma GCC diagnostic ignored "-Wunused-variable"
+#pragma GCC diagnostic ignored "-Wunused-local-typedef"
+#include <boost/geometry/index/rtree.hpp>
+#pragma GCC diagnostic pop
 
 // stl
 #include <algorithm>
+#include <iterator>
 
 using mapnik::datasource;
 using mapnik::parameters;
@@ -39,15 +50,25 @@ DATASOURCE_PLUGIN(mapnik::memory_datasource)
 
 namespace mapnik {
 
+struct memory_datasource::spatial_index
+{
+    using value_type = std::pair<box2d<double>, std::size_t>;
+    using tree_type = boost::geometry::index::rtree<value_type, boost::geometry::index::linear<16,4> >;
+
+    template <typename Iterator>
+    spatial_index(Iterator begin, Iterator end)
+        : tree(begin, end) {}
+
+    tree_type tree;
+};
+
 struct accumulate_extent
 {
     accumulate_extent(box2d<double> & ext)
         : ext_(ext),first_(true) {}
 
-    void operator() (feature_ptr const& feat)
+    void operator() (box2d<double> const& bbox)
     {
-        auto const& geom = feat->get_geometry();
-        auto bbox = geometry::envelope(geom);
         if ( first_ )
         {
             first_ = false;
@@ -73,7 +94,9 @@ memory_datasource::memory_datasource(parameters const& params)
       desc_(memory_datasource::name(),
             *params.get<std::string>("encoding","utf-8")),
       type_(datasource::Vector),
-      bbox_check_(*params.get<boolean_type>("bbox_check", true)) {}
+      bbox_check_(*params.get<boolean_type>("bbox_check", true)),
+      extent_(),
+      index_() {}
 
 memory_datasource::~memory_datasource() {}
 
@@ -81,7 +104,41 @@ void memory_datasource::push(feature_ptr feature)
 {
     // TODO - collect attribute descriptors?
     //desc_.add_descriptor(attribute_descriptor(fld_name,mapnik::Integer));
+    box2d<double> bbox = geometry::envelope(feature->get_geometry());
+#ifdef MAPNIK_THREADSAFE
+    mapnik::scoped_lock lock(mutex_);
+#endif
+    if (index_) index_->tree.insert(std::make_pair(bbox, features_.size()));
     features_.push_back(feature);
+    envelopes_.push_back(bbox);
+}
+
+void memory_datasource::find_intersecting(box2d<double> const& box, std::vector<std::size_t> & positions) const
+{
+    std::vector<spatial_index::value_type> values;
+    {
+#ifdef MAPNIK_THREADSAFE
+        mapnik::scoped_lock lock(mutex_);
+#endif
+        if (!index_)
+        {
+            std::vector<spatial_index::value_type> items;
+            items.reserve(envelopes_.size());
+            for (std::size_t i = 0; i < envelopes_.size(); ++i)
+            {
+                items.emplace_back(envelopes_[i], i);
+            }
+            // packing algorithm
+            index_ = std::make_unique<spatial_index>(items.begin(), items.end());
+        }
+        index_->tree.query(boost::geometry::index::intersects(box), std::back_inserter(values));
+    }
+    positions.reserve(values.size());
+    for (auto const& value : values)
+    {
+        positions.push_back(value.second);
+    }
+    std::sort(positions.begin(), positions.end());
 }
 
 datasource::datasource_t memory_datasource::type() const
@@ -113,7 +170,7 @@ box2d<double> memory_datasource::envelope() const
     if (!extent_.valid())
     {
         accumulate_extent func(extent_);
-        std::for_each(features_.begin(),features_.end(),func);
+        std::for_each(envelopes_.begin(),envelopes_.end(),func);
     }
     return extent_;
 }
@@ -136,7 +193,12 @@ size_t memory_datasource::size() const
 
 void memory_datasource::clear()
 {
+#ifdef MAPNIK_THREADSAFE
+    mapnik::scoped_lock lock(mutex_);
+#endif
     features_.clear();
+    envelopes_.clear();
+    index_.reset();
 }
 
 }
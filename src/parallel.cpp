@@ -0,0 +1,105 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+// mapnik
+#include <mapnik/util/parallel.hpp>
+
+// stl
+#ifdef MAPNIK_THREADSAFE
+#include <mutex>
+#include <thread>
+#endif
+
+namespace mapnik { namespace util {
+
+namespace {
+
+#ifdef MAPNIK_THREADSAFE
+struct parallel_limit
+{
+    parallel_limit()
+        : max(std::thread::hardware_concurrency() > 1 ? std::thread::hardware_concurrency() - 1 : 0),
+          used(0) {}
+    std::mutex mutex;
+    unsigned max;
+    unsigned used;
+};
+
+parallel_limit & limit()
+{
+    static parallel_limit instance;
+    return instance;
+}
+#endif
+
+}
+
+void set_parallel_threads(unsigned threads)
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(limit().mutex);
+    limit().max = threads;
+#else
+    (void)threads;
+#endif
+}
+
+unsigned parallel_threads()
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(limit().mutex);
+    return limit().max;
+#else
+    return 0;
+#endif
+}
+
+namespace detail {
+
+unsigned acquire_parallel_threads(unsigned wanted)
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(limit().mutex);
+    // lowering the limit doesn't stop the threads already running
+    unsigned left = limit().max > limit().used ? limit().max - limit().used : 0;
+    unsigned count = wanted < left ? wanted : left;
+    limit().used += count;
+    return count;
+#else
+    (void)wanted;
+    return 0;
+#endif
+}
+
+void release_parallel_threads(unsigned count)
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(limit().mutex);
+    limit().used -= count;
+#else
+    (void)count;
+#endif
+}
+
+}
+
+}}
@@ -32,6 +32,10 @@
 // stl
 #include <limits>
 #include <cmath>
+#include <cfloat>
+#include <vector>
+#include <algorithm>
+#include <type_traits>
 
 namespace mapnik
 {
@@ -98,6 +102,7 @@ raster_colorizer::raster_colorizer(colorizer_mode mode, color const& _color)
     : default_mode_(mode)
     , default_color_(_color)
     , epsilon_(std::numeric_limits<float>::epsilon())
+    , lut_size_(4096)
 {
 
 }
@@ -122,6 +127,20 @@ bool raster_colorizer::add_stop(colorizer_stop const& stop)
     return true;
 }
 
+namespace {
+
+inline bool colors_within_one(std::uint32_t a, std::uint32_t b)
+{
+    for (unsigned shift = 0; shift < 32; shift += 8)
+    {
+        int diff = static_cast<int>((a >> shift) & 0xff) - static_cast<int>((b >> shift) & 0xff);
+        if (diff > 1 || diff < -1) return false;
+    }
+    return true;
+}
+
+}
+
 template <typename T>
 void raster_colorizer::colorize(image_rgba8 & out, T const& in,
                                 boost::optional<double> const& nodata,
@@ -132,11 +151,110 @@ void raster_colorizer::colorize(image_rgba8 & out, T const& in,
     // TODO: assuming in/out have the same width/height for now
     std::uint32_t * out_data = out.getData();
     pixel_type const* in_data = in.getData();
-    int len = out.width() * out.height();
-    for (int i=0; i<len; ++i)
+    std::size_t len = out.width() * out.height();
+    auto is_nodata = [&](pixel_type value) {
+        return nodata && (std::fabs(value - *nodata) < epsilon_);
+    };
+
+    // range of the values to colorize
+    bool found = false;
+    pixel_type lo = 0;
+    pixel_type hi = 0;
+    for (std::size_t i = 0; i < len; ++i)
+    {
+        pixel_type value = in_data[i];
+        if (!std::isfinite(static_cast<double>(value)) || is_nodata(value)) continue;
+        if (!found)
+        {
+            lo = hi = value;
+            found = true;
+        }
+        lo = std::min(lo, value);
+        hi = std::max(hi, value);
+    }
+
+    if (found && std::is_integral<pixel_type>::value &&
+        static_cast<double>(hi) - static_cast<double>(lo) < static_cast<double>(len))
+    {
+        // one color per value in the range, only the nodata pixels are outside
+        std::vector<std::uint32_t> lut(static_cast<std::size_t>(hi - lo) + 1);
+        for (std::size_t k = 0; k < lut.size(); ++k)
+        {
+            pixel_type value = static_cast<pixel_type>(lo + k);
+            lut[k] = is_nodata(value) ? 0 : get_color(value);
+        }
+        for (std::size_t i = 0; i < len; ++i)
+        {
+            pixel_type value = in_data[i];
+            out_data[i] = (value < lo || value > hi) ? 0 : lut[static_cast<std::size_t>(value - lo)];
+        }
+        return;
+    }
+
+    if (found && !std::is_integral<pixel_type>::value && lut_size_ > 0 && lut_size_ < len && hi > lo)
+    {
+        // the range split into lut_size_ buckets colored from their center, except for
+        // the buckets next to a stop or over a steep gradient whose pixels still go
+        // through get_color(). Discrete and exact colors are the same as get_color(),
+        // linear ones are within one per channel.
+        std::size_t size = lut_size_;
+        double range = static_cast<double>(hi) - static_cast<double>(lo);
+        double step = range / size;
+        double scale = size / range;
+        std::vector<std::uint32_t> lut(size);
+        std::vector<std::uint8_t> split(size, 0);
+        // epsilon of exact stops, bucket index rounding and values rounded to float in get_color()
+        double margin = epsilon_ + step * 1e-3 +
+            2 * FLT_EPSILON * std::max(std::fabs(static_cast<double>(lo)), std::fabs(static_cast<double>(hi)));
+        for (auto const& stop : stops_)
+        {
+            double first = std::floor((stop.get_value() - margin - lo) * scale);
+            double last = std::floor((stop.get_value() + margin - lo) * scale);
+            if (last < 0 || first >= size) continue;
+            for (std::size_t b = static_cast<std::size_t>(std::max(first, 0.0));
+                 b <= static_cast<std::size_t>(std::min(last, size - 1.0)); ++b)
+            {
+                split[b] = 1;
+            }
+        }
+        for (std::size_t b = 0; b < size; ++b)
+        {
+            if (split[b]) continue;
+            double b0 = lo + b * step;
+            lut[b] = get_color(static_cast<float>(b0 + 0.5 * step));
+            // colors are monotonic between two stops, the bucket center is within
+            // one of the whole bucket if it is within one of both ends
+            if (!colors_within_one(lut[b], get_color(static_cast<float>(b0 - step * 1e-3))) ||
+                !colors_within_one(lut[b], get_color(static_cast<float>(b0 + step * (1 + 1e-3)))))
+            {
+                split[b] = 1;
+            }
+        }
+        for (std::size_t i = 0; i < len; ++i)
+        {
+            pixel_type value = in_data[i];
+            double x = (value - lo) * scale;
+            if (is_nodata(value))
+            {
+                out_data[i] = 0; // rgba(0,0,0,0)
+            }
+            else if (x >= 0 && x <= size)
+            {
+                std::size_t b = std::min(static_cast<std::size_t>(x), size - 1);
+                out_data[i] = split[b] ? get_color(value) : lut[b];
+            }
+            else
+            {
+                out_data[i] = get_color(value);
+            }
+        }
+        return;
+    }
+
+    for (std::size_t i = 0; i < len; ++i)
     {
         pixel_type value = in_data[i];
-        if (nodata && (std::fabs(value - *nodata) < epsilon_))
+        if (is_nodata(value))
         {
             out_data[i] = 0; // rgba(0,0,0,0)
         }
@@ -116,6 +116,10 @@ void serialize_raster_colorizer(ptree & sym_node,
     {
         set_attr(col_node, "epsilon", colorizer->get_epsilon());
     }
+    if (colorizer->get_lut_size() != dfl.get_lut_size() || explicit_defaults)
+    {
+        set_attr(col_node, "lut-size", colorizer->get_lut_size());
+    }
 
     colorizer_stops const& stops = colorizer->get_stops();
     for (auto const& stop : stops)
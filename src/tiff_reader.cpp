@@ -23,6 +23,9 @@
 // mapnik
 #include <mapnik/debug.hpp>
 #include <mapnik/image_reader.hpp>
+#include <mapnik/util/parallel.hpp>
+#include <mapnik/util/lru_cache.hpp>
+#include <mapnik/util/fs.hpp>
 
 extern "C"
 {
@@ -38,7 +41,13 @@ extern "C"
 #pragma GCC diagnostic pop
 
 // stl
+#include <ctime>
+#include <cstddef>
 #include <memory>
+#include <string>
+#include <vector>
+#include <functional>
+#include <algorithm>
 
 namespace mapnik { namespace impl {
 
@@ -100,6 +109,63 @@ static int tiff_map_proc(thandle_t, tdata_t* , toff_t*)
     return 0;
 }
 
+static TIFF* tiff_open(std::istream & input)
+{
+    return TIFFClientOpen("tiff_input_stream", "rcm",
+                          reinterpret_cast<thandle_t>(&input),
+                          impl::tiff_read_proc,
+                          impl::tiff_write_proc,
+                          impl::tiff_seek_proc,
+                          impl::tiff_close_proc,
+                          impl::tiff_size_proc,
+                          impl::tiff_map_proc,
+                          impl::tiff_unmap_proc);
+}
+
+}
+
+namespace detail {
+
+// a decoded tile of a tiff file, by directory and pixel type
+struct tiff_tile_key
+{
+    std::string file;
+    std::time_t modified;
+    tdir_t dir;
+    ttile_t tile;
+    image_dtype dtype;
+
+    bool operator==(tiff_tile_key const& other) const
+    {
+        return tile == other.tile && dir == other.dir && dtype == other.dtype &&
+            modified == other.modified && file == other.file;
+    }
+};
+
+struct tiff_tile_key_hash
+{
+    std::size_t operator()(tiff_tile_key const& key) const
+    {
+        std::size_t seed = std::hash<std::string>()(key.file);
+        auto combine = [&seed](std::size_t h) { seed ^= h + 0x9e3779b9 + (seed << 6) + (seed >> 2); };
+        combine(std::hash<std::time_t>()(key.modified));
+        combine(std::hash<std::size_t>()(key.dir));
+        combine(std::hash<std::size_t>()(key.tile));
+        combine(std::hash<int>()(static_cast<int>(key.dtype)));
+        return seed;
+    }
+};
+
+using tiff_tile_cache = util::lru_cache<tiff_tile_key, image_any, tiff_tile_key_hash>;
+
+// Decoded tiles of the tiled files read, shared by all the readers as a
+// reader often lives for a single read (16MB by default, 0 disables it).
+inline tiff_tile_cache & tile_cache()
+{
+    static tiff_tile_cache cache(16 * 1024 * 1024);
+    return cache;
+}
+
 }
 
 template <typename T>
@@ -120,9 +186,33 @@ class tiff_reader : public image_reader
         }
     };
 
+    // directory holding the image (level 0) or one of its overviews
+    struct level_info
+    {
+        tdir_t dir;
+        std::size_t width;
+        std::size_t height;
+        unsigned tile_width;
+        unsigned tile_height;
+    };
+
+    // a tile overlapping the requested window, null until decoded
+    struct tile_info
+    {
+        unsigned x;
+        unsigned y;
+        ttile_t index;
+        detail::tiff_tile_cache::value_ptr tile;
+    };
+
 private:
     source_type source_;
     input_stream stream_;
+    // decoded tiles are only shared between the readers of files
+    std::string file_name_;
+    std::time_t modified_;
+    // opens the source again, for decoding tiles on other threads
+    std::function<source_type()> make_source_;
     tiff_ptr tif_;
     int read_method_;
     int rows_per_strip_;
@@ -139,6 +229,7 @@ private:
     unsigned compression_;
     bool has_alpha_;
     bool is_tiled_;
+    std::vector<level_info> levels_;
 
 public:
     enum TiffType {
@@ -155,6 +246,10 @@ public:
     inline bool has_alpha() const final { return has_alpha_; }
     void read(unsigned x,unsigned y,image_rgba8& image) final;
     image_any read(unsigned x, unsigned y, unsigned width, unsigned height) final;
+    unsigned overviews() const final { return levels_.size() - 1; }
+    unsigned overview_width(unsigned level) const final { return levels_.at(level).width; }
+    unsigned overview_height(unsigned level) const final { return levels_.at(level).height; }
+    image_any read_overview(unsigned level, unsigned x, unsigned y, unsigned width, unsigned height) final;
     // methods specific to tiff reader
     unsigned bits_per_sample() const { return bps_; }
     unsigned sample_format() const { return sample_format_; }
@@ -165,6 +260,11 @@ public:
     unsigned rows_per_strip() const { return rows_per_strip_; }
     unsigned planar_config() const { return planar_config_; }
     unsigned compression() const { return compression_; }
+    // tiles of a window are decoded in parallel by bands of at least this many
+    static const std::size_t parallel_tiles = 4;
+    // bytes of decoded tiles kept for all the readers
+    static void set_tile_cache_size(std::size_t bytes) { detail::tile_cache().set_max_size(bytes); }
+    static std::size_t tile_cache_size() { return detail::tile_cache().size(); }
 private:
     tiff_reader(const tiff_reader&);
     tiff_reader& operator=(const tiff_reader&);
@@ -173,12 +273,21 @@ private:
     void read_stripped(unsigned x,unsigned y,image_rgba8& image);
 
     template <typename ImageData>
-    void read_tiled(unsigned x,unsigned y, ImageData & image);
+    void read_tiled(unsigned level, unsigned x,unsigned y, ImageData & image);
 
     template <typename ImageData>
-    image_any read_any_gray(unsigned x, unsigned y, unsigned width, unsigned height);
+    void decode_tiles(level_info const& info, std::vector<tile_info> & tiles);
+
+    detail::tiff_tile_key tile_key(tdir_t dir, ttile_t tile, image_dtype dtype) const
+    {
+        return detail::tiff_tile_key{file_name_, modified_, dir, tile, dtype};
+    }
+
+    template <typename ImageData>
+    image_any read_any_gray(unsigned level, unsigned x, unsigned y, unsigned width, unsigned height);
 
     TIFF* open(std::istream & input);
+    TIFF* open(tdir_t dir);
 };
 
 namespace
@@ -203,6 +312,9 @@ template <typename T>
 tiff_reader<T>::tiff_reader(std::string const& file_name)
     : source_(file_name, std::ios_base::in | std::ios_base::binary),
       stream_(source_),
+      file_name_(file_name),
+      modified_(util::last_write_time(file_name)),
+      make_source_([file_name]() { return source_type(file_name, std::ios_base::in | std::ios_base::binary); }),
       tif_(nullptr),
       read_method_(generic),
       rows_per_strip_(0),
@@ -217,7 +329,8 @@ tiff_reader<T>::tiff_reader(std::string const& file_name)
       planar_config_(PLANARCONFIG_CONTIG),
       compression_(COMPRESSION_NONE),
       has_alpha_(false),
-      is_tiled_(false)
+      is_tiled_(false),
+      levels_()
 {
     if (!stream_) throw image_reader_exception("TIFF reader: cannot open file "+ file_name);
     init();
@@ -227,6 +340,9 @@ template <typename T>
 tiff_reader<T>::tiff_reader(char const* data, std::size_t size)
     : source_(data, size),
       stream_(source_),
+      file_name_(),
+      modified_(0),
+      make_source_([data, size]() { return source_type(data, size); }),
       tif_(nullptr),
       read_method_(generic),
       rows_per_strip_(0),
@@ -241,7 +357,8 @@ tiff_reader<T>::tiff_reader(char const* data, std::size_t size)
       planar_config_(PLANARCONFIG_CONTIG),
       compression_(COMPRESSION_NONE),
       has_alpha_(false),
-      is_tiled_(false)
+      is_tiled_(false),
+      levels_()
 {
     if (!stream_) throw image_reader_exception("TIFF reader: cannot open image stream ");
     stream_.rdbuf()->pubsetbuf(0, 0);
@@ -349,6 +466,46 @@ void tiff_reader<T>::init()
             }
         }
     }
+    levels_.push_back(level_info{TIFFCurrentDirectory(tif), width_, height_,
+                                 static_cast<unsigned>(tile_width_), static_cast<unsigned>(tile_height_)});
+    // internal overviews (e.g from gdaladdo) are reduced resolution images in the
+    // following directories, only tiled ones with the same pixel layout are used
+    while (TIFFReadDirectory(tif))
+    {
+        std::uint32_t subfile_type = 0;
+        std::uint16_t bps = 0;
+        std::uint16_t sample_format = SAMPLEFORMAT_UINT;
+        std::uint16_t photometric = 0;
+        std::uint16_t bands = 1;
+        std::uint16_t planar_config = PLANARCONFIG_CONTIG;
+        TIFFGetField(tif, TIFFTAG_SUBFILETYPE, &subfile_type);
+        TIFFGetField(tif, TIFFTAG_BITSPERSAMPLE, &bps);
+        TIFFGetField(tif, TIFFTAG_SAMPLEFORMAT, &sample_format);
+        TIFFGetField(tif, TIFFTAG_PHOTOMETRIC, &photometric);
+        TIFFGetField(tif, TIFFTAG_SAMPLESPERPIXEL, &bands);
+        TIFFGetField(tif, TIFFTAG_PLANARCONFIG, &planar_config);
+        if ((subfile_type & FILETYPE_REDUCEDIMAGE) && TIFFIsTiled(tif) &&
+            bps == bps_ && sample_format == sample_format_ && photometric == photometric_ &&
+            bands == bands_ && planar_config == planar_config_)
+        {
+            std::uint32_t width = 0;
+            std::uint32_t height = 0;
+            std::uint32_t tile_width = 0;
+            std::uint32_t tile_height = 0;
+            TIFFGetField(tif, TIFFTAG_IMAGEWIDTH, &width);
+            TIFFGetField(tif, TIFFTAG_IMAGELENGTH, &height);
+            TIFFGetField(tif, TIFFTAG_TILEWIDTH, &tile_width);
+            TIFFGetField(tif, TIFFTAG_TILELENGTH, &tile_height);
+            if (width > 0 && height > 0 && width < width_ && height < height_ && tile_width > 0 && tile_height > 0)
+            {
+                MAPNIK_LOG_DEBUG(tiff_reader) << "overview: " << width << "x" << height;
+                levels_.push_back(level_info{TIFFCurrentDirectory(tif), width, height, tile_width, tile_height});
+            }
+        }
+    }
+    std::sort(levels_.begin() + 1, levels_.end(),
+              [](level_info const& a, level_info const& b) { return a.width > b.width; });
+    TIFFSetDirectory(tif, levels_.front().dir);
 }
 
 template <typename T>
@@ -383,7 +540,7 @@ void tiff_reader<T>::read(unsigned x,unsigned y,image_rgba8& image)
     }
     else if (read_method_==tiled)
     {
-        read_tiled(x,y,image);
+        read_tiled(0,x,y,image);
     }
     else
     {
@@ -393,19 +550,19 @@ void tiff_reader<T>::read(unsigned x,unsigned y,image_rgba8& image)
 
 template <typename T>
 template <typename ImageData>
-image_any tiff_reader<T>::read_any_gray(unsigned x0, unsigned y0, unsigned width, unsigned height)
+image_any tiff_reader<T>::read_any_gray(unsigned level, unsigned x0, unsigned y0, unsigned width, unsigned height)
 {
     using image_type = ImageData;
     using pixel_type = typename image_type::pixel_type;
-    if (read_method_ == tiled)
+    if (level > 0 || read_method_ == tiled)
     {
         image_type data(width,height);
-        read_tiled<image_type>(x0, y0, data);
+        read_tiled<image_type>(level, x0, y0, data);
         return image_any(std::move(data));
     }
     else
     {
-        TIFF* tif = open(stream_);
+        TIFF* tif = open(levels_.front().dir);
         if (tif)
         {
             image_type data(width, height);
@@ -464,6 +621,7 @@ struct tiff_reader_traits
 template <>
 struct tiff_reader_traits<image_rgba8>
 {
+    using image_type = image_rgba8;
     using pixel_type = std::uint32_t;
     static bool read_tile(TIFF * tif, unsigned x0, unsigned y0, pixel_type* buf, std::size_t tile_width, std::size_t tile_height)
     {
@@ -484,6 +642,16 @@ struct tiff_reader_traits<image_rgba8>
 template <typename T>
 image_any tiff_reader<T>::read(unsigned x0, unsigned y0, unsigned width, unsigned height)
 {
+    return read_overview(0, x0, y0, width, height);
+}
+
+template <typename T>
+image_any tiff_reader<T>::read_overview(unsigned level, unsigned x0, unsigned y0, unsigned width, unsigned height)
+{
+    if (level >= levels_.size())
+    {
+        throw image_reader_exception("tiff_reader: no such overview");
+    }
     if (width > 10000 || height > 10000)
     {
         throw image_reader_exception("Can't allocate tiff > 10000x10000");
@@ -501,11 +669,11 @@ image_any tiff_reader<T>::read(unsigned x0, unsigned y0, unsigned width, unsigne
             {
             case SAMPLEFORMAT_UINT:
             {
-                return read_any_gray<image_gray8>(x0, y0, width, height);
+                return read_any_gray<image_gray8>(level, x0, y0, width, height);
             }
             case SAMPLEFORMAT_INT:
             {
-                return read_any_gray<image_gray8s>(x0, y0, width, height);
+                return read_any_gray<image_gray8s>(level, x0, y0, width, height);
             }
             default:
             {
@@ -519,11 +687,11 @@ image_any tiff_reader<T>::read(unsigned x0, unsigned y0, unsigned width, unsigne
             {
             case SAMPLEFORMAT_UINT:
             {
-                return read_any_gray<image_gray16>(x0, y0, width, height);
+                return read_any_gray<image_gray16>(level, x0, y0, width, height);
             }
             case SAMPLEFORMAT_INT:
             {
-                return read_any_gray<image_gray16s>(x0, y0, width, height);
+                return read_any_gray<image_gray16s>(level, x0, y0, width, height);
             }
             default:
             {
@@ -537,15 +705,15 @@ image_any tiff_reader<T>::read(unsigned x0, unsigned y0, unsigned width, unsigne
             {
             case SAMPLEFORMAT_UINT:
             {
-                return read_any_gray<image_gray32>(x0, y0, width, height);
+                return read_any_gray<image_gray32>(level, x0, y0, width, height);
             }
             case SAMPLEFORMAT_INT:
             {
-                return read_any_gray<image_gray32s>(x0, y0, width, height);
+                return read_any_gray<image_gray32s>(level, x0, y0, width, height);
             }
             case SAMPLEFORMAT_IEEEFP:
             {
-                return read_any_gray<image_gray32f>(x0, y0, width, height);
+                return read_any_gray<image_gray32f>(level, x0, y0, width, height);
             }
             default:
             {
@@ -559,15 +727,15 @@ image_any tiff_reader<T>::read(unsigned x0, unsigned y0, unsigned width, unsigne
             {
             case SAMPLEFORMAT_UINT:
             {
-                return read_any_gray<image_gray64>(x0, y0, width, height);
+                return read_any_gray<image_gray64>(level, x0, y0, width, height);
             }
             case SAMPLEFORMAT_INT:
             {
-                return read_any_gray<image_gray64s>(x0, y0, width, height);
+                return read_any_gray<image_gray64s>(level, x0, y0, width, height);
             }
             case SAMPLEFORMAT_IEEEFP:
             {
-                return read_any_gray<image_gray64f>(x0, y0, width, height);
+                return read_any_gray<image_gray64f>(level, x0, y0, width, height);
             }
             default:
             {
@@ -589,7 +757,8 @@ image_any tiff_reader<T>::read(unsigned x0, unsigned y0, unsigned width, unsigne
         //PHOTOMETRIC_LOGL = 32844;
         //PHOTOMETRIC_LOGLUV = 32845;
         image_rgba8 data(width,height, true, true);
-        read(x0, y0, data);
+        if (level > 0) read_tiled(level, x0, y0, data);
+        else read(x0, y0, data);
         return image_any(std::move(data));
     }
     }
@@ -599,7 +768,7 @@ image_any tiff_reader<T>::read(unsigned x0, unsigned y0, unsigned width, unsigne
 template <typename T>
 void tiff_reader<T>::read_generic(unsigned, unsigned, image_rgba8& image)
 {
-    TIFF* tif = open(stream_);
+    TIFF* tif = open(levels_.front().dir);
     if (tif)
     {
         throw std::runtime_error("tiff_reader: TODO - tiff is not stripped or tiled");
@@ -608,52 +777,114 @@ void tiff_reader<T>::read_generic(unsigned, unsigned, image_rgba8& image)
 
 template <typename T>
 template <typename ImageData>
-void tiff_reader<T>::read_tiled(unsigned x0,unsigned y0, ImageData & image)
+void tiff_reader<T>::read_tiled(unsigned level, unsigned x0,unsigned y0, ImageData & image)
 {
-    using pixel_type = typename detail::tiff_reader_traits<ImageData>::pixel_type;
+    using image_type = typename detail::tiff_reader_traits<ImageData>::image_type;
 
-    TIFF* tif = open(stream_);
+    level_info const& info = levels_[level];
+    TIFF* tif = open(info.dir);
     if (tif)
     {
-        std::unique_ptr<pixel_type[]> buf(new pixel_type[tile_width_*tile_height_]);
+        int tile_width = info.tile_width;
+        int tile_height = info.tile_height;
         int width = image.width();
         int height = image.height();
-        int start_y = (y0 / tile_height_) * tile_height_;
-        int end_y = ((y0 + height) / tile_height_ + 1) * tile_height_;
-        int start_x = (x0 / tile_width_) * tile_width_;
-        int end_x = ((x0 + width) / tile_width_ + 1) * tile_width_;
-        end_y = std::min(end_y, int(height_));
-        end_x = std::min(end_x, int(width_));
-
-        for (int y = start_y; y < end_y; y += tile_height_)
+        int start_y = (y0 / tile_height) * tile_height;
+        int end_y = ((y0 + height) / tile_height + 1) * tile_height;
+        int start_x = (x0 / tile_width) * tile_width;
+        int end_x = ((x0 + width) / tile_width + 1) * tile_width;
+        end_y = std::min(end_y, int(info.height));
+        end_x = std::min(end_x, int(info.width));
+
+        std::vector<tile_info> tiles;
+        for (int y = start_y; y < end_y; y += tile_height)
         {
-            int ty0 = std::max(y0, static_cast<unsigned>(y)) - y;
-            int ty1 = std::min(height + y0, static_cast<unsigned>(y + tile_height_)) - y;
+            for (int x = start_x; x < end_x; x += tile_width)
+            {
+                ttile_t index = TIFFComputeTile(tif, x, y, 0, 0);
+                tiles.push_back(tile_info{static_cast<unsigned>(x), static_cast<unsigned>(y), index,
+                            file_name_.empty() ? nullptr : detail::tile_cache().find(tile_key(info.dir, index, image_type::dtype))});
+            }
+        }
+        decode_tiles<ImageData>(info, tiles);
 
-            for (int x = start_x; x < end_x; x += tile_width_)
+        for (auto const& t : tiles)
+        {
+            if (!t.tile) continue;
+            auto const* buf = util::get<image_type>(*t.tile).getData();
+            int x = t.x;
+            int y = t.y;
+            int ty0 = std::max(y0, t.y) - y;
+            int ty1 = std::min(height + y0, t.y + tile_height) - y;
+            int tx0 = std::max(x0, t.x);
+            int tx1 = std::min(width + x0, t.x + tile_width);
+            int row = y + ty0 - y0;
+            for (int ty = ty0; ty < ty1; ++ty, ++row)
             {
-                if (!detail::tiff_reader_traits<ImageData>::read_tile(tif, x, y, buf.get(), tile_width_, tile_height_))
-                {
-                    MAPNIK_LOG_DEBUG(tiff_reader) <<  "read_tile(...) failed at " << x << "/" << y << " for " << width_ << "/" << height_ << "\n";
-                    break;
-                }
-                int tx0 = std::max(x0, static_cast<unsigned>(x));
-                int tx1 = std::min(width + x0, static_cast<unsigned>(x + tile_width_));
-                int row = y + ty0 - y0;
-                for (int ty = ty0; ty < ty1; ++ty, ++row)
-                {
-                    image.setRow(row, tx0 - x0, tx1 - x0, &buf[ty * tile_width_ + tx0 - x]);
-                }
+                image.setRow(row, tx0 - x0, tx1 - x0, &buf[ty * tile_width + tx0 - x]);
             }
         }
     }
 }
 
+template <typename T>
+template <typename ImageData>
+void tiff_reader<T>::decode_tiles(level_info const& info, std::vector<tile_info> & tiles)
+{
+    using traits = detail::tiff_reader_traits<ImageData>;
+    using image_type = typename traits::image_type;
+
+    auto decode = [&info](TIFF * tif, tile_info & t) {
+        image_type tile(info.tile_width, info.tile_height);
+        if (traits::read_tile(tif, t.x, t.y, tile.getData(), info.tile_width, info.tile_height))
+        {
+            t.tile = std::make_shared<const image_any>(std::move(tile));
+        }
+        else
+        {
+            MAPNIK_LOG_DEBUG(tiff_reader) <<  "read_tile(...) failed at " << t.x << "/" << t.y << " for " << info.width << "/" << info.height << "\n";
+        }
+    };
+
+    std::vector<std::size_t> missing;
+    for (std::size_t i = 0; i < tiles.size(); ++i)
+    {
+        if (!tiles[i].tile) missing.push_back(i);
+    }
+    mapnik::util::parallel_for(missing.size(), parallel_tiles, [&](std::size_t first, std::size_t last) {
+            if (first == 0 && last == missing.size()) return;
+            // libtiff handles can't be shared between threads, so each band
+            // decodes from its own handle on a new stream over the same source
+            source_type source(make_source_());
+            input_stream stream(source);
+            if (!stream) return;
+            tiff_ptr tif(impl::tiff_open(stream), tiff_closer());
+            if (!tif || !TIFFSetDirectory(tif.get(), info.dir)) return;
+            for (std::size_t i = first; i < last; ++i)
+            {
+                decode(tif.get(), tiles[missing[i]]);
+            }
+        });
+    // a single band, or whatever the bands could not decode
+    TIFF* tif = open(info.dir);
+    for (std::size_t i : missing)
+    {
+        tile_info & t = tiles[i];
+        if (!t.tile && tif) decode(tif, t);
+        if (t.tile && !file_name_.empty())
+        {
+            // another reader may have cached it meanwhile
+            t.tile = detail::tile_cache().insert(tile_key(info.dir, t.index, image_type::dtype), t.tile,
+                                                 sizeof(image_any) + t.tile->getSize());
+        }
+    }
+}
+
 
 template <typename T>
 void tiff_reader<T>::read_stripped(unsigned x0,unsigned y0,image_rgba8& image)
 {
-    TIFF* tif = open(stream_);
+    TIFF* tif = open(levels_.front().dir);
     if (tif)
     {
         image_rgba8 strip(width_,rows_per_strip_,false);
@@ -692,17 +923,20 @@ TIFF* tiff_reader<T>::open(std::istream & input)
 {
     if (!tif_)
     {
-        tif_ = tiff_ptr(TIFFClientOpen("tiff_input_stream", "rcm",
-                                       reinterpret_cast<thandle_t>(&input),
-                                       impl::tiff_read_proc,
-                                       impl::tiff_write_proc,
-                                       impl::tiff_seek_proc,
-                                       impl::tiff_close_proc,
-                                       impl::tiff_size_proc,
-                                       impl::tiff_map_proc,
-                                       impl::tiff_unmap_proc), tiff_closer());
+        tif_ = tiff_ptr(impl::tiff_open(input), tiff_closer());
     }
     return tif_.get();
 }
 
+template <typename T>
+TIFF* tiff_reader<T>::open(tdir_t dir)
+{
+    TIFF* tif = open(stream_);
+    if (tif && TIFFCurrentDirectory(tif) != dir && !TIFFSetDirectory(tif, dir))
+    {
+        return nullptr;
+    }
+    return tif;
+}
+
 } // namespace mapnik
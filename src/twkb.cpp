@@ -0,0 +1,332 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+// mapnik
+#include <mapnik/debug.hpp>
+#include <mapnik/wkb.hpp>
+#include <mapnik/util/noncopyable.hpp>
+
+// stl
+#include <cmath>
+#include <cstdint>
+
+namespace mapnik
+{
+
+// Reader for the Tiny Well-known Binary format (TWKB, v0.23) as produced by
+// PostGIS ST_AsTWKB. Coordinates are zigzag/varint encoded integer deltas
+// scaled by 10^precision, so the reader keeps a running cursor per geometry.
+struct twkb_reader : util::noncopyable
+{
+private:
+    const char* twkb_;
+    std::size_t size_;
+    std::size_t pos_;
+    bool valid_;
+    // metadata from the current header
+    double factor_;
+    unsigned ndims_;
+    bool has_idlist_;
+    std::int64_t cursor_[4];
+
+public:
+
+    enum twkbGeometryType {
+        twkbPoint=1,
+        twkbLineString=2,
+        twkbPolygon=3,
+        twkbMultiPoint=4,
+        twkbMultiLineString=5,
+        twkbMultiPolygon=6,
+        twkbGeometryCollection=7
+    };
+
+    twkb_reader(const char* twkb, std::size_t size)
+        : twkb_(twkb),
+          size_(size),
+          pos_(0),
+          valid_(true),
+          factor_(1.0),
+          ndims_(2),
+          has_idlist_(false) {}
+
+    mapnik::geometry::geometry<double> read()
+    {
+        mapnik::geometry::geometry<double> geom = mapnik::geometry::geometry_empty();
+        if (pos_ + 2 > size_)
+        {
+            valid_ = false;
+            return geom;
+        }
+        std::uint8_t type_precision = static_cast<std::uint8_t>(twkb_[pos_++]);
+        std::uint8_t metadata = static_cast<std::uint8_t>(twkb_[pos_++]);
+
+        int type = type_precision & 0x0F;
+        int precision = unzigzag32(type_precision >> 4);
+        factor_ = std::pow(10.0, -precision);
+
+        bool has_bbox = metadata & 0x01;
+        bool has_size = metadata & 0x02;
+        has_idlist_ = metadata & 0x04;
+        bool has_ext_dims = metadata & 0x08;
+        bool is_empty = metadata & 0x10;
+
+        ndims_ = 2;
+        if (has_ext_dims)
+        {
+            if (pos_ >= size_)
+            {
+                valid_ = false;
+                return geom;
+            }
+            std::uint8_t ext_dims = static_cast<std::uint8_t>(twkb_[pos_++]);
+            if (ext_dims & 0x01) ++ndims_; // Z
+            if (ext_dims & 0x02) ++ndims_; // M
+        }
+        if (has_size)
+        {
+            read_unsigned_varint();
+        }
+        if (has_bbox)
+        {
+            // min and delta for every dimension
+            for (unsigned i = 0; i < 2 * ndims_; ++i)
+            {
+                read_unsigned_varint();
+            }
+        }
+        if (is_empty || !valid_)
+        {
+            return geom;
+        }
+
+        for (unsigned i = 0; i < ndims_; ++i)
+        {
+            cursor_[i] = 0;
+        }
+
+        switch (type)
+        {
+        case twkbPoint:
+            geom = read_point();
+            break;
+        case twkbLineString:
+            geom = read_linestring();
+            break;
+        case twkbPolygon:
+            geom = read_polygon();
+            break;
+        case twkbMultiPoint:
+            geom = read_multipoint();
+            break;
+        case twkbMultiLineString:
+            geom = read_multilinestring();
+            break;
+        case twkbMultiPolygon:
+            geom = read_multipolygon();
+            break;
+        case twkbGeometryCollection:
+            geom = read_collection();
+            break;
+        default:
+            MAPNIK_LOG_WARN(twkb_reader) << "twkb_reader: unknown geometry type " << type;
+            break;
+        }
+        if (!valid_)
+        {
+            // truncated or corrupt input
+            return mapnik::geometry::geometry_empty();
+        }
+        return geom;
+    }
+
+private:
+
+    static std::int32_t unzigzag32(std::uint32_t val)
+    {
+        return static_cast<std::int32_t>((val >> 1) ^ (0 - (val & 1)));
+    }
+
+    static std::int64_t unzigzag64(std::uint64_t val)
+    {
+        return static_cast<std::int64_t>((val >> 1) ^ (0 - (val & 1)));
+    }
+
+    std::uint64_t read_unsigned_varint()
+    {
+        std::uint64_t result = 0;
+        unsigned shift = 0;
+        while (pos_ < size_ && shift < 64)
+        {
+            std::uint8_t byte = static_cast<std::uint8_t>(twkb_[pos_++]);
+            result |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0)
+            {
+                return result;
+            }
+            shift += 7;
+        }
+        valid_ = false;
+        return 0;
+    }
+
+    std::int64_t read_signed_varint()
+    {
+        return unzigzag64(read_unsigned_varint());
+    }
+
+    std::size_t read_count()
+    {
+        std::uint64_t count = read_unsigned_varint();
+        // every element needs at least one byte, anything bigger is bogus
+        if (count > size_ - pos_)
+        {
+            valid_ = false;
+            return 0;
+        }
+        return static_cast<std::size_t>(count);
+    }
+
+    void skip_idlist(std::size_t num)
+    {
+        if (has_idlist_)
+        {
+            for (std::size_t i = 0; i < num; ++i)
+            {
+                read_signed_varint();
+            }
+        }
+    }
+
+    template <typename Ring>
+    void read_coords(Ring & ring, std::size_t num_points)
+    {
+        ring.reserve(num_points);
+        for (std::size_t i = 0; i < num_points && valid_; ++i)
+        {
+            for (unsigned j = 0; j < ndims_; ++j)
+            {
+                cursor_[j] += read_signed_varint();
+            }
+            ring.emplace_back(cursor_[0] * factor_, cursor_[1] * factor_);
+        }
+    }
+
+    mapnik::geometry::point<double> read_point()
+    {
+        for (unsigned j = 0; j < ndims_; ++j)
+        {
+            cursor_[j] += read_signed_varint();
+        }
+        return mapnik::geometry::point<double>(cursor_[0] * factor_, cursor_[1] * factor_);
+    }
+
+    mapnik::geometry::multi_point<double> read_multipoint()
+    {
+        mapnik::geometry::multi_point<double> multi_point;
+        std::size_t num_points = read_count();
+        skip_idlist(num_points);
+        read_coords(multi_point, num_points);
+        return multi_point;
+    }
+
+    mapnik::geometry::line_string<double> read_linestring()
+    {
+        mapnik::geometry::line_string<double> line;
+        std::size_t num_points = read_count();
+        read_coords(line, num_points);
+        return line;
+    }
+
+    mapnik::geometry::multi_line_string<double> read_multilinestring()
+    {
+        mapnik::geometry::multi_line_string<double> multi_line;
+        std::size_t num_lines = read_count();
+        skip_idlist(num_lines);
+        multi_line.reserve(num_lines);
+        for (std::size_t i = 0; i < num_lines && valid_; ++i)
+        {
+            multi_line.push_back(read_linestring());
+        }
+        return multi_line;
+    }
+
+    mapnik::geometry::polygon<double> read_polygon()
+    {
+        mapnik::geometry::polygon<double> poly;
+        std::size_t num_rings = read_count();
+        if (num_rings > 1)
+        {
+            poly.interior_rings.reserve(num_rings - 1);
+        }
+        for (std::size_t i = 0; i < num_rings && valid_; ++i)
+        {
+            mapnik::geometry::linear_ring<double> ring;
+            std::size_t num_points = read_count();
+            read_coords(ring, num_points);
+            // TWKB omits the closing point of rings when precision collapses it
+            if (!ring.empty() && ring.front() != ring.back())
+            {
+                ring.emplace_back(ring.front());
+            }
+            if (i == 0) poly.set_exterior_ring(std::move(ring));
+            else poly.add_hole(std::move(ring));
+        }
+        return poly;
+    }
+
+    mapnik::geometry::multi_polygon<double> read_multipolygon()
+    {
+        mapnik::geometry::multi_polygon<double> multi_poly;
+        std::size_t num_polys = read_count();
+        skip_idlist(num_polys);
+        multi_poly.reserve(num_polys);
+        for (std::size_t i = 0; i < num_polys && valid_; ++i)
+        {
+            multi_poly.push_back(read_polygon());
+        }
+        return multi_poly;
+    }
+
+    mapnik::geometry::geometry_collection<double> read_collection()
+    {
+        mapnik::geometry::geometry_collection<double> collection;
+        std::size_t num_geometries = read_count();
+        skip_idlist(num_geometries);
+        for (std::size_t i = 0; i < num_geometries && valid_; ++i)
+        {
+            // every member carries its own header
+            collection.push_back(read());
+        }
+        return collection;
+    }
+};
+
+mapnik::geometry::geometry<double> geometry_utils::from_twkb(const char* twkb,
+                                                             unsigned size)
+{
+    twkb_reader reader(twkb, size);
+    mapnik::geometry::geometry<double> geom(reader.read());
+    return geom;
+}
+
+} // namespace mapnik
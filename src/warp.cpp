@@ -30,6 +30,9 @@
 #include <mapnik/view_transform.hpp>
 #include <mapnik/raster.hpp>
 #include <mapnik/proj_transform.hpp>
+#include <mapnik/projection.hpp>
+#include <mapnik/util/lru_cache.hpp>
+#include <mapnik/util/parallel.hpp>
 
 // agg
 #include "agg_image_filters.h"
@@ -46,8 +49,100 @@
 #include "agg_image_accessors.h"
 #include "agg_renderer_scanline.h"
 
+// stl
+#include <functional>
+#include <vector>
+#include <array>
+#include <memory>
+#include <string>
+#include <algorithm>
+
 namespace mapnik {
 
+namespace detail {
+
+// source pixel grid reprojected into the target srs
+struct warp_mesh
+{
+    warp_mesh(std::size_t nx, std::size_t ny)
+        : xs(nx, ny, false),
+          ys(nx, ny, false) {}
+    image_gray64f xs;
+    image_gray64f ys;
+};
+
+// The meshes of the last rasters warped (up to 4MB), so the tiles of a layer
+// rendering the same source raster don't reproject it again. They don't
+// depend on the target extent, which is only applied when rendering.
+class warp_mesh_cache
+{
+public:
+    using mesh_ptr = std::shared_ptr<const warp_mesh>;
+    static const std::size_t max_size = 4 * 1024 * 1024;
+
+    warp_mesh_cache()
+        : cache_(max_size) {}
+
+    template <typename Create>
+    mesh_ptr get(std::size_t width, std::size_t height, box2d<double> const& source_ext,
+                 unsigned mesh_size, proj_transform const& prj_trans, Create create)
+    {
+        key_type key{width, height, source_ext, mesh_size,
+                     prj_trans.source().params(), prj_trans.dest().params()};
+        // reprojected outside the lock, another thread may do the same meanwhile
+        return cache_.get(key, create, [&key](warp_mesh const& mesh) {
+                return sizeof(warp_mesh) + sizeof(key_type) + key.source_srs.size() + key.dest_srs.size()
+                    + mesh.xs.getSize() + mesh.ys.getSize();
+            });
+    }
+
+private:
+    struct key_type
+    {
+        std::size_t width;
+        std::size_t height;
+        box2d<double> source_ext;
+        unsigned mesh_size;
+        std::string source_srs;
+        std::string dest_srs;
+
+        bool operator==(key_type const& other) const
+        {
+            return width == other.width && height == other.height &&
+                source_ext == other.source_ext && mesh_size == other.mesh_size &&
+                source_srs == other.source_srs && dest_srs == other.dest_srs;
+        }
+    };
+
+    struct key_hash
+    {
+        std::size_t operator()(key_type const& key) const
+        {
+            std::size_t seed = std::hash<std::size_t>()(key.width);
+            auto combine = [&seed](std::size_t h) { seed ^= h + 0x9e3779b9 + (seed << 6) + (seed >> 2); };
+            combine(std::hash<std::size_t>()(key.height));
+            combine(std::hash<double>()(key.source_ext.minx()));
+            combine(std::hash<double>()(key.source_ext.miny()));
+            combine(std::hash<double>()(key.source_ext.maxx()));
+            combine(std::hash<double>()(key.source_ext.maxy()));
+            combine(std::hash<unsigned>()(key.mesh_size));
+            combine(std::hash<std::string>()(key.source_srs));
+            combine(std::hash<std::string>()(key.dest_srs));
+            return seed;
+        }
+    };
+
+    util::lru_cache<key_type, warp_mesh, key_hash> cache_;
+};
+
+warp_mesh_cache & mesh_cache()
+{
+    static warp_mesh_cache cache;
+    return cache;
+}
+
+}
+
 template <typename T>
 MAPNIK_DECL void warp_image (T & target, T const& source, proj_transform const& prj_trans,
                  box2d<double> const& target_ext, box2d<double> const& source_ext,
@@ -70,90 +165,121 @@ MAPNIK_DECL void warp_image (T & target, T const& source, proj_transform const&
     std::size_t mesh_nx = std::ceil(source.width()/double(mesh_size) + 1);
     std::size_t mesh_ny = std::ceil(source.height()/double(mesh_size) + 1);
 
-    image_gray64f xs(mesh_nx, mesh_ny, false);
-    image_gray64f ys(mesh_nx, mesh_ny, false);
+    detail::warp_mesh_cache::mesh_ptr mesh = detail::mesh_cache().get(
+        source.width(), source.height(), source_ext, mesh_size, prj_trans, [&]() {
+            auto m = std::make_shared<detail::warp_mesh>(mesh_nx, mesh_ny);
+            // Precalculate reprojected mesh
+            for(std::size_t j = 0; j < mesh_ny; ++j)
+            {
+                for (std::size_t i=0; i<mesh_nx; ++i)
+                {
+                    m->xs(i,j) = std::min(i*mesh_size,source.width());
+                    m->ys(i,j) = std::min(j*mesh_size,source.height());
+                    ts.backward(&m->xs(i,j), &m->ys(i,j));
+                }
+            }
+            prj_trans.backward(m->xs.getData(), m->ys.getData(), nullptr, mesh_nx*mesh_ny);
+            return m;
+        });
+    image_gray64f const& xs = mesh->xs;
+    image_gray64f const& ys = mesh->ys;
 
-    // Precalculate reprojected mesh
-    for(std::size_t j = 0; j < mesh_ny; ++j)
+    // Mesh cells projected into the target, in target pixels
+    std::vector<std::array<double, 8> > cells;
+    cells.reserve((mesh_nx - 1) * (mesh_ny - 1));
+    for (std::size_t j = 0; j < mesh_ny - 1; ++j)
     {
-        for (std::size_t i=0; i<mesh_nx; ++i)
+        for (std::size_t i = 0; i < mesh_nx - 1; ++i)
         {
-            xs(i,j) = std::min(i*mesh_size,source.width());
-            ys(i,j) = std::min(j*mesh_size,source.height());
-            ts.backward(&xs(i,j), &ys(i,j));
+            std::array<double, 8> polygon{{xs(i,j), ys(i,j),
+                                           xs(i+1,j), ys(i+1,j),
+                                           xs(i+1,j+1), ys(i+1,j+1),
+                                           xs(i,j+1), ys(i,j+1)}};
+            tt.forward(&polygon[0], &polygon[1]);
+            tt.forward(&polygon[2], &polygon[3]);
+            tt.forward(&polygon[4], &polygon[5]);
+            tt.forward(&polygon[6], &polygon[7]);
+            cells.push_back(polygon);
         }
     }
-    prj_trans.backward(xs.getData(), ys.getData(), nullptr, mesh_nx*mesh_ny);
-
-    agg::rasterizer_scanline_aa<> rasterizer;
-    agg::scanline_bin scanline;
-    agg::rendering_buffer buf(target.getBytes(),
-                              target.width(),
-                              target.height(),
-                              target.width() * pixel_size);
-    pixfmt_pre pixf(buf);
-    renderer_base rb(pixf);
-    rasterizer.clip_box(0, 0, target.width(), target.height());
-    agg::rendering_buffer buf_tile(
-        const_cast<unsigned char*>(source.getBytes()),
-        source.width(),
-        source.height(),
-        source.width() * pixel_size);
-
-    pixfmt_pre pixf_tile(buf_tile);
-
-    using img_accessor_type = agg::image_accessor_clone<pixfmt_pre>;
-    img_accessor_type ia(pixf_tile);
-
-    agg::span_allocator<color_type> sa;
-    // Project mesh cells into target interpolating raster inside each one
-    for (std::size_t j = 0; j < mesh_ny - 1; ++j)
+
+    // Render the target rows [row0, row1), interpolating the raster inside
+    // each cell. Bands of rows are independent so they can run in parallel.
+    auto render_rows = [&](std::size_t row0, std::size_t row1)
     {
-        for (std::size_t i = 0; i < mesh_nx - 1; ++i)
+        agg::rasterizer_scanline_aa<> rasterizer;
+        agg::scanline_bin scanline;
+        agg::rendering_buffer buf(target.getBytes(),
+                                  target.width(),
+                                  target.height(),
+                                  target.width() * pixel_size);
+        pixfmt_pre pixf(buf);
+        renderer_base rb(pixf);
+        rasterizer.clip_box(0, row0, target.width(), row1);
+        agg::rendering_buffer buf_tile(
+            const_cast<unsigned char*>(source.getBytes()),
+            source.width(),
+            source.height(),
+            source.width() * pixel_size);
+
+        pixfmt_pre pixf_tile(buf_tile);
+
+        using img_accessor_type = agg::image_accessor_clone<pixfmt_pre>;
+        img_accessor_type ia(pixf_tile);
+
+        agg::span_allocator<color_type> sa;
+        agg::image_filter_lut filter;
+        if (scaling_method != SCALING_NEAR)
         {
-            double polygon[8] = {xs(i,j), ys(i,j),
-                                 xs(i+1,j), ys(i+1,j),
-                                 xs(i+1,j+1), ys(i+1,j+1),
-                                 xs(i,j+1), ys(i,j+1)};
-            tt.forward(polygon+0, polygon+1);
-            tt.forward(polygon+2, polygon+3);
-            tt.forward(polygon+4, polygon+5);
-            tt.forward(polygon+6, polygon+7);
-
-            rasterizer.reset();
-            rasterizer.move_to_d(std::floor(polygon[0]), std::floor(polygon[1]));
-            rasterizer.line_to_d(std::floor(polygon[2]), std::floor(polygon[3]));
-            rasterizer.line_to_d(std::floor(polygon[4]), std::floor(polygon[5]));
-            rasterizer.line_to_d(std::floor(polygon[6]), std::floor(polygon[7]));
-
-            std::size_t x0 = i * mesh_size;
-            std::size_t y0 = j * mesh_size;
-            std::size_t x1 = (i+1) * mesh_size;
-            std::size_t y1 = (j+1) * mesh_size;
-            x1 = std::min(x1, source.width());
-            y1 = std::min(y1, source.height());
-            agg::trans_affine tr(polygon, x0, y0, x1, y1);
-            if (tr.is_valid())
+            detail::set_scaling_method(filter, scaling_method, filter_factor);
+        }
+        for (std::size_t j = 0; j < mesh_ny - 1; ++j)
+        {
+            for (std::size_t i = 0; i < mesh_nx - 1; ++i)
             {
-                interpolator_type interpolator(tr);
-                if (scaling_method == SCALING_NEAR)
-                {
-                    using span_gen_type = typename detail::agg_scaling_traits<image_type>::span_image_filter;
-                    span_gen_type sg(ia, interpolator);
-                    agg::render_scanlines_bin(rasterizer, scanline, rb, sa, sg);
-                }
-                else
+                double polygon[8];
+                std::copy(cells[j * (mesh_nx - 1) + i].begin(), cells[j * (mesh_nx - 1) + i].end(), polygon);
+                double miny = std::min(std::min(polygon[1], polygon[3]), std::min(polygon[5], polygon[7]));
+                double maxy = std::max(std::max(polygon[1], polygon[3]), std::max(polygon[5], polygon[7]));
+                // cells entirely above or below the band
+                if (std::floor(maxy) < row0 || std::floor(miny) >= row1) continue;
+
+                rasterizer.reset();
+                rasterizer.move_to_d(std::floor(polygon[0]), std::floor(polygon[1]));
+                rasterizer.line_to_d(std::floor(polygon[2]), std::floor(polygon[3]));
+                rasterizer.line_to_d(std::floor(polygon[4]), std::floor(polygon[5]));
+                rasterizer.line_to_d(std::floor(polygon[6]), std::floor(polygon[7]));
+
+                std::size_t x0 = i * mesh_size;
+                std::size_t y0 = j * mesh_size;
+                std::size_t x1 = (i+1) * mesh_size;
+                std::size_t y1 = (j+1) * mesh_size;
+                x1 = std::min(x1, source.width());
+                y1 = std::min(y1, source.height());
+                agg::trans_affine tr(polygon, x0, y0, x1, y1);
+                if (tr.is_valid())
                 {
-                    using span_gen_type = typename detail::agg_scaling_traits<image_type>::span_image_resample_affine;
-                    agg::image_filter_lut filter;
-                    detail::set_scaling_method(filter, scaling_method, filter_factor);
-                    span_gen_type sg(ia, interpolator, filter);
-                    agg::render_scanlines_bin(rasterizer, scanline, rb, sa, sg);
+                    interpolator_type interpolator(tr);
+                    if (scaling_method == SCALING_NEAR)
+                    {
+                        using span_gen_type = typename detail::agg_scaling_traits<image_type>::span_image_filter;
+                        span_gen_type sg(ia, interpolator);
+                        agg::render_scanlines_bin(rasterizer, scanline, rb, sa, sg);
+                    }
+                    else
+                    {
+                        using span_gen_type = typename detail::agg_scaling_traits<image_type>::span_image_resample_affine;
+                        span_gen_type sg(ia, interpolator, filter);
+                        agg::render_scanlines_bin(rasterizer, scanline, rb, sa, sg);
+                    }
                 }
             }
-
         }
-    }
+    };
+
+    std::size_t height = target.height();
+    // bands of at least 64 rows, small targets are not worth the threads
+    mapnik::util::parallel_for(height, 64, render_rows);
 }
 
 namespace detail {
@@ -116,6 +116,7 @@ private:
     unsigned width_;
     unsigned height_;
     bool has_alpha_;
+    unsigned overviews_;
 public:
     explicit webp_reader(char const* data, std::size_t size);
     explicit webp_reader(std::string const& filename);
@@ -126,8 +127,14 @@ public:
     inline bool has_alpha() const final { return has_alpha_; }
     void read(unsigned x,unsigned y,image_rgba8& image) final;
     image_any read(unsigned x, unsigned y, unsigned width, unsigned height) final;
+    // halved sizes down to 1 pixel, scaled by libwebp while decoding
+    unsigned overviews() const final { return overviews_; }
+    unsigned overview_width(unsigned level) const final;
+    unsigned overview_height(unsigned level) const final;
+    image_any read_overview(unsigned level, unsigned x, unsigned y, unsigned width, unsigned height) final;
 private:
     void init();
+    void read_scaled(unsigned level, unsigned x, unsigned y, image_rgba8& image);
 };
 
 namespace
@@ -154,7 +161,8 @@ webp_reader<T>::webp_reader(char const* data, std::size_t size)
     : buffer_(new buffer_policy_type(reinterpret_cast<uint8_t const*>(data), size)),
       width_(0),
       height_(0),
-      has_alpha_(false)
+      has_alpha_(false),
+      overviews_(0)
 {
     init();
 }
@@ -165,7 +173,8 @@ webp_reader<T>::webp_reader(std::string const& filename)
       size_(0),
       width_(0),
       height_(0),
-      has_alpha_(false)
+      has_alpha_(false),
+      overviews_(0)
 {
     std::ifstream file(filename.c_str(), std::ios::binary);
     if (!file)
@@ -210,6 +219,7 @@ void webp_reader<T>::init()
         width_ = config.input.width;
         height_ = config.input.height;
         has_alpha_ = config.input.has_alpha;
+        while ((width_ >> (overviews_ + 1)) > 0 && (height_ >> (overviews_ + 1)) > 0) ++overviews_;
     }
     else
     {
@@ -235,9 +245,36 @@ boost::optional<box2d<double> > webp_reader<T>::bounding_box() const
     return boost::optional<box2d<double> >();
 }
 
+template <typename T>
+unsigned webp_reader<T>::overview_width(unsigned level) const
+{
+    if (level > overviews_) throw image_reader_exception("WEBP reader: no such overview");
+    return (width_ + (1u << level) - 1) >> level;
+}
+
+template <typename T>
+unsigned webp_reader<T>::overview_height(unsigned level) const
+{
+    if (level > overviews_) throw image_reader_exception("WEBP reader: no such overview");
+    return (height_ + (1u << level) - 1) >> level;
+}
+
 template <typename T>
 void webp_reader<T>::read(unsigned x0, unsigned y0,image_rgba8& image)
 {
+    read_scaled(0, x0, y0, image);
+}
+
+template <typename T>
+void webp_reader<T>::read_scaled(unsigned level, unsigned x0, unsigned y0,image_rgba8& image)
+{
+    unsigned level_width = overview_width(level);
+    unsigned level_height = overview_height(level);
+    if (x0 >= level_width || y0 >= level_height) return;
+    unsigned w = std::min(static_cast<std::size_t>(level_width - x0), image.width());
+    unsigned h = std::min(static_cast<std::size_t>(level_height - y0), image.height());
+    if (w == 0 || h == 0) return;
+
     WebPDecoderConfig config;
     config_guard guard(config);
     if (!WebPInitDecoderConfig(&config))
@@ -245,11 +282,19 @@ void webp_reader<T>::read(unsigned x0, unsigned y0,image_rgba8& image)
         throw image_reader_exception("WEBP reader: WebPInitDecoderConfig failed");
     }
 
+    // the window is cropped from the full size image, then scaled down
+    unsigned factor = 1u << level;
     config.options.use_cropping = 1;
-    config.options.crop_left = x0;
-    config.options.crop_top = y0;
-    config.options.crop_width = std::min(static_cast<std::size_t>(width_ - x0), image.width());
-    config.options.crop_height = std::min(static_cast<std::size_t>(height_ - y0), image.height());
+    config.options.crop_left = x0 * factor;
+    config.options.crop_top = y0 * factor;
+    config.options.crop_width = std::min(w * factor, width_ - x0 * factor);
+    config.options.crop_height = std::min(h * factor, height_ - y0 * factor);
+    if (level > 0)
+    {
+        config.options.use_scaling = 1;
+        config.options.scaled_width = w;
+        config.options.scaled_height = h;
+    }
 
     if (WebPGetFeatures(buffer_->data(), buffer_->size(), &config.input) != VP8_STATUS_OK)
     {
@@ -275,4 +320,12 @@ image_any webp_reader<T>::read(unsigned x, unsigned y, unsigned width, unsigned
     return image_any(std::move(data));
 }
 
+template <typename T>
+image_any webp_reader<T>::read_overview(unsigned level, unsigned x, unsigned y, unsigned width, unsigned height)
+{
+    image_rgba8 data(width,height);
+    read_scaled(level, x, y, data);
+    return image_any(std::move(data));
+}
+
 }
@@ -0,0 +1,98 @@
+#include "catch.hpp"
+
+#include <mapnik/datasource_cache.hpp>
+#include <mapnik/datasource.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/query.hpp>
+#include <mapnik/geometry.hpp>
+#include <mapnik/util/fs.hpp>
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace {
+
+using feature_values = std::tuple<mapnik::value_integer, double, double, std::string>;
+
+// rows ending with `newline` and quoted labels spanning several lines, enough
+// of them for the rows to be split into chunks of 64KB, most boundaries
+// falling inside quotes
+void write_csv(std::string const& filename, std::size_t rows, char newline)
+{
+    std::ofstream out(filename.c_str(), std::ios::binary);
+    out << "x,y,label" << newline;
+    for (std::size_t i = 0; i < rows; ++i)
+    {
+        out << (i % 360) - 180.0 << "," << (i % 170) - 85.0 << ",\"row " << i;
+        for (std::size_t line = 0; line < i % 7; ++line)
+        {
+            out << "\nline " << line << ", \"\"quoted\"\" text";
+        }
+        out << "\"" << newline;
+    }
+}
+
+std::vector<feature_values> read_features(std::string const& filename, unsigned jobs)
+{
+    mapnik::parameters params;
+    params["type"] = "csv";
+    params["file"] = filename;
+    params["jobs"] = static_cast<mapnik::value_integer>(jobs);
+    mapnik::datasource_ptr ds = mapnik::datasource_cache::instance().create(params);
+    REQUIRE( ds != nullptr );
+    mapnik::query q(ds->envelope());
+    q.add_property_name("label");
+    std::vector<feature_values> features;
+    mapnik::featureset_ptr fs = ds->features(q);
+    while (mapnik::feature_ptr feature = fs->next())
+    {
+        auto const& geom = feature->get_geometry();
+        REQUIRE( geom.is<mapnik::geometry::point<double> >() );
+        auto const& pt = mapnik::util::get<mapnik::geometry::point<double> >(geom);
+        features.emplace_back(feature->id(), pt.x, pt.y, feature->get("label").to_string());
+    }
+    return features;
+}
+
+}
+
+TEST_CASE("csv") {
+
+std::string plugin("./plugins/input/csv.input");
+if (!mapnik::util::exists(plugin))
+{
+    WARN( std::string("could not register ") + plugin );
+    return;
+}
+mapnik::datasource_cache::instance().register_datasource(plugin);
+
+SECTION("parallel chunks give the same features as a serial read") {
+    std::size_t rows = 20000;
+    // rows are lines, only labels over lines of another kind are kept whole
+    for (char newline : { '\r', '\n' })
+    {
+        INFO( "newline " << static_cast<int>(newline) );
+        std::string filename("/tmp/mapnik-csv-multiline-" + std::to_string(static_cast<int>(newline)) + ".csv");
+        write_csv(filename, rows, newline);
+        std::vector<feature_values> expected = read_features(filename, 1);
+        REQUIRE( !expected.empty() );
+        if (newline == '\r')
+        {
+            REQUIRE( expected.size() == rows );
+            REQUIRE( std::get<3>(expected[6]) == "row 6\nline 0, \"quoted\" text\nline 1, \"quoted\" text\n"
+                                                 "line 2, \"quoted\" text\nline 3, \"quoted\" text\n"
+                                                 "line 4, \"quoted\" text\nline 5, \"quoted\" text" );
+        }
+        for (unsigned jobs : { 2, 3, 8 })
+        {
+            INFO( "jobs " << jobs );
+            REQUIRE( read_features(filename, jobs) == expected );
+        }
+        std::remove(filename.c_str());
+    }
+}
+
+}
@@ -52,4 +52,39 @@ SECTION("hello world") {
 
 }
 
+SECTION("gdal featuresets of all styles open at once") {
+
+    std::string plugin("./plugins/input/gdal.input");
+    if (mapnik::util::exists(plugin))
+    {
+        try
+        {
+            mapnik::datasource_cache::instance().register_datasource(plugin);
+            mapnik::parameters p;
+            p["type"] = "gdal";
+            p["file"] = "./tests/data/tiff/ndvi_256x256_gray8_tiled_overviews.tif";
+            // a single dataset handle for more featuresets than that
+            p["max_size"] = "1";
+            p["pool_wait_timeout"] = "0";
+            mapnik::datasource_ptr ds = mapnik::datasource_cache::instance().create(p);
+            mapnik::query q(ds->envelope());
+            mapnik::featureset_ptr fs1 = ds->features(q);
+            mapnik::featureset_ptr fs2 = ds->features(q);
+            REQUIRE( fs1 != mapnik::featureset_ptr() );
+            REQUIRE( fs2 != mapnik::featureset_ptr() );
+            REQUIRE( fs1->next() != mapnik::feature_ptr() );
+            REQUIRE( fs2->next() != mapnik::feature_ptr() );
+        }
+        catch (std::exception const& ex)
+        {
+            FAIL(ex.what());
+        }
+    }
+    else
+    {
+        WARN( std::string("could not register ") + plugin );
+    }
+
+}
+
 }
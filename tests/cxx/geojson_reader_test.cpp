@@ -0,0 +1,159 @@
+#include "catch.hpp"
+#include "geometry_equal.hpp"
+
+#include <mapnik/feature.hpp>
+#include <mapnik/unicode.hpp>
+#include <mapnik/util/file_io.hpp>
+#include <mapnik/json/geojson_reader.hpp>
+#include <mapnik/json/feature_collection_grammar.hpp>
+#include <mapnik/json/geometry_parser.hpp>
+
+#include <string>
+#include <vector>
+
+namespace {
+
+std::vector<mapnik::feature_ptr> parse_with_grammar(std::string const& json, mapnik::transcoder const& tr)
+{
+    using iterator_type = char const*;
+    static const mapnik::json::feature_collection_grammar<iterator_type, mapnik::feature_impl> g(tr);
+    std::vector<mapnik::feature_ptr> features;
+    mapnik::json::default_feature_callback callback(features);
+    mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+    std::size_t start_id = 1;
+    iterator_type start = json.c_str();
+    iterator_type end = start + json.size();
+    boost::spirit::ascii::space_type space;
+    REQUIRE( boost::spirit::qi::phrase_parse(start, end, (g)(boost::phoenix::ref(ctx),
+                                                             boost::phoenix::ref(start_id),
+                                                             boost::phoenix::ref(callback)), space) );
+    return features;
+}
+
+std::vector<mapnik::feature_ptr> parse_with_reader(std::string const& json, mapnik::transcoder const& tr)
+{
+    std::vector<mapnik::feature_ptr> features;
+    mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+    std::size_t start_id = 1;
+    char const* start = json.c_str();
+    char const* end = start + json.size();
+    REQUIRE( mapnik::json::read_features(start, end, ctx, start_id, tr, features) );
+    return features;
+}
+
+void assert_features_equal(mapnik::feature_impl const& f1, mapnik::feature_impl const& f2)
+{
+    REQUIRE( f1.id() == f2.id() );
+    assert_g_equal(f1.get_geometry(), f2.get_geometry());
+    REQUIRE( f1.size() == f2.size() );
+    for (auto const& kv : f1)
+    {
+        std::string const& key = std::get<0>(kv);
+        mapnik::value const& val = std::get<1>(kv);
+        INFO( key );
+        REQUIRE( f2.has_key(key) );
+        mapnik::value const& other = f2.get(key);
+        REQUIRE( val.which() == other.which() );
+        REQUIRE( val.to_string() == other.to_string() );
+    }
+}
+
+std::string read_file(std::string const& filename)
+{
+    mapnik::util::file input(filename);
+    REQUIRE( input.open() );
+    auto data = input.data();
+    return std::string(data.get(), input.size());
+}
+
+}
+
+TEST_CASE("geojson reader") {
+
+mapnik::transcoder tr("utf8");
+
+SECTION("gives the same features as the grammar") {
+    for (auto const& filename : { "./tests/data/json/escaped.geojson",
+                                  "./tests/data/json/lines.geojson",
+                                  "./tests/data/json/points.geojson",
+                                  "./tests/data/json/null_feature.geojson",
+                                  "./tests/data/json/poly-multihole.json",
+                                  "./tests/data/json/feature_collection_level_properties.json",
+                                  "./tests/data/json/fixtures/point1.json",
+                                  "./tests/data/json/fixtures/point2.json" })
+    {
+        INFO( filename );
+        std::string json = read_file(filename);
+        std::vector<mapnik::feature_ptr> expected = parse_with_grammar(json, tr);
+        std::vector<mapnik::feature_ptr> features = parse_with_reader(json, tr);
+        REQUIRE( features.size() == expected.size() );
+        for (std::size_t i = 0; i < features.size(); ++i)
+        {
+            assert_features_equal(*expected[i], *features[i]);
+        }
+    }
+}
+
+SECTION("geometries") {
+    for (std::string const& json : {
+            std::string("{\"type\":\"Point\",\"coordinates\":[30.5,-10.25,100]}"),
+            std::string("{\"coordinates\":[[30,10],[10,30],[40,40]],\"type\":\"LineString\"}"),
+            std::string("{\"type\":\"LineString\",\"coordinates\":[[30,10]]}"),
+            std::string("{\"type\":\"Polygon\",\"coordinates\":[[[35,10],[45,45],[15,40],[10,20],[35,10]],"
+                        "[[20,30],[35,35],[30,20],[20,30]]]}"),
+            std::string("{\"type\":\"MultiPoint\",\"coordinates\":[[10,40],[40,30],[20,20],[30,10]]}"),
+            std::string("{\"type\":\"MultiLineString\",\"coordinates\":[[[10,10],[20,20],[10,40]],"
+                        "[[40,40],[30,30],[40,20],[30,10]]]}"),
+            std::string("{\"type\":\"MultiPolygon\",\"coordinates\":[[[[30,20],[45,40],[10,40],[30,20]]],"
+                        "[[[15,5],[40,10],[10,20],[5,10],[15,5]]]]}"),
+            std::string("{\"type\":\"GeometryCollection\",\"geometries\":[{\"type\":\"Point\",\"coordinates\":[4,6]},"
+                        "{\"type\":\"LineString\",\"coordinates\":[[4,6],[7,10]]}]}"),
+            std::string("{\"type\":\"Point\",\"coordinates\":[1e3,-2.5E-2]}"),
+            std::string("{\"type\":\"Point\",\"coordinates\":[0.30000000000000004,123456789012345678901234]}"),
+            std::string("null") })
+    {
+        INFO( json );
+        mapnik::geometry::geometry<double> expected;
+        REQUIRE( mapnik::json::from_geojson(json, expected) );
+        mapnik::geometry::geometry<double> geom;
+        char const* start = json.c_str();
+        REQUIRE( mapnik::json::read_geometry(start, start + json.size(), geom) );
+        REQUIRE( start == json.c_str() + json.size() );
+        assert_g_equal(expected, geom);
+    }
+}
+
+SECTION("unknown members and escapes") {
+    std::string json("{ \"bbox\" : [0,0,1,1], \"type\" : \"Feature\", \"id\" : 7,"
+                     " \"geometry\" : { \"bbox\" : [1,2,1,2], \"coordinates\" : [1,2], \"type\" : \"Point\" },"
+                     " \"properties\" : { \"na\\u006De\" : \"a \\\"b\\\" \\u00e9\\t\","
+                     " \"big\" : 12345678901234567890, \"object\" : { \"a\" : \"x y\", \"b\" : [ 1, 2 ] } } }");
+    mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+    mapnik::feature_impl feature(ctx, 1);
+    char const* start = json.c_str();
+    REQUIRE( mapnik::json::read_feature(start, start + json.size(), feature, tr) );
+    REQUIRE( feature.get_geometry().is<mapnik::geometry::point<double> >() );
+    auto const& pt = mapnik::util::get<mapnik::geometry::point<double> >(feature.get_geometry());
+    REQUIRE( pt.x == 1 );
+    REQUIRE( pt.y == 2 );
+    REQUIRE( feature.get("name").to_string() == "a \"b\" \xc3\xa9\t" );
+    REQUIRE( feature.get("big").is<mapnik::value_double>() );
+    REQUIRE( feature.get("object").to_string() == "{\"a\":\"x y\",\"b\":[1,2]}" );
+}
+
+SECTION("malformed input") {
+    for (std::string const& json : {
+            std::string("{\"type\":\"Feature\",\"geometry\":{\"type\":\"Point\",\"coordinates\":[1,2]}"),
+            std::string("{\"type\":\"Feature\",\"properties\":{\"a\":}}"),
+            std::string("{\"type\":\"Feature\",\"properties\":{\"a\":\"b}}"),
+            std::string("{\"type\":\"Feature\",\"geometry\":{\"type\":\"Circle\",\"coordinates\":[1,2]}}") })
+    {
+        INFO( json );
+        mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+        mapnik::feature_impl feature(ctx, 1);
+        char const* start = json.c_str();
+        REQUIRE( !mapnik::json::read_feature(start, start + json.size(), feature, tr) );
+    }
+}
+
+}
@@ -127,4 +127,28 @@ SECTION("readers") {
     }
 
 }
+
+#if defined(HAVE_JPEG)
+SECTION("jpeg overviews") {
+    std::unique_ptr<mapnik::image_reader> reader(mapnik::get_image_reader("./tests/data/images/checker.jpg", "jpeg"));
+    REQUIRE( reader->width() == 70 );
+    REQUIRE( reader->overviews() == 3 );
+    REQUIRE( reader->overview_width(1) == 35 );
+    REQUIRE( reader->overview_height(3) == 9 );
+    REQUIRE( reader->overview_for_scale(2.5) == 1 );
+    mapnik::image_any full = reader->read_overview(1, 0, 0, 35, 35);
+    mapnik::image_any window = reader->read_overview(1, 10, 20, 12, 8);
+    REQUIRE( window.width() == 12 );
+    REQUIRE( window.height() == 8 );
+    mapnik::image_rgba8 const& f = mapnik::util::get<mapnik::image_rgba8>(full);
+    mapnik::image_rgba8 const& w = mapnik::util::get<mapnik::image_rgba8>(window);
+    for (unsigned y = 0; y < 8; ++y)
+    {
+        for (unsigned x = 0; x < 12; ++x)
+        {
+            REQUIRE( w(x, y) == f(x + 10, y + 20) );
+        }
+    }
+}
+#endif
 }
\ No newline at end of file
@@ -0,0 +1,79 @@
+#include "catch.hpp"
+
+#include <mapnik/image.hpp>
+#include <mapnik/image_scaling.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <utility>
+
+namespace {
+
+// premultiplied gradients with noise, some of it transparent
+mapnik::image_rgba8 make_source(std::size_t width, std::size_t height)
+{
+    mapnik::image_rgba8 image(width, height);
+    std::uint32_t state = 12345;
+    for (std::size_t y = 0; y < height; ++y)
+    {
+        for (std::size_t x = 0; x < width; ++x)
+        {
+            state = state * 1103515245 + 12345;
+            unsigned noise = (state >> 16) & 0x3f;
+            unsigned a = (x < width / 4) ? 0 : (x < width / 2 ? 128 : 255);
+            unsigned r = std::min(a, static_cast<unsigned>(x * 255 / width) ^ noise);
+            unsigned g = std::min(a, static_cast<unsigned>(y * 255 / height) ^ noise);
+            unsigned b = std::min(a, noise * 4);
+            image(x, y) = (a << 24) | (b << 16) | (g << 8) | r;
+        }
+    }
+    return image;
+}
+
+// largest difference of a channel between two images
+int max_difference(mapnik::image_rgba8 const& a, mapnik::image_rgba8 const& b)
+{
+    int diff = 0;
+    for (std::size_t y = 0; y < a.height(); ++y)
+    {
+        for (std::size_t x = 0; x < a.width(); ++x)
+        {
+            for (unsigned shift = 0; shift < 32; shift += 8)
+            {
+                int ca = (a(x, y) >> shift) & 0xff;
+                int cb = (b(x, y) >> shift) & 0xff;
+                diff = std::max(diff, std::abs(ca - cb));
+            }
+        }
+    }
+    return diff;
+}
+
+}
+
+TEST_CASE("image scaling") {
+
+SECTION("separable resampling stays within 2 of the AGG span filters") {
+    mapnik::image_rgba8 source = make_source(97, 83);
+    for (auto method : { mapnik::SCALING_BILINEAR, mapnik::SCALING_BICUBIC, mapnik::SCALING_SPLINE36,
+                         mapnik::SCALING_GAUSSIAN, mapnik::SCALING_LANCZOS, mapnik::SCALING_BLACKMAN })
+    {
+        for (auto ratio : { std::make_pair(0.25, 0.25), std::make_pair(0.5, 0.7), std::make_pair(1.0, 1.0),
+                            std::make_pair(1.6, 1.6), std::make_pair(3.0, 0.5) })
+        {
+            INFO( "method " << *mapnik::scaling_method_to_string(method)
+                  << " ratio " << ratio.first << "x" << ratio.second );
+            std::size_t width = static_cast<std::size_t>(source.width() * ratio.first + 0.5);
+            std::size_t height = static_cast<std::size_t>(source.height() * ratio.second + 0.5);
+            mapnik::image_rgba8 separable(width, height);
+            mapnik::image_rgba8 spans(width, height);
+            mapnik::scale_image_agg(separable, source, method, ratio.first, ratio.second, 0.0, 0.0, 1.0);
+            mapnik::detail::scale_image_spans(spans, source, method, ratio.first, ratio.second, 0.0, 0.0, 1.0);
+            REQUIRE( max_difference(separable, spans) <= 2 );
+        }
+    }
+}
+
+}
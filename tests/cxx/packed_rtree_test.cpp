@@ -0,0 +1,189 @@
+#include "catch.hpp"
+
+#include <mapnik/util/packed_rtree.hpp>
+#include <mapnik/datasource_cache.hpp>
+#include <mapnik/datasource.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/query.hpp>
+#include <mapnik/util/fs.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+using entry_type = mapnik::util::packed_rtree_entry<1>;
+
+const char test_magic[8] = {'t','e','s','t','t','r','e','e'};
+
+// boxes on a grid, some overlapping their neighbours
+std::vector<mapnik::box2d<double> > grid_boxes(std::size_t count)
+{
+    std::vector<mapnik::box2d<double> > boxes;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        double x = static_cast<double>((i * 37) % 101);
+        double y = static_cast<double>((i * 53) % 97);
+        double size = static_cast<double>(i % 5);
+        boxes.emplace_back(x, y, x + size, y + size);
+    }
+    return boxes;
+}
+
+std::string write_tree(std::vector<mapnik::box2d<double> > const& boxes, unsigned node_size)
+{
+    mapnik::box2d<double> extent(0, 0, 105, 101);
+    mapnik::util::packed_rtree tree(extent, node_size);
+    for (std::size_t i = 0; i < boxes.size(); ++i)
+    {
+        tree.insert(i, boxes[i]);
+    }
+    tree.build();
+    std::ostringstream out;
+    mapnik::util::packed_rtree_write(out, tree.header(test_magic, 1));
+    for (std::size_t i = 0; i < tree.count(); ++i)
+    {
+        mapnik::box2d<double> const& box = tree.box(i);
+        entry_type entry = {{ box.minx(), box.miny(), box.maxx(), box.maxy() }, { tree.offset(i) }};
+        mapnik::util::packed_rtree_write(out, entry);
+    }
+    return out.str();
+}
+
+bool read_header(std::string const& data, mapnik::util::packed_rtree_header & header)
+{
+    if (data.size() < sizeof(header)) return false;
+    std::memcpy(&header, data.data(), sizeof(header));
+    mapnik::util::packed_rtree_little_endian(header);
+    return mapnik::util::packed_rtree_valid(header, test_magic, 1, sizeof(header), sizeof(entry_type), data.size());
+}
+
+std::vector<std::uint64_t> query_tree(std::string const& data, mapnik::box2d<double> const& box)
+{
+    mapnik::util::packed_rtree_header header;
+    std::vector<std::uint64_t> items;
+    if (!read_header(data, header)) return items;
+    // copied to get the alignment of the mapped files
+    std::vector<entry_type> entries(header.num_nodes);
+    std::memcpy(entries.data(), data.data() + sizeof(header), entries.size() * sizeof(entry_type));
+    mapnik::util::packed_rtree_query<entry_type>(
+        header,
+        [&box](mapnik::box2d<double> const& entry_box) { return entry_box.intersects(box); },
+        mapnik::util::packed_rtree_memory_nodes<entry_type>(entries.data()),
+        [&items](entry_type const& entry) { items.push_back(entry.values[0]); return true; });
+    std::sort(items.begin(), items.end());
+    return items;
+}
+
+std::vector<std::uint64_t> query_boxes(std::vector<mapnik::box2d<double> > const& boxes, mapnik::box2d<double> const& box)
+{
+    std::vector<std::uint64_t> items;
+    for (std::size_t i = 0; i < boxes.size(); ++i)
+    {
+        if (boxes[i].intersects(box)) items.push_back(i);
+    }
+    return items;
+}
+
+}
+
+TEST_CASE("packed rtree") {
+
+SECTION("level bounds") {
+    REQUIRE( mapnik::util::packed_rtree_level_bounds(0, 16).empty() );
+    REQUIRE( mapnik::util::packed_rtree_level_bounds(1, 16) == std::vector<std::uint64_t>({1, 2}) );
+    REQUIRE( mapnik::util::packed_rtree_level_bounds(10, 3) == std::vector<std::uint64_t>({10, 14, 16, 17}) );
+}
+
+SECTION("round trip finds the same items as a scan") {
+    for (std::size_t count : { 1, 2, 17, 1000 })
+    {
+        for (unsigned node_size : { 2, 4, 16 })
+        {
+            INFO( "items " << count << " node size " << node_size );
+            std::vector<mapnik::box2d<double> > boxes = grid_boxes(count);
+            std::string data = write_tree(boxes, node_size);
+            mapnik::util::packed_rtree_header header;
+            REQUIRE( read_header(data, header) );
+            REQUIRE( header.num_items == count );
+            REQUIRE( header.node_size == node_size );
+            REQUIRE( data.size() == sizeof(header) + header.num_nodes * sizeof(entry_type) );
+            for (auto const& box : { mapnik::box2d<double>(0, 0, 105, 101),
+                                     mapnik::box2d<double>(10, 10, 30, 20),
+                                     mapnik::box2d<double>(50.5, 50.5, 50.6, 50.6),
+                                     mapnik::box2d<double>(200, 200, 300, 300) })
+            {
+                REQUIRE( query_tree(data, box) == query_boxes(boxes, box) );
+            }
+        }
+    }
+}
+
+SECTION("truncated or foreign files are rejected") {
+    std::string data = write_tree(grid_boxes(100), 8);
+    mapnik::util::packed_rtree_header header;
+    REQUIRE( read_header(data, header) );
+    REQUIRE( !read_header(data.substr(0, data.size() - 1), header) );
+    std::string other(data);
+    other[0] = 'x';
+    REQUIRE( !read_header(other, header) );
+}
+
+SECTION("geojson index") {
+    std::string plugin("./plugins/input/geojson.input");
+    std::string tool("./utils/geojsonindex/geojsonindex");
+    if (!mapnik::util::exists(plugin) || !mapnik::util::exists(tool))
+    {
+        WARN( std::string("could not register ") + plugin + " or find " + tool );
+        return;
+    }
+    mapnik::datasource_cache::instance().register_datasource(plugin);
+    std::string filename("/tmp/mapnik-geojson-index-points.geojson");
+    {
+        std::remove((filename + ".index").c_str());
+        std::ifstream in("./tests/data/json/points.geojson", std::ios::binary);
+        std::ofstream out(filename.c_str(), std::ios::binary);
+        out << in.rdbuf();
+    }
+    REQUIRE( std::system((tool + " " + filename + " > /dev/null 2>&1").c_str()) == 0 );
+    REQUIRE( mapnik::util::exists(filename + ".index") );
+
+    // the same features through the in-memory tree and through the index
+    std::vector<std::vector<std::string> > results;
+    for (char const* cache_features : { "true", "false" })
+    {
+        mapnik::parameters params;
+        params["type"] = "geojson";
+        params["file"] = filename;
+        params["cache_features"] = cache_features;
+        mapnik::datasource_ptr ds = mapnik::datasource_cache::instance().create(params);
+        REQUIRE( ds != nullptr );
+        mapnik::box2d<double> extent = ds->envelope();
+        for (auto const& box : { extent,
+                                 mapnik::box2d<double>(extent.minx(), extent.miny(), extent.center().x, extent.center().y) })
+        {
+            // features read from the file all have the id 1, compare their labels
+            mapnik::query q(box);
+            q.add_property_name("label");
+            std::vector<std::string> labels;
+            mapnik::featureset_ptr fs = ds->features(q);
+            while (mapnik::feature_ptr feature = fs->next())
+            {
+                labels.push_back(feature->get("label").to_string());
+            }
+            std::sort(labels.begin(), labels.end());
+            results.push_back(labels);
+        }
+    }
+    REQUIRE( !results[0].empty() );
+    REQUIRE( results[0] == results[2] );
+    REQUIRE( results[1] == results[3] );
+}
+
+}
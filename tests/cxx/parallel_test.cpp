@@ -0,0 +1,71 @@
+#include "catch.hpp"
+
+#include <mapnik/util/parallel.hpp>
+
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+TEST_CASE("parallel") {
+
+SECTION("every item is visited once") {
+    for (std::size_t count : { 0, 1, 63, 64, 1000 })
+    {
+        std::vector<std::atomic<int> > visits(count);
+        for (auto & v : visits) v = 0;
+        mapnik::util::parallel_for(count, 16, [&visits](std::size_t first, std::size_t last) {
+                for (std::size_t i = first; i < last; ++i) ++visits[i];
+            });
+        for (auto const& v : visits)
+        {
+            REQUIRE( v == 1 );
+        }
+    }
+}
+
+SECTION("the limit is shared and restored") {
+    unsigned threads = mapnik::util::parallel_threads();
+    mapnik::util::set_parallel_threads(0);
+    std::thread::id caller = std::this_thread::get_id();
+    bool inline_only = true;
+    mapnik::util::parallel_for(1000, 1, [&](std::size_t, std::size_t) {
+            if (std::this_thread::get_id() != caller) inline_only = false;
+        });
+    REQUIRE( inline_only );
+    mapnik::util::set_parallel_threads(2);
+    std::atomic<int> bands(0);
+    mapnik::util::parallel_for(1000, 1, [&bands](std::size_t, std::size_t) { ++bands; });
+#ifdef MAPNIK_THREADSAFE
+    REQUIRE( bands == 3 );
+    bands = 0;
+    mapnik::util::parallel_for(1000, 1, [&bands](std::size_t, std::size_t) { ++bands; }, 2);
+    REQUIRE( bands == 2 );
+#else
+    REQUIRE( bands == 1 );
+#endif
+    mapnik::util::set_parallel_threads(threads);
+}
+
+SECTION("exceptions are rethrown once the bands are done") {
+    unsigned threads = mapnik::util::parallel_threads();
+    mapnik::util::set_parallel_threads(2);
+    std::atomic<int> bands(0);
+    REQUIRE_THROWS_AS(
+        mapnik::util::parallel_for(1000, 1, [&bands](std::size_t first, std::size_t) {
+                ++bands;
+                if (first == 0) throw std::runtime_error("first band");
+            }),
+        std::runtime_error const&);
+    // and the threads are given back
+    bands = 0;
+    mapnik::util::parallel_for(1000, 1, [&bands](std::size_t, std::size_t) { ++bands; });
+#ifdef MAPNIK_THREADSAFE
+    REQUIRE( bands == 3 );
+#else
+    REQUIRE( bands == 1 );
+#endif
+    mapnik::util::set_parallel_threads(threads);
+}
+
+}
@@ -0,0 +1,112 @@
+#include "catch.hpp"
+
+#include <mapnik/pool.hpp>
+
+#include <chrono>
+#include <memory>
+#include <vector>
+
+namespace {
+
+struct dummy_connection
+{
+    dummy_connection()
+        : ok(true) {}
+    bool isOK() const { return ok; }
+    bool ok;
+};
+
+template <typename T>
+struct dummy_creator
+{
+    T* operator()() const
+    {
+        return new T();
+    }
+};
+
+using pool_type = mapnik::Pool<dummy_connection, dummy_creator>;
+
+}
+
+TEST_CASE("pool") {
+
+SECTION("borrow and return") {
+
+    pool_type pool(dummy_creator<dummy_connection>(), 1, 2);
+    REQUIRE(pool.size() == 1);
+    {
+        std::shared_ptr<dummy_connection> c1 = pool.borrowObject();
+        REQUIRE(c1);
+        std::shared_ptr<dummy_connection> c2 = pool.borrowObject();
+        REQUIRE(c2);
+        REQUIRE(c1 != c2);
+        REQUIRE(pool.size() == 2);
+        REQUIRE(pool.stats().in_use == 2);
+        // exhausted, no waiting
+        std::shared_ptr<dummy_connection> c3 = pool.borrowObject(std::chrono::milliseconds(0));
+        REQUIRE(!c3);
+        REQUIRE(pool.stats().timeouts == 1);
+    }
+    mapnik::pool_stats stats = pool.stats();
+    REQUIRE(stats.in_use == 0);
+    REQUIRE(stats.idle == 2);
+    REQUIRE(stats.created == 2);
+    REQUIRE(stats.borrows == 2);
+}
+
+SECTION("returned objects are reused") {
+
+    pool_type pool(dummy_creator<dummy_connection>(), 1, 1);
+    dummy_connection * raw = nullptr;
+    {
+        std::shared_ptr<dummy_connection> c = pool.borrowObject();
+        raw = c.get();
+    }
+    std::shared_ptr<dummy_connection> c = pool.borrowObject();
+    REQUIRE(c.get() == raw);
+    REQUIRE(pool.stats().created == 1);
+}
+
+SECTION("broken objects are replaced") {
+
+    pool_type pool(dummy_creator<dummy_connection>(), 1, 1);
+    {
+        std::shared_ptr<dummy_connection> c = pool.borrowObject();
+        c->ok = false;
+    }
+    REQUIRE(pool.size() == 0);
+    std::shared_ptr<dummy_connection> c = pool.borrowObject();
+    REQUIRE(c);
+    REQUIRE(c->isOK());
+    mapnik::pool_stats stats = pool.stats();
+    REQUIRE(stats.broken == 1);
+    REQUIRE(stats.created == 2);
+}
+
+SECTION("borrowed objects outlive the pool") {
+
+    std::shared_ptr<dummy_connection> c;
+    {
+        pool_type pool(dummy_creator<dummy_connection>(), 1, 1);
+        c = pool.borrowObject();
+    }
+    REQUIRE(c);
+    REQUIRE(c->isOK());
+}
+
+#ifdef MAPNIK_THREADSAFE
+SECTION("exhausted pool waits up to the timeout") {
+
+    pool_type pool(dummy_creator<dummy_connection>(), 1, 1);
+    std::shared_ptr<dummy_connection> c = pool.borrowObject();
+    std::shared_ptr<dummy_connection> c2 = pool.borrowObject(std::chrono::milliseconds(10));
+    REQUIRE(!c2);
+    mapnik::pool_stats stats = pool.stats();
+    REQUIRE(stats.waits == 1);
+    REQUIRE(stats.timeouts == 1);
+    REQUIRE(stats.wait_time.count() > 0);
+}
+#endif
+
+}
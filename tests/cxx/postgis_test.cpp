@@ -0,0 +1,129 @@
+#include "catch.hpp"
+
+#include <mapnik/datasource_cache.hpp>
+#include <mapnik/datasource.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/query.hpp>
+#include <mapnik/feature_style_processor_context.hpp>
+#include <mapnik/util/fs.hpp>
+
+#include <string>
+#include <vector>
+#include <utility>
+
+// Needs a PostgreSQL server with PostGIS, reached through the usual libpq
+// environment variables (PGHOST, PGDATABASE, PGUSER...). Skipped otherwise.
+
+namespace {
+
+// three points, the layer queries only use the bbox to select them
+const std::string table("(SELECT id, geom, pg_typeof(!bbox!)::text AS bbox_type"
+                        " FROM (SELECT id, ST_SetSRID(ST_MakePoint(x, y), 4326) AS geom"
+                        " FROM (VALUES (1, 0.0, 0.0), (2, 10.0, 10.0), (3, -50.0, 5.0)) AS t(id, x, y)) AS points"
+                        " WHERE geom && !bbox!) AS data");
+
+mapnik::datasource_ptr create_datasource(std::vector<std::pair<std::string, std::string> > const& options)
+{
+    mapnik::parameters p;
+    p["type"] = "postgis";
+    p["table"] = table;
+    p["geometry_field"] = "geom";
+    p["key_field"] = "id";
+    p["srid"] = "4326";
+    p["extent"] = "-180,-90,180,90";
+    for (auto const& option : options)
+    {
+        p[option.first] = option.second;
+    }
+    return mapnik::datasource_cache::instance().create(p);
+}
+
+mapnik::query test_query()
+{
+    mapnik::query q(mapnik::box2d<double>(-20, -20, 20, 20));
+    q.add_property_name("bbox_type");
+    return q;
+}
+
+// ids and !bbox! types of the features of `fs`
+std::vector<std::pair<mapnik::value_integer, std::string> > read_features(mapnik::featureset_ptr const& fs)
+{
+    std::vector<std::pair<mapnik::value_integer, std::string> > features;
+    REQUIRE( fs != mapnik::featureset_ptr() );
+    while (mapnik::feature_ptr feature = fs->next())
+    {
+        features.emplace_back(feature->id(), feature->get("bbox_type").to_string());
+    }
+    return features;
+}
+
+// ids and !bbox! types of the features within -20,-20,20,20
+std::vector<std::pair<mapnik::value_integer, std::string> > read_features(mapnik::datasource_ptr const& ds)
+{
+    return read_features(ds->features(test_query()));
+}
+
+}
+
+TEST_CASE("postgis") {
+
+std::string plugin("./plugins/input/postgis.input");
+if (!mapnik::util::exists(plugin))
+{
+    WARN( std::string("could not register ") + plugin );
+    return;
+}
+mapnik::datasource_cache::instance().register_datasource(plugin);
+
+std::vector<std::pair<mapnik::value_integer, std::string> > expected;
+try
+{
+    expected = read_features(create_datasource({}));
+}
+catch (std::exception const& ex)
+{
+    WARN( std::string("could not query postgis, skipping: ") + ex.what() );
+    return;
+}
+
+SECTION("plain query") {
+    REQUIRE( expected.size() == 2 );
+    REQUIRE( expected[0].first == 1 );
+    REQUIRE( expected[1].first == 2 );
+}
+
+SECTION("prepared statements, cursors and pipelining give the same features") {
+    std::vector<std::vector<std::pair<std::string, std::string> > > configurations = {
+        { {"prepared_statements", "true"} },
+        { {"cursor_size", "1"} },
+        { {"prepared_statements", "true"}, {"cursor_size", "1"} },
+        { {"pipeline_queries", "true"} },
+        { {"pipeline_queries", "true"}, {"prepared_statements", "true"} },
+        { {"max_async_connection", "2"}, {"prepared_statements", "true"} } };
+    for (auto const& options : configurations)
+    {
+        std::string name;
+        for (auto const& option : options) name += option.first + "=" + option.second + " ";
+        INFO( name );
+        mapnik::datasource_ptr ds = create_datasource(options);
+        // twice, the second query reuses the prepared statement
+        REQUIRE( read_features(ds) == expected );
+        REQUIRE( read_features(ds) == expected );
+    }
+}
+
+SECTION("pipelined queries can be read out of order") {
+    mapnik::datasource_ptr ds = create_datasource({ {"pipeline_queries", "true"}, {"prepared_statements", "true"} });
+    mapnik::feature_style_context_map ctx_map;
+    mapnik::processor_context_ptr ctx = ds->get_context(ctx_map);
+    mapnik::query q = test_query();
+    // queued one after the other on the same connection, read the other way round
+    mapnik::featureset_ptr first = ds->features_with_context(q, ctx);
+    mapnik::featureset_ptr second = ds->features_with_context(q, ctx);
+    mapnik::featureset_ptr third = ds->features_with_context(q, ctx);
+    REQUIRE( read_features(third) == expected );
+    REQUIRE( read_features(first) == expected );
+    REQUIRE( read_features(second) == expected );
+}
+
+}
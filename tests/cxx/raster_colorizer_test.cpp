@@ -0,0 +1,133 @@
+#include "catch.hpp"
+
+#include <mapnik/raster_colorizer.hpp>
+#include <mapnik/image.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/map.hpp>
+#include <mapnik/load_map.hpp>
+#include <mapnik/save_map.hpp>
+#include <mapnik/feature_type_style.hpp>
+#include <mapnik/rule.hpp>
+#include <mapnik/symbolizer.hpp>
+
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <memory>
+#include <string>
+#include <type_traits>
+
+namespace {
+
+const double nodata = -9999;
+
+mapnik::raster_colorizer make_colorizer(mapnik::colorizer_mode_enum mode)
+{
+    mapnik::raster_colorizer colorizer(mode, mapnik::color(0, 0, 0, 0));
+    colorizer.add_stop(mapnik::colorizer_stop(-100, mapnik::COLORIZER_INHERIT, mapnik::color(0, 0, 255)));
+    colorizer.add_stop(mapnik::colorizer_stop(0, mapnik::COLORIZER_INHERIT, mapnik::color(255, 255, 255, 128)));
+    colorizer.add_stop(mapnik::colorizer_stop(10, mapnik::COLORIZER_INHERIT, mapnik::color(0, 128, 0)));
+    colorizer.add_stop(mapnik::colorizer_stop(1000, mapnik::COLORIZER_INHERIT, mapnik::color(255, 0, 0)));
+    return colorizer;
+}
+
+// values over the stops (some exactly on them), with nodata pixels
+template <typename Image>
+Image make_image()
+{
+    using pixel_type = typename Image::pixel_type;
+    Image image(256, 64);
+    for (std::size_t y = 0; y < image.height(); ++y)
+    {
+        for (std::size_t x = 0; x < image.width(); ++x)
+        {
+            std::size_t i = y * image.width() + x;
+            double value = -200.0 + (static_cast<double>((i * 7919) % 16384) / 16384.0) * 1400.0;
+            if (i % 97 == 0) value = nodata;
+            else if (i % 101 == 0) value = 10;
+            else if (!std::is_integral<pixel_type>::value) value += 0.25;
+            image(x, y) = static_cast<pixel_type>(value);
+        }
+    }
+    return image;
+}
+
+bool within_one(unsigned a, unsigned b)
+{
+    for (unsigned shift = 0; shift < 32; shift += 8)
+    {
+        if (std::abs(static_cast<int>((a >> shift) & 0xff) - static_cast<int>((b >> shift) & 0xff)) > 1) return false;
+    }
+    return true;
+}
+
+// colorize() against get_color() on each pixel
+template <typename Image>
+void check_colorize(Image const& image, mapnik::colorizer_mode_enum mode, bool exact)
+{
+    using pixel_type = typename Image::pixel_type;
+    mapnik::raster_colorizer colorizer = make_colorizer(mode);
+    mapnik::feature_impl feature(std::make_shared<mapnik::context_type>(), 1);
+    mapnik::image_rgba8 out(image.width(), image.height());
+    colorizer.colorize(out, image, nodata, feature);
+    std::size_t mismatches = 0;
+    for (std::size_t y = 0; y < image.height(); ++y)
+    {
+        for (std::size_t x = 0; x < image.width(); ++x)
+        {
+            pixel_type value = image(x, y);
+            unsigned expected = std::fabs(value - nodata) < colorizer.get_epsilon() ? 0 : colorizer.get_color(value);
+            unsigned color = out(x, y);
+            if (exact ? color != expected : !within_one(color, expected)) ++mismatches;
+        }
+    }
+    REQUIRE( mismatches == 0 );
+}
+
+}
+
+TEST_CASE("raster colorizer") {
+
+SECTION("colorize matches get_color") {
+    mapnik::image_gray16s gray16s = make_image<mapnik::image_gray16s>();
+    mapnik::image_gray32f gray32f = make_image<mapnik::image_gray32f>();
+    // and a NaN pixel
+    gray32f(3, 5) = std::numeric_limits<float>::quiet_NaN();
+    for (auto mode : { mapnik::COLORIZER_LINEAR, mapnik::COLORIZER_DISCRETE, mapnik::COLORIZER_EXACT })
+    {
+        INFO( "mode " << static_cast<int>(mode) );
+        // integers through one color per value, exact in every mode
+        check_colorize(gray16s, mode, true);
+        // floats through buckets, linear colors within one per channel
+        check_colorize(gray32f, mode, mode != mapnik::COLORIZER_LINEAR);
+    }
+}
+
+SECTION("lut-size round trip") {
+    std::string xml("<Map><Style name=\"raster\"><Rule><RasterSymbolizer>"
+                    "<RasterColorizer default-mode=\"linear\" lut-size=\"256\">"
+                    "<stop value=\"0\" color=\"red\"/><stop value=\"100\" color=\"blue\"/>"
+                    "</RasterColorizer></RasterSymbolizer></Rule></Style></Map>");
+    for (unsigned pass = 0; pass < 2; ++pass)
+    {
+        mapnik::Map map(256, 256);
+        mapnik::load_map_string(map, xml);
+        auto style = map.find_style("raster");
+        REQUIRE( style );
+        auto const& sym = style->get_rules().front().get_symbolizers().front();
+        REQUIRE( sym.is<mapnik::raster_symbolizer>() );
+        auto colorizer = mapnik::get<mapnik::raster_colorizer_ptr>(mapnik::util::get<mapnik::raster_symbolizer>(sym),
+                                                                   mapnik::keys::colorizer);
+        REQUIRE( colorizer );
+        REQUIRE( colorizer->get_lut_size() == 256 );
+        xml = mapnik::save_map_to_string(map);
+        REQUIRE( xml.find("lut-size=\"256\"") != std::string::npos );
+    }
+    // the default isn't written
+    mapnik::Map map(256, 256);
+    mapnik::load_map_string(map, "<Map><Style name=\"raster\"><Rule><RasterSymbolizer>"
+                                 "<RasterColorizer/></RasterSymbolizer></Rule></Style></Map>");
+    REQUIRE( mapnik::save_map_to_string(map).find("lut-size") == std::string::npos );
+}
+
+}
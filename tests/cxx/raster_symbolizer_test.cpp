@@ -0,0 +1,147 @@
+#include "catch.hpp"
+
+#include <mapnik/renderer_common.hpp>
+#include <mapnik/renderer_common/process_raster_symbolizer.hpp>
+#include <mapnik/image.hpp>
+#include <mapnik/image_scaling.hpp>
+#include <mapnik/image_util.hpp>
+#include <mapnik/raster_colorizer.hpp>
+#include <mapnik/symbolizer.hpp>
+#include <mapnik/feature.hpp>
+
+#include <boost/optional.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+
+namespace {
+
+// what the renderer was asked to composite
+struct composited
+{
+    composited()
+        : image(), source(nullptr), x(0), y(0) {}
+
+    void operator() (mapnik::image_rgba8 const& data, mapnik::composite_mode_e, double, int start_x, int start_y)
+    {
+        image = data;
+        source = &data;
+        x = start_x;
+        y = start_y;
+    }
+
+    mapnik::image_rgba8 image;
+    mapnik::image_rgba8 const* source;
+    int x;
+    int y;
+};
+
+template <typename Image>
+Image make_image(std::size_t width, std::size_t height)
+{
+    using pixel_type = typename Image::pixel_type;
+    Image image(width, height);
+    std::uint32_t state = 4321;
+    for (std::size_t y = 0; y < height; ++y)
+    {
+        for (std::size_t x = 0; x < width; ++x)
+        {
+            state = state * 1103515245 + 12345;
+            image(x, y) = static_cast<pixel_type>(state >> 8);
+        }
+    }
+    return image;
+}
+
+// image::operator== compares the buffers, not their pixels
+template <typename Image>
+bool same_pixels(Image const& a, Image const& b)
+{
+    return a.width() == b.width() && a.height() == b.height() &&
+        std::equal(a.getBytes(), a.getBytes() + a.getSize(), b.getBytes());
+}
+
+template <typename Image>
+void dispatch(Image const& source, int start_x, int start_y, int width, int height, double ratio,
+              mapnik::raster_symbolizer const& sym, composited & result)
+{
+    mapnik::feature_impl feature(std::make_shared<mapnik::context_type>(), 1);
+    boost::optional<double> nodata;
+    mapnik::detail::image_dispatcher<composited> dispatcher(start_x, start_y, width, height, ratio, ratio,
+                                                            mapnik::SCALING_NEAR, 1.0, 1.0, mapnik::src_over,
+                                                            sym, feature, result, nodata);
+    dispatcher(source);
+}
+
+// scale_image_nearest() against scale_image_agg() at ratios k and 1/k
+template <typename Image>
+void check_nearest(Image const& source)
+{
+    for (double k : { 2.0, 3.0, 4.0, 7.0 })
+    {
+        for (double ratio : { k, 1.0 / k })
+        {
+            INFO( "ratio " << ratio );
+            std::size_t width = static_cast<std::size_t>(std::floor(source.width() * ratio + 0.5));
+            std::size_t height = static_cast<std::size_t>(std::floor(source.height() * ratio + 0.5));
+            Image nearest(width, height);
+            Image agg(width, height);
+            REQUIRE( mapnik::detail::scale_image_nearest(nearest, source, ratio, ratio) );
+            mapnik::scale_image_agg(agg, source, mapnik::SCALING_NEAR, ratio, ratio, 0.0, 0.0, 1.0);
+            REQUIRE( same_pixels(nearest, agg) );
+        }
+    }
+}
+
+}
+
+TEST_CASE("raster symbolizer") {
+
+SECTION("rgba8 at 1:1 is composited as is") {
+    mapnik::image_rgba8 source = make_image<mapnik::image_rgba8>(61, 47);
+    mapnik::raster_symbolizer sym;
+    composited result;
+    dispatch(source, 13, -5, 61, 47, 1.0, sym, result);
+    REQUIRE( result.source == &source );
+    REQUIRE( result.x == 13 );
+    REQUIRE( result.y == -5 );
+}
+
+SECTION("gray8 at 1:1 is colorized from the source") {
+    mapnik::image_gray8 source = make_image<mapnik::image_gray8>(61, 47);
+    auto colorizer = std::make_shared<mapnik::raster_colorizer>(mapnik::COLORIZER_LINEAR, mapnik::color(0, 0, 0, 0));
+    colorizer->add_stop(mapnik::colorizer_stop(0, mapnik::COLORIZER_INHERIT, mapnik::color(0, 0, 255, 64)));
+    colorizer->add_stop(mapnik::colorizer_stop(255, mapnik::COLORIZER_INHERIT, mapnik::color(255, 0, 0)));
+    mapnik::raster_symbolizer sym;
+    mapnik::put(sym, mapnik::keys::colorizer, colorizer);
+    composited result;
+    dispatch(source, 7, 11, 61, 47, 1.0, sym, result);
+    REQUIRE( result.x == 7 );
+    REQUIRE( result.y == 11 );
+
+    mapnik::feature_impl feature(std::make_shared<mapnik::context_type>(), 1);
+    mapnik::image_rgba8 expected(61, 47);
+    colorizer->colorize(expected, source, boost::optional<double>(), feature);
+    mapnik::premultiply_alpha(expected);
+    REQUIRE( same_pixels(result.image, expected) );
+}
+
+SECTION("nearest by whole factors picks the pixels of scale_image_agg") {
+    check_nearest(make_image<mapnik::image_rgba8>(61, 47));
+    check_nearest(make_image<mapnik::image_gray8>(61, 47));
+
+    // and through the dispatcher
+    mapnik::image_rgba8 source = make_image<mapnik::image_rgba8>(61, 47);
+    mapnik::raster_symbolizer sym;
+    composited result;
+    dispatch(source, 3, 4, 122, 94, 2.0, sym, result);
+    mapnik::image_rgba8 expected(122, 94);
+    mapnik::scale_image_agg(expected, source, mapnik::SCALING_NEAR, 2.0, 2.0, 0.0, 0.0, 1.0);
+    REQUIRE( same_pixels(result.image, expected) );
+    REQUIRE( result.x == 3 );
+    REQUIRE( result.y == 4 );
+}
+
+}
@@ -0,0 +1,135 @@
+#include "catch.hpp"
+
+#include <mapnik/datasource_cache.hpp>
+#include <mapnik/datasource.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/query.hpp>
+#include <mapnik/util/fs.hpp>
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// the tests write the spatial index and the initdb table next to copies in /tmp
+void copy_file(std::string const& from, std::string const& to)
+{
+    std::remove(to.c_str());
+    std::remove((to + ".index").c_str());
+    std::ifstream in(from.c_str(), std::ios::binary);
+    std::ofstream out(to.c_str(), std::ios::binary);
+    out << in.rdbuf();
+}
+
+mapnik::datasource_ptr create_datasource(std::vector<std::pair<std::string, std::string> > const& options)
+{
+    mapnik::parameters p;
+    p["type"] = "sqlite";
+    p["file"] = "/tmp/mapnik-sqlite-world.sqlite";
+    p["table"] = "world_merc";
+    for (auto const& option : options)
+    {
+        p[option.first] = option.second;
+    }
+    return mapnik::datasource_cache::instance().create(p);
+}
+
+// ids of all features, with the `runs` attribute when asked for
+std::vector<mapnik::value_integer> read_ids(mapnik::featureset_ptr const& fs, std::string const& runs = "")
+{
+    std::vector<mapnik::value_integer> ids;
+    while (mapnik::feature_ptr feature = fs->next())
+    {
+        ids.push_back(feature->id());
+        if (!runs.empty()) ids.push_back(feature->get(runs).to_int());
+    }
+    return ids;
+}
+
+mapnik::query world_query(mapnik::datasource_ptr const& ds)
+{
+    mapnik::query q(ds->envelope());
+    q.add_property_name("name");
+    return q;
+}
+
+}
+
+TEST_CASE("sqlite") {
+
+std::string plugin("./plugins/input/sqlite.input");
+if (!mapnik::util::exists(plugin))
+{
+    WARN( std::string("could not register ") + plugin );
+    return;
+}
+mapnik::datasource_cache::instance().register_datasource(plugin);
+copy_file("./tests/data/sqlite/world.sqlite", "/tmp/mapnik-sqlite-world.sqlite");
+copy_file("./tests/data/sqlite/empty.db", "/tmp/mapnik-sqlite-log.sqlite");
+
+SECTION("pooled connections use the attached spatial index") {
+    mapnik::datasource_ptr ds = create_datasource({ {"max_size", "2"} });
+    mapnik::query q = world_query(ds);
+    std::vector<mapnik::value_integer> expected = read_ids(ds->features(q));
+    REQUIRE( expected.size() == 245 );
+
+    // more featuresets open at once than pooled connections
+    std::vector<mapnik::featureset_ptr> featuresets;
+    for (std::size_t i = 0; i < 4; ++i)
+    {
+        featuresets.push_back(ds->features(q));
+        REQUIRE( featuresets.back() != mapnik::featureset_ptr() );
+    }
+    for (auto const& fs : featuresets)
+    {
+        REQUIRE( read_ids(fs) == expected );
+    }
+
+    // and concurrent queries
+    std::vector<std::vector<mapnik::value_integer> > results(4);
+    std::vector<std::thread> threads;
+    for (auto & result : results)
+    {
+        threads.emplace_back([&ds, &q, &result] {
+            for (std::size_t i = 0; i < 10; ++i)
+            {
+                result = read_ids(ds->features(q));
+            }
+        });
+    }
+    for (auto & thread : threads)
+    {
+        thread.join();
+    }
+    for (auto const& result : results)
+    {
+        REQUIRE( result == expected );
+    }
+}
+
+SECTION("initdb runs once") {
+    // a second run would fail as the table already exists
+    mapnik::datasource_ptr ds = create_datasource({
+        {"table", "(SELECT *, (SELECT count(*) FROM log.runs) AS runs FROM world_merc)"},
+        {"geometry_table", "world_merc"},
+        {"key_field", "OGC_FID"},
+        {"attachdb", "log@/tmp/mapnik-sqlite-log.sqlite"},
+        {"initdb", "CREATE TABLE log.runs AS SELECT 1 AS n"} });
+    mapnik::query q = world_query(ds);
+    q.add_property_name("runs");
+    std::vector<mapnik::value_integer> first;
+    std::thread thread([&ds, &q, &first] { first = read_ids(ds->features(q), "runs"); });
+    thread.join();
+    std::vector<mapnik::value_integer> second = read_ids(ds->features(q), "runs");
+    REQUIRE( first.size() == 2 * 245 );
+    REQUIRE( first == second );
+    for (std::size_t i = 1; i < first.size(); i += 2)
+    {
+        REQUIRE( first[i] == 1 );
+    }
+}
+
+}
@@ -6,6 +6,7 @@
 #include <mapnik/image_reader.hpp>
 #include <mapnik/image_util.hpp>
 #include <mapnik/util/file_io.hpp>
+#include <mapnik/util/parallel.hpp>
 
 #include <mapnik/tiff_io.hpp>
 #include "../../src/tiff_reader.cpp"
@@ -214,6 +215,55 @@ SECTION("gray8 tiled") {
     TIFF_READ_ONE_PIXEL
 }
 
+SECTION("gray8 tiled overviews") {
+    TIFF_ASSERT("./tests/data/tiff/ndvi_256x256_gray8_tiled_overviews.tif")
+    REQUIRE( tiff_reader.is_tiled() == true );
+    REQUIRE( tiff_reader.tile_width() == 64 );
+    REQUIRE( tiff_reader.tile_height() == 64 );
+    REQUIRE( reader->overviews() == 2 );
+    REQUIRE( reader->overview_width(1) == 128 );
+    REQUIRE( reader->overview_height(2) == 64 );
+    REQUIRE( reader->overview_for_scale(1.0) == 0 );
+    REQUIRE( reader->overview_for_scale(3.0) == 1 );
+    REQUIRE( reader->overview_for_scale(16.0) == 2 );
+    REQUIRE( reader2->overviews() == 2 );
+    mapnik::image_any data = reader->read_overview(1, 0, 0, 128, 128);
+    REQUIRE( data.is<mapnik::image_gray8>() == true );
+    REQUIRE( data.width() == 128 );
+    REQUIRE( data.height() == 128 );
+    mapnik::image_any data2 = reader2->read_overview(1, 0, 0, 128, 128);
+    REQUIRE( mapnik::compare(data, data2) == 0 );
+    // windows across several tiles, decoded on the calling thread then in bands
+    std::size_t cache_size = 16 * 1024 * 1024;
+    tiff_reader.set_tile_cache_size(0);
+    mapnik::image_any full = tiff_reader.read(0, 0, 256, 256);
+    unsigned threads = mapnik::util::parallel_threads();
+    for (unsigned parallel : { 0, 4 })
+    {
+        mapnik::util::set_parallel_threads(parallel);
+        mapnik::image_any window = tiff_reader.read(50, 70, 100, 120);
+        mapnik::image_gray8 const& w = mapnik::util::get<mapnik::image_gray8>(window);
+        mapnik::image_gray8 const& f = mapnik::util::get<mapnik::image_gray8>(full);
+        REQUIRE( w(0, 0) == f(50, 70) );
+        REQUIRE( w(99, 119) == f(149, 189) );
+    }
+    mapnik::util::set_parallel_threads(threads);
+    // decoded tiles outlive their reader, but not those of memory buffers
+    tiff_reader.set_tile_cache_size(cache_size);
+    REQUIRE( tiff_reader.tile_cache_size() == 0 );
+    {
+        mapnik::tiff_reader<boost::iostreams::file_source> other("./tests/data/tiff/ndvi_256x256_gray8_tiled_overviews.tif");
+        other.read_overview(2, 0, 0, 64, 64);
+    }
+    std::size_t cached = tiff_reader.tile_cache_size();
+    REQUIRE( cached > 0 );
+    mapnik::image_any overview = tiff_reader.read_overview(2, 0, 0, 64, 64);
+    REQUIRE( overview.width() == 64 );
+    REQUIRE( tiff_reader.tile_cache_size() == cached );
+    tiff_reader2.read_overview(1, 0, 0, 128, 128);
+    REQUIRE( tiff_reader.tile_cache_size() == cached );
+}
+
 SECTION("gray16 striped") {
     TIFF_ASSERT("./tests/data/tiff/ndvi_256x256_gray16_striped.tif")
     REQUIRE( tiff_reader.rows_per_strip() == 16 );
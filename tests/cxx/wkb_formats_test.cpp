@@ -118,4 +118,47 @@ SECTION("wkb") {
         std::clog << "threw: " << ex.what() << "\n";
     }
 }
+
+SECTION("twkb") {
+
+    // POINT(1.5 -2.25) at precision 2
+    unsigned char point_blob[] = { 0x41, 0x00, 0xAC, 0x02, 0xC1, 0x03 };
+    // LINESTRING(1 1,5 5) at precision 0
+    unsigned char line_blob[] = { 0x02, 0x00, 0x02, 0x02, 0x02, 0x08, 0x08 };
+    // LINESTRING claiming 5 points but truncated
+    unsigned char truncated_blob[] = { 0x02, 0x00, 0x05, 0x02 };
+    // empty POLYGON
+    unsigned char empty_blob[] = { 0x03, 0x10 };
+
+    try {
+        mapnik::geometry::geometry<double> geom = mapnik::geometry_utils::from_twkb((const char*)point_blob,
+                                                                                 sizeof(point_blob) / sizeof(point_blob[0]));
+        REQUIRE(geom.is<mapnik::geometry::point<double> >());
+        auto const& pt = geom.get<mapnik::geometry::point<double> >();
+        REQUIRE(pt.x == Approx(1.5));
+        REQUIRE(pt.y == Approx(-2.25));
+
+        geom = mapnik::geometry_utils::from_twkb((const char*)line_blob,
+                                                 sizeof(line_blob) / sizeof(line_blob[0]));
+        REQUIRE(geom.is<mapnik::geometry::line_string<double> >());
+        auto const& line = geom.get<mapnik::geometry::line_string<double> >();
+        REQUIRE(line.size() == 2);
+        REQUIRE(line[0].x == 1);
+        REQUIRE(line[0].y == 1);
+        REQUIRE(line[1].x == 5);
+        REQUIRE(line[1].y == 5);
+
+        geom = mapnik::geometry_utils::from_twkb((const char*)truncated_blob,
+                                                 sizeof(truncated_blob) / sizeof(truncated_blob[0]));
+        REQUIRE(geom.is<mapnik::geometry::geometry_empty>());
+
+        geom = mapnik::geometry_utils::from_twkb((const char*)empty_blob,
+                                                 sizeof(empty_blob) / sizeof(empty_blob[0]));
+        REQUIRE(geom.is<mapnik::geometry::geometry_empty>());
+
+    } catch (std::exception const& ex) {
+        REQUIRE(false);
+        std::clog << "threw: " << ex.what() << "\n";
+    }
+}
 }
@@ -0,0 +1,223 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#include <cstring>
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <mapnik/box2d.hpp>
+#include <mapnik/util/fs.hpp>
+#include <mapnik/json/positions_grammar.hpp>
+#include <mapnik/json/extract_bounding_box_grammar_impl.hpp>
+#include "geojson_index.hpp"
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-parameter"
+#pragma GCC diagnostic ignored "-Wunused-local-typedef"
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/program_options.hpp>
+#include <boost/spirit/include/qi.hpp>
+#pragma GCC diagnostic pop
+
+using mapnik::box2d;
+
+const unsigned DEFAULT_NODE_SIZE=16;
+
+// writes the sidecar index read by the geojson plugin (see geojson_index.hpp)
+bool write_index(std::string const& index_name, mapnik::util::packed_rtree const& tree,
+                 mapnik::json::boxes const& boxes, std::uint64_t source_size, std::time_t source_mtime)
+{
+    std::ofstream file(index_name.c_str(), std::ios::out | std::ios::trunc | std::ios::binary);
+    if (!file) return false;
+    geojson_index_header header;
+    std::memset(&header, 0, sizeof(header));
+    header.tree = tree.header(geojson_index_magic, geojson_index_version);
+    header.source_size = source_size;
+    header.source_mtime = source_mtime;
+    if (!boxes.empty())
+    {
+        header.first_offset = boxes.front().second.first;
+        header.first_size = boxes.front().second.second;
+    }
+    geojson_index_little_endian(header);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (std::size_t i = 0; i < tree.count(); ++i)
+    {
+        box2d<double> const& box = tree.box(i);
+        geojson_index_entry entry = {{ box.minx(), box.miny(), box.maxx(), box.maxy() }, { tree.offset(i), 0 }};
+        if (i < tree.count_items())
+        {
+            // leaves were inserted with the position of their feature in `boxes`
+            auto const& range = boxes[tree.offset(i)].second;
+            entry.values[0] = range.first;
+            entry.values[1] = range.second;
+        }
+        mapnik::util::packed_rtree_write(file, entry);
+    }
+    return file.good();
+}
+
+int main (int argc,char** argv)
+{
+    namespace po = boost::program_options;
+    using std::string;
+    using std::vector;
+    using std::clog;
+    using std::endl;
+
+    bool verbose=false;
+    unsigned node_size=DEFAULT_NODE_SIZE;
+    unsigned jobs=1;
+    vector<string> geojson_files;
+
+    try
+    {
+        po::options_description desc("geojsonindex utility");
+        desc.add_options()
+            ("help,h", "produce usage message")
+            ("version,V","print version string")
+            ("verbose,v","verbose output")
+            ("node-size,n",po::value<unsigned int>(),"R-tree node size (default 16)")
+            ("jobs,j",po::value<unsigned int>(),"threads used to sort the R-tree (default 1)")
+            ("geojson_files",po::value<vector<string> >(),"GeoJSON files to index: file1 file2 ...fileN")
+            ;
+
+        po::positional_options_description p;
+        p.add("geojson_files",-1);
+        po::variables_map vm;
+        po::store(po::command_line_parser(argc, argv).options(desc).positional(p).run(), vm);
+        po::notify(vm);
+
+        if (vm.count("version"))
+        {
+            clog<<"version 0.1.0" <<std::endl;
+            return 1;
+        }
+
+        if (vm.count("help"))
+        {
+            clog << desc << endl;
+            return 1;
+        }
+        if (vm.count("verbose"))
+        {
+            verbose = true;
+        }
+        if (vm.count("node-size"))
+        {
+            node_size = std::max(2u, vm["node-size"].as<unsigned int>());
+        }
+        if (vm.count("jobs"))
+        {
+            jobs = vm["jobs"].as<unsigned int>();
+        }
+        if (vm.count("geojson_files"))
+        {
+            geojson_files=vm["geojson_files"].as< vector<string> >();
+        }
+    }
+    catch (std::exception const& ex)
+    {
+        clog << "Error: " << ex.what() << endl;
+        return -1;
+    }
+
+    if (geojson_files.size() == 0)
+    {
+        clog << "no GeoJSON files to index" << endl;
+        return 0;
+    }
+    clog << "node size:" << node_size << endl;
+
+    using base_iterator_type = char const*;
+    const mapnik::json::extract_bounding_box_grammar<base_iterator_type> bbox_grammar;
+    int result = 0;
+    for (auto const& filename : geojson_files)
+    {
+        clog << "processing " << filename << endl;
+        if (!mapnik::util::exists(filename))
+        {
+            clog << "Error : file " << filename << " does not exist" << endl;
+            result = -1;
+            continue;
+        }
+        // read the time first, a file changed while it is indexed gets a stale index
+        std::time_t mtime = mapnik::util::last_write_time(filename);
+        mapnik::json::boxes boxes;
+        std::uint64_t size = 0;
+        try
+        {
+            boost::interprocess::file_mapping mapping(filename.c_str(), boost::interprocess::read_only);
+            boost::interprocess::mapped_region region(mapping, boost::interprocess::read_only);
+            region.advise(boost::interprocess::mapped_region::advice_sequential);
+            base_iterator_type start = static_cast<char const*>(region.get_address());
+            base_iterator_type end = start + region.get_size();
+            size = region.get_size();
+            boost::spirit::ascii::space_type space;
+            if (!boost::spirit::qi::phrase_parse(start, end, (bbox_grammar)(boost::phoenix::ref(boxes)), space))
+            {
+                clog << "Error : could not parse " << filename << endl;
+                result = -1;
+                continue;
+            }
+        }
+        catch (std::exception const& ex)
+        {
+            clog << "Error : cannot open " << filename << ": " << ex.what() << endl;
+            result = -1;
+            continue;
+        }
+
+        box2d<double> extent;
+        for (auto const& item : boxes)
+        {
+            if (!extent.valid()) extent = item.first;
+            else extent.expand_to_include(item.first);
+        }
+        mapnik::util::packed_rtree tree(extent, node_size);
+        for (std::size_t i = 0; i < boxes.size(); ++i)
+        {
+            tree.insert(i, boxes[i].first);
+            if (verbose)
+            {
+                clog << "feature " << i << " offset=" << boxes[i].second.first
+                     << " size=" << boxes[i].second.second << " box=" << boxes[i].first << endl;
+            }
+        }
+        tree.build(jobs);
+        clog << " number features=" << boxes.size() << endl;
+        clog << " number nodes=" << tree.count() << endl;
+        clog << " extent:" << extent << endl;
+
+        std::string index_name = filename + ".index";
+        if (!write_index(index_name, tree, boxes, size, mtime))
+        {
+            clog << "cannot write index file \"" << index_name << "\"" << endl;
+            result = -1;
+        }
+    }
+
+    clog << "done!" << endl;
+    return result;
+}
@@ -39,6 +39,8 @@ boost_program_options = 'boost_program_options%s' % env['BOOST_APPEND']
 boost_system = 'boost_system%s' % env['BOOST_APPEND']
 libraries =  [env['MAPNIK_NAME'], boost_program_options, boost_system]
 libraries.append(env['ICU_LIB_NAME'])
+if env['PLATFORM'] == 'Linux':
+    libraries.append('pthread')
 if env['RUNTIME_LINK'] == 'static':
     libraries.extend(copy(env['LIBMAPNIK_LIBS']))
     if env['PLATFORM'] == 'Linux':
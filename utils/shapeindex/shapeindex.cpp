@@ -26,6 +26,7 @@
 #include <string>
 #include <mapnik/util/fs.hpp>
 #include "quadtree.hpp"
+#include "shp_packed_index.hpp"
 #include "shapefile.hpp"
 #include "shape_io.hpp"
 
@@ -39,6 +40,7 @@
 
 const int DEFAULT_DEPTH = 8;
 const double DEFAULT_RATIO=0.55;
+const unsigned DEFAULT_NODE_SIZE=16;
 
 int main (int argc,char** argv)
 {
@@ -52,6 +54,9 @@ int main (int argc,char** argv)
     bool verbose=false;
     unsigned int depth=DEFAULT_DEPTH;
     double ratio=DEFAULT_RATIO;
+    bool packed=false;
+    unsigned node_size=DEFAULT_NODE_SIZE;
+    unsigned jobs=1;
     vector<string> shape_files;
 
     try
@@ -63,6 +68,9 @@ int main (int argc,char** argv)
             ("verbose,v","verbose output")
             ("depth,d", po::value<unsigned int>(), "max tree depth\n(default 8)")
             ("ratio,r",po::value<double>(),"split ratio (default 0.55)")
+            ("packed,p","write a packed Hilbert R-tree (.hrtree) instead of the quadtree (.index)")
+            ("node-size,n",po::value<unsigned int>(),"packed R-tree node size (default 16)")
+            ("jobs,j",po::value<unsigned int>(),"threads used to sort the packed R-tree (default 1)")
             ("shape_files",po::value<vector<string> >(),"shape files to index: file1 file2 ...fileN")
             ;
 
@@ -95,6 +103,18 @@ int main (int argc,char** argv)
         {
             ratio = vm["ratio"].as<double>();
         }
+        if (vm.count("packed"))
+        {
+            packed = true;
+        }
+        if (vm.count("node-size"))
+        {
+            node_size = vm["node-size"].as<unsigned int>();
+        }
+        if (vm.count("jobs"))
+        {
+            jobs = vm["jobs"].as<unsigned int>();
+        }
 
         if (vm.count("shape_files"))
         {
@@ -107,8 +127,15 @@ int main (int argc,char** argv)
         return -1;
     }
 
-    clog << "max tree depth:" << depth << endl;
-    clog << "split ratio:" << ratio << endl;
+    if (packed)
+    {
+        clog << "node size:" << node_size << endl;
+    }
+    else
+    {
+        clog << "max tree depth:" << depth << endl;
+        clog << "split ratio:" << ratio << endl;
+    }
 
     //vector<string>::const_iterator itr = shape_files.begin();
     if (shape_files.size() == 0)
@@ -155,6 +182,7 @@ int main (int argc,char** argv)
         int pos=50;
         shp.seek(pos*2);
         quadtree<int> tree(extent,depth,ratio);
+        mapnik::util::packed_rtree packed_tree(extent,node_size);
         int count=0;
         while (true) {
 
@@ -220,7 +248,14 @@ int main (int argc,char** argv)
                 shp.read_envelope(item_ext);
                 shp.skip(2*content_length-4*8-4);
             }
-            tree.insert(offset,item_ext);
+            if (packed)
+            {
+                packed_tree.insert(offset,item_ext);
+            }
+            else
+            {
+                tree.insert(offset,item_ext);
+            }
             if (verbose)
             {
                 clog << "record number " << record_number << " box=" << item_ext << endl;
@@ -234,11 +269,19 @@ int main (int argc,char** argv)
 
         clog << " number shapes=" << count << endl;
 
-        std::fstream file((shapename+".index").c_str(),
+        std::string index_name = shapename + (packed ? ".hrtree" : ".index");
+        std::fstream file(index_name.c_str(),
                           std::ios::in | std::ios::out | std::ios::trunc | std::ios::binary);
         if (!file) {
             clog << "cannot open index file for writing file \""
-                 << (shapename+".index") << "\"" << endl;
+                 << index_name << "\"" << endl;
+        } else if (packed) {
+            packed_tree.build(jobs);
+            std::clog<<" number nodes="<<packed_tree.count()<<std::endl;
+            file.exceptions(std::ios::failbit | std::ios::badbit);
+            write_packed_index(file, packed_tree);
+            file.flush();
+            file.close();
         } else {
             tree.trim();
             std::clog<<" number nodes="<<tree.count()<<std::endl;
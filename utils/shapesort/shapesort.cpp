@@ -0,0 +1,368 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+// Rewrites a shapefile (.shp/.shx/.dbf) with its records in Hilbert curve
+// order of their bounding boxes and writes the packed R-tree (.hrtree) for
+// the new file in the same pass. Records close in space end up close in the
+// file, so the shape plugin reads the hits of a query in a few long runs.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <mapnik/util/fs.hpp>
+#include "shape_io.hpp"
+#include "shp_packed_index.hpp"
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-parameter"
+#pragma GCC diagnostic ignored "-Wunused-local-typedef"
+#include <boost/algorithm/string.hpp>
+#include <boost/program_options.hpp>
+#pragma GCC diagnostic pop
+
+const unsigned DEFAULT_NODE_SIZE=16;
+
+namespace {
+
+struct record_info
+{
+    std::uint64_t offset;   // byte offset of the record header in the input .shp
+    std::int32_t number;    // record number, i.e. the 1-based row in the .dbf
+    std::int32_t length;    // content length in bytes
+};
+
+std::int32_t xdr_integer(const char* data)
+{
+    std::int32_t val;
+    read_int32_xdr(data, val);
+    return val;
+}
+
+std::int32_t ndr_integer(const char* data)
+{
+    std::int32_t val;
+    read_int32_ndr(data, val);
+    return val;
+}
+
+double ndr_double(const char* data)
+{
+    double val;
+    read_double_ndr(data, val);
+    return val;
+}
+
+void write_xdr_integer(std::ostream & out, std::int32_t val)
+{
+    char b[4] = { static_cast<char>((val >> 24) & 0xff), static_cast<char>((val >> 16) & 0xff),
+                  static_cast<char>((val >> 8) & 0xff), static_cast<char>(val & 0xff) };
+    out.write(b, 4);
+}
+
+// bounding box of the record content, false for null shapes
+bool record_extent(std::vector<char> const& content, box2d<double> & ext)
+{
+    if (content.size() < 4) return false;
+    int shape_type = ndr_integer(content.data());
+    switch (shape_type)
+    {
+    case shape_io::shape_null:
+        return false;
+    case shape_io::shape_point:
+    case shape_io::shape_pointm:
+    case shape_io::shape_pointz:
+    {
+        if (content.size() < 20) return false;
+        double x = ndr_double(&content[4]);
+        double y = ndr_double(&content[12]);
+        ext.init(x, y, x, y);
+        return true;
+    }
+    default:
+        if (content.size() < 36) return false;
+        ext.init(ndr_double(&content[4]), ndr_double(&content[12]),
+                 ndr_double(&content[20]), ndr_double(&content[28]));
+        return true;
+    }
+}
+
+bool copy_file(std::string const& from, std::string const& to)
+{
+    std::ifstream in(from.c_str(), std::ios::in | std::ios::binary);
+    std::ofstream out(to.c_str(), std::ios::out | std::ios::trunc | std::ios::binary);
+    if (!in || !out) return false;
+    out << in.rdbuf();
+    return bool(out);
+}
+
+}
+
+int main (int argc,char** argv)
+{
+    using namespace mapnik;
+    namespace po = boost::program_options;
+    using std::string;
+    using std::vector;
+    using std::clog;
+    using std::endl;
+
+    bool verbose=false;
+    unsigned node_size=DEFAULT_NODE_SIZE;
+    unsigned jobs=1;
+    vector<string> shape_files;
+
+    try
+    {
+        po::options_description desc("shapesort utility");
+        desc.add_options()
+            ("help,h", "produce usage message")
+            ("version,V","print version string")
+            ("verbose,v","verbose output")
+            ("node-size,n",po::value<unsigned int>(),"packed R-tree node size (default 16)")
+            ("jobs,j",po::value<unsigned int>(),"threads used to sort the records (default 1)")
+            ("shape_files",po::value<vector<string> >(),"input and output shape file: input.shp output.shp")
+            ;
+
+        po::positional_options_description p;
+        p.add("shape_files",-1);
+        po::variables_map vm;
+        po::store(po::command_line_parser(argc, argv).options(desc).positional(p).run(), vm);
+        po::notify(vm);
+
+        if (vm.count("version"))
+        {
+            clog<<"version 0.1.0" <<std::endl;
+            return 1;
+        }
+
+        if (vm.count("help"))
+        {
+            clog << desc << endl;
+            return 1;
+        }
+        if (vm.count("verbose"))
+        {
+            verbose = true;
+        }
+        if (vm.count("node-size"))
+        {
+            node_size = vm["node-size"].as<unsigned int>();
+        }
+        if (vm.count("jobs"))
+        {
+            jobs = vm["jobs"].as<unsigned int>();
+        }
+        if (vm.count("shape_files"))
+        {
+            shape_files=vm["shape_files"].as< vector<string> >();
+        }
+    }
+    catch (std::exception const& ex)
+    {
+        clog << "Error: " << ex.what() << endl;
+        return -1;
+    }
+
+    if (shape_files.size() != 2)
+    {
+        clog << "usage: shapesort [options] input.shp output.shp" << endl;
+        return -1;
+    }
+
+    string input (shape_files[0]);
+    string output (shape_files[1]);
+    boost::algorithm::ireplace_last(input,".shp","");
+    boost::algorithm::ireplace_last(output,".shp","");
+    if (input == output)
+    {
+        clog << "Error : input and output must be different files" << endl;
+        return -1;
+    }
+    if (! mapnik::util::exists (input + ".shp") || ! mapnik::util::exists (input + ".dbf"))
+    {
+        clog << "Error : " << input << ".shp or " << input << ".dbf does not exist" << endl;
+        return -1;
+    }
+
+    std::ifstream shp ((input + ".shp").c_str(), std::ios::in | std::ios::binary);
+    std::ifstream dbf ((input + ".dbf").c_str(), std::ios::in | std::ios::binary);
+    char shp_header[100];
+    if (!shp.read(shp_header, 100) || xdr_integer(shp_header) != 9994)
+    {
+        clog << "Error : " << input << ".shp is not a shape file" << endl;
+        return -1;
+    }
+    // the length is in 16-bit words, read it unsigned to allow files up to 4GB
+    std::uint64_t file_length = 2 * static_cast<std::uint64_t>(static_cast<std::uint32_t>(xdr_integer(shp_header + 24)));
+    box2d<double> extent(ndr_double(shp_header + 36), ndr_double(shp_header + 44),
+                         ndr_double(shp_header + 52), ndr_double(shp_header + 60));
+    clog << "extent:" << extent << endl;
+    clog << "node size:" << node_size << endl;
+
+    // scan the records, the tree refers to them by their position in `records`
+    vector<record_info> records;
+    vector<std::size_t> null_records;
+    mapnik::util::packed_rtree tree(extent, node_size);
+    vector<char> content;
+    std::uint64_t offset = 100;
+    while (offset + 8 <= file_length)
+    {
+        char header[8];
+        if (!shp.read(header, 8)) break;
+        record_info rec { offset, xdr_integer(header), 2 * xdr_integer(header + 4) };
+        if (rec.length < 0 || offset + 8 + rec.length > file_length)
+        {
+            clog << "Error : invalid record at offset " << offset << endl;
+            return -1;
+        }
+        content.resize(rec.length);
+        if (!shp.read(content.data(), rec.length)) break;
+        box2d<double> item_ext;
+        if (record_extent(content, item_ext))
+        {
+            tree.insert(records.size(), item_ext);
+            if (verbose)
+            {
+                clog << "record number " << rec.number << " box=" << item_ext << endl;
+            }
+        }
+        else
+        {
+            // null shapes are not indexed and go to the end of the file
+            null_records.push_back(records.size());
+        }
+        records.push_back(rec);
+        offset += 8 + rec.length;
+    }
+    clog << " number shapes=" << records.size() << endl;
+
+    tree.build(jobs);
+    vector<std::size_t> order;
+    order.reserve(records.size());
+    for (std::size_t i = 0; i < tree.count_items(); ++i)
+    {
+        order.push_back(tree.offset(i));
+    }
+    order.insert(order.end(), null_records.begin(), null_records.end());
+
+    char dbf_header[32];
+    if (!dbf.read(dbf_header, 32))
+    {
+        clog << "Error : cannot read " << input << ".dbf" << endl;
+        return -1;
+    }
+    int dbf_header_length = static_cast<unsigned char>(dbf_header[8]) | (static_cast<unsigned char>(dbf_header[9]) << 8);
+    int dbf_record_length = static_cast<unsigned char>(dbf_header[10]) | (static_cast<unsigned char>(dbf_header[11]) << 8);
+    int dbf_num_records = ndr_integer(dbf_header + 4);
+    vector<char> dbf_fields(std::max(0, dbf_header_length - 32));
+    dbf.read(dbf_fields.data(), dbf_fields.size());
+
+    std::ofstream shp_out ((output + ".shp").c_str(), std::ios::out | std::ios::trunc | std::ios::binary);
+    std::ofstream shx_out ((output + ".shx").c_str(), std::ios::out | std::ios::trunc | std::ios::binary);
+    std::ofstream dbf_out ((output + ".dbf").c_str(), std::ios::out | std::ios::trunc | std::ios::binary);
+    if (!shp_out || !shx_out || !dbf_out)
+    {
+        clog << "Error : cannot open " << output << " for writing" << endl;
+        return -1;
+    }
+    try
+    {
+        shp_out.exceptions(std::ios::failbit | std::ios::badbit);
+        shx_out.exceptions(std::ios::failbit | std::ios::badbit);
+        dbf_out.exceptions(std::ios::failbit | std::ios::badbit);
+
+        // the .shp header stays the same, the .shx one only differs in length
+        shp_out.write(shp_header, 100);
+        shx_out.write(shp_header, 24);
+        write_xdr_integer(shx_out, 50 + 4 * static_cast<std::int32_t>(order.size()));
+        shx_out.write(shp_header + 28, 72);
+
+        // one row per record written
+        for (int i = 0; i < 4; ++i)
+        {
+            dbf_header[4 + i] = static_cast<char>((order.size() >> (8 * i)) & 0xff);
+        }
+        dbf_out.write(dbf_header, 32);
+        dbf_out.write(dbf_fields.data(), dbf_fields.size());
+
+        vector<char> row(dbf_record_length, ' ');
+        std::uint64_t out_offset = 100;
+        for (std::size_t i = 0; i < order.size(); ++i)
+        {
+            record_info const& rec = records[order[i]];
+            content.resize(rec.length);
+            shp.clear();
+            shp.seekg(rec.offset + 8, std::ios::beg);
+            if (!shp.read(content.data(), rec.length))
+            {
+                clog << "Error : cannot read record at offset " << rec.offset << endl;
+                return -1;
+            }
+            // renumber the records so they keep pointing at their .dbf row
+            write_xdr_integer(shp_out, static_cast<std::int32_t>(i + 1));
+            write_xdr_integer(shp_out, rec.length / 2);
+            shp_out.write(content.data(), rec.length);
+            write_xdr_integer(shx_out, static_cast<std::int32_t>(out_offset / 2));
+            write_xdr_integer(shx_out, rec.length / 2);
+            if (i < tree.count_items())
+            {
+                tree.set_offset(i, out_offset);
+            }
+            out_offset += 8 + rec.length;
+
+            std::fill(row.begin(), row.end(), ' ');
+            if (rec.number > 0 && rec.number <= dbf_num_records)
+            {
+                dbf.clear();
+                dbf.seekg(dbf_header_length + static_cast<std::uint64_t>(rec.number - 1) * dbf_record_length, std::ios::beg);
+                dbf.read(row.data(), row.size());
+            }
+            dbf_out.write(row.data(), row.size());
+        }
+        dbf_out.put('\x1a');
+
+        std::ofstream index_out ((output + ".hrtree").c_str(), std::ios::out | std::ios::trunc | std::ios::binary);
+        index_out.exceptions(std::ios::failbit | std::ios::badbit);
+        write_packed_index(index_out, tree, packed_index_sorted);
+        clog << " number nodes=" << tree.count() << endl;
+    }
+    catch (std::exception const& ex)
+    {
+        clog << "Error : writing " << output << " failed: " << ex.what() << endl;
+        return -1;
+    }
+
+    for (auto const& ext : { ".prj", ".cpg" })
+    {
+        if (mapnik::util::exists(input + ext) && !copy_file(input + ext, output + ext))
+        {
+            clog << "Error : cannot copy " << input << ext << endl;
+        }
+    }
+
+    clog << "done!" << endl;
+    return 0;
+}